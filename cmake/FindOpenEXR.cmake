@@ -0,0 +1,79 @@
+# Simple module to find OpenEXR. Handles the library names of both OpenEXR 2
+# (IlmImf, with Half) and OpenEXR 3 (OpenEXR, with Imath in its own package).
+#
+# Input variables:
+#  OPENEXR_LOCATION
+#
+# Output variables:
+#  OPENEXR_FOUND
+#  OPENEXR_INCLUDE_DIRS
+#  OPENEXR_LIBRARIES
+#
+
+set(_openexr_HINTS
+    ${OPENEXR_LOCATION}
+    $ENV{OPENEXR_LOCATION}
+    ${PXR_USD_LOCATION}
+    $ENV{PXR_USD_LOCATION})
+
+find_path(OPENEXR_INCLUDE_DIR
+    NAMES
+        OpenEXR/ImfMultiPartOutputFile.h
+    HINTS
+        ${_openexr_HINTS}
+    PATH_SUFFIXES
+        include
+    DOC
+        "OpenEXR include directory")
+
+# OpenEXR 3 installs the Imath headers next to its own.
+find_path(OPENEXR_IMATH_INCLUDE_DIR
+    NAMES
+        ImathBox.h
+    HINTS
+        ${_openexr_HINTS}
+    PATH_SUFFIXES
+        include/Imath
+        include/OpenEXR
+    DOC
+        "Imath include directory")
+
+find_library(OPENEXR_IMF_LIBRARY
+    NAMES
+        OpenEXR
+        IlmImf
+    HINTS
+        ${_openexr_HINTS}
+    PATH_SUFFIXES
+        lib
+        lib64
+    DOC
+        "OpenEXR library path")
+
+set(OPENEXR_LIBRARIES ${OPENEXR_IMF_LIBRARY})
+foreach(_openexr_LIB Iex IlmThread Imath Half)
+    find_library(OPENEXR_${_openexr_LIB}_LIBRARY
+        NAMES
+            ${_openexr_LIB}
+        HINTS
+            ${_openexr_HINTS}
+        PATH_SUFFIXES
+            lib
+            lib64)
+    if(OPENEXR_${_openexr_LIB}_LIBRARY)
+        list(APPEND OPENEXR_LIBRARIES ${OPENEXR_${_openexr_LIB}_LIBRARY})
+    endif()
+    mark_as_advanced(OPENEXR_${_openexr_LIB}_LIBRARY)
+endforeach()
+
+set(OPENEXR_INCLUDE_DIRS
+    ${OPENEXR_INCLUDE_DIR}
+    ${OPENEXR_INCLUDE_DIR}/OpenEXR
+    ${OPENEXR_IMATH_INCLUDE_DIR})
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(OpenEXR DEFAULT_MSG
+    OPENEXR_INCLUDE_DIR OPENEXR_IMATH_INCLUDE_DIR OPENEXR_IMF_LIBRARY)
+
+mark_as_advanced(OPENEXR_INCLUDE_DIR OPENEXR_IMATH_INCLUDE_DIR
+    OPENEXR_IMF_LIBRARY)
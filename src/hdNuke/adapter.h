@@ -35,8 +35,20 @@ public:
         return _sharedState;
     }
 
+    // Moves an adapter converted against another shared state (e.g. a
+    // staged scene's) over to this one. For updates only.
+    inline void SetSharedState(AdapterSharedState* statePtr) {
+        _sharedState = statePtr;
+    }
+
+protected:
+    // For updates only; queries must leave the shared state alone.
+    inline AdapterSharedState* _GetMutableSharedState() {
+        return _sharedState;
+    }
+
 private:
-    const AdapterSharedState* _sharedState;
+    AdapterSharedState* _sharedState;
 };
 
 
@@ -0,0 +1,137 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <algorithm>
+
+#include <pxr/base/arch/hash.h>
+#include <pxr/base/gf/matrix3f.h>
+#include <pxr/base/gf/matrix4f.h>
+#include <pxr/base/gf/vec2f.h>
+#include <pxr/base/gf/vec3f.h>
+#include <pxr/base/gf/vec4f.h>
+#include <pxr/base/vt/array.h>
+
+#include "arrayPool.h"
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+namespace
+{
+    template <typename T>
+    bool _GetArrayData(const VtValue& value, const char*& data, size_t& bytes)
+    {
+        if (not value.IsHolding<VtArray<T>>()) {
+            return false;
+        }
+        const VtArray<T>& array = value.UncheckedGet<VtArray<T>>();
+        data = reinterpret_cast<const char*>(array.cdata());
+        bytes = array.size() * sizeof(T);
+        return true;
+    }
+}  // namespace
+
+
+HdNukeSharedValue
+HdNukeArrayPool::Intern(VtValue&& value)
+{
+    const uint64_t hash = HashArray(value);
+    if (hash == 0) {
+        return std::make_shared<const VtValue>(std::move(value));
+    }
+
+    auto range = _values.equal_range(hash);
+    for (auto it = range.first; it != range.second; it++)
+    {
+        HdNukeSharedValue pooled = it->second.lock();
+        if (pooled and *pooled == value) {
+            return pooled;
+        }
+    }
+
+    auto pooled = std::make_shared<const VtValue>(std::move(value));
+    _values.emplace(hash, pooled);
+    if (_values.size() >= _pruneSize) {
+        _PruneExpired();
+    }
+    return pooled;
+}
+
+void
+HdNukeArrayPool::Merge(const HdNukeArrayPool& other)
+{
+    for (const auto& entry : other._values)
+    {
+        HdNukeSharedValue value = entry.second.lock();
+        if (not value) {
+            continue;
+        }
+
+        bool found = false;
+        auto range = _values.equal_range(entry.first);
+        for (auto it = range.first; it != range.second and not found; it++)
+        {
+            found = it->second.lock() == value;
+        }
+        if (not found) {
+            _values.emplace(entry.first, value);
+        }
+    }
+    if (_values.size() >= _pruneSize) {
+        _PruneExpired();
+    }
+}
+
+/* static */
+uint64_t
+HdNukeArrayPool::HashArray(const VtValue& value)
+{
+    const char* data = nullptr;
+    size_t bytes = 0;
+    if (not (_GetArrayData<float>(value, data, bytes)
+             or _GetArrayData<int>(value, data, bytes)
+             or _GetArrayData<GfVec2f>(value, data, bytes)
+             or _GetArrayData<GfVec3f>(value, data, bytes)
+             or _GetArrayData<GfVec4f>(value, data, bytes)
+             or _GetArrayData<GfMatrix3f>(value, data, bytes)
+             or _GetArrayData<GfMatrix4f>(value, data, bytes))
+            or bytes == 0) {
+        return 0;
+    }
+    // Seeded by the type, so arrays of different types with the same bytes
+    // don't collide.
+    const uint64_t hash = ArchHash64(data, bytes, value.GetTypeid().hash_code());
+    // Zero is reserved for values that can't be hashed.
+    return hash == 0 ? 1 : hash;
+}
+
+void
+HdNukeArrayPool::_PruneExpired()
+{
+    for (auto it = _values.begin(); it != _values.end(); )
+    {
+        if (it->second.expired()) {
+            it = _values.erase(it);
+        }
+        else {
+            it++;
+        }
+    }
+    // Only prune again once the pool has doubled, so interning stays cheap.
+    _pruneSize = std::max<size_t>(256, _values.size() * 2);
+}
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,67 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#ifndef HDNUKE_ARRAYPOOL_H
+#define HDNUKE_ARRAYPOOL_H
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+#include <pxr/pxr.h>
+
+#include <pxr/base/vt/value.h>
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+using HdNukeSharedValue = std::shared_ptr<const VtValue>;
+
+
+// Makes adapters whose arrays have the same contents share one VtArray
+// buffer, so duplicated geometry that isn't instanced only holds its points
+// and primvars once, and render delegates that key caches on buffer identity
+// see the same array. Arrays are found by a hash of their contents. Only used
+// while the owning scene data updates its adapters.
+class HdNukeArrayPool
+{
+public:
+    // Returns the pooled value equal to `value`, adding it if there is none.
+    // Values that can't be hashed are only wrapped.
+    HdNukeSharedValue Intern(VtValue&& value);
+
+    // Adds the values of another pool that this one doesn't hold yet, e.g.
+    // of a copy that adapters were converted against on another thread.
+    void Merge(const HdNukeArrayPool& other);
+
+    // Returns the number of entries, including those whose values have
+    // expired but haven't been pruned yet.
+    inline size_t GetSize() const { return _values.size(); }
+
+    // Hashes the data of a non-empty array of one of the POD types primvars
+    // are converted to, or returns zero for any other value.
+    static uint64_t HashArray(const VtValue& value);
+
+private:
+    void _PruneExpired();
+
+    std::unordered_multimap<uint64_t, std::weak_ptr<const VtValue>> _values;
+    size_t _pruneSize = 256;
+};
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // HDNUKE_ARRAYPOOL_H
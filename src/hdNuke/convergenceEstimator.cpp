@@ -0,0 +1,213 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <algorithm>
+#include <cmath>
+
+#include <pxr/base/gf/half.h>
+
+#include "convergenceEstimator.h"
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+namespace {
+
+// Guards against dividing by (nearly) black tiles.
+static const float MIN_TILE_LUMINANCE = 1e-3f;
+
+
+template <typename T>
+inline float
+_ToFloat(T value)
+{
+    return static_cast<float>(value);
+}
+
+template <>
+inline float
+_ToFloat(uint8_t value)
+{
+    return static_cast<float>(value) / 255.0f;
+}
+
+template <typename T>
+void
+_ReadRGB(const void* data, size_t numPixels, size_t numComponents,
+         float* dest)
+{
+    const T* src = static_cast<const T*>(data);
+    const size_t rgbComponents = std::min<size_t>(numComponents, 3);
+    for (size_t i = 0; i < numPixels; i++)
+    {
+        for (size_t c = 0; c < 3; c++)
+        {
+            dest[c] = _ToFloat(src[c < rgbComponents ? c : 0]);
+        }
+        src += numComponents;
+        dest += 3;
+    }
+}
+
+}  // namespace
+
+
+HdNukeConvergenceEstimator::HdNukeConvergenceEstimator(int tileSize)
+    : _tileSize(std::max(tileSize, 1))
+{
+}
+
+void
+HdNukeConvergenceEstimator::Reset()
+{
+    _width = _height = 0;
+    _tilesX = _tilesY = 0;
+    _previous.clear();
+    _tileConverged.clear();
+    _convergedCount = 0;
+}
+
+bool
+HdNukeConvergenceEstimator::Update(HdRenderBuffer* colorBuffer,
+                                   float threshold)
+{
+    if (colorBuffer == nullptr) {
+        return false;
+    }
+
+    _Resize(static_cast<int>(colorBuffer->GetWidth()),
+            static_cast<int>(colorBuffer->GetHeight()));
+    if (not _ReadBuffer(colorBuffer, _current)) {
+        return false;
+    }
+    return _Compare(threshold);
+}
+
+bool
+HdNukeConvergenceEstimator::Update(const float* rgba, int width, int height,
+                                   float threshold)
+{
+    _Resize(width, height);
+    const size_t numPixels = static_cast<size_t>(width) * height;
+    _current.resize(numPixels * 3);
+    _ReadRGB<float>(rgba, numPixels, 4, _current.data());
+    return _Compare(threshold);
+}
+
+void
+HdNukeConvergenceEstimator::_Resize(int width, int height)
+{
+    if (width != _width or height != _height) {
+        Reset();
+        _width = width;
+        _height = height;
+        _tilesX = (width + _tileSize - 1) / _tileSize;
+        _tilesY = (height + _tileSize - 1) / _tileSize;
+        _tileConverged.assign(static_cast<size_t>(_tilesX * _tilesY), false);
+    }
+}
+
+bool
+HdNukeConvergenceEstimator::_Compare(float threshold)
+{
+    if (_previous.empty()) {
+        _previous.swap(_current);
+        return false;
+    }
+
+    for (int ty = 0; ty < _tilesY; ty++)
+    {
+        const int y0 = ty * _tileSize;
+        const int y1 = std::min(y0 + _tileSize, _height);
+        for (int tx = 0; tx < _tilesX; tx++)
+        {
+            const size_t tileIndex = static_cast<size_t>(ty * _tilesX + tx);
+            if (_tileConverged[tileIndex]) {
+                continue;
+            }
+
+            const int x0 = tx * _tileSize;
+            const int x1 = std::min(x0 + _tileSize, _width);
+            double difference = 0.0;
+            double luminance = 0.0;
+            for (int y = y0; y < y1; y++)
+            {
+                size_t i = (static_cast<size_t>(y) * _width + x0) * 3;
+                const size_t end = i + static_cast<size_t>(x1 - x0) * 3;
+                for (; i < end; i++)
+                {
+                    difference += std::fabs(_current[i] - _previous[i]);
+                    luminance += std::fabs(_current[i]);
+                }
+            }
+
+            if (difference <= threshold
+                    * std::max(luminance, static_cast<double>(MIN_TILE_LUMINANCE))) {
+                _tileConverged[tileIndex] = true;
+                _convergedCount++;
+            }
+        }
+    }
+
+    _previous.swap(_current);
+    return _convergedCount == _tileConverged.size();
+}
+
+bool
+HdNukeConvergenceEstimator::IsTileConverged(int tileX, int tileY) const
+{
+    if (tileX < 0 or tileY < 0 or tileX >= _tilesX or tileY >= _tilesY) {
+        return false;
+    }
+    return _tileConverged[static_cast<size_t>(tileY * _tilesX + tileX)];
+}
+
+bool
+HdNukeConvergenceEstimator::_ReadBuffer(HdRenderBuffer* buffer,
+                                        std::vector<float>& pixels)
+{
+    const HdFormat format = buffer->GetFormat();
+    const size_t numComponents = HdGetComponentCount(format);
+    const size_t numPixels = static_cast<size_t>(_width) * _height;
+
+    buffer->Resolve();
+    pixels.resize(numPixels * 3);
+    const void* data = buffer->Map();
+    if (data == nullptr) {
+        buffer->Unmap();
+        return false;
+    }
+
+    bool supported = true;
+    switch (HdGetComponentFormat(format)) {
+        case HdFormatUNorm8:
+            _ReadRGB<uint8_t>(data, numPixels, numComponents, pixels.data());
+            break;
+        case HdFormatFloat16:
+            _ReadRGB<GfHalf>(data, numPixels, numComponents, pixels.data());
+            break;
+        case HdFormatFloat32:
+            _ReadRGB<float>(data, numPixels, numComponents, pixels.data());
+            break;
+        default:
+            supported = false;
+    }
+
+    buffer->Unmap();
+    return supported;
+}
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,76 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#ifndef HDNUKE_CONVERGENCEESTIMATOR_H
+#define HDNUKE_CONVERGENCEESTIMATOR_H
+
+#include <vector>
+
+#include <pxr/pxr.h>
+
+#include <pxr/imaging/hd/renderBuffer.h>
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+// Decides whether a progressive render has converged by comparing the color
+// buffer between successive Execute calls, independently of what the render
+// delegate itself reports.
+//
+// The image is split into square tiles, and a tile is considered converged
+// once the mean change of its pixels relative to their mean brightness drops
+// below the threshold. Converged tiles are not measured again.
+class HdNukeConvergenceEstimator
+{
+public:
+    HdNukeConvergenceEstimator(int tileSize = 32);
+
+    // Forgets the previous image, e.g. when starting a new render.
+    void Reset();
+
+    // Resolves and reads the given color buffer, and returns true if every
+    // tile has converged since the last call. Always returns false for the
+    // first call after a reset, or if the buffer format is unsupported.
+    bool Update(HdRenderBuffer* colorBuffer, float threshold);
+    // The same, for an image that has already been read back as RGBA floats.
+    bool Update(const float* rgba, int width, int height, float threshold);
+
+    inline size_t GetTileCount() const { return _tileConverged.size(); }
+    inline size_t GetConvergedTileCount() const { return _convergedCount; }
+
+    // Whether the tile at the given tile coordinates has converged.
+    bool IsTileConverged(int tileX, int tileY) const;
+
+private:
+    void _Resize(int width, int height);
+    bool _Compare(float threshold);
+    bool _ReadBuffer(HdRenderBuffer* buffer, std::vector<float>& pixels);
+
+    int _tileSize;
+    int _width = 0;
+    int _height = 0;
+    int _tilesX = 0;
+    int _tilesY = 0;
+
+    std::vector<float> _previous;
+    std::vector<float> _current;
+    std::vector<bool> _tileConverged;
+    size_t _convergedCount = 0;
+};
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // HDNUKE_CONVERGENCEESTIMATOR_H
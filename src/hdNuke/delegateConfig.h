@@ -29,6 +29,8 @@ public:
     HdNukeDelegateConfig();
     HdNukeDelegateConfig(const SdfPath& delegateId);
 
+    inline const SdfPath& DelegateId() const { return _delegateId; }
+
     inline const SdfPath& GeoRoot() const { return _geoRoot; }
     inline const SdfPath& LightRoot() const { return _lightRoot; }
     inline const SdfPath& MaterialRoot() const { return _materialRoot; }
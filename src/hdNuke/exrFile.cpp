@@ -0,0 +1,271 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <mutex>
+
+#include <OpenEXR/ImfChannelList.h>
+#include <OpenEXR/ImfFrameBuffer.h>
+#include <OpenEXR/ImfHeader.h>
+#include <OpenEXR/ImfInputFile.h>
+#include <OpenEXR/ImfIntAttribute.h>
+#include <OpenEXR/ImfMultiPartOutputFile.h>
+#include <OpenEXR/ImfOutputFile.h>
+#include <OpenEXR/ImfOutputPart.h>
+#include <OpenEXR/ImfPartType.h>
+#include <OpenEXR/ImfThreading.h>
+
+#include <pxr/base/work/threadLimits.h>
+
+#include "exrFile.h"
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+namespace {
+
+// The OpenEXR library linked here need not be the one the host configured,
+// so make sure its thread pool can compress on every core.
+void
+_InitThreads()
+{
+    static std::once_flag initialized;
+    std::call_once(initialized, []() {
+        if (Imf::globalThreadCount() == 0) {
+            Imf::setGlobalThreadCount(static_cast<int>(WorkGetConcurrencyLimit()));
+        }
+    });
+}
+
+// Images are stored bottom to top, files top to bottom.
+void
+_FlipRows(const float* src, float* dest, int width, int height)
+{
+    const size_t rowSize = static_cast<size_t>(width);
+    for (int y = 0; y < height; y++)
+    {
+        std::memcpy(dest + (height - 1 - y) * rowSize, src + y * rowSize,
+                    rowSize * sizeof(float));
+    }
+}
+
+Imf::Header
+_MakeHeader(const HdNukeExrImage& image)
+{
+    Imf::Header header(image.width, image.height);
+    header.compression() = Imf::ZIP_COMPRESSION;
+    for (const auto& channelName : image.channelNames)
+    {
+        header.channels().insert(channelName, Imf::Channel(Imf::FLOAT));
+    }
+    for (const auto& attribute : image.intAttributes)
+    {
+        header.insert(attribute.first, Imf::IntAttribute(attribute.second));
+    }
+    return header;
+}
+
+// Flips the channels of the image into `flipped`, and points the frame
+// buffer at them.
+void
+_MakeFrameBuffer(const HdNukeExrImage& image, std::vector<float>& flipped,
+                 Imf::FrameBuffer& frameBuffer)
+{
+    const size_t channelSize = static_cast<size_t>(image.width) * image.height;
+    flipped.resize(image.pixels.size());
+    for (size_t c = 0; c < image.channelNames.size(); c++)
+    {
+        float* channel = flipped.data() + c * channelSize;
+        _FlipRows(image.Channel(c), channel, image.width, image.height);
+        frameBuffer.insert(image.channelNames[c],
+                           Imf::Slice(Imf::FLOAT, reinterpret_cast<char*>(channel),
+                                      sizeof(float),
+                                      sizeof(float) * image.width));
+    }
+}
+
+inline bool
+_Fail(std::string* errorMsg, const std::string& msg)
+{
+    if (errorMsg != nullptr) {
+        *errorMsg = msg;
+    }
+    return false;
+}
+
+}  // namespace
+
+
+void
+HdNukeExrImage::Resize(int w, int h, const std::vector<std::string>& names)
+{
+    width = std::max(w, 0);
+    height = std::max(h, 0);
+    channelNames = names;
+    pixels.assign(static_cast<size_t>(width) * height * names.size(), 0.0f);
+}
+
+int
+HdNukeExrImage::FindChannel(const std::string& name) const
+{
+    auto it = std::find(channelNames.begin(), channelNames.end(), name);
+    if (it == channelNames.end()) {
+        return -1;
+    }
+    return static_cast<int>(it - channelNames.begin());
+}
+
+
+bool
+HdNukeWriteExr(const std::string& path, const HdNukeExrImage& image,
+               std::string* errorMsg)
+{
+    if (image.width <= 0 or image.height <= 0 or image.channelNames.empty()) {
+        return _Fail(errorMsg, "Empty image");
+    }
+
+    _InitThreads();
+    try {
+        std::vector<float> flipped;
+        Imf::FrameBuffer frameBuffer;
+        _MakeFrameBuffer(image, flipped, frameBuffer);
+
+        Imf::OutputFile file(path.c_str(), _MakeHeader(image));
+        file.setFrameBuffer(frameBuffer);
+        file.writePixels(image.height);
+    }
+    catch (const std::exception& e) {
+        return _Fail(errorMsg, "Failed writing " + path + ": " + e.what());
+    }
+    return true;
+}
+
+bool
+HdNukeWriteMultiPartExr(const std::string& path,
+                        const std::vector<HdNukeExrPart>& parts,
+                        std::string* errorMsg)
+{
+    if (parts.empty()) {
+        return _Fail(errorMsg, "No parts to write");
+    }
+
+    std::vector<Imf::Header> headers;
+    for (const auto& part : parts)
+    {
+        const HdNukeExrImage& image = part.image;
+        if (image.width <= 0 or image.height <= 0
+                or image.channelNames.empty()) {
+            return _Fail(errorMsg, "Empty image in part " + part.name);
+        }
+        headers.push_back(_MakeHeader(image));
+        headers.back().setName(part.name);
+        headers.back().setType(Imf::SCANLINEIMAGE);
+    }
+
+    _InitThreads();
+    try {
+        Imf::MultiPartOutputFile file(path.c_str(), headers.data(),
+                                      static_cast<int>(headers.size()));
+        // The parts are written one after another, so only one flipped copy
+        // is held at a time, and the blocks of each part are compressed in
+        // parallel.
+        std::vector<float> flipped;
+        for (size_t i = 0; i < parts.size(); i++)
+        {
+            Imf::FrameBuffer frameBuffer;
+            _MakeFrameBuffer(parts[i].image, flipped, frameBuffer);
+
+            Imf::OutputPart part(file, static_cast<int>(i));
+            part.setFrameBuffer(frameBuffer);
+            part.writePixels(parts[i].image.height);
+        }
+    }
+    catch (const std::exception& e) {
+        return _Fail(errorMsg, "Failed writing " + path + ": " + e.what());
+    }
+    return true;
+}
+
+bool
+HdNukeReadExr(const std::string& path, HdNukeExrImage* image,
+              std::string* errorMsg)
+{
+    _InitThreads();
+    try {
+        Imf::InputFile file(path.c_str());
+        const Imf::Header& header = file.header();
+
+        std::vector<std::string> channelNames;
+        for (auto it = header.channels().begin();
+             it != header.channels().end(); ++it)
+        {
+            if (it.channel().xSampling != 1 or it.channel().ySampling != 1) {
+                return _Fail(errorMsg, std::string("Unsupported channel ")
+                                       + it.name() + " in " + path);
+            }
+            channelNames.push_back(it.name());
+        }
+
+        const Imath::Box2i& window = header.dataWindow();
+        const int width = window.max.x - window.min.x + 1;
+        const int height = window.max.y - window.min.y + 1;
+        if (width <= 0 or height <= 0 or channelNames.empty()) {
+            return _Fail(errorMsg, "Empty image in " + path);
+        }
+
+        image->Resize(width, height, channelNames);
+        image->intAttributes.clear();
+        for (auto it = header.begin(); it != header.end(); ++it)
+        {
+            const auto* attribute =
+                dynamic_cast<const Imf::IntAttribute*>(&it.attribute());
+            if (attribute) {
+                image->intAttributes[it.name()] = attribute->value();
+            }
+        }
+
+        // Read top to bottom, then flip into the image. Half channels are
+        // converted to float by the library.
+        const size_t channelSize = static_cast<size_t>(width) * height;
+        std::vector<float> flipped(image->pixels.size());
+        Imf::FrameBuffer frameBuffer;
+        for (size_t c = 0; c < channelNames.size(); c++)
+        {
+            char* origin = reinterpret_cast<char*>(flipped.data() + c * channelSize)
+                           - (window.min.x + static_cast<ptrdiff_t>(window.min.y)
+                              * width) * static_cast<ptrdiff_t>(sizeof(float));
+            frameBuffer.insert(channelNames[c],
+                               Imf::Slice(Imf::FLOAT, origin, sizeof(float),
+                                          sizeof(float) * width));
+        }
+        file.setFrameBuffer(frameBuffer);
+        file.readPixels(window.min.y, window.max.y);
+
+        for (size_t c = 0; c < channelNames.size(); c++)
+        {
+            _FlipRows(flipped.data() + c * channelSize, image->Channel(c),
+                      width, height);
+        }
+    }
+    catch (const std::exception& e) {
+        return _Fail(errorMsg, "Could not read " + path + ": " + e.what());
+    }
+    return true;
+}
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,78 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#ifndef HDNUKE_EXRFILE_H
+#define HDNUKE_EXRFILE_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <pxr/pxr.h>
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+// A float image with any number of named channels, stored one channel after
+// another, with rows ordered bottom to top (as in Nuke).
+struct HdNukeExrImage
+{
+    int width = 0;
+    int height = 0;
+    std::vector<std::string> channelNames;
+    std::vector<float> pixels;
+    // Written to (and read back from) the file header.
+    std::map<std::string, int> intAttributes;
+
+    void Resize(int w, int h, const std::vector<std::string>& names);
+
+    inline float* Channel(size_t index) {
+        return pixels.data() + index * static_cast<size_t>(width) * height;
+    }
+    inline const float* Channel(size_t index) const {
+        return pixels.data() + index * static_cast<size_t>(width) * height;
+    }
+
+    // Returns the index of the named channel, or -1 if there is none.
+    int FindChannel(const std::string& name) const;
+};
+
+
+// One part of a multi-part file, e.g. one AOV of a render.
+struct HdNukeExrPart
+{
+    std::string name;
+    HdNukeExrImage image;
+};
+
+
+// Stores and reloads render results through the OpenEXR library. Images are
+// written as scanline files with 32-bit float channels and ZIP compression,
+// which is done on OpenEXR's thread pool. Reading converts every channel to
+// float, and only reads the first part of a multi-part file. Errors are
+// returned through `errorMsg` rather than thrown.
+bool HdNukeWriteExr(const std::string& path, const HdNukeExrImage& image,
+                    std::string* errorMsg = nullptr);
+// Writes each image as one part of a multi-part file.
+bool HdNukeWriteMultiPartExr(const std::string& path,
+                             const std::vector<HdNukeExrPart>& parts,
+                             std::string* errorMsg = nullptr);
+bool HdNukeReadExr(const std::string& path, HdNukeExrImage* image,
+                   std::string* errorMsg = nullptr);
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // HDNUKE_EXRFILE_H
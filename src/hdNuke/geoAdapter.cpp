@@ -12,6 +12,11 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 //
+#include <atomic>
+
+#include <pxr/base/vt/types.h>
+#include <pxr/base/work/loops.h>
+
 #include <pxr/usd/usdGeom/tokens.h>
 
 #include <pxr/imaging/pxOsd/tokens.h>
@@ -26,14 +31,240 @@ using namespace DD::Image;
 PXR_NAMESPACE_OPEN_SCOPE
 
 
+namespace
+{
+    // Smaller arrays aren't worth packing at reduced precision.
+    const size_t _MinPackedArraySize = 1024;
+
+    const HdNukePrimvarLayoutPtr& _GetEmptyPrimvarLayout()
+    {
+        static const HdNukePrimvarLayoutPtr emptyLayout =
+            std::make_shared<const HdNukePrimvarLayout>();
+        return emptyLayout;
+    }
+
+    // Group_Object      -> HdInterpolationConstant
+    // Group_Primitives  -> HdInterpolationUniform
+    // Group_Points (?)  -> HdInterpolationVertex
+    // Group_Vertices    -> HdInterpolationFaceVarying
+    //
+    // Returns HdInterpolationCount for groups that don't map to primvars.
+    HdInterpolation _GetPrimvarInterpolation(int group)
+    {
+        switch (group) {
+            case Group_Object:
+                return HdInterpolationConstant;
+            case Group_Primitives:
+                return HdInterpolationUniform;
+            case Group_Points:
+                return HdInterpolationVertex;
+            case Group_Vertices:
+                return HdInterpolationFaceVarying;
+            default:
+                return HdInterpolationCount;
+        }
+    }
+
+    void _GetPrimvarNameAndRole(const TfToken& attribName,
+                                TfToken& primvarName, TfToken& role)
+    {
+        primvarName = attribName;
+        if (attribName == HdNukeTokens->Cf) {
+            // attribName = HdTokens->faceColors;
+            role = HdPrimvarRoleTokens->color;
+        }
+        else if (attribName == HdNukeTokens->uv) {
+            primvarName = HdNukeTokens->st;
+            role = HdPrimvarRoleTokens->textureCoordinate;
+        }
+        else if (attribName == HdNukeTokens->N) {
+            primvarName = HdTokens->normals;
+            role = HdPrimvarRoleTokens->normal;
+        }
+        else if (attribName == HdNukeTokens->size) {
+            primvarName = HdTokens->widths;
+        }
+        else if (attribName == HdNukeTokens->PW) {
+            role = HdPrimvarRoleTokens->point;
+        }
+        else if (attribName == HdNukeTokens->vel) {
+            primvarName = HdTokens->velocities;
+            role = HdPrimvarRoleTokens->vector;
+        }
+        else {
+            role = HdPrimvarRoleTokens->none;
+        }
+    }
+    // Converts an attribute to the primvar value Hydra expects, or returns an
+    // empty value if its type isn't supported.
+    VtValue _ConvertAttribute(const Attribute& attribute,
+                              const TfToken& primvarName)
+    {
+        const AttribType attrType = attribute.type();
+
+        // XXX: Special case for UVs. Nuke typically stores UVs as Vector4 (for
+        // some inexplicable reason), but USD/Hydra conventions stipulate
+        // Vec2f. Thus, we do type conversion in the case of a float vecter
+        // attr with width > 2, just to be nice.
+        if (primvarName == HdNukeTokens->st and (attrType == VECTOR4_ATTRIB
+                                                 or attrType == VECTOR3_ATTRIB
+                                                 or attrType == NORMAL_ATTRIB))
+        {
+            const auto size = attribute.size();
+            VtVec2fArray uvs(size);
+            float* dataPtr = static_cast<float*>(attribute.array());
+            float* outPtr = reinterpret_cast<float*>(uvs.data());
+            const auto width = attribute.data_elements();
+            for (size_t i = 0; i < size; i++, dataPtr += width) {
+                *outPtr++ = dataPtr[0];
+                *outPtr++ = dataPtr[1];
+            }
+            return VtValue::Take(uvs);
+        }
+
+        // General-purpose attribute conversions
+        if (attribute.size() == 1) {
+            void* rawData = attribute.array();
+            float* floatData = static_cast<float*>(rawData);
+
+            switch (attrType) {
+                case FLOAT_ATTRIB:
+                    return VtValue(floatData[0]);
+                case INT_ATTRIB:
+                    return VtValue(static_cast<int32_t*>(rawData)[0]);
+                case STRING_ATTRIB:
+                    return VtValue(std::string(static_cast<char**>(rawData)[0]));
+                case STD_STRING_ATTRIB:
+                    return VtValue(static_cast<std::string*>(rawData)[0]);
+                case VECTOR2_ATTRIB:
+                    return VtValue(GfVec2f(floatData));
+                case VECTOR3_ATTRIB:
+                case NORMAL_ATTRIB:
+                    return VtValue(GfVec3f(floatData));
+                case VECTOR4_ATTRIB:
+                    return VtValue(GfVec4f(floatData));
+                case MATRIX3_ATTRIB:
+                    {
+                        GfMatrix3f gfMatrix;
+                        std::copy(floatData, floatData + 9, gfMatrix.data());
+                        return VtValue(gfMatrix);
+                    }
+                case MATRIX4_ATTRIB:
+                    {
+                        GfMatrix4f gfMatrix;
+                        std::copy(floatData, floatData + 16, gfMatrix.data());
+                        return VtValue(gfMatrix);
+                    }
+                default:
+                    break;
+            }
+        }
+        else {
+            switch (attrType) {
+                case FLOAT_ATTRIB:
+                    return DDAttrToVtArrayValue<float>(attribute);
+                case INT_ATTRIB:
+                    return DDAttrToVtArrayValue<int32_t>(attribute);
+                case VECTOR2_ATTRIB:
+                    return DDAttrToVtArrayValue<GfVec2f>(attribute);
+                case VECTOR3_ATTRIB:
+                case NORMAL_ATTRIB:
+                    return DDAttrToVtArrayValue<GfVec3f>(attribute);
+                case VECTOR4_ATTRIB:
+                    return DDAttrToVtArrayValue<GfVec4f>(attribute);
+                case MATRIX3_ATTRIB:
+                    return DDAttrToVtArrayValue<GfMatrix3f>(attribute);
+                case MATRIX4_ATTRIB:
+                    return DDAttrToVtArrayValue<GfMatrix4f>(attribute);
+                case STD_STRING_ATTRIB:
+                    return DDAttrToVtArrayValue<std::string>(attribute);
+                default:
+                    break;
+
+                // XXX: Ignoring char* array attrs for now... not sure whether
+                // they need special-case handling.
+                // case STRING_ATTRIB:
+            }
+        }
+
+        TF_WARN("HdNukeGeoAdapter : Unhandled attribute type: %d", attrType);
+        return VtValue();
+    }
+
+    // Checks, in parallel, that every face-vertex value matches the value at
+    // the first face-vertex of the same point.
+    template <typename T>
+    bool _CornersAgree(const VtArray<T>& values,
+                       const VtIntArray& faceVertexIndices,
+                       const std::vector<int>& firstCorners)
+    {
+        std::atomic<bool> agree(true);
+        const T* data = values.cdata();
+        const int* indices = faceVertexIndices.cdata();
+        WorkParallelForN(values.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+            {
+                if (not (data[i] == data[firstCorners[indices[i]]])) {
+                    agree = false;
+                }
+                if ((i & 1023) == 0 and not agree) {
+                    return;
+                }
+            }
+        });
+        return agree;
+    }
+
+    template <typename T>
+    VtValue _GatherVertexValues(const VtArray<T>& values,
+                                const std::vector<int>& firstCorners)
+    {
+        VtArray<T> vertexValues(firstCorners.size());
+        T* out = vertexValues.data();
+        const T* data = values.cdata();
+        WorkParallelForN(firstCorners.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+            {
+                out[i] = firstCorners[i] < 0 ? VtZero<T>()
+                                             : data[firstCorners[i]];
+            }
+        });
+        return VtValue::Take(vertexValues);
+    }
+
+    // Demotes a face-varying array of T. `demotable` is the cached result of
+    // the check, or null if it has to be made. Returns false if the value
+    // doesn't hold an array of T.
+    template <typename T>
+    bool _DemoteArray(VtValue& value, const VtIntArray& faceVertexIndices,
+                      const std::vector<int>& firstCorners,
+                      const bool* cachedDemotable, bool& demotable)
+    {
+        if (not value.IsHolding<VtArray<T>>()) {
+            return false;
+        }
+
+        const VtArray<T>& values = value.UncheckedGet<VtArray<T>>();
+        demotable = cachedDemotable
+            ? *cachedDemotable
+            : _CornersAgree(values, faceVertexIndices, firstCorners);
+        if (demotable) {
+            value = _GatherVertexValues(values, firstCorners);
+        }
+        return true;
+    }
+}  // namespace
+
+
 HdNukeGeoAdapter::HdNukeGeoAdapter(AdapterSharedState* statePtr)
     : HdNukeAdapter(statePtr)
+    , _primvarLayout(_GetEmptyPrimvarLayout())
 {
 }
 
 void
 HdNukeGeoAdapter::Update(const GeoInfo& geo, HdDirtyBits dirtyBits,
-                         bool isInstanced)
+                         bool isInstanced, uint64_t attributesHash)
 {
     if (dirtyBits == HdChangeTracker::Clean) {
         return;
@@ -66,7 +297,7 @@ HdNukeGeoAdapter::Update(const GeoInfo& geo, HdDirtyBits dirtyBits,
     if (dirtyBits & (HdChangeTracker::DirtyPrimvar
                      | HdChangeTracker::DirtyNormals
                      | HdChangeTracker::DirtyWidths)) {
-        _RebuildPrimvars(geo);
+        _RebuildPrimvars(geo, attributesHash);
     }
 
     if (dirtyBits & HdChangeTracker::DirtyExtent) {
@@ -77,23 +308,6 @@ HdNukeGeoAdapter::Update(const GeoInfo& geo, HdDirtyBits dirtyBits,
     }
 }
 
-HdPrimvarDescriptorVector
-HdNukeGeoAdapter::GetPrimvarDescriptors(HdInterpolation interpolation) const
-{
-    switch (interpolation) {
-        case HdInterpolationConstant:
-            return _constantPrimvarDescriptors;
-        case HdInterpolationUniform:
-            return _uniformPrimvarDescriptors;
-        case HdInterpolationVertex:
-            return _vertexPrimvarDescriptors;
-        case HdInterpolationFaceVarying:
-            return _faceVaryingPrimvarDescriptors;
-        default:
-            return HdPrimvarDescriptorVector();
-    }
-}
-
 void
 HdNukeGeoAdapter::_RebuildMeshTopology(const GeoInfo& geo)
 {
@@ -144,18 +358,19 @@ HdNukeGeoAdapter::_RebuildMeshTopology(const GeoInfo& geo)
     _topology = HdMeshTopology(PxOsdOpenSubdivTokens->smooth,
                                UsdGeomTokens->rightHanded, faceVertexCounts,
                                faceVertexIndices);
+    _topologyVersion++;
 }
 
 void HdNukeGeoAdapter::_RebuildPointList(const GeoInfo& geo)
 {
+    VtVec3fArray points;
     const PointList* pointList = geo.point_list();
-    if (ARCH_UNLIKELY(!pointList)) {
-        _points.clear();
-        return;
+    if (ARCH_LIKELY(pointList)) {
+        const auto* rawPoints = reinterpret_cast<const GfVec3f*>(pointList->data());
+        points.assign(rawPoints, rawPoints + pointList->size());
     }
-
-    const auto* rawPoints = reinterpret_cast<const GfVec3f*>(pointList->data());
-    _points.assign(rawPoints, rawPoints + pointList->size());
+    _points = _GetMutableSharedState()->arrayPool.Intern(
+        VtValue::Take(points));
 }
 
 VtValue
@@ -163,33 +378,75 @@ HdNukeGeoAdapter::Get(const TfToken& key) const
 {
 // TODO: Attach node name as primvar
     if (key == HdTokens->points) {
-        return VtValue(_points);
+        return _points ? *_points : VtValue();
     }
     else if (key == HdTokens->displayColor) {
         // TODO: Look up color from GeoInfo
-        return VtValue(GetSharedState()->defaultDisplayColor);
-    }
-    else if (key == HdNukeTokens->st) {
-        return VtValue(_uvs);
+        return GetSharedState()->defaultDisplayColor;
     }
 
     auto it = _primvarData.find(key);
     if (it != _primvarData.end()) {
-        return it->second;
+        return *it->second;
+    }
+
+    auto packedIt = _packedPrimvars.find(key);
+    if (packedIt != _packedPrimvars.end()) {
+        return _Widen(*packedIt->second);
+    }
+
+    auto lazyIt = _lazyPrimvars.find(key);
+    if (lazyIt != _lazyPrimvars.end()) {
+        _LazyPrimvar& lazyPrimvar = *lazyIt->second;
+        std::call_once(lazyPrimvar.converted, [this, &lazyPrimvar, &key]() {
+            lazyPrimvar.value = _ConvertAttribute(*lazyPrimvar.attribute, key);
+            lazyPrimvar.attribute = AttributePtr();
+            if (lazyPrimvar.reducePrecision
+                    and _PackPrimvar(lazyPrimvar.value,
+                                     lazyPrimvar.packed.array)) {
+                lazyPrimvar.value = VtValue();
+            }
+        });
+        return lazyPrimvar.packed.array.IsEmpty()
+            ? lazyPrimvar.value : _Widen(lazyPrimvar.packed);
     }
 
     TF_WARN("HdNukeGeoAdapter::Get : Unrecognized key: %s", key.GetText());
     return VtValue();
 }
 
+/* static */
+VtValue
+HdNukeGeoAdapter::_Widen(_PackedPrimvar& primvar)
+{
+    // Every query of a sync but the first only adds a reference.
+    std::lock_guard<std::mutex> lock(primvar.mutex);
+    if (primvar.widened.IsEmpty()) {
+        primvar.widened = primvar.array.Unpack();
+    }
+    return primvar.widened;
+}
+
 void
-HdNukeGeoAdapter::_RebuildPrimvars(const GeoInfo& geo)
+HdNukeGeoAdapter::ReleaseWidenedPrimvars()
 {
-    // Group_Object      -> HdInterpolationConstant
-    // Group_Primitives  -> HdInterpolationUniform
-    // Group_Points (?)  -> HdInterpolationVertex
-    // Group_Vertices    -> HdInterpolationFaceVarying
+    auto release = [](_PackedPrimvar& primvar) {
+        std::lock_guard<std::mutex> lock(primvar.mutex);
+        primvar.widened = VtValue();
+    };
+    for (const auto& entry : _packedPrimvars)
+    {
+        release(*entry.second);
+    }
+    for (const auto& entry : _lazyPrimvars)
+    {
+        release(entry.second->packed);
+    }
+}
 
+void
+HdNukeGeoAdapter::_RebuildPrimvars(const GeoInfo& geo, uint64_t attributesHash)
+{
     static HdPrimvarDescriptor displayColorDescriptor(
             HdTokens->displayColor, HdInterpolationConstant,
             HdPrimvarRoleTokens->color);
@@ -202,192 +459,240 @@ HdNukeGeoAdapter::_RebuildPrimvars(const GeoInfo& geo)
             HdTokens->points, HdInterpolationVertex,
             HdPrimvarRoleTokens->point);
 
-    // TODO: Try to reuse existing descriptors?
-    _constantPrimvarDescriptors.clear();
-    _constantPrimvarDescriptors.push_back(displayColorDescriptor);
-    _uniformPrimvarDescriptors.clear();
-    _vertexPrimvarDescriptors.clear();
-    _vertexPrimvarDescriptors.push_back(pointsDescriptor);
-    _faceVaryingPrimvarDescriptors.clear();
-
-    _primvarData.clear();
-    _primvarData.reserve(geo.get_attribcontext_count());
-
+    // The attributes that pass the filter, along with their primvar names.
+    struct PrimvarSource
+    {
+        const AttribContext* attribCtx;
+        HdInterpolation interpolation;
+        TfToken name;
+        TfToken role;
+        bool reducePrecision;
+    };
+    std::vector<PrimvarSource> sources;
+    sources.reserve(geo.get_attribcontext_count());
+
+    AdapterSharedState* sharedState = _GetMutableSharedState();
+    HdNukeArrayPool& arrayPool = sharedState->arrayPool;
+    HdNukePrimvarFilter& filter = sharedState->primvarFilter;
+    const bool reducePrecision =
+        sharedState->primvarPrecision != HdNukePrimvarPrecision::Full;
     for (const auto& attribCtx : geo.get_cache_pointer()->attributes)
     {
         if (attribCtx.empty()) {
             continue;
         }
 
-        TfToken primvarName(attribCtx.name);
-        TfToken role;
-
-        if (primvarName == HdNukeTokens->Cf) {
-            // attribName = HdTokens->faceColors;
-            role = HdPrimvarRoleTokens->color;
+        PrimvarSource source;
+        source.attribCtx = &attribCtx;
+        source.interpolation = _GetPrimvarInterpolation(attribCtx.group);
+        if (source.interpolation == HdInterpolationCount) {
+            continue;
         }
-        else if (primvarName == HdNukeTokens->uv) {
-            primvarName = HdNukeTokens->st;
-            role = HdPrimvarRoleTokens->textureCoordinate;
+
+        const TfToken attribName(attribCtx.name);
+        _GetPrimvarNameAndRole(attribName, source.name, source.role);
+        if (not filter.IsAllowed(attribName, source.name)) {
+            continue;
         }
-        else if (primvarName == HdNukeTokens->N) {
-            primvarName = HdTokens->normals;
-            role = HdPrimvarRoleTokens->normal;
+        source.reducePrecision = reducePrecision
+            and sharedState->reducedPrecisionPrimvars.IsAllowed(attribName,
+                                                                source.name);
+        sources.push_back(std::move(source));
+    }
+
+    // In lazy mode, attributes are only converted when they are queried. As
+    // the data isn't looked at, face-varying primvars aren't demoted either.
+    const bool lazy = GetSharedState()->lazyPrimvars;
+
+    _primvarData.clear();
+    _packedPrimvars.clear();
+    _lazyPrimvars.clear();
+    if (not lazy) {
+        _primvarData.reserve(sources.size());
+    }
+
+    TfTokenMap<_VertexDemotion> vertexDemotions;
+    vertexDemotions.swap(_vertexDemotions);
+
+    for (PrimvarSource& source : sources)
+    {
+        const TfToken& primvarName = source.name;
+        if (lazy) {
+            auto lazyPrimvar = std::unique_ptr<_LazyPrimvar>(new _LazyPrimvar);
+            lazyPrimvar->attribute = source.attribCtx->attribute;
+            lazyPrimvar->reducePrecision = source.reducePrecision;
+            _lazyPrimvars.emplace(primvarName, std::move(lazyPrimvar));
+            continue;
         }
-        else if (primvarName == HdNukeTokens->size) {
-            primvarName = HdTokens->widths;
+
+        VtValue value = _ConvertAttribute(*source.attribCtx->attribute,
+                                          primvarName);
+        if (value.IsEmpty() or _primvarData.count(primvarName) > 0
+                or _packedPrimvars.count(primvarName) > 0) {
+            continue;
         }
-        else if (primvarName == HdNukeTokens->PW) {
-            role = HdPrimvarRoleTokens->point;
+
+        if (source.interpolation == HdInterpolationFaceVarying) {
+            // Keep the last check of this primvar, if there was one.
+            auto demotionIt = vertexDemotions.find(primvarName);
+            if (demotionIt != vertexDemotions.end()) {
+                _vertexDemotions.insert(*demotionIt);
+            }
+            if (_DemoteToVertex(primvarName, value, attributesHash,
+                                geo.points())) {
+                source.interpolation = HdInterpolationVertex;
+            }
         }
-        else if (primvarName == HdNukeTokens->vel) {
-            primvarName = HdTokens->velocities;
-            role = HdPrimvarRoleTokens->vector;
+
+        HdNukePackedArray packed;
+        if (source.reducePrecision and _PackPrimvar(value, packed)) {
+            auto packedPrimvar =
+                std::unique_ptr<_PackedPrimvar>(new _PackedPrimvar);
+            packedPrimvar->array = std::move(packed);
+            _packedPrimvars.emplace(primvarName, std::move(packedPrimvar));
         }
         else {
-            role = HdPrimvarRoleTokens->none;
+            _primvarData.emplace(primvarName,
+                                 arrayPool.Intern(std::move(value)));
         }
+    }
 
-        switch (attribCtx.group) {
-            case Group_Object:
-                _constantPrimvarDescriptors.emplace_back(
-                    primvarName, HdInterpolationConstant, role);
-                break;
-            case Group_Primitives:
-                _uniformPrimvarDescriptors.emplace_back(
-                    primvarName, HdInterpolationUniform, role);
-                break;
-            case Group_Points:
-                _vertexPrimvarDescriptors.emplace_back(
-                    primvarName, HdInterpolationVertex, role);
-                break;
-            case Group_Vertices:
-                _faceVaryingPrimvarDescriptors.emplace_back(
-                    primvarName, HdInterpolationFaceVarying, role);
-                break;
-            default:
-                continue;
+    std::string signature;
+    for (const PrimvarSource& source : sources)
+    {
+        HdNukePrimvarLayoutCache::AppendToSignature(
+            signature, source.name, source.interpolation,
+            source.attribCtx->attribute->type());
+    }
+
+    // Descriptors only need to be built if no other adapter has the layout.
+    HdNukePrimvarLayoutCache& layouts = sharedState->primvarLayouts;
+    HdNukePrimvarLayoutPtr layout = layouts.Find(signature);
+    HdNukePrimvarLayout newLayout;
+    if (not layout) {
+        newLayout.descriptors[HdInterpolationConstant].push_back(
+            displayColorDescriptor);
+        newLayout.descriptors[HdInterpolationVertex].push_back(
+            pointsDescriptor);
+        for (const PrimvarSource& source : sources)
+        {
+            newLayout.descriptors[source.interpolation].emplace_back(
+                source.name, source.interpolation, source.role);
         }
+    }
 
-        // Store attribute data
-        const Attribute& attribute = *attribCtx.attribute;
-        const AttribType attrType = attribute.type();
+    _primvarLayout = layout ? layout
+                            : layouts.Insert(signature, std::move(newLayout));
+}
 
-        // XXX: Special case for UVs. Nuke typically stores UVs as Vector4 (for
-        // some inexplicable reason), but USD/Hydra conventions stipulate Vec2f.
-        // Thus, we do type conversion in the case of a float vecter attr with
-        // width > 2, just to be nice.
-        if (primvarName == HdNukeTokens->st and (attrType == VECTOR4_ATTRIB
-                                                 or attrType == VECTOR3_ATTRIB
-                                                 or attrType == NORMAL_ATTRIB))
+bool
+HdNukeGeoAdapter::_DemoteToVertex(const TfToken& primvarName, VtValue& value,
+                                  uint64_t attributesHash, size_t numPoints)
+{
+    const VtIntArray& faceVertexIndices = _topology.GetFaceVertexIndices();
+    if (not value.IsArrayValued()
+            or value.GetArraySize() != faceVertexIndices.size()) {
+        return false;
+    }
+
+    if (_firstCornersVersion != _topologyVersion or _firstCorners.empty()) {
+        int maxIndex = -1;
+        for (int index : faceVertexIndices)
         {
-            const auto size = attribute.size();
-            _uvs.resize(size);
-            float* dataPtr = static_cast<float*>(attribute.array());
-            float* outPtr = reinterpret_cast<float*>(_uvs.data());
-            const auto width = attribute.data_elements();
-            for (size_t i = 0; i < size; i++, dataPtr += width) {
-                *outPtr++ = dataPtr[0];
-                *outPtr++ = dataPtr[1];
+            maxIndex = std::max(maxIndex, index);
+        }
+        _firstCorners.assign(std::max<size_t>(numPoints, maxIndex + 1), -1);
+        for (size_t i = 0; i < faceVertexIndices.size(); i++)
+        {
+            int& firstCorner = _firstCorners[faceVertexIndices[i]];
+            if (firstCorner < 0) {
+                firstCorner = static_cast<int>(i);
             }
-            continue;
         }
+        _firstCornersVersion = _topologyVersion;
+    }
 
-        // General-purpose attribute conversions
-        if (attribute.size() == 1) {
-            void* rawData = attribute.array();
-            float* floatData = static_cast<float*>(rawData);
+    const bool* cachedDemotable = nullptr;
+    auto it = _vertexDemotions.find(primvarName);
+    if (attributesHash != 0 and it != _vertexDemotions.end()
+            and it->second.attributesHash == attributesHash
+            and it->second.topologyVersion == _topologyVersion) {
+        cachedDemotable = &it->second.demotable;
+    }
 
-            switch (attrType) {
-                case FLOAT_ATTRIB:
-                    _StorePrimvarScalar(primvarName, floatData[0]);
-                    break;
-                case INT_ATTRIB:
-                    _StorePrimvarScalar(primvarName,
-                                        static_cast<int32_t*>(rawData)[0]);
-                    break;
-                case STRING_ATTRIB:
-                    _StorePrimvarScalar(primvarName,
-                                        std::string(static_cast<char**>(rawData)[0]));
-                    break;
-                case STD_STRING_ATTRIB:
-                    _StorePrimvarScalar(primvarName,
-                                        static_cast<std::string*>(rawData)[0]);
-                    break;
-                case VECTOR2_ATTRIB:
-                    _StorePrimvarScalar(primvarName, GfVec2f(floatData));
-                    break;
-                case VECTOR3_ATTRIB:
-                case NORMAL_ATTRIB:
-                    _StorePrimvarScalar(primvarName, GfVec3f(floatData));
-                    break;
-                case VECTOR4_ATTRIB:
-                    _StorePrimvarScalar(primvarName, GfVec4f(floatData));
-                    break;
-                case MATRIX3_ATTRIB:
-                    {
-                        GfMatrix3f gfMatrix;
-                        std::copy(floatData, floatData + 9, gfMatrix.data());
-                        _StorePrimvarScalar(primvarName, gfMatrix);
-                    }
-                    break;
-                case MATRIX4_ATTRIB:
-                    {
-                        GfMatrix4f gfMatrix;
-                        std::copy(floatData, floatData + 16, gfMatrix.data());
-                        _StorePrimvarScalar(primvarName, gfMatrix);
-                    }
-                    break;
-                default:
-                    TF_WARN("HdNukeGeoAdapter::_RebuildPrimvars : Unhandled "
-                            "attribute type: %d", attrType);
-                    continue;
-            }
+    bool demotable = false;
+    if (not (_DemoteArray<float>(value, faceVertexIndices, _firstCorners,
+                                 cachedDemotable, demotable)
+             or _DemoteArray<int>(value, faceVertexIndices, _firstCorners,
+                                  cachedDemotable, demotable)
+             or _DemoteArray<GfVec2f>(value, faceVertexIndices, _firstCorners,
+                                      cachedDemotable, demotable)
+             or _DemoteArray<GfVec3f>(value, faceVertexIndices, _firstCorners,
+                                      cachedDemotable, demotable)
+             or _DemoteArray<GfVec4f>(value, faceVertexIndices, _firstCorners,
+                                      cachedDemotable, demotable)
+             or _DemoteArray<GfMatrix3f>(value, faceVertexIndices,
+                                         _firstCorners, cachedDemotable,
+                                         demotable)
+             or _DemoteArray<GfMatrix4f>(value, faceVertexIndices,
+                                         _firstCorners, cachedDemotable,
+                                         demotable))) {
+        return false;
+    }
+
+    _vertexDemotions[primvarName] =
+        _VertexDemotion{attributesHash, _topologyVersion, demotable};
+    return demotable;
+}
+
+bool
+HdNukeGeoAdapter::_PackPrimvar(const VtValue& value,
+                               HdNukePackedArray& packed) const
+{
+    if (not value.IsArrayValued()
+            or value.GetArraySize() < _MinPackedArraySize) {
+        return false;
+    }
+    return packed.Pack(value, GetSharedState()->primvarPrecision);
+}
+
+void
+HdNukeGeoAdapter::GetPrimvarMemoryUsage(
+        size_t& bytes, size_t& fullBytes,
+        std::unordered_set<const VtValue*>& counted) const
+{
+    auto addShared = [&bytes, &fullBytes, &counted](
+            const HdNukeSharedValue& value) {
+        if (value and counted.insert(value.get()).second) {
+            const size_t arrayBytes =
+                HdNukePackedArray::GetArrayMemoryUsage(*value);
+            bytes += arrayBytes;
+            fullBytes += arrayBytes;
         }
-        else {
-            switch (attrType) {
-                case FLOAT_ATTRIB:
-                    _StorePrimvarArray(primvarName,
-                                       DDAttrToVtArrayValue<float>(attribute));
-                    break;
-                case INT_ATTRIB:
-                    _StorePrimvarArray(primvarName,
-                                       DDAttrToVtArrayValue<int32_t>(attribute));
-                    break;
-                case VECTOR2_ATTRIB:
-                    _StorePrimvarArray(primvarName,
-                                       DDAttrToVtArrayValue<GfVec2f>(attribute));
-                    break;
-                case VECTOR3_ATTRIB:
-                case NORMAL_ATTRIB:
-                    _StorePrimvarArray(primvarName,
-                                       DDAttrToVtArrayValue<GfVec3f>(attribute));
-                    break;
-                case VECTOR4_ATTRIB:
-                    _StorePrimvarArray(primvarName,
-                                       DDAttrToVtArrayValue<GfVec4f>(attribute));
-                    break;
-                case MATRIX3_ATTRIB:
-                    _StorePrimvarArray(primvarName,
-                                       DDAttrToVtArrayValue<GfMatrix3f>(attribute));
-                    break;
-                case MATRIX4_ATTRIB:
-                    _StorePrimvarArray(primvarName,
-                                       DDAttrToVtArrayValue<GfMatrix4f>(attribute));
-                    break;
-                case STD_STRING_ATTRIB:
-                    _StorePrimvarArray(primvarName,
-                                       DDAttrToVtArrayValue<std::string>(attribute));
-                    break;
-                default:
-                    TF_WARN("HdNukeGeoAdapter::_RebuildPrimvars : Unhandled "
-                            "attribute type: %d", attrType);
-                    continue;
+    };
 
-                // XXX: Ignoring char* array attrs for now... not sure whether they
-                // need special-case handling.
-                // case STRING_ATTRIB:
-            }
+    addShared(_points);
+    for (const auto& entry : _primvarData)
+    {
+        addShared(entry.second);
+    }
+    for (const auto& entry : _packedPrimvars)
+    {
+        bytes += entry.second->array.GetMemoryUsage();
+        fullBytes += entry.second->array.GetUnpackedMemoryUsage();
+    }
+    for (const auto& entry : _lazyPrimvars)
+    {
+        const _LazyPrimvar& lazyPrimvar = *entry.second;
+        if (not lazyPrimvar.packed.array.IsEmpty()) {
+            bytes += lazyPrimvar.packed.array.GetMemoryUsage();
+            fullBytes += lazyPrimvar.packed.array.GetUnpackedMemoryUsage();
+        }
+        else {
+            const size_t arrayBytes =
+                HdNukePackedArray::GetArrayMemoryUsage(lazyPrimvar.value);
+            bytes += arrayBytes;
+            fullBytes += arrayBytes;
         }
     }
 }
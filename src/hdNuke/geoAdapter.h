@@ -15,6 +15,11 @@
 #ifndef HDNUKE_GEOADAPTER_H
 #define HDNUKE_GEOADAPTER_H
 
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
 #include <pxr/pxr.h>
 
 #include <pxr/base/gf/vec2f.h>
@@ -24,6 +29,9 @@
 #include <DDImage/GeoInfo.h>
 
 #include "adapter.h"
+#include "arrayPool.h"
+#include "packedArray.h"
+#include "primvarLayout.h"
 #include "types.h"
 
 
@@ -35,53 +43,123 @@ class HdNukeGeoAdapter : public HdNukeAdapter
 public:
     HdNukeGeoAdapter(AdapterSharedState* statePtr);
 
+    // `attributesHash` identifies the geometry's attributes, e.g. the source
+    // op's attributes hash. While it is unchanged (and not zero), face-varying
+    // primvars aren't checked for vertex demotion again.
     void Update(const DD::Image::GeoInfo& geo, HdDirtyBits dirtyBits,
-                bool isInstanced);
+                bool isInstanced, uint64_t attributesHash = 0);
+
+    // Queries only read state written by Update, so Hydra may call them from
+    // several threads at once during a sync.
 
-    inline GfRange3d GetExtent() const { return _extent; }
+    inline const GfRange3d& GetExtent() const { return _extent; }
 
-    inline GfMatrix4d GetTransform() const { return _transform; }
+    inline const GfMatrix4d& GetTransform() const { return _transform; }
 
     inline bool GetVisible() const { return _visible; }
 
-    inline HdMeshTopology GetMeshTopology() const { return _topology; }
+    inline const HdMeshTopology& GetMeshTopology() const { return _topology; }
 
+    // Values are stored as VtValues, so this only adds a reference. Reduced
+    // precision primvars are widened by their first Get, and the widened
+    // array is returned until ReleaseWidenedPrimvars.
     VtValue Get(const TfToken& key) const;
 
+    // Drops the widened arrays of reduced precision primvars, e.g. once a
+    // sync is done, so they only take their full size while being synced.
+    void ReleaseWidenedPrimvars();
+
     SdfPath GetMaterialId(const SdfPath& rprimId) const;
 
-    HdPrimvarDescriptorVector
-    GetPrimvarDescriptors(HdInterpolation interpolation) const;
+    // Adds the bytes held by the points and converted primvars, and the bytes
+    // they would take at full precision. Arrays shared through the array pool
+    // are only added if they aren't in `counted` yet. Not to be called during
+    // a sync.
+    void GetPrimvarMemoryUsage(
+        size_t& bytes, size_t& fullBytes,
+        std::unordered_set<const VtValue*>& counted) const;
+
+    inline const HdPrimvarDescriptorVector&
+    GetPrimvarDescriptors(HdInterpolation interpolation) const {
+        return _primvarLayout->GetDescriptors(interpolation);
+    }
 
 private:
+    // A primvar stored at reduced precision, along with its widened value
+    // while that is in use.
+    struct _PackedPrimvar
+    {
+        HdNukePackedArray array;
+        std::mutex mutex;
+        VtValue widened;
+    };
+
+    static VtValue _Widen(_PackedPrimvar& primvar);
+
+    // Packs a primvar's value if it is a large enough float array. Returns
+    // false if it should be stored as is.
+    bool _PackPrimvar(const VtValue& value, HdNukePackedArray& packed) const;
+
     void _RebuildPointList(const DD::Image::GeoInfo& geo);
-    void _RebuildPrimvars(const DD::Image::GeoInfo& geo);
+    void _RebuildPrimvars(const DD::Image::GeoInfo& geo,
+                          uint64_t attributesHash);
     void _RebuildMeshTopology(const DD::Image::GeoInfo& geo);
 
-    template <typename T>
-    inline void _StorePrimvarScalar(TfToken& key, const T& value) {
-        _primvarData.emplace(key, VtValue(value));
-    }
-
-    inline void _StorePrimvarArray(TfToken& key, VtValue&& array) {
-        _primvarData.emplace(key, std::move(array));
-    }
+    // Replaces a face-varying value with a vertex one if every corner that
+    // shares a point has the same value. Returns false if it can't. The
+    // result of the last check is reused while the attributes hash (if not
+    // zero) and the topology are unchanged.
+    bool _DemoteToVertex(const TfToken& primvarName, VtValue& value,
+                         uint64_t attributesHash, size_t numPoints);
 
     GfMatrix4d _transform;
     GfRange3d _extent;
     bool _visible = true;
 
-    VtVec3fArray _points;
-    VtVec2fArray _uvs;
+    // Never written to, and possibly shared with other adapters.
+    HdNukeSharedValue _points;
 
     HdMeshTopology _topology;
-
-    HdPrimvarDescriptorVector _constantPrimvarDescriptors;
-    HdPrimvarDescriptorVector _uniformPrimvarDescriptors;
-    HdPrimvarDescriptorVector _vertexPrimvarDescriptors;
-    HdPrimvarDescriptorVector _faceVaryingPrimvarDescriptors;
-
-    TfTokenMap<VtValue> _primvarData;
+    // Bumped whenever the topology is rebuilt.
+    uint64_t _topologyVersion = 0;
+
+    // The first face-vertex of each point (or -1), for face-varying to
+    // vertex demotion. Built on demand for the current topology.
+    std::vector<int> _firstCorners;
+    uint64_t _firstCornersVersion = 0;
+
+    // Whether a face-varying primvar could be demoted, by the attributes and
+    // topology it was checked against, so unchanged primvars aren't checked
+    // again.
+    struct _VertexDemotion
+    {
+        uint64_t attributesHash;
+        uint64_t topologyVersion;
+        bool demotable;
+    };
+    TfTokenMap<_VertexDemotion> _vertexDemotions;
+
+    // Never null, and shared with other adapters of the same layout.
+    HdNukePrimvarLayoutPtr _primvarLayout;
+
+    TfTokenMap<HdNukeSharedValue> _primvarData;
+    // Primvars stored at reduced precision. The widened arrays are only kept
+    // until they are released, as keeping them would undo the memory savings.
+    TfTokenMap<std::unique_ptr<_PackedPrimvar>> _packedPrimvars;
+
+    // An attribute whose conversion is deferred until it is first queried.
+    // Holding the attribute keeps its data alive after Nuke rebuilds the
+    // geometry.
+    struct _LazyPrimvar
+    {
+        DD::Image::AttributePtr attribute;
+        bool reducePrecision = false;
+        std::once_flag converted;
+        VtValue value;
+        _PackedPrimvar packed;
+    };
+
+    TfTokenMap<std::unique_ptr<_LazyPrimvar>> _lazyPrimvars;
 };
 
 using HdNukeGeoAdapterPtr = std::shared_ptr<HdNukeGeoAdapter>;
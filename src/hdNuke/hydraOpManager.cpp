@@ -95,10 +95,15 @@ HydraOpManager::UpdateIndex(HydraOp* op)
     {
         if (_lightOps.find(it->first) == newLightMapEnd) {
             renderIndex.RemoveSprim(it->second->GetPrimTypeName(), it->first);
+            _delegate->_prims.erase(it->first);
         }
     }
 
     _lightOps.swap(_delegate->_hydraLightOps);
+    for (const auto& lightEntry : _delegate->_hydraLightOps)
+    {
+        _delegate->_RegisterHydraLight(lightEntry.first, lightEntry.second);
+    }
 
     // Prune UsdImagingDelegates for disconnected stage ops
     const auto curDelegateMapEnd = _delegate->_usdDelegates.end();
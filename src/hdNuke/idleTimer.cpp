@@ -0,0 +1,87 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "idleTimer.h"
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+HdNukeIdleTimer::~HdNukeIdleTimer()
+{
+    Stop();
+}
+
+void
+HdNukeIdleTimer::Schedule(double seconds, std::function<void()> callback)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_quit) {
+            return;
+        }
+        _callback = std::move(callback);
+        _deadline = _Clock::now() + std::chrono::duration_cast<_Clock::duration>(
+            std::chrono::duration<double>(seconds));
+        if (not _thread.joinable()) {
+            _thread = std::thread(&HdNukeIdleTimer::_Run, this);
+        }
+    }
+    _condition.notify_all();
+}
+
+void
+HdNukeIdleTimer::Cancel()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _callback = nullptr;
+}
+
+void
+HdNukeIdleTimer::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _quit = true;
+        _callback = nullptr;
+    }
+    _condition.notify_all();
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+void
+HdNukeIdleTimer::_Run()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (not _quit)
+    {
+        if (not _callback) {
+            _condition.wait(lock);
+            continue;
+        }
+        if (_condition.wait_until(lock, _deadline) == std::cv_status::timeout
+                and _callback and _Clock::now() >= _deadline) {
+            std::function<void()> callback;
+            callback.swap(_callback);
+            lock.unlock();
+            callback();
+            lock.lock();
+        }
+    }
+}
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,65 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#ifndef HDNUKE_IDLETIMER_H
+#define HDNUKE_IDLETIMER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include <pxr/pxr.h>
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+// Calls a function on a background thread once a given time has passed
+// without it being rescheduled, e.g. to act once the user stops making
+// changes.
+class HdNukeIdleTimer
+{
+public:
+    HdNukeIdleTimer() = default;
+    ~HdNukeIdleTimer();
+
+    HdNukeIdleTimer(const HdNukeIdleTimer&) = delete;
+    HdNukeIdleTimer& operator=(const HdNukeIdleTimer&) = delete;
+
+    // Replaces any pending call.
+    void Schedule(double seconds, std::function<void()> callback);
+    void Cancel();
+    // Drops any pending call and joins the timer thread, waiting for a call
+    // in progress to return. The timer can't be scheduled again.
+    void Stop();
+
+private:
+    void _Run();
+
+    using _Clock = std::chrono::steady_clock;
+
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::thread _thread;
+    std::function<void()> _callback;
+    _Clock::time_point _deadline;
+    bool _quit = false;
+};
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // HDNUKE_IDLETIMER_H
@@ -20,22 +20,29 @@
 PXR_NAMESPACE_OPEN_SCOPE
 
 
-void
+bool
 HdNukeInstancerAdapter::Update(const GeoInfoVector& geoInfoPtrs)
 {
-    _instanceXforms.resize(geoInfoPtrs.size());
+    VtMatrix4dArray instanceXforms(geoInfoPtrs.size());
     for (size_t i = 0; i < geoInfoPtrs.size(); i++)
     {
         const float* matrixPtr = geoInfoPtrs[i]->matrix.array();
-        std::copy(matrixPtr, matrixPtr + 16, _instanceXforms[i].data());
+        std::copy(matrixPtr, matrixPtr + 16, instanceXforms[i].data());
     }
+
+    if (instanceXforms == _instanceXforms) {
+        return false;
+    }
+    _instanceXforms.swap(instanceXforms);
+    _instanceXformsValue = VtValue(_instanceXforms);
+    return true;
 }
 
 VtValue
 HdNukeInstancerAdapter::Get(const TfToken& key) const
 {
     if (key == HdInstancerTokens->instanceTransform) {
-        return VtValue(_instanceXforms);
+        return _instanceXformsValue;
     }
     return VtValue();
 }
@@ -34,7 +34,8 @@ public:
     HdNukeInstancerAdapter(AdapterSharedState* statePtr)
         : HdNukeAdapter(statePtr) { }
 
-    void Update(const GeoInfoVector& geoInfoPtrs);
+    // Returns true if the instance transforms changed.
+    bool Update(const GeoInfoVector& geoInfoPtrs);
 
     VtValue Get(const TfToken& key) const;
 
@@ -42,6 +43,8 @@ public:
 
 private:
     VtMatrix4dArray _instanceXforms;
+    // Shares _instanceXforms, so Get doesn't allocate.
+    VtValue _instanceXformsValue;
 };
 
 using HdNukeInstancerAdapterPtr = std::shared_ptr<HdNukeInstancerAdapter>;
@@ -29,46 +29,36 @@ HdNukeLightAdapter::HdNukeLightAdapter(AdapterSharedState* statePtr,
     : HdNukeAdapter(statePtr)
     , _light(lightOp)
     , _lightType(lightType)
-    , _lastHash(lightOp->hash())
 {
+    Update();
 }
 
-GfMatrix4d
-HdNukeLightAdapter::GetTransform() const
+void
+HdNukeLightAdapter::Update()
 {
+// TODO: We need a way to make sure the light still exists in the scene...
     TF_VERIFY(_light);
-    return DDToGfMatrix4d(_light->matrix());
+
+    _lastHash = _light->hash();
+    _transform = DDToGfMatrix4d(_light->matrix());
+
+    auto& pixel = _light->color();
+    _params[HdLightTokens->color] = VtValue(
+        GfVec3f(pixel[Chan_Red], pixel[Chan_Green], pixel[Chan_Blue]));
+    _params[HdLightTokens->intensity] = VtValue(_light->intensity());
+    _params[HdLightTokens->radius] = VtValue(_light->sample_width());
+    _params[HdLightTokens->shadowColor] = VtValue(GfVec3f(0));
+    _params[HdLightTokens->shadowEnable] = VtValue(_light->cast_shadows());
+    _params[HdLightTokens->exposure] = VtValue(1.0f);
+    _params[HdLightTokens->diffuse] = VtValue(1.0f);
+    _params[HdLightTokens->specular] = VtValue(1.0f);
 }
 
 VtValue
 HdNukeLightAdapter::GetLightParamValue(const TfToken& paramName) const
 {
-// TODO: We need a way to make sure the light still exists in the scene...
-    TF_VERIFY(_light);
-
-    if (paramName == HdLightTokens->color) {
-        auto& pixel = _light->color();
-        return VtValue(
-            GfVec3f(pixel[Chan_Red], pixel[Chan_Green], pixel[Chan_Blue]));
-    }
-    else if (paramName == HdLightTokens->intensity) {
-        return VtValue(_light->intensity());
-    }
-    else if (paramName == HdLightTokens->radius) {
-        return VtValue(_light->sample_width());
-    }
-    else if (paramName == HdLightTokens->shadowColor) {
-        return VtValue(GfVec3f(0));
-    }
-    else if (paramName == HdLightTokens->shadowEnable) {
-        return VtValue(_light->cast_shadows());
-    }
-    else if (paramName == HdLightTokens->exposure or
-             paramName == HdLightTokens->diffuse or
-             paramName == HdLightTokens->specular) {
-        return VtValue(1.0f);
-    }
-    return VtValue();
+    auto it = _params.find(paramName);
+    return it == _params.end() ? VtValue() : it->second;
 }
 
 
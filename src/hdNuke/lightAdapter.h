@@ -17,11 +17,15 @@
 
 #include <pxr/pxr.h>
 
+#include <pxr/base/gf/matrix4d.h>
+#include <pxr/base/vt/value.h>
+
 #include <pxr/imaging/hd/types.h>
 
 #include <DDImage/LightOp.h>
 
 #include "adapter.h"
+#include "types.h"
 
 
 PXR_NAMESPACE_OPEN_SCOPE
@@ -38,10 +42,13 @@ public:
     const TfToken& GetLightType() const { return _lightType; }
 
     const DD::Image::Hash& GetLastHash() const { return _lastHash; }
-    inline void UpdateLastHash() { _lastHash = _light->hash(); }
     inline bool DirtyHash() const { return _lastHash != _light->hash(); }
 
-    GfMatrix4d GetTransform() const;
+    // Copies the transform and parameters from the light op, so Hydra's sync
+    // threads never read the op while Nuke may be changing it.
+    void Update();
+
+    inline const GfMatrix4d& GetTransform() const { return _transform; }
 
     VtValue GetLightParamValue(const TfToken& paramName) const;
 
@@ -51,6 +58,9 @@ private:
     const DD::Image::LightOp* _light;
     TfToken _lightType;
     DD::Image::Hash _lastHash;
+
+    GfMatrix4d _transform;
+    TfTokenMap<VtValue> _params;
 };
 
 using HdNukeLightAdapterPtr = std::shared_ptr<HdNukeLightAdapter>;
@@ -0,0 +1,225 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <pxr/base/gf/half.h>
+#include <pxr/base/gf/matrix3f.h>
+#include <pxr/base/gf/matrix4f.h>
+#include <pxr/base/gf/vec2f.h>
+#include <pxr/base/gf/vec3f.h>
+#include <pxr/base/gf/vec4f.h>
+#include <pxr/base/vt/array.h>
+
+#include "packedArray.h"
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+bool
+HdNukePackedArray::Pack(const VtValue& value, HdNukePrimvarPrecision precision)
+{
+    _data.clear();
+    _offsets.clear();
+    _scales.clear();
+    _size = 0;
+    _components = 0;
+
+    if (precision == HdNukePrimvarPrecision::Full) {
+        return false;
+    }
+
+    return _Pack<float>(value, _ElementType::Float, 1, precision)
+        or _Pack<GfVec2f>(value, _ElementType::Vec2f, 2, precision)
+        or _Pack<GfVec3f>(value, _ElementType::Vec3f, 3, precision)
+        or _Pack<GfVec4f>(value, _ElementType::Vec4f, 4, precision)
+        or _Pack<GfMatrix3f>(value, _ElementType::Matrix3f, 9, precision)
+        or _Pack<GfMatrix4f>(value, _ElementType::Matrix4f, 16, precision);
+}
+
+VtValue
+HdNukePackedArray::Unpack() const
+{
+    switch (_type) {
+        case _ElementType::Float:
+            return _Unpack<float>();
+        case _ElementType::Vec2f:
+            return _Unpack<GfVec2f>();
+        case _ElementType::Vec3f:
+            return _Unpack<GfVec3f>();
+        case _ElementType::Vec4f:
+            return _Unpack<GfVec4f>();
+        case _ElementType::Matrix3f:
+            return _Unpack<GfMatrix3f>();
+        case _ElementType::Matrix4f:
+            return _Unpack<GfMatrix4f>();
+    }
+    return VtValue();
+}
+
+size_t
+HdNukePackedArray::GetMemoryUsage() const
+{
+    return _data.size() * sizeof(uint16_t)
+        + (_offsets.size() + _scales.size()) * sizeof(float);
+}
+
+size_t
+HdNukePackedArray::GetUnpackedMemoryUsage() const
+{
+    return _size * _components * sizeof(float);
+}
+
+/* static */
+size_t
+HdNukePackedArray::GetArrayMemoryUsage(const VtValue& value)
+{
+    if (not value.IsArrayValued()) {
+        return 0;
+    }
+
+    const size_t size = value.GetArraySize();
+    if (value.IsHolding<VtFloatArray>() or value.IsHolding<VtIntArray>()) {
+        return size * 4;
+    }
+    else if (value.IsHolding<VtVec2fArray>()) {
+        return size * sizeof(GfVec2f);
+    }
+    else if (value.IsHolding<VtVec3fArray>()) {
+        return size * sizeof(GfVec3f);
+    }
+    else if (value.IsHolding<VtVec4fArray>()) {
+        return size * sizeof(GfVec4f);
+    }
+    else if (value.IsHolding<VtMatrix3fArray>()) {
+        return size * sizeof(GfMatrix3f);
+    }
+    else if (value.IsHolding<VtMatrix4fArray>()) {
+        return size * sizeof(GfMatrix4f);
+    }
+    else if (value.IsHolding<VtStringArray>()) {
+        size_t bytes = size * sizeof(std::string);
+        for (const std::string& str : value.UncheckedGet<VtStringArray>())
+        {
+            bytes += str.capacity();
+        }
+        return bytes;
+    }
+    return 0;
+}
+
+template <typename T>
+bool
+HdNukePackedArray::_Pack(const VtValue& value, _ElementType type,
+                         size_t components, HdNukePrimvarPrecision precision)
+{
+    if (not value.IsHolding<VtArray<T>>()) {
+        return false;
+    }
+
+    const VtArray<T>& array = value.UncheckedGet<VtArray<T>>();
+    _type = type;
+    _precision = precision;
+    _size = array.size();
+    _components = components;
+    _PackFloats(reinterpret_cast<const float*>(array.cdata()),
+                _size * _components);
+    return true;
+}
+
+template <typename T>
+VtValue
+HdNukePackedArray::_Unpack() const
+{
+    VtArray<T> array(_size);
+    _UnpackFloats(reinterpret_cast<float*>(array.data()));
+    return VtValue::Take(array);
+}
+
+void
+HdNukePackedArray::_PackFloats(const float* data, size_t count)
+{
+    _data.resize(count);
+    if (count == 0) {
+        return;
+    }
+
+    if (_precision == HdNukePrimvarPrecision::Quantized) {
+        _offsets.assign(_components, std::numeric_limits<float>::max());
+        std::vector<float> maxValues(_components,
+                                     std::numeric_limits<float>::lowest());
+        bool finite = true;
+        for (size_t i = 0; i < count and finite; i++)
+        {
+            const size_t c = i % _components;
+            finite = std::isfinite(data[i]);
+            _offsets[c] = std::min(_offsets[c], data[i]);
+            maxValues[c] = std::max(maxValues[c], data[i]);
+        }
+
+        // The range can't be spread over the integers, so fall back to half.
+        if (not finite) {
+            _offsets.clear();
+            _precision = HdNukePrimvarPrecision::Half;
+        }
+        else {
+            _scales.resize(_components);
+            for (size_t c = 0; c < _components; c++)
+            {
+                _scales[c] = (maxValues[c] - _offsets[c]) / 65535.0f;
+            }
+            for (size_t i = 0; i < count; i++)
+            {
+                const size_t c = i % _components;
+                const float q = _scales[c] > 0.0f
+                    ? (data[i] - _offsets[c]) / _scales[c] : 0.0f;
+                _data[i] = static_cast<uint16_t>(
+                    std::min(65535.0f, std::max(0.0f, std::round(q))));
+            }
+            return;
+        }
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        _data[i] = GfHalf(data[i]).bits();
+    }
+}
+
+void
+HdNukePackedArray::_UnpackFloats(float* data) const
+{
+    const size_t count = _data.size();
+    if (_precision == HdNukePrimvarPrecision::Quantized) {
+        for (size_t i = 0; i < count; i++)
+        {
+            const size_t c = i % _components;
+            data[i] = _offsets[c] + _scales[c] * _data[i];
+        }
+        return;
+    }
+
+    GfHalf half;
+    for (size_t i = 0; i < count; i++)
+    {
+        half.setBits(_data[i]);
+        data[i] = half;
+    }
+}
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
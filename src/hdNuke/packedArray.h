@@ -0,0 +1,98 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#ifndef HDNUKE_PACKEDARRAY_H
+#define HDNUKE_PACKEDARRAY_H
+
+#include <cstdint>
+#include <vector>
+
+#include <pxr/pxr.h>
+
+#include <pxr/base/vt/value.h>
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+enum class HdNukePrimvarPrecision
+{
+    Full,
+    // IEEE half floats. Round trips within a relative error of 2^-11 for
+    // magnitudes up to 65504, and an absolute error of 2^-25 below 2^-14.
+    Half,
+    // 16 bits per component, spread over the component's range in the array.
+    // Round trips within half a step, i.e. (max - min) / 131070.
+    Quantized
+};
+
+
+// A float-based VtArray (float, GfVec*f or GfMatrix*f elements) stored with
+// 16 bits per component, and widened back to 32-bit floats on demand.
+class HdNukePackedArray
+{
+public:
+    // Returns false, leaving the array empty, if the value isn't a float-based
+    // array.
+    bool Pack(const VtValue& value, HdNukePrimvarPrecision precision);
+
+    // Widens the array back into a VtArray of its original type. This
+    // allocates and converts the whole array on every call.
+    VtValue Unpack() const;
+
+    inline bool IsEmpty() const { return _components == 0; }
+
+    // The bytes held, and the bytes the array takes at full precision.
+    size_t GetMemoryUsage() const;
+    size_t GetUnpackedMemoryUsage() const;
+
+    // The bytes taken by the data of a VtArray value, or zero for other
+    // values.
+    static size_t GetArrayMemoryUsage(const VtValue& value);
+
+private:
+    enum class _ElementType
+    {
+        Float,
+        Vec2f,
+        Vec3f,
+        Vec4f,
+        Matrix3f,
+        Matrix4f
+    };
+
+    template <typename T>
+    bool _Pack(const VtValue& value, _ElementType type, size_t components,
+               HdNukePrimvarPrecision precision);
+    template <typename T>
+    VtValue _Unpack() const;
+
+    void _PackFloats(const float* data, size_t count);
+    void _UnpackFloats(float* data) const;
+
+    _ElementType _type = _ElementType::Float;
+    HdNukePrimvarPrecision _precision = HdNukePrimvarPrecision::Half;
+    size_t _size = 0;
+    // Floats per element.
+    size_t _components = 0;
+    std::vector<uint16_t> _data;
+    // The range of each component, for quantized arrays.
+    std::vector<float> _offsets;
+    std::vector<float> _scales;
+};
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // HDNUKE_PACKEDARRAY_H
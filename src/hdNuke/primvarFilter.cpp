@@ -0,0 +1,104 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <pxr/base/tf/stringUtils.h>
+
+#include "primvarFilter.h"
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+bool
+HdNukeGlobMatch(const char* pattern, const char* name)
+{
+    // Where to resume after the last "*", if the rest fails to match.
+    const char* starPattern = nullptr;
+    const char* starName = nullptr;
+    while (*name) {
+        if (*pattern == '*') {
+            starPattern = ++pattern;
+            starName = name;
+        }
+        else if (*pattern == '?' or *pattern == *name) {
+            pattern++;
+            name++;
+        }
+        else if (starPattern) {
+            pattern = starPattern;
+            name = ++starName;
+        }
+        else {
+            return false;
+        }
+    }
+    while (*pattern == '*') {
+        pattern++;
+    }
+    return *pattern == '\0';
+}
+
+
+bool
+HdNukePrimvarFilter::SetPatterns(const std::string& allow,
+                                 const std::string& deny)
+{
+    if (allow == _allow and deny == _deny) {
+        return false;
+    }
+
+    _allow = allow;
+    _deny = deny;
+    _allowPatterns = TfStringTokenize(allow);
+    _denyPatterns = TfStringTokenize(deny);
+    _results.clear();
+    return true;
+}
+
+bool
+HdNukePrimvarFilter::IsAllowed(const TfToken& attribName,
+                               const TfToken& primvarName)
+{
+    _Names names(attribName, primvarName);
+    auto it = _results.find(names);
+    if (it != _results.end()) {
+        return it->second;
+    }
+
+    const bool allowed =
+        (_allowPatterns.empty()
+         or _Matches(_allowPatterns, attribName, primvarName))
+        and not _Matches(_denyPatterns, attribName, primvarName);
+    _results.emplace(std::move(names), allowed);
+    return allowed;
+}
+
+/* static */
+bool
+HdNukePrimvarFilter::_Matches(const std::vector<std::string>& patterns,
+                              const TfToken& attribName,
+                              const TfToken& primvarName)
+{
+    for (const std::string& pattern : patterns)
+    {
+        if (HdNukeGlobMatch(pattern.c_str(), attribName.GetText())
+                or HdNukeGlobMatch(pattern.c_str(), primvarName.GetText())) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
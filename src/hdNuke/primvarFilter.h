@@ -0,0 +1,76 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#ifndef HDNUKE_PRIMVARFILTER_H
+#define HDNUKE_PRIMVARFILTER_H
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <pxr/pxr.h>
+
+#include <pxr/base/tf/token.h>
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+// Matches the whole of `name` against a glob pattern, where "*" matches any
+// run of characters and "?" any single one.
+bool HdNukeGlobMatch(const char* pattern, const char* name);
+
+
+// Decides which geometry attributes are converted to primvars, from
+// whitespace-separated lists of glob patterns. A pattern may match either the
+// Nuke attribute name (e.g. "N") or the primvar name (e.g. "normals").
+class HdNukePrimvarFilter
+{
+public:
+    // An empty allow list allows every attribute that isn't denied. Returns
+    // false if the patterns haven't changed.
+    bool SetPatterns(const std::string& allow, const std::string& deny);
+
+    bool IsAllowed(const TfToken& attribName, const TfToken& primvarName);
+
+private:
+    static bool _Matches(const std::vector<std::string>& patterns,
+                         const TfToken& attribName,
+                         const TfToken& primvarName);
+
+    std::string _allow;
+    std::string _deny;
+    std::vector<std::string> _allowPatterns;
+    std::vector<std::string> _denyPatterns;
+
+    using _Names = std::pair<TfToken, TfToken>;
+
+    struct _NamesHash
+    {
+        size_t operator()(const _Names& names) const
+        {
+            return names.first.Hash() * 31 + names.second.Hash();
+        }
+    };
+
+    // Results by attribute and primvar name, since scenes repeat the same
+    // few names. Patterns match either name, so both are part of the key.
+    std::unordered_map<_Names, bool, _NamesHash> _results;
+};
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // HDNUKE_PRIMVARFILTER_H
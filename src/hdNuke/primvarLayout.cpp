@@ -0,0 +1,102 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <algorithm>
+
+#include "primvarLayout.h"
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+const HdPrimvarDescriptorVector&
+HdNukePrimvarLayout::GetDescriptors(HdInterpolation interpolation) const
+{
+    static const HdPrimvarDescriptorVector emptyDescriptors;
+
+    if (interpolation < 0 or interpolation >= HdInterpolationCount) {
+        return emptyDescriptors;
+    }
+    return descriptors[interpolation];
+}
+
+HdNukePrimvarLayoutPtr
+HdNukePrimvarLayoutCache::Find(const std::string& signature) const
+{
+    auto it = _layouts.find(signature);
+    return it == _layouts.end() ? nullptr : it->second.lock();
+}
+
+HdNukePrimvarLayoutPtr
+HdNukePrimvarLayoutCache::Insert(const std::string& signature,
+                                 HdNukePrimvarLayout&& layout)
+{
+    auto layoutPtr = std::make_shared<const HdNukePrimvarLayout>(
+        std::move(layout));
+    _layouts[signature] = layoutPtr;
+    if (_layouts.size() >= _pruneSize) {
+        _PruneExpired();
+    }
+    return layoutPtr;
+}
+
+void
+HdNukePrimvarLayoutCache::Merge(const HdNukePrimvarLayoutCache& other)
+{
+    for (const auto& entry : other._layouts)
+    {
+        if (entry.second.expired()) {
+            continue;
+        }
+        auto& layout = _layouts[entry.first];
+        if (layout.expired()) {
+            layout = entry.second;
+        }
+    }
+    if (_layouts.size() >= _pruneSize) {
+        _PruneExpired();
+    }
+}
+
+/* static */
+void
+HdNukePrimvarLayoutCache::AppendToSignature(std::string& signature,
+                                            const TfToken& primvarName,
+                                            HdInterpolation interpolation,
+                                            int type)
+{
+    signature.append(primvarName.GetString());
+    signature.push_back('\0');
+    signature.push_back(static_cast<char>(interpolation));
+    signature.push_back(static_cast<char>(type));
+}
+
+void
+HdNukePrimvarLayoutCache::_PruneExpired()
+{
+    for (auto it = _layouts.begin(); it != _layouts.end(); )
+    {
+        if (it->second.expired()) {
+            it = _layouts.erase(it);
+        }
+        else {
+            it++;
+        }
+    }
+    // Only prune again once the cache has doubled, so inserting stays cheap.
+    _pruneSize = std::max<size_t>(64, _layouts.size() * 2);
+}
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
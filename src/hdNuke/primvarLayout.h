@@ -0,0 +1,78 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#ifndef HDNUKE_PRIMVARLAYOUT_H
+#define HDNUKE_PRIMVARLAYOUT_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <pxr/pxr.h>
+
+#include <pxr/base/tf/token.h>
+
+#include <pxr/imaging/hd/sceneDelegate.h>
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+// The primvar descriptors of a prim, by interpolation.
+struct HdNukePrimvarLayout
+{
+    HdPrimvarDescriptorVector descriptors[HdInterpolationCount];
+
+    const HdPrimvarDescriptorVector&
+    GetDescriptors(HdInterpolation interpolation) const;
+};
+
+using HdNukePrimvarLayoutPtr = std::shared_ptr<const HdNukePrimvarLayout>;
+
+
+// Shares primvar layouts between adapters whose attributes have the same
+// signature (names, interpolations and types), so the descriptors of a layout
+// are built once. Only used while the owning scene data updates its adapters.
+class HdNukePrimvarLayoutCache
+{
+public:
+    // Returns the layout with the given signature, or null if no adapter
+    // holds one any more.
+    HdNukePrimvarLayoutPtr Find(const std::string& signature) const;
+
+    HdNukePrimvarLayoutPtr Insert(const std::string& signature,
+                                  HdNukePrimvarLayout&& layout);
+
+    // Adds the layouts of another cache that this one has no live layout
+    // for.
+    void Merge(const HdNukePrimvarLayoutCache& other);
+
+    // Appends a primvar, and the type of the attribute it comes from, to a
+    // signature.
+    static void AppendToSignature(std::string& signature,
+                                  const TfToken& primvarName,
+                                  HdInterpolation interpolation, int type);
+
+private:
+    void _PruneExpired();
+
+    std::unordered_map<std::string,
+                       std::weak_ptr<const HdNukePrimvarLayout>> _layouts;
+    size_t _pruneSize = 64;
+};
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // HDNUKE_PRIMVARLAYOUT_H
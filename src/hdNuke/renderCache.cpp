@@ -0,0 +1,175 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <algorithm>
+#include <cstdio>
+#include <tuple>
+#include <vector>
+
+#include <pxr/base/arch/defines.h>
+#include <pxr/base/arch/fileSystem.h>
+#include <pxr/base/arch/systemInfo.h>
+#include <pxr/base/tf/diagnostic.h>
+#include <pxr/base/tf/fileUtils.h>
+#include <pxr/base/tf/getenv.h>
+#include <pxr/base/tf/pathUtils.h>
+#include <pxr/base/tf/stringUtils.h>
+
+#if !defined(ARCH_OS_WINDOWS)
+#include <utime.h>
+#endif
+
+#include "renderCache.h"
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+namespace {
+
+static const char* const CACHE_FILE_SUFFIX = ".exr";
+
+// Marks a file as recently used.
+void
+_Touch(const std::string& path)
+{
+#if !defined(ARCH_OS_WINDOWS)
+    utime(path.c_str(), nullptr);
+#endif
+}
+
+}  // namespace
+
+
+HdNukeRenderCache::HdNukeRenderCache()
+{
+    SetDirectory(std::string());
+}
+
+void
+HdNukeRenderCache::SetDirectory(const std::string& directory)
+{
+    if (directory.empty()) {
+        _directory = TfGetenv("HDNUKE_RENDER_CACHE_DIR",
+                              TfStringCatPaths(ArchGetTmpDir(),
+                                               "hdNuke_renderCache"));
+    }
+    else {
+        _directory = directory;
+    }
+}
+
+bool
+HdNukeRenderCache::Contains(const std::string& key) const
+{
+    return TfIsFile(_GetPath(key));
+}
+
+bool
+HdNukeRenderCache::Load(const std::string& key, HdNukeExrImage* image)
+{
+    const std::string path = _GetPath(key);
+    if (not TfIsFile(path) or not HdNukeReadExr(path, image)) {
+        _misses++;
+        return false;
+    }
+    _Touch(path);
+    _hits++;
+    return true;
+}
+
+bool
+HdNukeRenderCache::Store(const std::string& key, const HdNukeExrImage& image)
+{
+    if (not TfIsDir(_directory) and not TfMakeDirs(_directory)
+            and not TfIsDir(_directory)) {
+        TF_WARN("Could not create render cache directory %s",
+                _directory.c_str());
+        return false;
+    }
+
+    // Write to a temporary file first, so other readers never see a partial
+    // image.
+    const std::string path = _GetPath(key);
+    const std::string tempPath = TfStringPrintf("%s.%d.tmp", path.c_str(),
+                                                ArchGetProcessId());
+    std::string errorMsg;
+    if (not HdNukeWriteExr(tempPath, image, &errorMsg)) {
+        TF_WARN("Could not write render cache file: %s", errorMsg.c_str());
+        TfDeleteFile(tempPath);
+        return false;
+    }
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        TfDeleteFile(tempPath);
+        return false;
+    }
+
+    Trim();
+    return true;
+}
+
+void
+HdNukeRenderCache::Trim()
+{
+    if (_maxBytes == 0) {
+        return;
+    }
+
+    std::vector<std::string> fileNames;
+    if (not TfReadDir(_directory, nullptr, &fileNames, nullptr)) {
+        return;
+    }
+
+    // (last use, size, path)
+    std::vector<std::tuple<double, size_t, std::string>> entries;
+    size_t totalBytes = 0;
+    for (const auto& fileName : fileNames)
+    {
+        if (not TfStringEndsWith(fileName, CACHE_FILE_SUFFIX)) {
+            continue;
+        }
+        std::string path = TfStringCatPaths(_directory, fileName);
+        double mtime = 0;
+        const int64_t length = ArchGetFileLength(path.c_str());
+        if (length < 0 or not ArchGetModificationTime(path.c_str(), &mtime)) {
+            continue;
+        }
+        totalBytes += static_cast<size_t>(length);
+        entries.emplace_back(mtime, static_cast<size_t>(length), std::move(path));
+    }
+
+    if (totalBytes <= _maxBytes) {
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end());
+    for (const auto& entry : entries)
+    {
+        if (totalBytes <= _maxBytes) {
+            break;
+        }
+        if (TfDeleteFile(std::get<2>(entry))) {
+            totalBytes -= std::get<1>(entry);
+        }
+    }
+}
+
+std::string
+HdNukeRenderCache::_GetPath(const std::string& key) const
+{
+    return TfStringCatPaths(_directory, key + CACHE_FILE_SUFFIX);
+}
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,70 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#ifndef HDNUKE_RENDERCACHE_H
+#define HDNUKE_RENDERCACHE_H
+
+#include <string>
+
+#include <pxr/pxr.h>
+
+#include "exrFile.h"
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+// An on-disk cache of render results, stored as one EXR file per key in a
+// local directory. When the cache grows beyond its size limit, the least
+// recently used files are deleted. Several caches (e.g. from different
+// nodes or Nuke sessions) may safely share a directory.
+class HdNukeRenderCache
+{
+public:
+    HdNukeRenderCache();
+
+    // An empty directory selects the default location, which can be set with
+    // the HDNUKE_RENDER_CACHE_DIR environment variable.
+    void SetDirectory(const std::string& directory);
+    inline const std::string& GetDirectory() const { return _directory; }
+
+    // Zero disables the size limit.
+    inline void SetMaxBytes(size_t bytes) { _maxBytes = bytes; }
+
+    bool Contains(const std::string& key) const;
+
+    // Reads the image stored for the given key, and counts a hit or a miss.
+    bool Load(const std::string& key, HdNukeExrImage* image);
+
+    bool Store(const std::string& key, const HdNukeExrImage& image);
+
+    // Deletes least recently used files until the cache fits its limit.
+    void Trim();
+
+    inline size_t GetHits() const { return _hits; }
+    inline size_t GetMisses() const { return _misses; }
+
+private:
+    std::string _GetPath(const std::string& key) const;
+
+    std::string _directory;
+    size_t _maxBytes = 0;
+    size_t _hits = 0;
+    size_t _misses = 0;
+};
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // HDNUKE_RENDERCACHE_H
@@ -0,0 +1,189 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+
+#include <pxr/base/arch/fileSystem.h>
+#include <pxr/base/arch/systemInfo.h>
+#include <pxr/base/tf/diagnostic.h>
+#include <pxr/base/tf/fileUtils.h>
+#include <pxr/base/tf/getenv.h>
+#include <pxr/base/tf/pathUtils.h>
+#include <pxr/base/tf/stringUtils.h>
+
+#include "renderCheckpoints.h"
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+namespace {
+
+static const char* const CHECKPOINT_FILE_SUFFIX = ".checkpoint.exr";
+static const char* const ITERATIONS_ATTRIBUTE = "hdNukeIterations";
+
+void
+_WriteCheckpoint(const std::string& directory, const std::string& path,
+                 const HdNukeExrImage& image)
+{
+    if (not TfIsDir(directory) and not TfMakeDirs(directory)
+            and not TfIsDir(directory)) {
+        TF_WARN("Could not create checkpoint directory %s", directory.c_str());
+        return;
+    }
+
+    // The last complete snapshot is only replaced once the new one is.
+    const std::string tempPath = TfStringPrintf("%s.%d.tmp", path.c_str(),
+                                                ArchGetProcessId());
+    std::string errorMsg;
+    if (not HdNukeWriteExr(tempPath, image, &errorMsg)) {
+        TF_WARN("Could not write render checkpoint: %s", errorMsg.c_str());
+        TfDeleteFile(tempPath);
+        return;
+    }
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        TfDeleteFile(tempPath);
+    }
+}
+
+}  // namespace
+
+
+HdNukeRenderCheckpoints::HdNukeRenderCheckpoints()
+{
+    SetDirectory(std::string());
+}
+
+HdNukeRenderCheckpoints::~HdNukeRenderCheckpoints()
+{
+    _Wait();
+}
+
+void
+HdNukeRenderCheckpoints::SetDirectory(const std::string& directory)
+{
+    if (directory.empty()) {
+        _directory = TfGetenv("HDNUKE_CHECKPOINT_DIR",
+                              TfStringCatPaths(ArchGetTmpDir(),
+                                               "hdNuke_checkpoints"));
+    }
+    else {
+        _directory = directory;
+    }
+}
+
+bool
+HdNukeRenderCheckpoints::Load(const std::string& key, HdNukeExrImage* image,
+                              int* iterations)
+{
+    // A snapshot being written for this key would be newer.
+    _Wait();
+
+    const std::string path = _GetPath(key);
+    if (not TfIsFile(path) or not HdNukeReadExr(path, image)) {
+        return false;
+    }
+    auto it = image->intAttributes.find(ITERATIONS_ATTRIBUTE);
+    if (it == image->intAttributes.end() or it->second <= 0) {
+        return false;
+    }
+    *iterations = it->second;
+    return true;
+}
+
+bool
+HdNukeRenderCheckpoints::Store(const std::string& key, HdNukeExrImage&& image,
+                               int iterations, bool wait)
+{
+    if (_pending.valid()) {
+        if (not wait and _pending.wait_for(std::chrono::seconds(0))
+                         != std::future_status::ready) {
+            return false;
+        }
+        _pending.get();
+    }
+
+    image.intAttributes[ITERATIONS_ATTRIBUTE] = iterations;
+    auto sharedImage = std::make_shared<HdNukeExrImage>(std::move(image));
+    const std::string directory = _directory;
+    const std::string path = _GetPath(key);
+    _pending = std::async(std::launch::async, [directory, path, sharedImage]() {
+        _WriteCheckpoint(directory, path, *sharedImage);
+    });
+    return true;
+}
+
+void
+HdNukeRenderCheckpoints::Remove(const std::string& key)
+{
+    _Wait();
+    const std::string path = _GetPath(key);
+    if (TfIsFile(path)) {
+        TfDeleteFile(path);
+    }
+}
+
+/* static */
+bool
+HdNukeRenderCheckpoints::Blend(HdNukeExrImage* image, int iterations,
+                               const HdNukeExrImage& resumed,
+                               int resumeIterations,
+                               const std::vector<std::string>& accumulated)
+{
+    if (resumed.width != image->width or resumed.height != image->height) {
+        return false;
+    }
+    if (resumeIterations <= 0) {
+        return true;
+    }
+
+    const float resumeWeight = static_cast<float>(resumeIterations)
+        / static_cast<float>(resumeIterations + std::max(iterations, 0));
+    const size_t numPixels = static_cast<size_t>(image->width) * image->height;
+    for (const std::string& name : accumulated)
+    {
+        const int channel = image->FindChannel(name);
+        const int resumeChannel = resumed.FindChannel(name);
+        if (channel < 0 or resumeChannel < 0) {
+            continue;
+        }
+        float* dest = image->Channel(static_cast<size_t>(channel));
+        const float* src = resumed.Channel(static_cast<size_t>(resumeChannel));
+        for (size_t i = 0; i < numPixels; i++)
+        {
+            dest[i] += (src[i] - dest[i]) * resumeWeight;
+        }
+    }
+    return true;
+}
+
+std::string
+HdNukeRenderCheckpoints::_GetPath(const std::string& key) const
+{
+    return TfStringCatPaths(_directory, key + CHECKPOINT_FILE_SUFFIX);
+}
+
+void
+HdNukeRenderCheckpoints::_Wait()
+{
+    if (_pending.valid()) {
+        _pending.get();
+    }
+}
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
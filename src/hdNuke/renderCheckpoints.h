@@ -0,0 +1,78 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#ifndef HDNUKE_RENDERCHECKPOINTS_H
+#define HDNUKE_RENDERCHECKPOINTS_H
+
+#include <future>
+#include <string>
+#include <vector>
+
+#include <pxr/pxr.h>
+
+#include "exrFile.h"
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+// Snapshots of progressive renders in progress, stored as one EXR file per
+// key in a local (or shared) directory, along with the number of iterations
+// they hold. A render that is cut short, e.g. by a preempted farm job, can
+// then resume from its last snapshot rather than start over.
+class HdNukeRenderCheckpoints
+{
+public:
+    HdNukeRenderCheckpoints();
+    ~HdNukeRenderCheckpoints();
+
+    HdNukeRenderCheckpoints(const HdNukeRenderCheckpoints&) = delete;
+    HdNukeRenderCheckpoints& operator=(const HdNukeRenderCheckpoints&) = delete;
+
+    // An empty directory selects the default location, which can be set with
+    // the HDNUKE_CHECKPOINT_DIR environment variable.
+    void SetDirectory(const std::string& directory);
+    inline const std::string& GetDirectory() const { return _directory; }
+
+    bool Load(const std::string& key, HdNukeExrImage* image, int* iterations);
+
+    // Writes the snapshot in the background. Returns false (and drops the
+    // snapshot) if the last one is still being written, unless wait is set.
+    bool Store(const std::string& key, HdNukeExrImage&& image, int iterations,
+               bool wait = false);
+
+    // Deletes the snapshot, once the render it belongs to is done.
+    void Remove(const std::string& key);
+
+    // Blends the snapshot a render resumed from into the image of the passes
+    // it has run since, as if it had never stopped. Each pass is taken to
+    // add the same number of samples. Only the named channels are
+    // accumulated; the others (e.g. depth) keep the latest pass. Returns
+    // false, leaving the image alone, if the sizes differ.
+    static bool Blend(HdNukeExrImage* image, int iterations,
+                      const HdNukeExrImage& resumed, int resumeIterations,
+                      const std::vector<std::string>& accumulated);
+
+private:
+    std::string _GetPath(const std::string& key) const;
+    void _Wait();
+
+    std::string _directory;
+    std::future<void> _pending;
+};
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // HDNUKE_RENDERCHECKPOINTS_H
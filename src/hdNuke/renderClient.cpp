@@ -0,0 +1,562 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <chrono>
+#include <csignal>
+#include <thread>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <pxr/base/arch/errno.h>
+#include <pxr/base/arch/symbols.h>
+#include <pxr/base/tf/getenv.h>
+#include <pxr/base/tf/pathUtils.h>
+#include <pxr/base/tf/stringUtils.h>
+
+#include <pxr/imaging/hd/light.h>
+#include <pxr/imaging/hd/tokens.h>
+
+#include "renderClient.h"
+
+
+extern char** environ;
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+namespace
+{
+    const HdDirtyBits _PrimvarDirtyBits = HdChangeTracker::DirtyPrimvar
+                                          | HdChangeTracker::DirtyPoints
+                                          | HdChangeTracker::DirtyNormals
+                                          | HdChangeTracker::DirtyWidths;
+
+    const TfTokenVector& _LightParams()
+    {
+        static const TfTokenVector params = {
+            HdLightTokens->color,
+            HdLightTokens->intensity,
+            HdLightTokens->exposure,
+            HdLightTokens->diffuse,
+            HdLightTokens->specular,
+            HdLightTokens->radius,
+            HdLightTokens->shadowColor,
+            HdLightTokens->shadowEnable
+        };
+        return params;
+    }
+}  // namespace
+
+
+HdNukeRenderClient::~HdNukeRenderClient()
+{
+    Stop();
+}
+
+/* static */
+std::string
+HdNukeRenderClient::GetDefaultExecutable()
+{
+    const std::string envPath = TfGetenv("HDNUKE_RENDER_SERVER");
+    if (not envPath.empty()) {
+        return envPath;
+    }
+
+    std::string libraryPath;
+    if (not ArchGetAddressInfo(
+            reinterpret_cast<void*>(&HdNukeRenderClient::GetDefaultExecutable),
+            &libraryPath, nullptr, nullptr, nullptr)) {
+        return "hdNukeRenderServer";
+    }
+    return TfNormPath(TfStringCatPaths(TfGetPathName(libraryPath),
+                                       "../bin/hdNukeRenderServer"));
+}
+
+bool
+HdNukeRenderClient::Start(const Options& options)
+{
+    if (IsRunning() and options == _options) {
+        return true;
+    }
+    Stop();
+    _error.clear();
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        return _Fail(TfStringPrintf("Could not create render server socket: %s",
+                                    ArchStrerror().c_str()));
+    }
+    // Only the server's end is inherited.
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+
+    std::vector<std::string> args = {
+        options.executable,
+        "--fd", TfStringify(fds[1])
+    };
+    if (options.threads > 0) {
+        args.push_back("--threads");
+        args.push_back(TfStringify(options.threads));
+    }
+    if (not options.cpus.empty()) {
+        args.push_back("--cpus");
+        args.push_back(options.cpus);
+    }
+    std::vector<char*> argv;
+    for (auto& arg : args)
+    {
+        argv.push_back(&arg[0]);
+    }
+    argv.push_back(nullptr);
+
+    const int result = posix_spawn(&_pid, options.executable.c_str(), nullptr,
+                                   nullptr, argv.data(), environ);
+    close(fds[1]);
+    if (result != 0) {
+        close(fds[0]);
+        _pid = -1;
+        return _Fail(TfStringPrintf("Could not launch render server %s: %s",
+                                    options.executable.c_str(),
+                                    ArchStrerror(result).c_str()));
+    }
+
+    _socket = fds[0];
+    _options = options;
+    return true;
+}
+
+void
+HdNukeRenderClient::Stop()
+{
+    if (_socket >= 0) {
+        HdNukeSendMessage(_socket, HdNukeRenderServerMessage::Quit,
+                          HdNukeMessageWriter());
+        close(_socket);
+        _socket = -1;
+    }
+
+    if (_pid > 0) {
+        // Give the server a moment to shut its delegate down cleanly.
+        int status = 0;
+        pid_t exited = 0;
+        for (int i = 0; i < 50 and exited == 0; i++)
+        {
+            exited = waitpid(_pid, &status, WNOHANG);
+            if (exited == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            }
+        }
+        if (exited == 0) {
+            kill(_pid, SIGKILL);
+            waitpid(_pid, &status, 0);
+        }
+        _pid = -1;
+    }
+
+    _pendingReplies = 0;
+    _framebuffer.Close();
+    _renderer = TfToken();
+    _sceneSynced = false;
+    _sentRprims.clear();
+    _sentLights.clear();
+}
+
+bool
+HdNukeRenderClient::SetRenderer(const TfToken& pluginId, bool* changed)
+{
+    if (changed != nullptr) {
+        *changed = false;
+    }
+    if (pluginId == _renderer) {
+        return true;
+    }
+
+    HdNukeMessageWriter payload;
+    payload.WriteToken(pluginId);
+    if (not _Request(HdNukeRenderServerMessage::SetRenderer, payload)) {
+        return false;
+    }
+    _renderer = pluginId;
+    if (changed != nullptr) {
+        *changed = true;
+    }
+    return true;
+}
+
+bool
+HdNukeRenderClient::SetSettings(
+        const std::vector<std::pair<TfToken, VtValue>>& settings)
+{
+    if (settings.empty()) {
+        return true;
+    }
+
+    HdNukeMessageWriter payload;
+    payload.Write(static_cast<uint32_t>(settings.size()));
+    for (const auto& setting : settings)
+    {
+        payload.WriteToken(setting.first);
+        if (not payload.WriteValue(setting.second)) {
+            TF_WARN("Render setting %s has a type the render server does not "
+                    "support", setting.first.GetText());
+        }
+    }
+    return _Request(HdNukeRenderServerMessage::SetSettings, payload);
+}
+
+bool
+HdNukeRenderClient::SetCamera(int view, const GfVec4d& viewport,
+                              const GfMatrix4d& viewMatrix,
+                              const GfMatrix4d& projectionMatrix)
+{
+    HdNukeMessageWriter payload;
+    payload.Write(static_cast<int32_t>(view));
+    payload.Write(viewport);
+    payload.Write(viewMatrix);
+    payload.Write(projectionMatrix);
+    return _Request(HdNukeRenderServerMessage::SetCamera, payload);
+}
+
+bool
+HdNukeRenderClient::SyncScene(const HdNukeSceneData& sceneData)
+{
+    if (_sceneSynced and sceneData.GetVersion() == _syncedVersion) {
+        return true;
+    }
+
+    const auto& rprims = sceneData.GetRprims();
+    const auto& lights = sceneData.GetLights();
+
+    HdNukeMessageWriter payload;
+
+    std::vector<SdfPath> removed;
+    for (auto it = _sentRprims.begin(); it != _sentRprims.end(); )
+    {
+        const auto rprimIt = rprims.find(*it);
+        if (rprimIt == rprims.end() or not rprimIt->second.instancerId.IsEmpty()) {
+            removed.push_back(*it);
+            it = _sentRprims.erase(it);
+        }
+        else {
+            it++;
+        }
+    }
+    payload.Write(static_cast<uint32_t>(removed.size()));
+    for (const auto& primId : removed)
+    {
+        payload.WritePath(primId);
+    }
+
+    HdNukeMessageWriter changed;
+    uint32_t changedCount = 0;
+    bool skippedInstances = false;
+    for (const auto& rprimEntry : rprims)
+    {
+        const HdNukeRprimEntry& rprim = rprimEntry.second;
+        if (not rprim.instancerId.IsEmpty()) {
+            skippedInstances = true;
+            continue;
+        }
+
+        HdDirtyBits dirtyBits = HdChangeTracker::AllDirty;
+        if (not _sentRprims.insert(rprimEntry.first).second) {
+            dirtyBits = rprim.history.Since(_syncedVersion);
+        }
+        if (dirtyBits == HdChangeTracker::Clean) {
+            continue;
+        }
+        _WriteRprim(changed, rprimEntry.first, rprim, dirtyBits);
+        changedCount++;
+    }
+    if (skippedInstances) {
+        TF_WARN("Instanced geometry is not supported by the render server");
+    }
+    payload.Write(changedCount);
+    payload.WriteBytes(changed.GetData().data(), changed.GetData().size());
+
+    removed.clear();
+    for (auto it = _sentLights.begin(); it != _sentLights.end(); )
+    {
+        if (lights.find(*it) == lights.end()) {
+            removed.push_back(*it);
+            it = _sentLights.erase(it);
+        }
+        else {
+            it++;
+        }
+    }
+    payload.Write(static_cast<uint32_t>(removed.size()));
+    for (const auto& lightId : removed)
+    {
+        payload.WritePath(lightId);
+    }
+
+    changed.Clear();
+    changedCount = 0;
+    for (const auto& lightEntry : lights)
+    {
+        HdDirtyBits dirtyBits = HdChangeTracker::AllDirty;
+        if (not _sentLights.insert(lightEntry.first).second) {
+            dirtyBits = lightEntry.second.history.Since(_syncedVersion);
+        }
+        if (dirtyBits == HdChangeTracker::Clean) {
+            continue;
+        }
+        _WriteLight(changed, lightEntry.first, lightEntry.second, dirtyBits);
+        changedCount++;
+    }
+    payload.Write(changedCount);
+    payload.WriteBytes(changed.GetData().data(), changed.GetData().size());
+
+    if (not _Request(HdNukeRenderServerMessage::UpdateScene, payload)) {
+        return false;
+    }
+    _syncedVersion = sceneData.GetVersion();
+    _sceneSynced = true;
+    return true;
+}
+
+bool
+HdNukeRenderClient::ClearScene()
+{
+    _sceneSynced = false;
+    _sentRprims.clear();
+    _sentLights.clear();
+    return _Request(HdNukeRenderServerMessage::ClearScene,
+                    HdNukeMessageWriter());
+}
+
+void
+HdNukeRenderClient::_WriteRprim(HdNukeMessageWriter& out, const SdfPath& primId,
+                                const HdNukeRprimEntry& rprim,
+                                HdDirtyBits dirtyBits) const
+{
+    const HdNukeGeoAdapterPtr& adapter = rprim.adapter;
+
+    out.WritePath(primId);
+    out.WriteToken(rprim.primType);
+    out.Write(static_cast<uint32_t>(dirtyBits));
+
+    if (dirtyBits & HdChangeTracker::DirtyTransform) {
+        out.Write(adapter->GetTransform());
+    }
+    if (dirtyBits & HdChangeTracker::DirtyVisibility) {
+        out.Write(static_cast<uint8_t>(adapter->GetVisible()));
+    }
+    if (dirtyBits & HdChangeTracker::DirtyExtent) {
+        const GfRange3d extent = adapter->GetExtent();
+        out.Write(extent.GetMin());
+        out.Write(extent.GetMax());
+    }
+    if (dirtyBits & HdChangeTracker::DirtyTopology) {
+        out.WriteTopology(adapter->GetMeshTopology());
+    }
+    if (dirtyBits & _PrimvarDirtyBits) {
+        // The server reads the descriptors of every interpolation.
+        for (int interpolation = 0; interpolation < HdInterpolationCount;
+             interpolation++)
+        {
+            const HdPrimvarDescriptorVector& descriptors =
+                adapter->GetPrimvarDescriptors(
+                    static_cast<HdInterpolation>(interpolation));
+            out.WritePrimvarDescriptors(descriptors);
+            for (const auto& descriptor : descriptors)
+            {
+                if (not out.WriteValue(adapter->Get(descriptor.name))) {
+                    TF_WARN("Primvar %s of %s has a type the render server "
+                            "does not support", descriptor.name.GetText(),
+                            primId.GetText());
+                }
+            }
+        }
+        // The values are in the message now.
+        adapter->ReleaseWidenedPrimvars();
+    }
+}
+
+void
+HdNukeRenderClient::_WriteLight(HdNukeMessageWriter& out, const SdfPath& lightId,
+                                const HdNukeLightEntry& light,
+                                HdDirtyBits dirtyBits) const
+{
+    out.WritePath(lightId);
+    out.WriteToken(light.lightType);
+    out.Write(static_cast<uint32_t>(dirtyBits));
+
+    if (dirtyBits & HdLight::DirtyTransform) {
+        out.Write(light.adapter->GetTransform());
+    }
+    if (dirtyBits & (HdLight::DirtyParams | HdLight::DirtyShadowParams)) {
+        std::vector<std::pair<TfToken, VtValue>> params;
+        for (const TfToken& param : _LightParams())
+        {
+            VtValue value = light.adapter->GetLightParamValue(param);
+            if (not value.IsEmpty()) {
+                params.emplace_back(param, std::move(value));
+            }
+        }
+        out.Write(static_cast<uint32_t>(params.size()));
+        for (const auto& param : params)
+        {
+            out.WriteToken(param.first);
+            out.WriteValue(param.second);
+        }
+    }
+}
+
+bool
+HdNukeRenderClient::Execute(int view, bool* converged)
+{
+    HdNukeMessageWriter payload;
+    payload.Write(static_cast<int32_t>(view));
+    std::vector<char> reply;
+    if (not _Request(HdNukeRenderServerMessage::Execute, payload, &reply)) {
+        return false;
+    }
+    HdNukeMessageReader reader(reply);
+    *converged = reader.Read<uint8_t>() != 0;
+    return reader.IsValid() or _Fail("Malformed render server reply");
+}
+
+bool
+HdNukeRenderClient::Pause()
+{
+    return _Request(HdNukeRenderServerMessage::Pause, HdNukeMessageWriter());
+}
+
+bool
+HdNukeRenderClient::Resolve(int view, int width, int height,
+                            const float** color, const float** depth,
+                            int* bufferWidth, int* bufferHeight)
+{
+    // Color and depth, as floats.
+    const size_t size = static_cast<size_t>(width) * height * 5 * sizeof(float);
+    if (_framebuffer.GetSize() < size) {
+        // A new name, so the server never maps a segment that is going away.
+        const std::string name = TfStringPrintf("/hdNuke_%d_%d",
+                                                static_cast<int>(getpid()),
+                                                ++_framebufferSerial);
+        if (not _framebuffer.Create(name, size)) {
+            return _Fail("Could not create render server framebuffer");
+        }
+
+        HdNukeMessageWriter payload;
+        payload.WriteString(name);
+        payload.Write(static_cast<uint64_t>(size));
+        if (not _Request(HdNukeRenderServerMessage::SetFramebuffer, payload)) {
+            return false;
+        }
+    }
+
+    HdNukeMessageWriter payload;
+    payload.Write(static_cast<int32_t>(view));
+    std::vector<char> reply;
+    if (not _Request(HdNukeRenderServerMessage::Resolve, payload, &reply)) {
+        return false;
+    }
+    HdNukeMessageReader reader(reply);
+    *bufferWidth = reader.Read<int32_t>();
+    *bufferHeight = reader.Read<int32_t>();
+    const size_t numPixels = static_cast<size_t>(*bufferWidth) * *bufferHeight;
+    if (not reader.IsValid() or numPixels * 5 * sizeof(float) > _framebuffer.GetSize()) {
+        return _Fail("Malformed render server reply");
+    }
+
+    const float* data = static_cast<const float*>(_framebuffer.GetData());
+    *color = data;
+    *depth = data + numPixels * 4;
+    return true;
+}
+
+bool
+HdNukeRenderClient::_Request(HdNukeRenderServerMessage type,
+                             const HdNukeMessageWriter& payload,
+                             std::vector<char>* reply)
+{
+    if (not IsRunning()) {
+        return _Fail("The render server is not running");
+    }
+
+    std::vector<char> data;
+    HdNukeRenderServerMessage replyType;
+    while (_pendingReplies > 0) {
+        if (not _Receive(&replyType, &data)) {
+            return false;
+        }
+        _pendingReplies--;
+    }
+
+    if (not HdNukeSendMessage(_socket, type, payload)) {
+        return _Fail("Lost the connection to the render server");
+    }
+    _pendingReplies++;
+    if (not _Receive(&replyType, &data)) {
+        return false;
+    }
+    _pendingReplies--;
+    if (replyType != HdNukeRenderServerMessage::Reply) {
+        return _Fail("Lost the connection to the render server");
+    }
+
+    HdNukeMessageReader reader(data);
+    const bool ok = reader.Read<uint8_t>() != 0;
+    const std::string error = reader.ReadString();
+    if (not reader.IsValid()) {
+        return _Fail("Malformed render server reply");
+    }
+    if (not ok) {
+        // The server is still usable.
+        _error = error;
+        return false;
+    }
+
+    if (reply != nullptr) {
+        reply->assign(data.begin() + static_cast<std::ptrdiff_t>(reader.GetOffset()),
+                      data.end());
+    }
+    return true;
+}
+
+bool
+HdNukeRenderClient::_Receive(HdNukeRenderServerMessage* type,
+                             std::vector<char>* data)
+{
+    switch (HdNukeReceiveMessage(_socket, type, data, _timeout, _interrupted)) {
+        case HdNukeReceiveStatus::Received:
+            return true;
+        case HdNukeReceiveStatus::Interrupted:
+            // The server is still usable once it has replied.
+            _error = "Render server request interrupted";
+            return false;
+        case HdNukeReceiveStatus::TimedOut:
+            return _Fail(TfStringPrintf(
+                "The render server did not reply within %g seconds", _timeout));
+        default:
+            return _Fail("Lost the connection to the render server");
+    }
+}
+
+bool
+HdNukeRenderClient::_Fail(const std::string& message)
+{
+    Stop();
+    _error = message;
+    return false;
+}
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,161 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#ifndef HDNUKE_RENDERCLIENT_H
+#define HDNUKE_RENDERCLIENT_H
+
+#include <functional>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <sys/types.h>
+
+#include <pxr/pxr.h>
+
+#include <pxr/base/gf/matrix4d.h>
+#include <pxr/base/gf/vec4d.h>
+
+#include "renderServerProtocol.h"
+#include "sceneData.h"
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+// Drives an hdNukeRenderServer process, which renders the converted Nuke
+// scene with its own render delegate. This keeps delegate crashes (and
+// memory use) out of the Nuke process, and lets the renderer's threads be
+// confined to a set of cores.
+//
+// Only the prims that changed since the last sync are sent to the server, and
+// framebuffers come back through a shared memory segment rather than the
+// socket.
+//
+// Losing the connection stops the server, so the next Start launches a new
+// one. Requests the server merely rejects leave it running.
+class HdNukeRenderClient
+{
+public:
+    struct Options
+    {
+        std::string executable;
+        // Zero lets the server use all cores.
+        int threads = 0;
+        // A list of cores to pin the server to, e.g. "0-7,16". Empty to leave
+        // the affinity alone.
+        std::string cpus;
+
+        bool operator==(const Options& other) const {
+            return executable == other.executable and threads == other.threads
+                   and cpus == other.cpus;
+        }
+        bool operator!=(const Options& other) const {
+            return not (*this == other);
+        }
+    };
+
+    HdNukeRenderClient() = default;
+    ~HdNukeRenderClient();
+
+    HdNukeRenderClient(const HdNukeRenderClient&) = delete;
+    HdNukeRenderClient& operator=(const HdNukeRenderClient&) = delete;
+
+    // Launches the server, unless it is already running with the same
+    // options. Returns false if the server could not be started.
+    bool Start(const Options& options);
+    void Stop();
+
+    inline bool IsRunning() const { return _socket >= 0; }
+
+    // A request that gets no reply within `seconds` (never if not positive)
+    // stops the server.
+    inline void SetTimeout(double seconds) { _timeout = seconds; }
+    // Polled while waiting for a reply. Once it returns true, the request
+    // fails without waiting any longer, and the server keeps running; its
+    // reply is skipped by the next request.
+    inline void SetInterruptCallback(std::function<bool()> interrupted) {
+        _interrupted = std::move(interrupted);
+    }
+
+    // Switching renderers keeps the scene, but not the settings or cameras.
+    // `changed` is set to whether the renderer differs from the last one.
+    bool SetRenderer(const TfToken& pluginId, bool* changed = nullptr);
+    inline const TfToken& GetRenderer() const { return _renderer; }
+
+    bool SetSettings(const std::vector<std::pair<TfToken, VtValue>>& settings);
+
+    bool SetCamera(int view, const GfVec4d& viewport,
+                   const GfMatrix4d& viewMatrix,
+                   const GfMatrix4d& projectionMatrix);
+
+    // Sends the prims added, changed or removed since the last sync. Of the
+    // changed prims, only the parts covered by their dirty bits are sent.
+    bool SyncScene(const HdNukeSceneData& sceneData);
+    bool ClearScene();
+
+    // Runs a single iteration of the view's render tasks.
+    bool Execute(int view, bool* converged);
+    bool Pause();
+
+    // Has the server copy the view's color (RGBA) and depth buffers into
+    // shared memory. The returned pointers stay valid until the next Resolve.
+    bool Resolve(int view, int width, int height, const float** color,
+                 const float** depth, int* bufferWidth, int* bufferHeight);
+
+    inline const std::string& GetError() const { return _error; }
+
+    // The server next to the HdNuke library, unless overridden by
+    // $HDNUKE_RENDER_SERVER.
+    static std::string GetDefaultExecutable();
+
+private:
+    bool _Request(HdNukeRenderServerMessage type,
+                  const HdNukeMessageWriter& payload,
+                  std::vector<char>* reply = nullptr);
+    bool _Fail(const std::string& message);
+    bool _Receive(HdNukeRenderServerMessage* type, std::vector<char>* data);
+
+    void _WriteRprim(HdNukeMessageWriter& out, const SdfPath& primId,
+                     const HdNukeRprimEntry& rprim, HdDirtyBits dirtyBits) const;
+    void _WriteLight(HdNukeMessageWriter& out, const SdfPath& lightId,
+                     const HdNukeLightEntry& light, HdDirtyBits dirtyBits) const;
+
+    Options _options;
+    pid_t _pid = -1;
+    int _socket = -1;
+    std::string _error;
+
+    double _timeout = 0.0;
+    std::function<bool()> _interrupted;
+    // Replies to interrupted requests, still to be skipped.
+    int _pendingReplies = 0;
+
+    HdNukeSharedMemory _framebuffer;
+    int _framebufferSerial = 0;
+
+    TfToken _renderer;
+
+    // What the server holds of the scene.
+    uint64_t _syncedVersion = 0;
+    bool _sceneSynced = false;
+    std::unordered_set<SdfPath, SdfPath::Hash> _sentRprims;
+    std::unordered_set<SdfPath, SdfPath::Hash> _sentLights;
+};
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // HDNUKE_RENDERCLIENT_H
@@ -0,0 +1,74 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <chrono>
+
+#include "renderLoop.h"
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+HdNukeRenderLoop::Result
+HdNukeRenderLoop::Run()
+{
+    using Clock = std::chrono::steady_clock;
+
+    const Clock::time_point start = Clock::now();
+    _iterations = 0;
+    _elapsed = 0.0;
+
+    bool converged = false;
+    do {
+        if (interrupted and interrupted()) {
+            if (pause) {
+                pause();
+            }
+            return Interrupted;
+        }
+        if (maxIterations > 0
+                and startIteration + _iterations >= maxIterations) {
+            return IterationLimit;
+        }
+        if (_iterations > 0) {
+            // The time budget takes precedence, so a render that runs out of
+            // both stops for good.
+            if (timeBudget > 0 and startTime + _elapsed >= timeBudget) {
+                return TimeLimit;
+            }
+            if (sliceTime > 0 and _elapsed >= sliceTime) {
+                return Sliced;
+            }
+        }
+        const bool executed = execute(&converged);
+        if (executed) {
+            _iterations++;
+        }
+        const bool finished = executed and afterPass and afterPass(converged);
+        _elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+        if (not executed) {
+            return (interrupted and interrupted()) ? Interrupted : Failed;
+        }
+        if (finished and not converged) {
+            return Finished;
+        }
+    }
+    while (not converged);
+
+    return Converged;
+}
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,82 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#ifndef HDNUKE_RENDERLOOP_H
+#define HDNUKE_RENDERLOOP_H
+
+#include <functional>
+
+#include <pxr/pxr.h>
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+// Drives a progressive render one Execute pass at a time, checking for
+// interruption and the iteration and time limits between passes, so a new
+// request preempts the current render within one pass.
+class HdNukeRenderLoop
+{
+public:
+    enum Result
+    {
+        Converged,
+        Finished,  // Stopped by afterPass
+        IterationLimit,
+        TimeLimit,
+        Sliced,  // Out of slice time, to be continued by another Run
+        Interrupted,
+        Failed
+    };
+
+    // Zero disables the limit. The iteration limit includes the passes in
+    // `startIteration`, e.g. those of a resumed checkpoint, and the time
+    // budget includes `startTime`, the seconds spent by earlier Runs of a
+    // render that is being continued.
+    int maxIterations = 0;
+    int startIteration = 0;
+    double timeBudget = 0.0;
+    double startTime = 0.0;
+    // Ends the Run after this many seconds, without stopping the render, so
+    // it can show its progress and be continued. Zero disables slicing.
+    double sliceTime = 0.0;
+
+    // Polled before every pass.
+    std::function<bool()> interrupted;
+    // Runs one pass, and reports whether the render has converged. Returns
+    // false on failure. A pass that fails once the render has been
+    // interrupted (e.g. one that gave up waiting on a render server) ends the
+    // loop as an interruption.
+    std::function<bool(bool* converged)> execute;
+    // Optional. Called after every pass; returning true ends the render.
+    std::function<bool(bool converged)> afterPass;
+    // Called when the loop is interrupted, so the delegate stops rendering
+    // in the background.
+    std::function<void()> pause;
+
+    Result Run();
+
+    // The number of passes executed by the last Run, and the seconds it took.
+    inline int GetIterations() const { return _iterations; }
+    inline double GetElapsed() const { return _elapsed; }
+
+private:
+    int _iterations = 0;
+    double _elapsed = 0.0;
+};
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // HDNUKE_RENDERLOOP_H
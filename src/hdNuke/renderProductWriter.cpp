@@ -0,0 +1,221 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <set>
+
+#include <pxr/base/arch/systemInfo.h>
+#include <pxr/base/gf/half.h>
+#include <pxr/base/tf/diagnostic.h>
+#include <pxr/base/tf/fileUtils.h>
+#include <pxr/base/tf/pathUtils.h>
+#include <pxr/base/tf/stringUtils.h>
+
+#include "renderProductWriter.h"
+#include "utils.h"
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+namespace {
+
+// Writes to a temporary file first, so other readers never see a partial
+// image. Returns an error message, or an empty string on success.
+std::string
+_WriteProduct(const std::string& path, const std::vector<HdNukeExrPart>& parts)
+{
+    const std::string directory = TfGetPathName(path);
+    if (not directory.empty() and not TfIsDir(directory)
+            and not TfMakeDirs(directory) and not TfIsDir(directory)) {
+        return "Could not create directory " + directory;
+    }
+
+    const std::string tempPath = TfStringPrintf("%s.%d.tmp", path.c_str(),
+                                                ArchGetProcessId());
+    std::string errorMsg;
+    if (not HdNukeWriteMultiPartExr(tempPath, parts, &errorMsg)) {
+        TfDeleteFile(tempPath);
+        return errorMsg;
+    }
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        TfDeleteFile(tempPath);
+        return "Could not rename " + tempPath + " to " + path;
+    }
+    return std::string();
+}
+
+std::mutex _writersMutex;
+std::set<HdNukeRenderProductWriter*> _writers;
+
+void
+_WaitForAllWriters()
+{
+    std::lock_guard<std::mutex> lock(_writersMutex);
+    for (HdNukeRenderProductWriter* writer : _writers)
+    {
+        writer->Wait();
+        const std::string errors = writer->TakeErrors();
+        if (not errors.empty()) {
+            TF_WARN("Could not write render products: %s", errors.c_str());
+        }
+    }
+}
+
+}  // namespace
+
+
+HdNukeRenderProductWriter::HdNukeRenderProductWriter()
+{
+    static std::once_flag registerExitHook;
+    std::call_once(registerExitHook, []() {
+        std::atexit(_WaitForAllWriters);
+    });
+
+    std::lock_guard<std::mutex> lock(_writersMutex);
+    _writers.insert(this);
+}
+
+HdNukeRenderProductWriter::~HdNukeRenderProductWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(_writersMutex);
+        _writers.erase(this);
+    }
+    Wait();
+
+    const std::string errors = TakeErrors();
+    if (not errors.empty()) {
+        TF_WARN("Could not write render products: %s", errors.c_str());
+    }
+}
+
+void
+HdNukeRenderProductWriter::Write(const std::string& path,
+                                 std::vector<HdNukeExrPart>&& parts)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _Collect(false);
+    while (_pending.size() >= _maxPending)
+    {
+        _errors.push_back(_pending.front().get());
+        _pending.pop_front();
+    }
+
+    // The parts are moved into the task, so the caller's buffers can be
+    // reused right away.
+    auto sharedParts = std::make_shared<std::vector<HdNukeExrPart>>(
+        std::move(parts));
+    _pending.push_back(std::async(std::launch::async, [path, sharedParts]() {
+        return _WriteProduct(path, *sharedParts);
+    }));
+}
+
+void
+HdNukeRenderProductWriter::Wait()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _Collect(true);
+}
+
+std::string
+HdNukeRenderProductWriter::TakeErrors()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _Collect(false);
+    std::vector<std::string> errors;
+    for (auto& error : _errors)
+    {
+        if (not error.empty()) {
+            errors.push_back(std::move(error));
+        }
+    }
+    _errors.clear();
+    return TfStringJoin(errors, "\n");
+}
+
+void
+HdNukeRenderProductWriter::_Collect(bool wait)
+{
+    while (not _pending.empty())
+    {
+        std::future<std::string>& write = _pending.front();
+        if (not wait and write.wait_for(std::chrono::seconds(0))
+                         != std::future_status::ready) {
+            break;
+        }
+        _errors.push_back(write.get());
+        _pending.pop_front();
+    }
+}
+
+
+bool
+HdNukeRenderBufferToExrImage(HdRenderBuffer* buffer,
+                             const std::vector<std::string>& channelNames,
+                             HdNukeExrImage* image)
+{
+    const HdFormat bufferFormat = buffer->GetFormat();
+    const size_t numComponents = HdGetComponentCount(bufferFormat);
+    if (numComponents == 0 or numComponents != channelNames.size()) {
+        return false;
+    }
+
+    image->Resize(static_cast<int>(buffer->GetWidth()),
+                  static_cast<int>(buffer->GetHeight()), channelNames);
+    const size_t numPixels = static_cast<size_t>(image->width) * image->height;
+    float* dest = image->pixels.data();
+
+    // Buffers are interleaved, images store one channel after another.
+    bool supported = true;
+    void* data = buffer->Map();
+    switch (HdGetComponentFormat(bufferFormat)) {
+        case HdFormatUNorm8:
+            for (size_t c = 0; c < numComponents; c++)
+            {
+                const uint8_t* src = static_cast<uint8_t*>(data) + c;
+                for (size_t i = 0; i < numPixels; i++)
+                {
+                    *dest++ = src[i * numComponents] / 255.0f;
+                }
+            }
+            break;
+        case HdFormatSNorm8:
+            ConvertHdBufferData<int8_t>(data, dest, numPixels, numComponents,
+                                        false);
+            break;
+        case HdFormatFloat16:
+            ConvertHdBufferData<GfHalf>(data, dest, numPixels, numComponents,
+                                        false);
+            break;
+        case HdFormatFloat32:
+            ConvertHdBufferData<float>(data, dest, numPixels, numComponents,
+                                       false);
+            break;
+        case HdFormatInt32:
+            ConvertHdBufferData<int32_t>(data, dest, numPixels, numComponents,
+                                         false);
+            break;
+        default:
+            supported = false;
+    }
+    buffer->Unmap();
+    return supported;
+}
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
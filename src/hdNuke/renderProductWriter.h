@@ -0,0 +1,81 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#ifndef HDNUKE_RENDERPRODUCTWRITER_H
+#define HDNUKE_RENDERPRODUCTWRITER_H
+
+#include <algorithm>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <pxr/pxr.h>
+
+#include <pxr/imaging/hd/renderBuffer.h>
+
+#include "exrFile.h"
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+// Writes render products (multi-part EXR files holding the AOVs of a render)
+// in the background, so the render thread can go on to the next frame while
+// the last one is compressed and written.
+class HdNukeRenderProductWriter
+{
+public:
+    HdNukeRenderProductWriter();
+    // Waits for pending files. Nuke may exit without destroying its ops, so
+    // that is also done for all writers when the process exits.
+    ~HdNukeRenderProductWriter();
+
+    HdNukeRenderProductWriter(const HdNukeRenderProductWriter&) = delete;
+    HdNukeRenderProductWriter& operator=(const HdNukeRenderProductWriter&) = delete;
+
+    // Limits the number of files being written at once, and thus the memory
+    // held by pending frames. Write blocks until a file is done if needed.
+    inline void SetMaxPending(size_t count) { _maxPending = std::max<size_t>(count, 1); }
+
+    void Write(const std::string& path, std::vector<HdNukeExrPart>&& parts);
+
+    // Waits for all pending files to be written.
+    void Wait();
+
+    // Returns the errors of the writes that have finished since the last
+    // call, one per line, or an empty string if there were none.
+    std::string TakeErrors();
+
+private:
+    void _Collect(bool wait);
+
+    std::mutex _mutex;
+    std::deque<std::future<std::string>> _pending;
+    std::vector<std::string> _errors;
+    size_t _maxPending = 2;
+};
+
+
+// Copies a (resolved) render buffer into an image, with one channel per
+// buffer component. Returns false if the buffer's format isn't supported.
+bool HdNukeRenderBufferToExrImage(HdRenderBuffer* buffer,
+                                  const std::vector<std::string>& channelNames,
+                                  HdNukeExrImage* image);
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // HDNUKE_RENDERPRODUCTWRITER_H
@@ -0,0 +1,497 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <pxr/base/gf/matrix4d.h>
+#include <pxr/base/gf/vec2f.h>
+#include <pxr/base/gf/vec3f.h>
+#include <pxr/base/gf/vec4f.h>
+#include <pxr/base/tf/diagnostic.h>
+
+#include "renderServerProtocol.h"
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+namespace
+{
+    enum _ValueType : uint8_t
+    {
+        _Empty = 0,
+        _Bool,
+        _Int,
+        _Float,
+        _Double,
+        _String,
+        _Token,
+        _Vec2f,
+        _Vec3f,
+        _Vec4f,
+        _Matrix4d,
+        _IntArray,
+        _FloatArray,
+        _Vec2fArray,
+        _Vec3fArray,
+        _Vec4fArray
+    };
+
+    struct _MessageHeader
+    {
+        uint32_t type;
+        uint32_t reserved;
+        uint64_t size;
+    };
+
+#if defined(MSG_NOSIGNAL)
+    const int _SendFlags = MSG_NOSIGNAL;
+#else
+    const int _SendFlags = 0;
+#endif
+
+    bool _SendAll(int fd, const void* data, size_t size)
+    {
+        const char* ptr = static_cast<const char*>(data);
+        while (size > 0) {
+            const ssize_t sent = send(fd, ptr, size, _SendFlags);
+            if (sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            ptr += sent;
+            size -= static_cast<size_t>(sent);
+        }
+        return true;
+    }
+
+    using _Clock = std::chrono::steady_clock;
+
+    // How often an interruption is checked for while waiting.
+    const int _PollIntervalMs = 50;
+
+    HdNukeReceiveStatus _ReceiveAll(int fd, void* data, size_t size,
+                                    const _Clock::time_point* deadline,
+                                    const std::function<bool()>& interrupted)
+    {
+        char* ptr = static_cast<char*>(data);
+        while (size > 0) {
+            if (deadline != nullptr or interrupted) {
+                int waitMs = interrupted ? _PollIntervalMs : INT_MAX;
+                if (deadline != nullptr) {
+                    const auto remaining =
+                        std::chrono::duration_cast<std::chrono::milliseconds>(
+                            *deadline - _Clock::now()).count();
+                    if (remaining <= 0) {
+                        return HdNukeReceiveStatus::TimedOut;
+                    }
+                    waitMs = static_cast<int>(
+                        std::min<decltype(remaining)>(waitMs, remaining));
+                }
+
+                pollfd pfd;
+                pfd.fd = fd;
+                pfd.events = POLLIN;
+                pfd.revents = 0;
+                const int ready = poll(&pfd, 1, waitMs);
+                if (ready < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return HdNukeReceiveStatus::Closed;
+                }
+                if (ready == 0) {
+                    // Only before any of the data has arrived, so it can
+                    // still be received whole later.
+                    if (interrupted and ptr == data and interrupted()) {
+                        return HdNukeReceiveStatus::Interrupted;
+                    }
+                    continue;
+                }
+            }
+
+            const ssize_t received = recv(fd, ptr, size, 0);
+            if (received == 0) {
+                return HdNukeReceiveStatus::Closed;
+            }
+            if (received < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return HdNukeReceiveStatus::Closed;
+            }
+            ptr += received;
+            size -= static_cast<size_t>(received);
+        }
+        return HdNukeReceiveStatus::Received;
+    }
+}  // namespace
+
+
+void
+HdNukeMessageWriter::WriteBytes(const void* data, size_t size)
+{
+    if (size == 0) {
+        return;
+    }
+    const char* bytes = static_cast<const char*>(data);
+    _data.insert(_data.end(), bytes, bytes + size);
+}
+
+void
+HdNukeMessageWriter::WriteString(const std::string& value)
+{
+    Write(static_cast<uint64_t>(value.size()));
+    WriteBytes(value.data(), value.size());
+}
+
+bool
+HdNukeMessageWriter::WriteValue(const VtValue& value)
+{
+    if (value.IsHolding<bool>()) {
+        Write(_Bool);
+        Write(static_cast<uint8_t>(value.UncheckedGet<bool>()));
+    }
+    else if (value.IsHolding<int>()) {
+        Write(_Int);
+        Write(value.UncheckedGet<int>());
+    }
+    else if (value.IsHolding<float>()) {
+        Write(_Float);
+        Write(value.UncheckedGet<float>());
+    }
+    else if (value.IsHolding<double>()) {
+        Write(_Double);
+        Write(value.UncheckedGet<double>());
+    }
+    else if (value.IsHolding<std::string>()) {
+        Write(_String);
+        WriteString(value.UncheckedGet<std::string>());
+    }
+    else if (value.IsHolding<TfToken>()) {
+        Write(_Token);
+        WriteToken(value.UncheckedGet<TfToken>());
+    }
+    else if (value.IsHolding<GfVec2f>()) {
+        Write(_Vec2f);
+        Write(value.UncheckedGet<GfVec2f>());
+    }
+    else if (value.IsHolding<GfVec3f>()) {
+        Write(_Vec3f);
+        Write(value.UncheckedGet<GfVec3f>());
+    }
+    else if (value.IsHolding<GfVec4f>()) {
+        Write(_Vec4f);
+        Write(value.UncheckedGet<GfVec4f>());
+    }
+    else if (value.IsHolding<GfMatrix4d>()) {
+        Write(_Matrix4d);
+        Write(value.UncheckedGet<GfMatrix4d>());
+    }
+    else if (value.IsHolding<VtIntArray>()) {
+        Write(_IntArray);
+        WriteArray(value.UncheckedGet<VtIntArray>());
+    }
+    else if (value.IsHolding<VtFloatArray>()) {
+        Write(_FloatArray);
+        WriteArray(value.UncheckedGet<VtFloatArray>());
+    }
+    else if (value.IsHolding<VtVec2fArray>()) {
+        Write(_Vec2fArray);
+        WriteArray(value.UncheckedGet<VtVec2fArray>());
+    }
+    else if (value.IsHolding<VtVec3fArray>()) {
+        Write(_Vec3fArray);
+        WriteArray(value.UncheckedGet<VtVec3fArray>());
+    }
+    else if (value.IsHolding<VtVec4fArray>()) {
+        Write(_Vec4fArray);
+        WriteArray(value.UncheckedGet<VtVec4fArray>());
+    }
+    else {
+        Write(_Empty);
+        return value.IsEmpty();
+    }
+    return true;
+}
+
+void
+HdNukeMessageWriter::WriteTopology(const HdMeshTopology& topology)
+{
+    WriteToken(topology.GetScheme());
+    WriteToken(topology.GetOrientation());
+    WriteArray(topology.GetFaceVertexCounts());
+    WriteArray(topology.GetFaceVertexIndices());
+    WriteArray(topology.GetHoleIndices());
+}
+
+void
+HdNukeMessageWriter::WritePrimvarDescriptors(
+        const HdPrimvarDescriptorVector& descriptors)
+{
+    Write(static_cast<uint32_t>(descriptors.size()));
+    for (const auto& descriptor : descriptors)
+    {
+        WriteToken(descriptor.name);
+        Write(static_cast<int32_t>(descriptor.interpolation));
+        WriteToken(descriptor.role);
+    }
+}
+
+
+bool
+HdNukeMessageReader::ReadBytes(void* dest, size_t size)
+{
+    if (not _valid or size > _data.size() - _offset) {
+        _valid = false;
+        return false;
+    }
+    if (size > 0) {
+        std::memcpy(dest, _data.data() + _offset, size);
+        _offset += size;
+    }
+    return true;
+}
+
+std::string
+HdNukeMessageReader::ReadString()
+{
+    const uint64_t size = Read<uint64_t>();
+    if (not _valid or size > _data.size() - _offset) {
+        _valid = false;
+        return std::string();
+    }
+    std::string value(_data.data() + _offset, size);
+    _offset += size;
+    return value;
+}
+
+SdfPath
+HdNukeMessageReader::ReadPath()
+{
+    const std::string path = ReadString();
+    return path.empty() ? SdfPath() : SdfPath(path);
+}
+
+VtValue
+HdNukeMessageReader::ReadValue()
+{
+    switch (Read<uint8_t>()) {
+        case _Bool:
+            return VtValue(Read<uint8_t>() != 0);
+        case _Int:
+            return VtValue(Read<int>());
+        case _Float:
+            return VtValue(Read<float>());
+        case _Double:
+            return VtValue(Read<double>());
+        case _String:
+            return VtValue(ReadString());
+        case _Token:
+            return VtValue(ReadToken());
+        case _Vec2f:
+            return VtValue(Read<GfVec2f>());
+        case _Vec3f:
+            return VtValue(Read<GfVec3f>());
+        case _Vec4f:
+            return VtValue(Read<GfVec4f>());
+        case _Matrix4d:
+            return VtValue(Read<GfMatrix4d>());
+        case _IntArray:
+            return VtValue(ReadArray<int>());
+        case _FloatArray:
+            return VtValue(ReadArray<float>());
+        case _Vec2fArray:
+            return VtValue(ReadArray<GfVec2f>());
+        case _Vec3fArray:
+            return VtValue(ReadArray<GfVec3f>());
+        case _Vec4fArray:
+            return VtValue(ReadArray<GfVec4f>());
+        case _Empty:
+            return VtValue();
+        default:
+            _valid = false;
+            return VtValue();
+    }
+}
+
+HdMeshTopology
+HdNukeMessageReader::ReadTopology()
+{
+    const TfToken scheme = ReadToken();
+    const TfToken orientation = ReadToken();
+    const VtIntArray faceVertexCounts = ReadArray<int>();
+    const VtIntArray faceVertexIndices = ReadArray<int>();
+    const VtIntArray holeIndices = ReadArray<int>();
+    return HdMeshTopology(scheme, orientation, faceVertexCounts,
+                          faceVertexIndices, holeIndices);
+}
+
+HdPrimvarDescriptorVector
+HdNukeMessageReader::ReadPrimvarDescriptors()
+{
+    HdPrimvarDescriptorVector descriptors;
+    const uint32_t count = Read<uint32_t>();
+    for (uint32_t i = 0; i < count and _valid; i++)
+    {
+        const TfToken name = ReadToken();
+        const int32_t interpolation = Read<int32_t>();
+        const TfToken role = ReadToken();
+        descriptors.emplace_back(
+            name, static_cast<HdInterpolation>(interpolation), role);
+    }
+    return descriptors;
+}
+
+
+bool
+HdNukeSendMessage(int fd, HdNukeRenderServerMessage type,
+                  const HdNukeMessageWriter& payload)
+{
+    const std::vector<char>& data = payload.GetData();
+    _MessageHeader header;
+    header.type = static_cast<uint32_t>(type);
+    header.reserved = 0;
+    header.size = data.size();
+    return _SendAll(fd, &header, sizeof(header))
+           and _SendAll(fd, data.data(), data.size());
+}
+
+bool
+HdNukeReceiveMessage(int fd, HdNukeRenderServerMessage* type,
+                     std::vector<char>* payload)
+{
+    return HdNukeReceiveMessage(fd, type, payload, 0.0, nullptr)
+           == HdNukeReceiveStatus::Received;
+}
+
+HdNukeReceiveStatus
+HdNukeReceiveMessage(int fd, HdNukeRenderServerMessage* type,
+                     std::vector<char>* payload, double timeout,
+                     const std::function<bool()>& interrupted)
+{
+    _Clock::time_point deadline;
+    if (timeout > 0) {
+        deadline = _Clock::now() + std::chrono::duration_cast<_Clock::duration>(
+            std::chrono::duration<double>(timeout));
+    }
+    const _Clock::time_point* deadlinePtr = timeout > 0 ? &deadline : nullptr;
+
+    _MessageHeader header;
+    HdNukeReceiveStatus status = _ReceiveAll(fd, &header, sizeof(header),
+                                             deadlinePtr, interrupted);
+    if (status != HdNukeReceiveStatus::Received) {
+        return status;
+    }
+    *type = static_cast<HdNukeRenderServerMessage>(header.type);
+    payload->resize(header.size);
+    // The payload follows right behind its header.
+    return _ReceiveAll(fd, payload->data(), payload->size(), deadlinePtr,
+                       nullptr);
+}
+
+
+HdNukeSharedMemory::~HdNukeSharedMemory()
+{
+    Close();
+}
+
+bool
+HdNukeSharedMemory::Create(const std::string& name, size_t size)
+{
+    Close();
+
+    const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        TF_WARN("Could not create shared memory segment %s: %s",
+                name.c_str(), std::strerror(errno));
+        return false;
+    }
+    _name = name;
+    _owner = true;
+
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        TF_WARN("Could not resize shared memory segment %s: %s",
+                name.c_str(), std::strerror(errno));
+        close(fd);
+        Close();
+        return false;
+    }
+    if (not _Map(fd, size)) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+bool
+HdNukeSharedMemory::Open(const std::string& name, size_t size)
+{
+    Close();
+
+    const int fd = shm_open(name.c_str(), O_RDWR, 0600);
+    if (fd < 0) {
+        TF_WARN("Could not open shared memory segment %s: %s",
+                name.c_str(), std::strerror(errno));
+        return false;
+    }
+    _name = name;
+    return _Map(fd, size);
+}
+
+bool
+HdNukeSharedMemory::_Map(int fd, size_t size)
+{
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // The mapping stays valid after the descriptor is closed.
+    close(fd);
+    if (data == MAP_FAILED) {
+        TF_WARN("Could not map shared memory segment %s: %s",
+                _name.c_str(), std::strerror(errno));
+        return false;
+    }
+    _data = data;
+    _size = size;
+    return true;
+}
+
+void
+HdNukeSharedMemory::Close()
+{
+    if (_data != nullptr) {
+        munmap(_data, _size);
+        _data = nullptr;
+    }
+    if (_owner and not _name.empty()) {
+        shm_unlink(_name.c_str());
+    }
+    _name.clear();
+    _size = 0;
+    _owner = false;
+}
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,222 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#ifndef HDNUKE_RENDERSERVERPROTOCOL_H
+#define HDNUKE_RENDERSERVERPROTOCOL_H
+
+#include <cstring>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <pxr/pxr.h>
+
+#include <pxr/base/tf/token.h>
+#include <pxr/base/vt/array.h>
+#include <pxr/base/vt/value.h>
+
+#include <pxr/imaging/hd/meshTopology.h>
+#include <pxr/imaging/hd/sceneDelegate.h>
+
+#include <pxr/usd/sdf/path.h>
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+// The messages exchanged between HydraRender and hdNukeRenderServer over a
+// Unix domain socket. Every request is answered by a Reply, which starts with
+// a success flag and an error message, followed by any request-specific
+// results.
+//
+// This only depends on USD, so the server doesn't have to load DDImage.
+enum class HdNukeRenderServerMessage : uint32_t
+{
+    // token pluginId
+    SetRenderer = 1,
+    // string shmName, uint64 size. The client owns the segment.
+    SetFramebuffer,
+    // uint32 count, then (token key, value) pairs.
+    SetSettings,
+    // int32 view, GfVec4d viewport, GfMatrix4d view, GfMatrix4d projection
+    SetCamera,
+    // See HdNukeRenderClient::SyncScene.
+    UpdateScene,
+    // Removes every prim.
+    ClearScene,
+    // int32 view. Replies with uint8 converged.
+    Execute,
+    // Pauses background rendering until the next Execute.
+    Pause,
+    // int32 view. Writes the view's color (RGBA) and depth buffers to the
+    // framebuffer segment as floats, and replies with int32 width, height.
+    Resolve,
+    Reply,
+    Quit
+};
+
+
+class HdNukeMessageWriter
+{
+public:
+    void WriteBytes(const void* data, size_t size);
+
+    template <typename T>
+    void Write(const T& value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "Only trivially copyable types can be written directly");
+        WriteBytes(&value, sizeof(T));
+    }
+
+    void WriteString(const std::string& value);
+    inline void WriteToken(const TfToken& value) { WriteString(value.GetString()); }
+    inline void WritePath(const SdfPath& value) { WriteString(value.GetString()); }
+
+    template <typename T>
+    void WriteArray(const VtArray<T>& value)
+    {
+        Write(static_cast<uint64_t>(value.size()));
+        WriteBytes(value.cdata(), value.size() * sizeof(T));
+    }
+
+    // Returns false (and writes an empty value) if the value's type is not
+    // supported.
+    bool WriteValue(const VtValue& value);
+
+    void WriteTopology(const HdMeshTopology& topology);
+    void WritePrimvarDescriptors(const HdPrimvarDescriptorVector& descriptors);
+
+    inline const std::vector<char>& GetData() const { return _data; }
+    inline void Clear() { _data.clear(); }
+
+private:
+    std::vector<char> _data;
+};
+
+
+// Reads the values written by an HdNukeMessageWriter, in the same order. Once
+// a read runs past the end of the data, it and all further reads return
+// default values, and IsValid returns false.
+class HdNukeMessageReader
+{
+public:
+    HdNukeMessageReader(const std::vector<char>& data)
+        : _data(data) { }
+
+    bool ReadBytes(void* dest, size_t size);
+
+    template <typename T>
+    T Read()
+    {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "Only trivially copyable types can be read directly");
+        T value = T();
+        ReadBytes(&value, sizeof(T));
+        return value;
+    }
+
+    std::string ReadString();
+    inline TfToken ReadToken() { return TfToken(ReadString()); }
+    SdfPath ReadPath();
+
+    template <typename T>
+    VtArray<T> ReadArray()
+    {
+        const uint64_t size = Read<uint64_t>();
+        if (not _valid or size > (_data.size() - _offset) / sizeof(T)) {
+            _valid = false;
+            return VtArray<T>();
+        }
+        VtArray<T> value(size);
+        ReadBytes(value.data(), size * sizeof(T));
+        return value;
+    }
+
+    VtValue ReadValue();
+
+    HdMeshTopology ReadTopology();
+    HdPrimvarDescriptorVector ReadPrimvarDescriptors();
+
+    inline bool IsValid() const { return _valid; }
+    inline size_t GetOffset() const { return _offset; }
+    inline bool AtEnd() const { return _offset == _data.size(); }
+
+private:
+    const std::vector<char>& _data;
+    size_t _offset = 0;
+    bool _valid = true;
+};
+
+
+// Send or receive a whole message, retrying interrupted and partial transfers.
+// Both return false once the connection is closed or broken.
+bool HdNukeSendMessage(int fd, HdNukeRenderServerMessage type,
+                       const HdNukeMessageWriter& payload);
+bool HdNukeReceiveMessage(int fd, HdNukeRenderServerMessage* type,
+                          std::vector<char>* payload);
+
+enum class HdNukeReceiveStatus
+{
+    Received,
+    Closed,
+    TimedOut,
+    Interrupted
+};
+
+// Waits at most `timeout` seconds (forever if not positive) for the whole
+// message, polling `interrupted`, if given, until it starts to arrive. After
+// an interruption the message can still be received whole. After a timeout
+// the connection is out of step and has to be closed.
+HdNukeReceiveStatus HdNukeReceiveMessage(
+    int fd, HdNukeRenderServerMessage* type, std::vector<char>* payload,
+    double timeout, const std::function<bool()>& interrupted);
+
+
+// A POSIX shared memory segment, through which framebuffers are handed over
+// without going through the socket.
+class HdNukeSharedMemory
+{
+public:
+    HdNukeSharedMemory() = default;
+    ~HdNukeSharedMemory();
+
+    HdNukeSharedMemory(const HdNukeSharedMemory&) = delete;
+    HdNukeSharedMemory& operator=(const HdNukeSharedMemory&) = delete;
+
+    // Creates a new segment, which is unlinked again once this object is
+    // destroyed (or recreated).
+    bool Create(const std::string& name, size_t size);
+    // Maps a segment created by another process.
+    bool Open(const std::string& name, size_t size);
+    void Close();
+
+    inline const std::string& GetName() const { return _name; }
+    inline size_t GetSize() const { return _size; }
+    inline void* GetData() const { return _data; }
+
+private:
+    bool _Map(int fd, size_t size);
+
+    std::string _name;
+    size_t _size = 0;
+    void* _data = nullptr;
+    bool _owner = false;
+};
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // HDNUKE_RENDERSERVERPROTOCOL_H
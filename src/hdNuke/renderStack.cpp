@@ -12,6 +12,13 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 //
+#include <fstream>
+
+#include <unistd.h>
+
+#include <pxr/base/arch/defines.h>
+#include <pxr/base/tf/stringUtils.h>
+
 #include <pxr/usd/usdGeom/metrics.h>
 #include <pxr/usd/usdGeom/xform.h>
 
@@ -21,15 +28,43 @@
 PXR_NAMESPACE_OPEN_SCOPE
 
 
-HydraRenderStack::HydraRenderStack(HdRendererPlugin* pluginPtr)
-        : rendererPlugin(pluginPtr),
-          primCollection(HdTokens->geometry,
+namespace
+{
+    size_t GetResidentMemory()
+    {
+#if defined(ARCH_OS_LINUX)
+        std::ifstream statm("/proc/self/statm");
+        size_t totalPages = 0;
+        size_t residentPages = 0;
+        if (statm >> totalPages >> residentPages) {
+            return residentPages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        }
+#endif
+        return 0;
+    }
+}  // namespace
+
+
+HydraRenderStack::HydraRenderStack(HdRendererPlugin* pluginPtr,
+                                   const HdNukeSceneDataPtr& sceneData)
+        : HydraRenderStack(pluginPtr->CreateRenderDelegate(), sceneData)
+{
+    rendererPlugin = pluginPtr;
+}
+
+HydraRenderStack::HydraRenderStack(HdRenderDelegate* renderDelegate,
+                                   const HdNukeSceneDataPtr& sceneData)
+        : primCollection(HdTokens->geometry,
                          HdReprSelector(HdReprTokens->refined))
 {
-    HdRenderDelegate* renderDelegate = rendererPlugin->CreateRenderDelegate();
     renderIndex = HdRenderIndex::New(renderDelegate);
 
-    nukeDelegate = new HdNukeSceneDelegate(renderIndex);
+    if (sceneData) {
+        nukeDelegate = new HdNukeSceneDelegate(renderIndex, sceneData);
+    }
+    else {
+        nukeDelegate = new HdNukeSceneDelegate(renderIndex);
+    }
 
     static SdfPath taskControllerId("/HdNuke_TaskController");
     taskController = new HdxTaskController(renderIndex, taskControllerId);
@@ -39,6 +74,13 @@ HydraRenderStack::HydraRenderStack(HdRendererPlugin* pluginPtr)
 
 HydraRenderStack::~HydraRenderStack()
 {
+    for (const auto& entry : _viewTaskControllers)
+    {
+        if (entry.second != taskController) {
+            delete entry.second;
+        }
+    }
+
     if (taskController != nullptr) {
         delete taskController;
     }
@@ -60,6 +102,36 @@ HydraRenderStack::~HydraRenderStack()
 
         HdRendererPluginRegistry::GetInstance().ReleasePlugin(rendererPlugin);
     }
+    else {
+        delete renderDelegate;
+    }
+}
+
+HdxTaskController*
+HydraRenderStack::GetTaskController(int view, bool* created)
+{
+    if (created != nullptr) {
+        *created = false;
+    }
+
+    auto it = _viewTaskControllers.find(view);
+    if (it != _viewTaskControllers.end()) {
+        return it->second;
+    }
+
+    HdxTaskController* controller = taskController;
+    if (not _viewTaskControllers.empty()) {
+        SdfPath controllerId(TfStringPrintf("/HdNuke_TaskController_view%d",
+                                            view));
+        controller = new HdxTaskController(renderIndex, controllerId);
+        controller->SetCollection(primCollection);
+    }
+
+    _viewTaskControllers.emplace(view, controller);
+    if (created != nullptr) {
+        *created = true;
+    }
+    return controller;
 }
 
 std::vector<HdRenderBuffer*>
@@ -70,22 +142,67 @@ HydraRenderStack::GetRenderBuffers() const
         return buffers;
     }
 
-    auto bprimIds = renderIndex->GetBprimSubtree(
-        HdPrimTypeTokens->renderBuffer, taskController->GetControllerId());
-    buffers.reserve(bprimIds.size());
+    std::vector<const HdxTaskController*> controllers(1, taskController);
+    for (const auto& entry : _viewTaskControllers)
+    {
+        if (entry.second != taskController) {
+            controllers.push_back(entry.second);
+        }
+    }
 
-    for (const auto& bprimId : bprimIds)
+    for (const HdxTaskController* controller : controllers)
     {
-        buffers.push_back(
-            static_cast<HdRenderBuffer*>(renderIndex->GetBprim(
-                HdPrimTypeTokens->renderBuffer, bprimId)));
+        auto bprimIds = renderIndex->GetBprimSubtree(
+            HdPrimTypeTokens->renderBuffer, controller->GetControllerId());
+        buffers.reserve(buffers.size() + bprimIds.size());
+
+        for (const auto& bprimId : bprimIds)
+        {
+            buffers.push_back(
+                static_cast<HdRenderBuffer*>(renderIndex->GetBprim(
+                    HdPrimTypeTokens->renderBuffer, bprimId)));
+        }
     }
     return buffers;
 }
 
+void
+HydraRenderStack::PauseRendering()
+{
+    if (IsRenderingPaused()) {
+        return;
+    }
+
+    HdRenderDelegate* renderDelegate = GetRenderDelegate();
+    if (renderDelegate->IsPauseSupported()) {
+        _paused = renderDelegate->Pause();
+    }
+#if PXR_VERSION >= 2011
+    else if (renderDelegate->IsStopSupported()) {
+        _stopped = renderDelegate->Stop();
+    }
+#endif
+}
+
+void
+HydraRenderStack::ResumeRendering()
+{
+    HdRenderDelegate* renderDelegate = GetRenderDelegate();
+    if (_paused) {
+        renderDelegate->Resume();
+        _paused = false;
+    }
+#if PXR_VERSION >= 2011
+    if (_stopped) {
+        renderDelegate->Restart();
+        _stopped = false;
+    }
+#endif
+}
+
 /* static */
 HydraRenderStack*
-HydraRenderStack::Create(TfToken pluginId)
+HydraRenderStack::Create(TfToken pluginId, const HdNukeSceneDataPtr& sceneData)
 {
     auto& pluginRegistry = HdRendererPluginRegistry::GetInstance();
     if (not pluginRegistry.IsRegisteredPlugin(pluginId)) {
@@ -98,7 +215,103 @@ HydraRenderStack::Create(TfToken pluginId)
         return nullptr;
     }
 
-    return new HydraRenderStack(plugin);
+    return new HydraRenderStack(plugin, sceneData);
+}
+
+
+HydraRenderStack*
+HydraRenderStackCache::Acquire(const TfToken& pluginId, bool* created)
+{
+    if (created != nullptr) {
+        *created = false;
+    }
+
+    for (auto it = _entries.begin(); it != _entries.end(); it++)
+    {
+        if (it->first == pluginId) {
+            if (it != _entries.begin()) {
+                _entries.splice(_entries.begin(), _entries, it);
+            }
+            return _entries.front().second.get();
+        }
+    }
+
+    // Make room before creating the new stack, so we don't hold more stacks
+    // than requested at peak.
+    _Evict(_capacity - 1);
+
+    HydraRenderStack* stack = HydraRenderStack::Create(pluginId, _sceneData);
+    if (stack == nullptr) {
+        return nullptr;
+    }
+
+    _entries.emplace_front(pluginId, std::unique_ptr<HydraRenderStack>(stack));
+    if (created != nullptr) {
+        *created = true;
+    }
+    Trim();
+    return stack;
+}
+
+HydraRenderStack*
+HydraRenderStackCache::GetActive() const
+{
+    return _entries.empty() ? nullptr : _entries.front().second.get();
+}
+
+void
+HydraRenderStackCache::SetCapacity(size_t capacity)
+{
+    _capacity = std::max(capacity, size_t(1));
+}
+
+void
+HydraRenderStackCache::SetMemoryLimit(size_t bytes)
+{
+    if (bytes != _memoryLimit) {
+        _memoryLimit = bytes;
+        _residentAfterEvict = 0;
+    }
+}
+
+void
+HydraRenderStackCache::Trim()
+{
+    _Evict(_capacity);
+
+    if (_memoryLimit == 0 or _entries.size() < 2) {
+        return;
+    }
+
+    // Freed memory is rarely returned to the system, so the resident size
+    // usually stays put after an eviction. Only evict again once it has grown
+    // past what it was after the last one, and never more than one stack per
+    // call, so a single high reading can't release every inactive stack.
+    const size_t resident = GetResidentMemory();
+    if (resident > _memoryLimit and resident > _residentAfterEvict) {
+        _entries.pop_back();
+        _residentAfterEvict = GetResidentMemory();
+    }
+}
+
+void
+HydraRenderStackCache::ClearInactive()
+{
+    _Evict(1);
+}
+
+void
+HydraRenderStackCache::Clear()
+{
+    _entries.clear();
+}
+
+void
+HydraRenderStackCache::_Evict(size_t maxEntries)
+{
+    while (_entries.size() > maxEntries) {
+        _entries.pop_back();
+    }
 }
 
 
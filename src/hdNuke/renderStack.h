@@ -15,6 +15,10 @@
 #ifndef HDNUKE_RENDERSTACK_H
 #define HDNUKE_RENDERSTACK_H
 
+#include <list>
+#include <map>
+#include <memory>
+
 #include <pxr/pxr.h>
 
 #include <pxr/imaging/hd/renderBuffer.h>
@@ -24,6 +28,7 @@
 #include <pxr/imaging/hd/renderIndex.h>
 #include <pxr/imaging/hdx/taskController.h>
 
+#include "sceneData.h"
 #include "sceneDelegate.h"
 
 
@@ -40,7 +45,12 @@ public:
     HdNukeSceneDelegate* nukeDelegate = nullptr;
     HdRprimCollection primCollection;
 
-    HydraRenderStack(HdRendererPlugin* pluginPtr);
+    HydraRenderStack(HdRendererPlugin* pluginPtr,
+                     const HdNukeSceneDataPtr& sceneData);
+    // Takes ownership of a render delegate that was not created by a plugin,
+    // e.g. in tests.
+    HydraRenderStack(HdRenderDelegate* renderDelegate,
+                     const HdNukeSceneDataPtr& sceneData);
 
     ~HydraRenderStack();
 
@@ -48,9 +58,84 @@ public:
         return renderIndex->GetRenderDelegate();
     }
 
+    // Returns the task controller rendering the given Nuke view, creating it
+    // if needed. Each view has its own camera and render buffers, while the
+    // render index (and thus the synced scene) is shared by all of them. The
+    // first view requested uses `taskController`.
+    HdxTaskController* GetTaskController(int view, bool* created = nullptr);
+
+    // Returns the render buffers of all views.
     std::vector<HdRenderBuffer*> GetRenderBuffers() const;
 
-    static HydraRenderStack* Create(TfToken pluginId);
+    // Interrupts the delegate's (background) rendering, using Pause if it is
+    // supported, so accumulated samples survive, or Stop otherwise.
+    void PauseRendering();
+    // Undoes PauseRendering. Must be called before the tasks are executed
+    // again.
+    void ResumeRendering();
+
+    inline bool IsRenderingPaused() const { return _paused or _stopped; }
+
+    // If no scene data is given, the stack converts the Nuke scene itself.
+    static HydraRenderStack* Create(
+        TfToken pluginId,
+        const HdNukeSceneDataPtr& sceneData = HdNukeSceneDataPtr());
+
+private:
+    std::map<int, HdxTaskController*> _viewTaskControllers;
+
+    bool _paused = false;
+    bool _stopped = false;
+};
+
+
+// Keeps a small number of recently used render stacks alive, so that switching
+// back to a previously active renderer only needs to sync the scene changes
+// made since it was last used, rather than rebuilding its render index (and
+// any acceleration structures the delegate holds) from scratch. All stacks are
+// populated from the same converted scene data, so a newly created stack never
+// has to convert the Nuke scene again either.
+//
+// The most recently acquired stack is considered active, and is never evicted.
+class HydraRenderStackCache
+{
+public:
+    HydraRenderStackCache(const HdNukeSceneDataPtr& sceneData)
+        : _sceneData(sceneData) { }
+
+    HydraRenderStack* Acquire(const TfToken& pluginId, bool* created = nullptr);
+
+    inline const HdNukeSceneDataPtr& GetSceneData() const { return _sceneData; }
+
+    HydraRenderStack* GetActive() const;
+
+    // The maximum number of stacks to keep alive, including the active one.
+    void SetCapacity(size_t capacity);
+
+    // If non-zero, Trim releases the least recently used inactive stack when
+    // the resident memory of the process exceeds this many bytes and has grown
+    // since the previous such eviction.
+    void SetMemoryLimit(size_t bytes);
+
+    inline size_t Size() const { return _entries.size(); }
+
+    void Trim();
+    void ClearInactive();
+    void Clear();
+
+private:
+    void _Evict(size_t maxEntries);
+
+    using _Entry = std::pair<TfToken, std::unique_ptr<HydraRenderStack>>;
+
+    HdNukeSceneDataPtr _sceneData;
+
+    // Ordered from most to least recently used.
+    std::list<_Entry> _entries;
+
+    size_t _capacity = 2;
+    size_t _memoryLimit = 0;
+    size_t _residentAfterEvict = 0;
 };
 
 
@@ -0,0 +1,161 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <set>
+#include <thread>
+
+#include <pxr/base/arch/defines.h>
+#include <pxr/base/tf/stringUtils.h>
+
+#include "renderWorkers.h"
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+namespace
+{
+    // Parses a core number, which must be a plain non-negative integer.
+    bool _ParseCore(const std::string& text, int* core)
+    {
+        if (text.empty() or text.size() > 6
+                or text.find_first_not_of("0123456789") != std::string::npos) {
+            return false;
+        }
+        *core = std::atoi(text.c_str());
+        return true;
+    }
+}  // namespace
+
+
+bool
+HdNukePartitionCpus(const std::string& cpus, size_t workers,
+                    std::vector<std::string>* result, std::string* error)
+{
+    result->assign(workers, std::string());
+    const int available = static_cast<int>(std::thread::hardware_concurrency());
+
+    std::set<int> cores;
+    if (cpus.empty()) {
+#if defined(ARCH_OS_LINUX)
+        if (workers < 2) {
+            return true;
+        }
+        for (int core = 0; core < available; core++)
+        {
+            cores.insert(core);
+        }
+#else
+        return true;
+#endif
+    }
+    else {
+        for (const auto& range : TfStringSplit(cpus, ","))
+        {
+            const std::string trimmed = TfStringTrim(range);
+            const std::vector<std::string> bounds = TfStringSplit(trimmed, "-");
+            int first = 0;
+            int last = 0;
+            if (bounds.empty() or bounds.size() > 2
+                    or not _ParseCore(bounds.front(), &first)
+                    or not _ParseCore(bounds.back(), &last)) {
+                *error = TfStringPrintf("Invalid core range \"%s\" in \"%s\"",
+                                        trimmed.c_str(), cpus.c_str());
+                return false;
+            }
+            if (first > last) {
+                *error = TfStringPrintf("Core range \"%s\" starts after it ends",
+                                        trimmed.c_str());
+                return false;
+            }
+            if (available > 0) {
+                last = std::min(last, available - 1);
+            }
+            for (int core = first; core <= last; core++)
+            {
+                cores.insert(core);
+            }
+        }
+    }
+
+    if (cores.empty()) {
+        *error = TfStringPrintf("None of the cores \"%s\" exist on this "
+                                "machine, which has %d", cpus.c_str(), available);
+        return false;
+    }
+    if (cores.size() < workers) {
+        *error = TfStringPrintf("%zu workers need at least as many cores, but "
+                                "only %zu are available", workers, cores.size());
+        return false;
+    }
+
+    const std::vector<int> sortedCores(cores.begin(), cores.end());
+    for (size_t worker = 0; worker < workers; worker++)
+    {
+        const size_t begin = sortedCores.size() * worker / workers;
+        const size_t end = sortedCores.size() * (worker + 1) / workers;
+        std::vector<std::string> ids;
+        for (size_t i = begin; i < end; i++)
+        {
+            ids.push_back(TfStringify(sortedCores[i]));
+        }
+        (*result)[worker] = TfStringJoin(ids, ",");
+    }
+    return true;
+}
+
+std::vector<HdNukeTile>
+HdNukeSplitIntoTiles(int width, int height, int count)
+{
+    count = std::max(count, 1);
+    const int columns = std::max(1, std::min(width, static_cast<int>(std::lround(
+        std::sqrt(count * static_cast<double>(width) / height)))));
+    const int rows = std::max(1, std::min(height, (count + columns - 1) / columns));
+
+    std::vector<HdNukeTile> tiles;
+    tiles.reserve(static_cast<size_t>(rows * columns));
+    for (int row = 0; row < rows; row++)
+    {
+        for (int column = 0; column < columns; column++)
+        {
+            tiles.push_back({width * column / columns, height * row / rows,
+                             width * (column + 1) / columns,
+                             height * (row + 1) / rows});
+        }
+    }
+    return tiles;
+}
+
+GfMatrix4d
+HdNukeTileProjection(const GfMatrix4d& projection, const HdNukeTile& tile,
+                     int width, int height)
+{
+    const double left = -1.0 + 2.0 * tile.x0 / width;
+    const double right = -1.0 + 2.0 * tile.x1 / width;
+    const double bottom = -1.0 + 2.0 * tile.y0 / height;
+    const double top = -1.0 + 2.0 * tile.y1 / height;
+
+    GfMatrix4d window(1);
+    window[0][0] = 2.0 / (right - left);
+    window[1][1] = 2.0 / (top - bottom);
+    window[3][0] = -(right + left) / (right - left);
+    window[3][1] = -(top + bottom) / (top - bottom);
+    return projection * window;
+}
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
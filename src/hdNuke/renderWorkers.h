@@ -0,0 +1,53 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#ifndef HDNUKE_RENDERWORKERS_H
+#define HDNUKE_RENDERWORKERS_H
+
+#include <string>
+#include <vector>
+
+#include <pxr/pxr.h>
+
+#include <pxr/base/gf/matrix4d.h>
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+// Splits a list of cores (e.g. "0-7,16") into one list per worker. Without a
+// list, the machine's cores are split up on Linux, and left alone elsewhere.
+// Cores the machine doesn't have are ignored. Returns false if the list is
+// malformed, or has fewer cores than there are workers.
+bool HdNukePartitionCpus(const std::string& cpus, size_t workers,
+                         std::vector<std::string>* result, std::string* error);
+
+
+// A part of the image rendered by one worker, in pixels, excluding x1 and y1.
+struct HdNukeTile
+{
+    int x0, y0, x1, y1;
+};
+
+// Splits an image into roughly square tiles, which cover it without overlap.
+std::vector<HdNukeTile> HdNukeSplitIntoTiles(int width, int height, int count);
+
+// Narrows a projection to the part of the image covered by a tile.
+GfMatrix4d HdNukeTileProjection(const GfMatrix4d& projection,
+                                const HdNukeTile& tile, int width, int height);
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // HDNUKE_RENDERWORKERS_H
@@ -0,0 +1,690 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <unordered_set>
+
+#include <pxr/imaging/hd/tokens.h>
+
+#include "sceneData.h"
+#include "utils.h"
+
+
+using namespace DD::Image;
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+void
+HdNukeDirtyHistory::Record(uint64_t version, HdDirtyBits bits)
+{
+    if (_count > 0) {
+        // Fold repeated changes within one version into a single entry.
+        auto& last = _entries[(_first + _count - 1) % Capacity];
+        if (last.first == version) {
+            last.second |= bits;
+            return;
+        }
+    }
+
+    if (_count == Capacity) {
+        _droppedVersion = _entries[_first].first;
+        _first = (_first + 1) % Capacity;
+        _count--;
+    }
+    _entries[(_first + _count) % Capacity] = std::make_pair(version, bits);
+    _count++;
+}
+
+HdDirtyBits
+HdNukeDirtyHistory::Since(uint64_t version) const
+{
+    if (_droppedVersion > version) {
+        return HdChangeTracker::AllDirty;
+    }
+
+    HdDirtyBits bits = HdChangeTracker::Clean;
+    for (size_t i = 0; i < _count; i++)
+    {
+        const auto& entry = _entries[(_first + i) % Capacity];
+        if (entry.first > version) {
+            bits |= entry.second;
+        }
+    }
+    return bits;
+}
+
+
+void
+HdNukeStagedScene::Build(GeoOp* geoOp, const HdNukeSceneData& sceneData)
+{
+    hash = HdNukeSceneData::ComputeSceneHash(geoOp);
+    geoOp->build_scene(scene);
+
+    sharedState = sceneData.GetSharedState();
+    conversionVersion = sceneData.GetConversionVersion();
+
+    // Group the GeoInfos the same way the update does, so each prim is
+    // found by its first GeoInfo, and read the ops while on this thread.
+    std::unordered_map<GeoOp*, std::unordered_map<Hash, GeoInfoVector>> geoSourceMap;
+    GeometryList* geoList = scene.object_list();
+    for (size_t i = 0; i < geoList->size(); i++)
+    {
+        GeoInfo& geoInfo = geoList->object(i);
+        GeoOp* sourceOp = op_cast<GeoOp*>(geoInfo.source_geo->firstOp());
+        geoSourceMap[sourceOp][geoInfo.src_id()].push_back(&geoInfo);
+    }
+
+    prims.clear();
+    for (const auto& geoSourceMapEntry : geoSourceMap)
+    {
+        const uint64_t attributesHash =
+            geoSourceMapEntry.first->hash(Group_Attributes).value();
+        for (const auto& geoInfoIdEntry : geoSourceMapEntry.second)
+        {
+            const GeoInfoVector& geoInfos = geoInfoIdEntry.second;
+            if (sceneData.GetRprimType(*geoInfos[0]).IsEmpty()) {
+                continue;
+            }
+
+            HdNukeStagedPrim& prim = prims[geoInfos[0]];
+            prim.instanced = geoInfos.size() > 1;
+            prim.attributesHash = attributesHash;
+        }
+    }
+}
+
+void
+HdNukeStagedScene::Convert()
+{
+    for (auto& entry : prims)
+    {
+        HdNukeStagedPrim& prim = entry.second;
+        prim.adapter = std::make_shared<HdNukeGeoAdapter>(&sharedState);
+        prim.adapter->Update(*entry.first, HdChangeTracker::AllDirty,
+                             prim.instanced, prim.attributesHash);
+    }
+}
+
+
+HdNukeSceneData::HdNukeSceneData()
+    : _config(HdNukeDelegateConfig::DefaultDelegateID)
+{
+}
+
+HdNukeSceneData::HdNukeSceneData(const SdfPath& delegateId)
+    : _config(delegateId)
+{
+}
+
+bool
+HdNukeSceneData::Update(GeoOp* geoOp)
+{
+    TF_VERIFY(geoOp);
+
+    if (not geoOp->valid()) {
+        TF_CODING_ERROR("HdNukeSceneData::Update called with unvalidated GeoOp");
+        return false;
+    }
+
+    Hash sceneHash = ComputeSceneHash(geoOp);
+    if (sceneHash == _sceneHash) {
+        return false;
+    }
+    _sceneHash = sceneHash;
+
+    _version++;
+
+    geoOp->build_scene(_scene);
+
+    UpdateGeometry(_scene.object_list());
+    UpdateLights(_scene.lights);
+    return true;
+}
+
+bool
+HdNukeSceneData::Update(HdNukeStagedScene& staged)
+{
+    if (staged.hash == _sceneHash) {
+        return false;
+    }
+    _sceneHash = staged.hash;
+
+    _version++;
+
+    const bool adopt = staged.conversionVersion == _conversionVersion;
+    UpdateGeometry(staged.scene.object_list(), adopt ? &staged : nullptr);
+    UpdateLights(staged.scene.lights);
+    if (adopt) {
+        // Later conversions share the buffers and layouts of the adopted
+        // prims too.
+        _sharedState.arrayPool.Merge(staged.sharedState.arrayPool);
+        _sharedState.primvarLayouts.Merge(staged.sharedState.primvarLayouts);
+    }
+    return true;
+}
+
+void
+HdNukeSceneData::SetDefaultDisplayColor(const GfVec3f& color)
+{
+    if (color == _sharedState.defaultDisplayColor.UncheckedGet<GfVec3f>()) {
+        return;
+    }
+
+    _sharedState.defaultDisplayColor = VtValue(color);
+    if (not _rprims.empty()) {
+        _version++;
+        for (auto& entry : _rprims)
+        {
+            entry.second.history.Record(_version, HdChangeTracker::DirtyPrimvar);
+        }
+    }
+}
+
+void
+HdNukeSceneData::SetLazyPrimvars(bool lazy)
+{
+    if (lazy == _sharedState.lazyPrimvars) {
+        return;
+    }
+
+    _sharedState.lazyPrimvars = lazy;
+    _InvalidateConversion();
+}
+
+void
+HdNukeSceneData::SetPrimvarFilter(const std::string& allow,
+                                  const std::string& deny)
+{
+    if (_sharedState.primvarFilter.SetPatterns(allow, deny)) {
+        _InvalidateConversion();
+    }
+}
+
+void
+HdNukeSceneData::SetPrimvarPrecision(HdNukePrimvarPrecision precision,
+                                     const std::string& patterns)
+{
+    const bool patternsChanged =
+        _sharedState.reducedPrecisionPrimvars.SetPatterns(patterns, "");
+    if (precision != _sharedState.primvarPrecision or patternsChanged) {
+        _sharedState.primvarPrecision = precision;
+        _InvalidateConversion();
+    }
+}
+
+void
+HdNukeSceneData::GetPrimvarMemoryUsage(size_t& bytes, size_t& fullBytes) const
+{
+    bytes = 0;
+    fullBytes = 0;
+    std::unordered_set<const VtValue*> counted;
+    for (const auto& entry : _rprims)
+    {
+        entry.second.adapter->GetPrimvarMemoryUsage(bytes, fullBytes, counted);
+    }
+}
+
+void
+HdNukeSceneData::Clear()
+{
+    if (_rprims.empty() and _instancerAdapters.empty() and _lights.empty()
+            and _sceneHash == Hash()) {
+        return;
+    }
+
+    ClearGeo();
+    ClearLights();
+    _sceneHash = Hash();
+    _version++;
+}
+
+HdNukeGeoAdapterPtr
+HdNukeSceneData::GetGeoAdapter(const SdfPath& id) const
+{
+    auto it = _rprims.find(id);
+    return it == _rprims.end() ? nullptr : it->second.adapter;
+}
+
+HdNukeInstancerAdapterPtr
+HdNukeSceneData::GetInstancerAdapter(const SdfPath& id) const
+{
+    auto it = _instancerAdapters.find(id);
+    return it == _instancerAdapters.end() ? nullptr : it->second;
+}
+
+HdNukeLightAdapterPtr
+HdNukeSceneData::GetLightAdapter(const SdfPath& id) const
+{
+    auto it = _lights.find(id);
+    return it == _lights.end() ? nullptr : it->second.adapter;
+}
+
+TfToken
+HdNukeSceneData::GetRprimType(const GeoInfo& geoInfo) const
+{
+    const Primitive* firstPrim = geoInfo.primitive(0);
+    if (firstPrim) {
+        switch (firstPrim->getPrimitiveType()) {
+            case eTriangle:
+            case ePolygon:
+            case eMesh:
+            case ePolyMesh:
+                return HdPrimTypeTokens->mesh;
+            case eParticlesSprite:
+                return HdPrimTypeTokens->points;
+            // XXX: I have yet to encounter these, and I don't want to assume
+            // they will be just like eParticlesSprite, so I'm just leaving some
+            // canary warnings...
+            case ePoint:
+                TF_WARN("HdNukeSceneData : Unhandled GeoInfo primitive "
+                        "type : ePoint");
+                break;
+            case eParticles:
+                TF_WARN("HdNukeSceneData : Unhandled GeoInfo primitive "
+                        "type : eParticles");
+                break;
+            default:
+                break;
+        }
+    }
+    return TfToken();
+}
+
+SdfPath
+HdNukeSceneData::GetRprimSubPath(const GeoInfo& geoInfo,
+                                 const TfToken& primType) const
+{
+    if (primType.IsEmpty()) {
+        return SdfPath();
+    }
+
+    // Look for an object-level "name" attribute on the geo, and if one is
+    // found, use that as the prim's sub-path.
+    const auto* nameCtx = geoInfo.get_group_attribcontext(Group_Object, "name");
+    if (nameCtx and not nameCtx->empty()
+            and (nameCtx->type == STRING_ATTRIB
+                 or nameCtx->type == STD_STRING_ATTRIB))
+    {
+        void* rawData = nameCtx->attribute->array();
+        std::string attrValue;
+        if (nameCtx->type == STD_STRING_ATTRIB) {
+            attrValue = static_cast<std::string*>(rawData)[0];
+        }
+        else {
+            attrValue = std::string(static_cast<char**>(rawData)[0]);
+        }
+
+        SdfPath result(attrValue);
+        if (result.IsAbsolutePath()) {
+            return result.MakeRelativePath(SdfPath::AbsoluteRootPath());
+        }
+        return result;
+    }
+
+    // Otherwise, use a combination of the RPrim type name and the GeoInfo's
+    // source hash to produce a (relatively) stable prim ID.
+    std::ostringstream buf;
+    buf << primType << '_' << std::hex << geoInfo.src_id().value();
+    return SdfPath(buf.str());
+}
+
+/* static */
+SdfPath
+HdNukeSceneData::GetInstancerId(const SdfPath& primId)
+{
+    return primId.AppendChild(HdInstancerTokens->instancer);
+}
+
+/* static */
+Hash
+HdNukeSceneData::ComputeSceneHash(GeoOp* geoOp)
+{
+    Hash sceneHash;
+    sceneHash.append(geoOp->hash());
+    for (uint32_t i = 0; i < Group_Last; i++)
+    {
+        sceneHash.append(geoOp->hash(i));
+    }
+    return sceneHash;
+}
+
+void
+HdNukeSceneData::UpdateGeometry(GeometryList* geoList,
+                                const HdNukeStagedScene* staged)
+{
+    if (geoList->size() == 0) {
+        ClearGeo();
+        return;
+    }
+
+    std::unordered_map<GeoOp*, SdfPath> opSubtreeMap;
+    std::unordered_map<GeoOp*, std::unordered_map<Hash, GeoInfoVector>> geoSourceMap;
+
+    const SdfPath& geoRoot = GetConfig().GeoRoot();
+    for (size_t i = 0; i < geoList->size(); i++)
+    {
+        GeoInfo& geoInfo = geoList->object(i);
+        GeoOp* sourceOp = op_cast<GeoOp*>(geoInfo.source_geo->firstOp());
+
+        if (opSubtreeMap.find(sourceOp) == opSubtreeMap.end()) {
+            opSubtreeMap.emplace(sourceOp,
+                                 geoRoot.AppendPath(GetPathFromOp(sourceOp)));
+        }
+
+        geoSourceMap[sourceOp][geoInfo.src_id()].push_back(&geoInfo);
+    }
+
+    // Remove prims whose source GeoOps are not part of the new scene.
+    for (auto it = _opSubtrees.begin(); it != _opSubtrees.end(); )
+    {
+        if (opSubtreeMap.find(it->first) == opSubtreeMap.end()) {
+            for (const auto& primId : _opPrimIds[it->first])
+            {
+                _RemoveRprim(primId);
+            }
+            _opPrimIds.erase(it->first);
+            _opStateHashes.erase(it->first);
+            it = _opSubtrees.erase(it);
+        }
+        else {
+            it++;
+        }
+    }
+
+    for (const auto& geoSourceMapEntry : geoSourceMap)
+    {
+        GeoOp* sourceOp = geoSourceMapEntry.first;
+        const SdfPath& subtree = opSubtreeMap[sourceOp];
+
+        HdDirtyBits opDirtyBits = HdChangeTracker::AllDirty;
+
+        auto opHashIter = _opStateHashes.find(sourceOp);
+        if (opHashIter == _opStateHashes.end()) {
+            GeoOpHashArray opHashes;
+            UpdateHashArray(sourceOp, opHashes);
+            _opSubtrees.emplace(sourceOp, subtree);
+            _opStateHashes.emplace(sourceOp, std::move(opHashes));
+        }
+        else {
+            // Compute update mask
+            // TODO: Double-check that this works
+            uint32_t updateMask = UpdateHashArray(sourceOp, opHashIter->second);
+            opDirtyBits = DirtyBitsFromUpdateMask(updateMask);
+        }
+
+        SdfPathVector& opPrimIds = _opPrimIds[sourceOp];
+        std::unordered_set<SdfPath, SdfPath::Hash> existingPrimIds;
+
+        for (const auto& geoInfoIdEntry : geoSourceMapEntry.second)
+        {
+            const GeoInfoVector& geoInfos = geoInfoIdEntry.second;
+            const GeoInfo& firstGeo = *geoInfos[0];
+
+            TfToken primType = GetRprimType(firstGeo);
+            if (primType.IsEmpty()) {
+                continue;
+            }
+
+            SdfPath subPath = GetRprimSubPath(firstGeo, primType);
+            if (subPath.IsEmpty()) {
+                continue;
+            }
+
+            SdfPath primId = subtree.AppendPath(subPath);
+            if (primId.IsEmpty()) {
+                continue;
+            }
+
+            SdfPath instancerId = GetInstancerId(primId);
+            HdNukeInstancerAdapterPtr instAdapter = GetInstancerAdapter(instancerId);
+
+            // If more than one GeoInfo exists with the same source hash, make
+            // sure an instancer exists for the prim.
+            bool createdNewInstancer = false;
+            if (geoInfos.size() > 1) {
+                if (not instAdapter) {
+                    instAdapter = std::make_shared<HdNukeInstancerAdapter>(
+                        &_sharedState);
+                    _instancerAdapters.emplace(instancerId, instAdapter);
+                    createdNewInstancer = true;
+                }
+            }
+
+            // XXX: If there's an existing instancer but only 1 instance, we
+            // leave the instancer in place, just to simplify the bookkeeping.
+
+            bool instancerChanged = false;
+            if (instAdapter) {
+                instancerChanged = instAdapter->Update(geoInfos);
+            }
+
+            auto rprimIt = _rprims.find(primId);
+            HdDirtyBits geoDirtyBits = opDirtyBits;
+            if (rprimIt == _rprims.end()) {
+                HdNukeRprimEntry entry;
+                entry.primType = primType;
+                entry.adapter = std::make_shared<HdNukeGeoAdapter>(&_sharedState);
+                rprimIt = _rprims.emplace(primId, std::move(entry)).first;
+                geoDirtyBits = HdChangeTracker::AllDirty;
+            }
+            else if (createdNewInstancer or rprimIt->second.primType != primType) {
+                // Render indices have to re-insert the Rprim to establish a
+                // relationship to the new instancer (HdRprim keeps track of
+                // its own instancer ID, and there is no way to update it in
+                // place), so it needs a full conversion as well.
+                rprimIt->second.primType = primType;
+                geoDirtyBits = HdChangeTracker::AllDirty;
+            }
+
+            HdNukeRprimEntry& rprim = rprimIt->second;
+            if (instAdapter) {
+                rprim.instancerId = instancerId;
+            }
+
+            const bool instanced = static_cast<bool>(instAdapter);
+            const HdNukeStagedPrim* stagedPrim = nullptr;
+            if (staged and geoDirtyBits != HdChangeTracker::Clean) {
+                auto stagedIt = staged->prims.find(&firstGeo);
+                if (stagedIt != staged->prims.end()
+                        and stagedIt->second.adapter
+                        and stagedIt->second.instanced == instanced) {
+                    stagedPrim = &stagedIt->second;
+                }
+            }
+
+            if (stagedPrim) {
+                // Converted in full while the previous frame rendered.
+                stagedPrim->adapter->SetSharedState(&_sharedState);
+                rprim.adapter = stagedPrim->adapter;
+            }
+            else {
+                // The attributes are unchanged while the source op's
+                // attributes hash is, which is what marks the primvars dirty
+                // in the first place.
+                rprim.adapter->Update(firstGeo, geoDirtyBits, instanced,
+                                      sourceOp->hash(Group_Attributes).value());
+            }
+
+            if (instancerChanged and not createdNewInstancer) {
+                geoDirtyBits |= HdChangeTracker::DirtyInstancer;
+            }
+            if (geoDirtyBits != HdChangeTracker::Clean) {
+                rprim.history.Record(_version, geoDirtyBits);
+            }
+
+            existingPrimIds.insert(primId);
+        }
+
+        for (const auto& primId : opPrimIds)
+        {
+            if (existingPrimIds.find(primId) == existingPrimIds.end()) {
+                _RemoveRprim(primId);
+            }
+        }
+        opPrimIds.assign(existingPrimIds.begin(), existingPrimIds.end());
+    }
+}
+
+void
+HdNukeSceneData::UpdateLights(const std::vector<LightContext*>& lights)
+{
+    SdfPathMap<LightOp*> sceneLights;
+
+    const SdfPath& lightParent = GetConfig().NukeLightRoot();
+    for (const LightContext* lightCtx : lights)
+    {
+        LightOp* lightOp = dynamic_cast<LightOp*>(lightCtx->light()->firstOp());
+        if (lightOp) {
+            sceneLights.emplace(lightParent.AppendPath(GetPathFromOp(lightOp)),
+                                lightOp);
+        }
+    }
+
+    // Remove lights not in the new scene.
+    for (auto it = _lights.begin(); it != _lights.end(); )
+    {
+        if (sceneLights.find(it->first) == sceneLights.end()) {
+            it = _lights.erase(it);
+        }
+        else {
+            it++;
+        }
+    }
+
+    for (const auto& lightInfo : sceneLights) {
+        const SdfPath& lightId = lightInfo.first;
+        LightOp* lightOp = lightInfo.second;
+
+        TfToken lightType;
+        switch (lightOp->lightType()) {
+            case LightOp::eDirectionalLight:
+                lightType = HdPrimTypeTokens->distantLight;
+                break;
+            case LightOp::eSpotLight:
+                lightType = HdPrimTypeTokens->diskLight;
+                break;
+            case LightOp::ePointLight:
+                lightType = HdPrimTypeTokens->sphereLight;
+                break;
+            case LightOp::eOtherLight:
+                // XXX: The only other current type is an environment light, but
+                // the node is missing a lot of necessary options...
+                lightType = HdPrimTypeTokens->domeLight;
+                break;
+            default:
+                continue;
+        }
+
+        auto it = _lights.find(lightId);
+        if (it != _lights.end()) {
+            HdNukeLightEntry& entry = it->second;
+            if (entry.lightType == lightType and entry.adapter->GetLightOp() == lightOp) {
+                if (entry.adapter->DirtyHash()) {
+                    entry.history.Record(_version,
+                                         HdNukeLightAdapter::DefaultDirtyBits);
+                    entry.adapter->Update();
+                }
+                continue;
+            }
+
+            // Light ID is the same, but op type has changed, so blow it away.
+            _lights.erase(it);
+        }
+
+        HdNukeLightEntry entry;
+        entry.lightType = lightType;
+        entry.adapter = std::make_shared<HdNukeLightAdapter>(
+            &_sharedState, lightOp, lightType);
+        entry.history.Record(_version, HdChangeTracker::AllDirty);
+        _lights.emplace(lightId, std::move(entry));
+    }
+}
+
+void
+HdNukeSceneData::ClearGeo()
+{
+    _rprims.clear();
+    _instancerAdapters.clear();
+    _opSubtrees.clear();
+    _opStateHashes.clear();
+    _opPrimIds.clear();
+}
+
+void
+HdNukeSceneData::ClearLights()
+{
+    _lights.clear();
+}
+
+void
+HdNukeSceneData::_RemoveRprim(const SdfPath& primId)
+{
+    _rprims.erase(primId);
+    _instancerAdapters.erase(GetInstancerId(primId));
+}
+
+void
+HdNukeSceneData::_InvalidateConversion()
+{
+    _sceneHash = Hash();
+    _opStateHashes.clear();
+    _conversionVersion++;
+}
+
+/* static */
+uint32_t
+HdNukeSceneData::UpdateHashArray(const GeoOp* op, GeoOpHashArray& hashes)
+{
+    uint32_t updateMask = 0;  // XXX: The mask enum in GeoInfo.h is untyped...
+    for (uint32_t i = 0; i < Group_Last; i++)
+    {
+        const Hash groupHash(op->hash(i));
+        if (groupHash != hashes[i]) {
+            updateMask |= 1 << i;
+        }
+        hashes[i] = groupHash;
+    }
+    return updateMask;
+}
+
+/* static */
+HdDirtyBits
+HdNukeSceneData::DirtyBitsFromUpdateMask(uint32_t updateMask)
+{
+    HdDirtyBits dirtyBits = HdChangeTracker::Clean;
+    if (updateMask & Mask_Object) {
+        // Mask_Object gets set for render mode changes as well
+        dirtyBits |= HdChangeTracker::DirtyVisibility;
+    }
+
+    if (updateMask & (Mask_Primitives | Mask_Vertices)) {
+        dirtyBits |= HdChangeTracker::DirtyTopology;
+    }
+    if (updateMask & Mask_Points) {
+        dirtyBits |= (HdChangeTracker::DirtyPoints
+                     | HdChangeTracker::DirtyExtent);
+    }
+    if (updateMask & Mask_Matrix) {
+        dirtyBits |= HdChangeTracker::DirtyTransform;
+    }
+    if (updateMask & Mask_Attributes) {
+        dirtyBits |= (HdChangeTracker::DirtyPrimvar
+                      | HdChangeTracker::DirtyNormals
+                      | HdChangeTracker::DirtyWidths);
+    }
+    return dirtyBits;
+}
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,245 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#ifndef HDNUKE_SCENEDATA_H
+#define HDNUKE_SCENEDATA_H
+
+#include <array>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <pxr/pxr.h>
+
+#include <pxr/imaging/hd/changeTracker.h>
+
+#include <DDImage/GeoOp.h>
+#include <DDImage/Scene.h>
+
+#include "delegateConfig.h"
+#include "geoAdapter.h"
+#include "instancerAdapter.h"
+#include "lightAdapter.h"
+#include "sharedState.h"
+#include "types.h"
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+// Remembers the dirty bits recorded for a prim over its last few changes, so
+// any number of render indices populated from the same converted scene can
+// each work out what changed since they last synced.
+class HdNukeDirtyHistory
+{
+public:
+    void Record(uint64_t version, HdDirtyBits bits);
+
+    // Returns the union of the bits recorded after `version`, or AllDirty if
+    // the history no longer reaches back that far.
+    HdDirtyBits Since(uint64_t version) const;
+
+private:
+    static const size_t Capacity = 8;
+
+    std::array<std::pair<uint64_t, HdDirtyBits>, Capacity> _entries;
+    size_t _first = 0;
+    size_t _count = 0;
+    // The latest version whose entry has been pushed out of the history.
+    uint64_t _droppedVersion = 0;
+};
+
+
+struct HdNukeRprimEntry
+{
+    TfToken primType;
+    // Empty if the prim is not instanced.
+    SdfPath instancerId;
+    HdNukeGeoAdapterPtr adapter;
+    HdNukeDirtyHistory history;
+};
+
+
+struct HdNukeLightEntry
+{
+    TfToken lightType;
+    HdNukeLightAdapterPtr adapter;
+    HdNukeDirtyHistory history;
+};
+
+
+class HdNukeSceneData;
+
+
+// A prim of a staged scene, converted ahead of the update that adopts it.
+struct HdNukeStagedPrim
+{
+    bool instanced = false;
+    uint64_t attributesHash = 0;
+    HdNukeGeoAdapterPtr adapter;
+};
+
+
+// A Nuke scene built ahead of its conversion, e.g. while the previous frame
+// renders. Build reads the ops, so it must run on a Nuke thread. Convert only
+// reads the geometry Build copied into the scene, so it may run on a worker
+// thread.
+struct HdNukeStagedScene
+{
+    DD::Image::Hash hash;
+    DD::Image::Scene scene;
+
+    // A copy of the scene data's shared state the prims are converted
+    // against, and the conversion settings version it was taken at.
+    AdapterSharedState sharedState;
+    uint64_t conversionVersion = 0;
+
+    // By the first GeoInfo of each prim.
+    std::unordered_map<const DD::Image::GeoInfo*, HdNukeStagedPrim> prims;
+
+    // Builds the scene of the given (validated) op, to be converted with the
+    // settings the scene data has now.
+    void Build(DD::Image::GeoOp* geoOp, const HdNukeSceneData& sceneData);
+
+    // Converts the geometry of the built scene. The lights are converted by
+    // the update, as they read their ops.
+    void Convert();
+};
+
+
+// The Nuke scene, converted into Hydra terms. None of this depends on the
+// render delegate, so one instance can be shared by any number of
+// HdNukeSceneDelegates (and thus render indices), which populate themselves
+// from it without re-running build_scene or any of the conversion.
+//
+// Every Update that changes anything bumps the scene version, and changes are
+// recorded against it, so delegates only need to remember the version they
+// last synced.
+class HdNukeSceneData
+{
+public:
+    HdNukeSceneData();
+    HdNukeSceneData(const SdfPath& delegateId);
+
+    inline const HdNukeDelegateConfig& GetConfig() const { return _config; }
+
+    inline uint64_t GetVersion() const { return _version; }
+
+    inline const AdapterSharedState& GetSharedState() const {
+        return _sharedState;
+    }
+
+    // Bumped whenever the settings that conversion depends on change.
+    inline uint64_t GetConversionVersion() const {
+        return _conversionVersion;
+    }
+
+    // Builds and converts the scene of the given op. Returns false without
+    // doing any work if the op's hashes have not changed since the last update.
+    bool Update(DD::Image::GeoOp* geoOp);
+    // Converts a scene that has already been built, adopting the prims it
+    // converted if the conversion settings haven't changed since. The staged
+    // scene must be kept alive until the next update.
+    bool Update(HdNukeStagedScene& staged);
+
+    void SetDefaultDisplayColor(const GfVec3f& color);
+
+    // Switches between converting all primvars up front and converting each
+    // one on its first query. Changing the mode reconverts the scene on the
+    // next Update.
+    void SetLazyPrimvars(bool lazy);
+
+    // Sets the glob patterns of the attributes converted to primvars (see
+    // HdNukePrimvarFilter). Changing them reconverts the scene on the next
+    // Update.
+    void SetPrimvarFilter(const std::string& allow, const std::string& deny);
+
+    // Stores large float arrays of the primvars matching the glob patterns
+    // at the given precision. Changing either reconverts the scene on the
+    // next Update.
+    void SetPrimvarPrecision(HdNukePrimvarPrecision precision,
+                             const std::string& patterns);
+
+    // The bytes held by the converted points and primvars of all Rprims, and
+    // the bytes they would take at full precision. Arrays shared between
+    // Rprims are counted once.
+    void GetPrimvarMemoryUsage(size_t& bytes, size_t& fullBytes) const;
+
+    void Clear();
+
+    inline const SdfPathMap<HdNukeRprimEntry>& GetRprims() const {
+        return _rprims;
+    }
+    inline const SdfPathMap<HdNukeInstancerAdapterPtr>& GetInstancers() const {
+        return _instancerAdapters;
+    }
+    inline const SdfPathMap<HdNukeLightEntry>& GetLights() const {
+        return _lights;
+    }
+
+    HdNukeGeoAdapterPtr GetGeoAdapter(const SdfPath& id) const;
+    HdNukeInstancerAdapterPtr GetInstancerAdapter(const SdfPath& id) const;
+    HdNukeLightAdapterPtr GetLightAdapter(const SdfPath& id) const;
+
+    TfToken GetRprimType(const DD::Image::GeoInfo& geoInfo) const;
+    SdfPath GetRprimSubPath(const DD::Image::GeoInfo& geoInfo,
+                            const TfToken& primType) const;
+
+    static SdfPath GetInstancerId(const SdfPath& primId);
+
+    // Returns the hash used to decide whether the scene of the given op
+    // needs to be rebuilt.
+    static DD::Image::Hash ComputeSceneHash(DD::Image::GeoOp* geoOp);
+
+    static uint32_t UpdateHashArray(const DD::Image::GeoOp* op,
+                                    GeoOpHashArray& hashes);
+    static HdDirtyBits DirtyBitsFromUpdateMask(uint32_t updateMask);
+
+protected:
+    void UpdateGeometry(DD::Image::GeometryList* geoList,
+                        const HdNukeStagedScene* staged = nullptr);
+    void UpdateLights(const std::vector<DD::Image::LightContext*>& lights);
+
+    void ClearGeo();
+    void ClearLights();
+
+    void _RemoveRprim(const SdfPath& primId);
+    // Makes the next Update convert every prim again, as if the scene were new.
+    void _InvalidateConversion();
+
+private:
+    HdNukeDelegateConfig _config;
+
+    DD::Image::Scene _scene;
+    DD::Image::Hash _sceneHash;
+    uint64_t _version = 0;
+    uint64_t _conversionVersion = 0;
+
+    std::unordered_map<DD::Image::GeoOp*, SdfPath> _opSubtrees;
+    std::unordered_map<DD::Image::GeoOp*, GeoOpHashArray> _opStateHashes;
+    std::unordered_map<DD::Image::GeoOp*, SdfPathVector> _opPrimIds;
+
+    SdfPathMap<HdNukeRprimEntry> _rprims;
+    SdfPathMap<HdNukeInstancerAdapterPtr> _instancerAdapters;
+    SdfPathMap<HdNukeLightEntry> _lights;
+
+    AdapterSharedState _sharedState;
+};
+
+using HdNukeSceneDataPtr = std::shared_ptr<HdNukeSceneData>;
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // HDNUKE_SCENEDATA_H
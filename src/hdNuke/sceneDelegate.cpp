@@ -12,8 +12,11 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 //
+#include <algorithm>
+
 #include <pxr/base/gf/vec3f.h>
 
+#include <pxr/imaging/hd/light.h>
 #include <pxr/imaging/hd/renderIndex.h>
 
 #include "hydraOpManager.h"
@@ -29,60 +32,76 @@ using namespace DD::Image;
 PXR_NAMESPACE_OPEN_SCOPE
 
 
-namespace
-{
-    inline bool IsInstancerId(const SdfPath& primId)
-    {
-        return primId.GetName() == HdInstancerTokens->instancer;
-    }
-
-    inline SdfPath GetInstancerId(const SdfPath& primId)
-    {
-        return primId.AppendChild(HdInstancerTokens->instancer);
-    }
-}  // namespace
-
-
 HdNukeSceneDelegate::HdNukeSceneDelegate(HdRenderIndex* renderIndex)
-    : HdSceneDelegate(renderIndex, HdNukeDelegateConfig::DefaultDelegateID)
-    , _config(HdNukeDelegateConfig::DefaultDelegateID)
+    : HdNukeSceneDelegate(renderIndex, std::make_shared<HdNukeSceneData>())
 {
-    _defaultMaterialId = GetConfig().MaterialRoot().AppendChild(
-           HdNukePathTokens->defaultSurface);
 }
 
 HdNukeSceneDelegate::HdNukeSceneDelegate(HdRenderIndex* renderIndex,
                                          const SdfPath& delegateId)
-    : HdSceneDelegate(renderIndex, delegateId)
-    , _config(delegateId)
+    : HdNukeSceneDelegate(renderIndex,
+                          std::make_shared<HdNukeSceneData>(delegateId))
+{
+}
+
+HdNukeSceneDelegate::HdNukeSceneDelegate(HdRenderIndex* renderIndex,
+                                         const HdNukeSceneDataPtr& sceneData)
+    : HdSceneDelegate(renderIndex, sceneData->GetConfig().DelegateId())
+    , _sceneData(sceneData)
 {
     _defaultMaterialId = GetConfig().MaterialRoot().AppendChild(
            HdNukePathTokens->defaultSurface);
 }
 
+const HdNukeSceneDelegate::_PrimHandle*
+HdNukeSceneDelegate::_FindPrim(const SdfPath& id) const
+{
+    auto it = _prims.find(id);
+    return it == _prims.end() ? nullptr : &it->second;
+}
+
+template <typename Adapter>
+Adapter*
+HdNukeSceneDelegate::_FindAdapter(const SdfPath& id,
+                                  _PrimHandle::Kind kind) const
+{
+    auto it = _prims.find(id);
+    if (it == _prims.end() or it->second.kind != kind) {
+        return nullptr;
+    }
+    return static_cast<Adapter*>(it->second.adapter.get());
+}
+
 HdMeshTopology
 HdNukeSceneDelegate::GetMeshTopology(const SdfPath& id)
 {
-    return GetGeoAdapter(id)->GetMeshTopology();
+    auto geoAdapter = _FindAdapter<HdNukeGeoAdapter>(id, _PrimHandle::Geo);
+    return geoAdapter ? geoAdapter->GetMeshTopology() : HdMeshTopology();
 }
 
 GfRange3d
 HdNukeSceneDelegate::GetExtent(const SdfPath& id)
 {
-    return GetGeoAdapter(id)->GetExtent();
+    auto geoAdapter = _FindAdapter<HdNukeGeoAdapter>(id, _PrimHandle::Geo);
+    return geoAdapter ? geoAdapter->GetExtent() : GfRange3d();
 }
 
 GfMatrix4d
 HdNukeSceneDelegate::GetTransform(const SdfPath& id)
 {
-    if (id.HasPrefix(GetConfig().GeoRoot())) {
-        return GetGeoAdapter(id)->GetTransform();
-    }
-    else if (id.HasPrefix(GetConfig().HydraLightRoot())) {
-        return GetHydraLightOp(id)->GetTransform();
-    }
-    else if (id.HasPrefix(GetConfig().NukeLightRoot())) {
-        return GetLightAdapter(id)->GetTransform();
+    if (const _PrimHandle* prim = _FindPrim(id)) {
+        switch (prim->kind) {
+            case _PrimHandle::Geo:
+                return static_cast<HdNukeGeoAdapter*>(
+                    prim->adapter.get())->GetTransform();
+            case _PrimHandle::NukeLight:
+                return static_cast<HdNukeLightAdapter*>(
+                    prim->adapter.get())->GetTransform();
+            case _PrimHandle::HydraLight:
+                return prim->hydraLightOp->GetTransform();
+            default:
+                break;
+        }
     }
 
     TF_WARN("HdNukeSceneDelegate::GetTransform : Unrecognized prim id: %s",
@@ -93,7 +112,7 @@ HdNukeSceneDelegate::GetTransform(const SdfPath& id)
 bool
 HdNukeSceneDelegate::GetVisible(const SdfPath& id)
 {
-    if (HdNukeGeoAdapterPtr geoAdapter = GetGeoAdapter(id)) {
+    if (auto geoAdapter = _FindAdapter<HdNukeGeoAdapter>(id, _PrimHandle::Geo)) {
         return geoAdapter->GetVisible();
     }
     return true;
@@ -106,11 +125,19 @@ HdNukeSceneDelegate::Get(const SdfPath& id, const TfToken& key)
         return VtValue(GetTransform(id));
     }
 
-    if (IsInstancerId(id)) {
-        return GetInstancerAdapter(id)->Get(key);
-    }
-    else if (id.HasPrefix(GetConfig().GeoRoot())) {
-        return GetGeoAdapter(id)->Get(key);
+    if (const _PrimHandle* prim = _FindPrim(id)) {
+        if (prim->kind == _PrimHandle::Geo) {
+            if (key == HdTokens->displayColor
+                    and not _displayColorOverride.IsEmpty()) {
+                return _displayColorOverride;
+            }
+            return static_cast<HdNukeGeoAdapter*>(
+                prim->adapter.get())->Get(key);
+        }
+        else if (prim->kind == _PrimHandle::Instancer) {
+            return static_cast<HdNukeInstancerAdapter*>(
+                prim->adapter.get())->Get(key);
+        }
     }
     TF_WARN("HdNukeSceneDelegate::Get : Unrecognized prim id: %s (key: %s)",
             id.GetText(), key.GetText());
@@ -121,7 +148,11 @@ VtIntArray
 HdNukeSceneDelegate::GetInstanceIndices(const SdfPath& instancerId,
                                         const SdfPath& prototypeId)
 {
-    auto adapter = GetInstancerAdapter(instancerId);
+    auto adapter = _FindAdapter<HdNukeInstancerAdapter>(
+        instancerId, _PrimHandle::Instancer);
+    if (not adapter) {
+        return VtIntArray();
+    }
     VtIntArray result(adapter->InstanceCount());
     std::iota(result.begin(), result.end(), 0);
     return result;
@@ -148,21 +179,47 @@ HdNukeSceneDelegate::GetPrimvarDescriptors(const SdfPath& id,
         primvars.emplace_back(HdInstancerTokens->instanceTransform, interpolation);
         return primvars;
     }
-    else if (id.HasPrefix(GetConfig().GeoRoot())) {
-        return GetGeoAdapter(id)->GetPrimvarDescriptors(interpolation);
+    else if (auto geoAdapter =
+                _FindAdapter<HdNukeGeoAdapter>(id, _PrimHandle::Geo)) {
+        return geoAdapter->GetPrimvarDescriptors(interpolation);
     }
     return HdPrimvarDescriptorVector();
 }
 
+void
+HdNukeSceneDelegate::PostSyncCleanup()
+{
+    for (const auto& primEntry : _prims)
+    {
+        if (primEntry.second.kind == _PrimHandle::Geo) {
+            static_cast<HdNukeGeoAdapter*>(
+                primEntry.second.adapter.get())->ReleaseWidenedPrimvars();
+        }
+    }
+}
+
 VtValue
 HdNukeSceneDelegate::GetLightParamValue(const SdfPath& id,
                                         const TfToken& paramName)
 {
-    if (id.HasPrefix(GetConfig().HydraLightRoot())) {
-        return GetHydraLightOp(id)->GetLightParamValue(paramName);
+    if (not _lightParamOverrides.empty()) {
+        auto lightIt = _lightParamOverrides.find(id);
+        if (lightIt != _lightParamOverrides.end()) {
+            auto paramIt = lightIt->second.find(paramName);
+            if (paramIt != lightIt->second.end()) {
+                return paramIt->second;
+            }
+        }
     }
-    else if (id.HasPrefix(GetConfig().NukeLightRoot())) {
-        return GetLightAdapter(id)->GetLightParamValue(paramName);
+
+    if (const _PrimHandle* prim = _FindPrim(id)) {
+        if (prim->kind == _PrimHandle::HydraLight) {
+            return prim->hydraLightOp->GetLightParamValue(paramName);
+        }
+        else if (prim->kind == _PrimHandle::NukeLight) {
+            return static_cast<HdNukeLightAdapter*>(
+                prim->adapter.get())->GetLightParamValue(paramName);
+        }
     }
     return VtValue();
 }
@@ -170,374 +227,295 @@ HdNukeSceneDelegate::GetLightParamValue(const SdfPath& id,
 HdNukeGeoAdapterPtr
 HdNukeSceneDelegate::GetGeoAdapter(const SdfPath& id) const
 {
-    auto it = _geoAdapters.find(id);
-    return it == _geoAdapters.end() ? nullptr : it->second;
+    const _PrimHandle* prim = _FindPrim(id);
+    if (prim and prim->kind == _PrimHandle::Geo) {
+        return std::static_pointer_cast<HdNukeGeoAdapter>(prim->adapter);
+    }
+    return _sceneData->GetGeoAdapter(id);
 }
 
 HdNukeInstancerAdapterPtr
 HdNukeSceneDelegate::GetInstancerAdapter(const SdfPath& id) const
 {
-    auto it = _instancerAdapters.find(id);
-    return it == _instancerAdapters.end() ? nullptr : it->second;
+    const _PrimHandle* prim = _FindPrim(id);
+    if (prim and prim->kind == _PrimHandle::Instancer) {
+        return std::static_pointer_cast<HdNukeInstancerAdapter>(prim->adapter);
+    }
+    return _sceneData->GetInstancerAdapter(id);
 }
 
 HdNukeLightAdapterPtr
 HdNukeSceneDelegate::GetLightAdapter(const SdfPath& id) const
 {
-    auto it = _lightAdapters.find(id);
-    return it == _lightAdapters.end() ? nullptr : it->second;
+    const _PrimHandle* prim = _FindPrim(id);
+    if (prim and prim->kind == _PrimHandle::NukeLight) {
+        return std::static_pointer_cast<HdNukeLightAdapter>(prim->adapter);
+    }
+    return _sceneData->GetLightAdapter(id);
 }
 
 HydraLightOp*
 HdNukeSceneDelegate::GetHydraLightOp(const SdfPath& id) const
 {
-    auto it = _hydraLightOps.find(id);
-    return it == _hydraLightOps.end() ? nullptr : it->second;
-}
-
-TfToken
-HdNukeSceneDelegate::GetRprimType(const GeoInfo& geoInfo) const
-{
-    const Primitive* firstPrim = geoInfo.primitive(0);
-    if (firstPrim) {
-        switch (firstPrim->getPrimitiveType()) {
-            case eTriangle:
-            case ePolygon:
-            case eMesh:
-            case ePolyMesh:
-                return HdPrimTypeTokens->mesh;
-            case eParticlesSprite:
-                return HdPrimTypeTokens->points;
-            // XXX: I have yet to encounter these, and I don't want to assume
-            // they will be just like eParticlesSprite, so I'm just leaving some
-            // canary warnings...
-            case ePoint:
-                TF_WARN("HdNukeSceneDelegate : Unhandled GeoInfo primitive "
-                        "type : ePoint");
-                break;
-            case eParticles:
-                TF_WARN("HdNukeSceneDelegate : Unhandled GeoInfo primitive "
-                        "type : eParticles");
-                break;
-            default:
-                break;
-        }
+    const _PrimHandle* prim = _FindPrim(id);
+    if (prim and prim->kind == _PrimHandle::HydraLight) {
+        return prim->hydraLightOp;
     }
-    return TfToken();
+    return nullptr;
+}
+
+void
+HdNukeSceneDelegate::_RegisterHydraLight(const SdfPath& id, HydraLightOp* op)
+{
+    _PrimHandle& prim = _prims[id];
+    if (prim.kind == _PrimHandle::HydraLight and prim.hydraLightOp == op) {
+        return;
+    }
+    prim.kind = _PrimHandle::HydraLight;
+    prim.adapter.reset();
+    prim.hydraLightOp = op;
+}
+
+void
+HdNukeSceneDelegate::SetDefaultDisplayColor(GfVec3f color)
+{
+    _sceneData->SetDefaultDisplayColor(color);
 }
 
 SdfPath
-HdNukeSceneDelegate::GetRprimSubPath(const GeoInfo& geoInfo,
-                                     const TfToken& primType) const
+HdNukeSceneDelegate::FindLightId(const std::string& name) const
 {
-    if (primType.IsEmpty()) {
+    if (name.empty()) {
         return SdfPath();
     }
 
-    // Look for an object-level "name" attribute on the geo, and if one is
-    // found, use that as the prim's sub-path.
-    const auto* nameCtx = geoInfo.get_group_attribcontext(Group_Object, "name");
-    if (nameCtx and not nameCtx->empty()
-            and (nameCtx->type == STRING_ATTRIB
-                 or nameCtx->type == STD_STRING_ATTRIB))
-    {
-        void* rawData = nameCtx->attribute->array();
-        std::string attrValue;
-        if (nameCtx->type == STD_STRING_ATTRIB) {
-            attrValue = static_cast<std::string*>(rawData)[0];
-        }
-        else {
-            attrValue = std::string(static_cast<char**>(rawData)[0]);
-        }
-
-        SdfPath result(attrValue);
-        if (result.IsAbsolutePath()) {
-            return result.MakeRelativePath(SdfPath::AbsoluteRootPath());
-        }
-        return result;
+    SdfPath nukeLightId;
+    SdfPath hydraLightId;
+    if (name[0] == '/') {
+        nukeLightId = hydraLightId = SdfPath(name);
+    }
+    else {
+        std::string tail(name);
+        std::replace(tail.begin(), tail.end(), '.', '/');
+        nukeLightId = GetConfig().NukeLightRoot().AppendPath(SdfPath(tail));
+        hydraLightId = GetConfig().HydraLightRoot().AppendPath(SdfPath(tail));
     }
 
-    // Otherwise, use a combination of the RPrim type name and the GeoInfo's
-    // source hash to produce a (relatively) stable prim ID.
-    std::ostringstream buf;
-    buf << primType << '_' << std::hex << geoInfo.src_id().value();
-    return SdfPath(buf.str());
+    const _PrimHandle* prim = _FindPrim(nukeLightId);
+    if (prim and prim->kind == _PrimHandle::NukeLight) {
+        return nukeLightId;
+    }
+    prim = _FindPrim(hydraLightId);
+    if (prim and prim->kind == _PrimHandle::HydraLight) {
+        return hydraLightId;
+    }
+    return SdfPath();
 }
 
 void
-HdNukeSceneDelegate::SetDefaultDisplayColor(GfVec3f color)
+HdNukeSceneDelegate::SetLightParamOverride(const SdfPath& id,
+                                           const TfToken& paramName,
+                                           const VtValue& value)
 {
-    if (color == sharedState.defaultDisplayColor) {
+    VtValue& overrideValue = _lightParamOverrides[id][paramName];
+    if (overrideValue == value) {
         return;
     }
+    overrideValue = value;
 
-    sharedState.defaultDisplayColor = color;
-    if (not _geoAdapters.empty()) {
-        HdChangeTracker& tracker = GetRenderIndex().GetChangeTracker();
-        for (auto it = _geoAdapters.cbegin(); it != _geoAdapters.cend(); it++) {
-            tracker.MarkPrimvarDirty(it->first, HdTokens->displayColor);
-        }
+    const _PrimHandle* prim = _FindPrim(id);
+    if (prim and (prim->kind == _PrimHandle::NukeLight
+                  or prim->kind == _PrimHandle::HydraLight)) {
+        GetRenderIndex().GetChangeTracker().MarkSprimDirty(
+            id, HdLight::DirtyParams);
     }
 }
 
 void
-HdNukeSceneDelegate::SyncNukeGeometry(GeometryList* geoList)
+HdNukeSceneDelegate::SetDisplayColorOverride(const GfVec3f& color)
 {
-    if (geoList->size() == 0) {
-        ClearNukeGeo();
+    if (_displayColorOverride.IsHolding<GfVec3f>()
+            and _displayColorOverride.UncheckedGet<GfVec3f>() == color) {
         return;
     }
+    _displayColorOverride = VtValue(color);
+    _MarkDisplayColorDirty();
+}
 
-    std::unordered_map<GeoOp*, SdfPath> opSubtreeMap;
-    std::unordered_map<GeoOp*, std::unordered_map<Hash, GeoInfoVector>> geoSourceMap;
+void
+HdNukeSceneDelegate::ClearDisplayColorOverride()
+{
+    if (_displayColorOverride.IsEmpty()) {
+        return;
+    }
+    _displayColorOverride = VtValue();
+    _MarkDisplayColorDirty();
+}
 
-    const SdfPath& geoRoot = GetConfig().GeoRoot();
-    for (size_t i = 0; i < geoList->size(); i++)
+void
+HdNukeSceneDelegate::_MarkDisplayColorDirty()
+{
+    HdChangeTracker& changeTracker = GetRenderIndex().GetChangeTracker();
+    for (const auto& primEntry : _prims)
     {
-        GeoInfo& geoInfo = geoList->object(i);
-        GeoOp* sourceOp = op_cast<GeoOp*>(geoInfo.source_geo->firstOp());
-
-        if (opSubtreeMap.find(sourceOp) == opSubtreeMap.end()) {
-            opSubtreeMap.emplace(sourceOp,
-                                 geoRoot.AppendPath(GetPathFromOp(sourceOp)));
+        if (primEntry.second.kind == _PrimHandle::Geo) {
+            changeTracker.MarkPrimvarDirty(primEntry.first,
+                                           HdTokens->displayColor);
         }
+    }
+}
 
-        geoSourceMap[sourceOp][geoInfo.src_id()].push_back(&geoInfo);
+void
+HdNukeSceneDelegate::ClearLightParamOverrides()
+{
+    HdChangeTracker& changeTracker = GetRenderIndex().GetChangeTracker();
+    for (const auto& lightEntry : _lightParamOverrides)
+    {
+        const _PrimHandle* prim = _FindPrim(lightEntry.first);
+        if (prim and (prim->kind == _PrimHandle::NukeLight
+                      or prim->kind == _PrimHandle::HydraLight)) {
+            changeTracker.MarkSprimDirty(lightEntry.first, HdLight::DirtyParams);
+        }
     }
+    _lightParamOverrides.clear();
+}
 
+void
+HdNukeSceneDelegate::SyncNukeGeometry()
+{
     HdRenderIndex& renderIndex = GetRenderIndex();
+    HdChangeTracker& changeTracker = renderIndex.GetChangeTracker();
+
+    const auto& rprims = _sceneData->GetRprims();
+    const auto& instancers = _sceneData->GetInstancers();
 
-    // Remove Rprim subtrees whose source GeoOps are not part of the new scene.
-    for (auto it = _opSubtrees.begin(); it != _opSubtrees.end(); )
+    // Remove Rprims that are no longer part of the scene, as well as those
+    // whose type or instancer has changed, since HdRprim can't update either
+    // in place.
+    for (auto it = _indexedRprims.begin(); it != _indexedRprims.end(); )
     {
-        if (opSubtreeMap.find(it->first) == opSubtreeMap.end()) {
-            _RemoveSubtree(it->second);
-            _opStateHashes.erase(it->first);
-            it = _opSubtrees.erase(it);
+        const auto rprimIt = rprims.find(it->first);
+        if (rprimIt == rprims.end()
+                or rprimIt->second.primType != it->second.primType
+                or rprimIt->second.instancerId != it->second.instancerId) {
+            renderIndex.RemoveRprim(it->first);
+            _prims.erase(it->first);
+            it = _indexedRprims.erase(it);
         }
         else {
             it++;
         }
     }
 
-    HdChangeTracker& changeTracker = renderIndex.GetChangeTracker();
-
-    for (const auto& geoSourceMapEntry : geoSourceMap)
+    for (auto it = _indexedInstancers.begin(); it != _indexedInstancers.end(); )
     {
-        GeoOp* sourceOp = geoSourceMapEntry.first;
-        const SdfPath& subtree = opSubtreeMap[sourceOp];
-
-        HdDirtyBits opDirtyBits = HdChangeTracker::AllDirty;
-        bool newOp = false;
-
-        auto opHashIter = _opStateHashes.find(sourceOp);
-        if (opHashIter == _opStateHashes.end()) {
-            GeoOpHashArray opHashes;
-            UpdateHashArray(sourceOp, opHashes);
-            _opSubtrees.emplace(sourceOp, subtree);
-            _opStateHashes.emplace(sourceOp, std::move(opHashes));
-            newOp = true;
+        if (instancers.find(*it) == instancers.end()) {
+            renderIndex.RemoveInstancer(*it);
+            _prims.erase(*it);
+            it = _indexedInstancers.erase(it);
         }
         else {
-            // Compute update mask
-            // TODO: Double-check that this works
-            uint32_t updateMask = UpdateHashArray(sourceOp, opHashIter->second);
-            opDirtyBits = DirtyBitsFromUpdateMask(updateMask);
+            it++;
         }
+    }
 
-        std::unordered_set<SdfPath, SdfPath::Hash> existingPrimIds;
-        SdfPathVector lastOpRprimSubtree = renderIndex.GetRprimSubtree(subtree);
-
-        for (const auto& geoInfoIdEntry : geoSourceMapEntry.second)
-        {
-            const GeoInfoVector& geoInfos = geoInfoIdEntry.second;
-            const GeoInfo& firstGeo = *geoInfos[0];
-
-            TfToken primType = GetRprimType(firstGeo);
-            if (primType.IsEmpty()
-                    or not renderIndex.IsRprimTypeSupported(primType)) {
-                continue;
-            }
-
-            SdfPath subPath = GetRprimSubPath(firstGeo, primType);
-            if (subPath.IsEmpty()) {
-                continue;
-            }
-
-            SdfPath primId = subtree.AppendPath(subPath);
-            if (primId.IsEmpty()) {
-                continue;
-            }
-
-            SdfPath instancerId = GetInstancerId(primId);
-            HdNukeInstancerAdapterPtr instAdapter = GetInstancerAdapter(instancerId);
-
-            // If more than one GeoInfo exists with the same source hash, make
-            // sure an instancer exists (or gets created) in the render index.
-            bool createdNewInstancer = false;
-            if (geoInfos.size() > 1) {
-                if (not instAdapter) {
-                    instAdapter = std::make_shared<HdNukeInstancerAdapter>(
-                        &sharedState);
-                    _instancerAdapters.emplace(instancerId, instAdapter);
-                    renderIndex.InsertInstancer(this, instancerId);
-                    createdNewInstancer = true;
-                }
-
-            }
-
-            // XXX: If there's an existing instancer but only 1 instance, we
-            // leave the instancer in place, just to simplify the bookkeeping.
-
-            if (instAdapter) {
-                instAdapter->Update(geoInfos);
-            }
-
-            HdNukeGeoAdapterPtr geoAdapter = GetGeoAdapter(primId);
-            bool needNewPrim = false;
-
-            if (createdNewInstancer and geoAdapter != nullptr) {
-                // An Rprim already existed for this GeoInfo, but the number of
-                // GeoInfo's with the same source hash is now > 1, and we've
-                // added a new instancer as a result. Thus, we need to remove
-                // and then re-insert the Rprim to establish a relationship to
-                // the instancer.
-                // It would be nice if we could just inform the change tracker
-                // of this new relationship and move on, but HdRprim also keeps
-                // track of its own instancer ID (which is passed to its
-                // constructor), and there is no way to update it in place.
-                renderIndex.RemoveRprim(primId);
-                needNewPrim = true;
-            }
-            else if (geoAdapter == nullptr) {
-                geoAdapter = std::make_shared<HdNukeGeoAdapter>(&sharedState);
-                _geoAdapters.emplace(primId, geoAdapter);
+    for (const auto& rprimEntry : rprims)
+    {
+        const SdfPath& primId = rprimEntry.first;
+        const HdNukeRprimEntry& rprim = rprimEntry.second;
 
-                needNewPrim = true;
-            }
+        if (not renderIndex.IsRprimTypeSupported(rprim.primType)) {
+            continue;
+        }
 
-            HdDirtyBits geoDirtyBits;
+        const SdfPath& instancerId = rprim.instancerId;
+        if (not instancerId.IsEmpty()
+                and _indexedInstancers.insert(instancerId).second) {
+            renderIndex.InsertInstancer(this, instancerId);
+        }
+        _RegisterAdapter(primId, _PrimHandle::Geo, rprim.adapter);
 
-            if (needNewPrim) {
-                if (instAdapter) {
-                    renderIndex.InsertRprim(primType, this, primId, instancerId);
-                }
-                else {
-                    renderIndex.InsertRprim(primType, this, primId);
-                }
-                geoDirtyBits = HdChangeTracker::AllDirty;
+        if (_indexedRprims.find(primId) == _indexedRprims.end()) {
+            if (instancerId.IsEmpty()) {
+                renderIndex.InsertRprim(rprim.primType, this, primId);
             }
             else {
-                geoDirtyBits = opDirtyBits;
-                if (geoDirtyBits != HdChangeTracker::Clean) {
-                    changeTracker.MarkRprimDirty(primId, geoDirtyBits);
-                }
+                renderIndex.InsertRprim(rprim.primType, this, primId,
+                                        instancerId);
             }
+            _indexedRprims.emplace(primId,
+                                   _IndexedRprim{rprim.primType, instancerId});
+            continue;
+        }
 
-            geoAdapter->Update(firstGeo, geoDirtyBits,
-                               static_cast<bool>(instAdapter));
-
-            if (instAdapter and not createdNewInstancer) {
+        HdDirtyBits dirtyBits = rprim.history.Since(_syncedVersion);
+        if (dirtyBits & HdChangeTracker::DirtyInstancer) {
+            if (not instancerId.IsEmpty()) {
                 changeTracker.MarkInstancerDirty(instancerId);
             }
-
-            // Minor optimization
-            if (not newOp) {
-                existingPrimIds.insert(primId);
-            }
+            dirtyBits &= ~HdChangeTracker::DirtyInstancer;
         }
-
-        if (not newOp) {
-            for (const auto& indexPrimId : lastOpRprimSubtree)
-            {
-                if (existingPrimIds.find(indexPrimId) == existingPrimIds.end()) {
-                    _RemoveRprim(indexPrimId);
-                }
-            }
+        if (dirtyBits != HdChangeTracker::Clean) {
+            changeTracker.MarkRprimDirty(primId, dirtyBits);
         }
     }
-}
-
-void
-HdNukeSceneDelegate::SyncNukeLights(std::vector<LightContext*> lights)
-{
-    SdfPathMap<LightOp*> sceneLights;
 
-    const SdfPath& lightParent = GetConfig().NukeLightRoot();
-    for (const LightContext* lightCtx : lights)
+    for (const SdfPath& instancerId : _indexedInstancers)
     {
-        LightOp* lightOp = dynamic_cast<LightOp*>(lightCtx->light()->firstOp());
-        if (lightOp) {
-            sceneLights.emplace(lightParent.AppendPath(GetPathFromOp(lightOp)),
-                                lightOp);
+        const auto instancerIt = instancers.find(instancerId);
+        if (instancerIt != instancers.end()) {
+            _RegisterAdapter(instancerId, _PrimHandle::Instancer,
+                             instancerIt->second);
         }
     }
+}
 
+void
+HdNukeSceneDelegate::SyncNukeLights()
+{
     HdRenderIndex& renderIndex = GetRenderIndex();
     HdChangeTracker& changeTracker = renderIndex.GetChangeTracker();
 
-    // Remove lights not in the new scene.
-    for (auto it = _lightAdapters.begin(); it != _lightAdapters.end(); )
+    const auto& lights = _sceneData->GetLights();
+
+    // Remove lights not in the new scene (or whose type has changed).
+    for (auto it = _indexedLights.begin(); it != _indexedLights.end(); )
     {
-        if (sceneLights.find(it->first) == sceneLights.end()) {
-            renderIndex.RemoveSprim(it->second->GetLightType(), it->first);
-            it = _lightAdapters.erase(it);
+        const auto lightIt = lights.find(it->first);
+        if (lightIt == lights.end() or lightIt->second.lightType != it->second) {
+            renderIndex.RemoveSprim(it->second, it->first);
+            _prims.erase(it->first);
+            it = _indexedLights.erase(it);
         }
         else {
             it++;
         }
     }
 
-    for (const auto& lightInfo : sceneLights) {
-        const SdfPath& lightId = lightInfo.first;
-        LightOp* lightOp = lightInfo.second;
-
-        TfToken lightType;
-        switch (lightOp->lightType()) {
-            case LightOp::eDirectionalLight:
-                lightType = HdPrimTypeTokens->distantLight;
-                break;
-            case LightOp::eSpotLight:
-                lightType = HdPrimTypeTokens->diskLight;
-                break;
-            case LightOp::ePointLight:
-                lightType = HdPrimTypeTokens->sphereLight;
-                break;
-            case LightOp::eOtherLight:
-                // XXX: The only other current type is an environment light, but
-                // the node is missing a lot of necessary options...
-                lightType = HdPrimTypeTokens->domeLight;
-                break;
-            default:
-                continue;
+    for (const auto& lightEntry : lights)
+    {
+        const SdfPath& lightId = lightEntry.first;
+        const HdNukeLightEntry& light = lightEntry.second;
+
+        if (_indexedLights.find(lightId) != _indexedLights.end()) {
+            // The adapter is replaced if the light's node changes.
+            _RegisterAdapter(lightId, _PrimHandle::NukeLight, light.adapter);
+            HdDirtyBits dirtyBits = light.history.Since(_syncedVersion);
+            if (dirtyBits != HdChangeTracker::Clean) {
+                changeTracker.MarkSprimDirty(lightId, dirtyBits);
+            }
+            continue;
         }
 
-        if (not renderIndex.IsSprimTypeSupported(lightType)) {
+        if (not renderIndex.IsSprimTypeSupported(light.lightType)) {
             TF_WARN("Selected render delegate does not support Sprim type %s",
-                    lightType.GetText());
+                    light.lightType.GetText());
             continue;
         }
 
-        if (auto adapter = GetLightAdapter(lightId)) {
-            if (adapter->GetLightType() == lightType) {
-                if (adapter->DirtyHash()) {
-                    changeTracker.MarkSprimDirty(
-                        lightId, HdNukeLightAdapter::DefaultDirtyBits);
-                    adapter->UpdateLastHash();
-                }
-                continue;
-            }
-
-            // Light ID is the same, but op type has changed, so blow it away.
-            renderIndex.RemoveSprim(adapter->GetLightType(), lightId);
-            _lightAdapters.erase(lightId);
-        }
-
-        auto adapterPtr = std::make_shared<HdNukeLightAdapter>(
-            &sharedState, lightOp, lightType);
-        _lightAdapters.emplace(lightId, adapterPtr);
-
-        renderIndex.InsertSprim(lightType, this, lightId);
+        renderIndex.InsertSprim(light.lightType, this, lightId);
+        _indexedLights.emplace(lightId, light.lightType);
+        _RegisterAdapter(lightId, _PrimHandle::NukeLight, light.adapter);
     }
 }
 
@@ -551,18 +529,31 @@ HdNukeSceneDelegate::SyncFromGeoOp(GeoOp* geoOp)
         return;
     }
 
-    geoOp->build_scene(_scene);
-
-    SyncNukeGeometry(_scene.object_list());
-    SyncNukeLights(_scene.lights);
+    _sceneData->Update(geoOp);
+    SyncSceneData();
+}
 
+void
+HdNukeSceneDelegate::SyncSceneData()
+{
     HdRenderIndex& renderIndex = GetRenderIndex();
 
     // XXX: Temporary, until Hydra material ops are implemented
-    if (renderIndex.IsSprimTypeSupported(HdPrimTypeTokens->material)) {
+    if (not _defaultMaterialInserted
+            and renderIndex.IsSprimTypeSupported(HdPrimTypeTokens->material)) {
         renderIndex.InsertSprim(
             HdPrimTypeTokens->material, this, DefaultMaterialId());
+        _defaultMaterialInserted = true;
+    }
+
+    if (_sceneData->GetVersion() == _syncedVersion) {
+        return;
     }
+
+    SyncNukeGeometry();
+    SyncNukeLights();
+
+    _syncedVersion = _sceneData->GetVersion();
 }
 
 void
@@ -581,103 +572,21 @@ void HdNukeSceneDelegate::ClearAll()
 void
 HdNukeSceneDelegate::ClearNukePrims()
 {
-    ClearNukeGeo();
-    ClearNukeLights();
-}
-
-void
-HdNukeSceneDelegate::ClearNukeGeo()
-{
-    _geoAdapters.clear();
-    _instancerAdapters.clear();
-    _opSubtrees.clear();
-    _opStateHashes.clear();
-    GetRenderIndex().RemoveSubtree(GetConfig().GeoRoot(), this);
-}
-
-void
-HdNukeSceneDelegate::ClearNukeLights()
-{
-    _lightAdapters.clear();
-    GetRenderIndex().RemoveSubtree(GetConfig().NukeLightRoot(), this);
+    // The scene data may be shared with other delegates, which will catch up
+    // with the removal the next time they are synced.
+    _sceneData->Clear();
+    SyncSceneData();
 }
 
 void
 HdNukeSceneDelegate::ClearHydraPrims()
 {
-    _hydraLightOps.clear();
-    GetRenderIndex().RemoveSubtree(GetConfig().HydraLightRoot(), this);
-}
-
-inline void
-HdNukeSceneDelegate::_RemoveRprim(const SdfPath& primId)
-{
-    HdRenderIndex& renderIndex = GetRenderIndex();
-    renderIndex.RemoveSubtree(primId, this);
-    _geoAdapters.erase(primId);
-    _instancerAdapters.erase(GetInstancerId(primId));
-}
-
-void
-HdNukeSceneDelegate::_RemoveSubtree(const SdfPath& subtree)
-{
-    for (auto adapterIt = _geoAdapters.begin(); adapterIt != _geoAdapters.end();)
-    {
-        const SdfPath& rprimPath = adapterIt->first;
-        if (rprimPath.HasPrefix(subtree)) {
-            _instancerAdapters.erase(GetInstancerId(rprimPath));
-            adapterIt = _geoAdapters.erase(adapterIt);
-        }
-        else {
-            adapterIt++;
-        }
-    }
-
-    GetRenderIndex().RemoveSubtree(subtree, this);
-}
-
-/* static */
-uint32_t
-HdNukeSceneDelegate::UpdateHashArray(const GeoOp* op, GeoOpHashArray& hashes)
-{
-    uint32_t updateMask = 0;  // XXX: The mask enum in GeoInfo.h is untyped...
-    for (uint32_t i = 0; i < Group_Last; i++)
+    for (const auto& lightEntry : _hydraLightOps)
     {
-        const Hash groupHash(op->hash(i));
-        if (groupHash != hashes[i]) {
-            updateMask |= 1 << i;
-        }
-        hashes[i] = groupHash;
-    }
-    return updateMask;
-}
-
-/* static */
-HdDirtyBits
-HdNukeSceneDelegate::DirtyBitsFromUpdateMask(uint32_t updateMask)
-{
-    HdDirtyBits dirtyBits = HdChangeTracker::Clean;
-    if (updateMask & Mask_Object) {
-        // Mask_Object gets set for render mode changes as well
-        dirtyBits |= HdChangeTracker::DirtyVisibility;
-    }
-
-    if (updateMask & (Mask_Primitives | Mask_Vertices)) {
-        dirtyBits |= HdChangeTracker::DirtyTopology;
-    }
-    if (updateMask & Mask_Points) {
-        dirtyBits |= (HdChangeTracker::DirtyPoints
-                     | HdChangeTracker::DirtyExtent);
-    }
-    if (updateMask & Mask_Matrix) {
-        dirtyBits |= HdChangeTracker::DirtyTransform;
+        _prims.erase(lightEntry.first);
     }
-    if (updateMask & Mask_Attributes) {
-        dirtyBits |= (HdChangeTracker::DirtyPrimvar
-                      | HdChangeTracker::DirtyNormals
-                      | HdChangeTracker::DirtyWidths);
-    }
-    return dirtyBits;
+    _hydraLightOps.clear();
+    GetRenderIndex().RemoveSubtree(GetConfig().HydraLightRoot(), this);
 }
 
 
@@ -15,6 +15,10 @@
 #ifndef HDNUKE_SCENEDELEGATE_H
 #define HDNUKE_SCENEDELEGATE_H
 
+#include <map>
+#include <memory>
+#include <string>
+
 #include <pxr/pxr.h>
 
 #include <pxr/imaging/hd/sceneDelegate.h>
@@ -24,11 +28,7 @@
 #include <DDImage/GeoOp.h>
 #include <DDImage/Scene.h>
 
-#include "delegateConfig.h"
-#include "geoAdapter.h"
-#include "instancerAdapter.h"
-#include "lightAdapter.h"
-#include "sharedState.h"
+#include "sceneData.h"
 #include "types.h"
 
 
@@ -46,6 +46,10 @@ class HdNukeSceneDelegate : public HdSceneDelegate
 public:
     HdNukeSceneDelegate(HdRenderIndex* renderIndex);
     HdNukeSceneDelegate(HdRenderIndex* renderIndex, const SdfPath& delegateId);
+    // Populates the render index from converted scene data that may be shared
+    // with other delegates. The delegate ID is taken from the data's config.
+    HdNukeSceneDelegate(HdRenderIndex* renderIndex,
+                        const HdNukeSceneDataPtr& sceneData);
 
     ~HdNukeSceneDelegate() { }
 
@@ -72,11 +76,14 @@ public:
     GetPrimvarDescriptors(const SdfPath& id,
                           HdInterpolation interpolation) override;
 
-    inline const HdNukeDelegateConfig& GetConfig() const { return _config; }
+    // Releases the primvars widened from reduced precision during the sync.
+    void PostSyncCleanup() override;
+
+    inline const HdNukeDelegateConfig& GetConfig() const {
+        return _sceneData->GetConfig();
+    }
 
-    TfToken GetRprimType(const DD::Image::GeoInfo& geoInfo) const;
-    SdfPath GetRprimSubPath(const DD::Image::GeoInfo& geoInfo,
-                            const TfToken& primType) const;
+    inline const HdNukeSceneDataPtr& GetSceneData() const { return _sceneData; }
 
     inline const SdfPath& DefaultMaterialId() const { return _defaultMaterialId; }
 
@@ -86,56 +93,109 @@ public:
     HydraLightOp* GetHydraLightOp(const SdfPath& id) const;
 
     void SetDefaultDisplayColor(GfVec3f color);
-
+    // Overrides the display color of this delegate's Nuke geometry without
+    // touching the (shared) converted scene, e.g. for wedges. Only the
+    // displayColor primvar is marked dirty.
+    void SetDisplayColorOverride(const GfVec3f& color);
+    void ClearDisplayColorOverride();
+
+    // Returns the ID of a light in the render index, given its ID or the name
+    // of its node, or an empty path if there is no such light.
+    SdfPath FindLightId(const std::string& name) const;
+    // Overrides a light parameter without touching the converted scene, e.g.
+    // for wedges. Only the lights whose overrides change are marked dirty.
+    void SetLightParamOverride(const SdfPath& id, const TfToken& paramName,
+                               const VtValue& value);
+    void ClearLightParamOverrides();
+
+    // Updates the converted scene from the given op, then syncs the render
+    // index with it.
     void SyncFromGeoOp(DD::Image::GeoOp* geoOp);
+    // Brings the render index up to date with the converted scene data.
+    void SyncSceneData();
     void SyncHydraOp(HydraOp* hydraOp);
 
     void ClearNukePrims();
     void ClearHydraPrims();
     void ClearAll();
 
-    static uint32_t UpdateHashArray(const DD::Image::GeoOp* op,
-                                    GeoOpHashArray& hashes);
-    static HdDirtyBits DirtyBitsFromUpdateMask(uint32_t updateMask);
-
 protected:
-    void SyncNukeGeometry(DD::Image::GeometryList* geoList);
-    void SyncNukeLights(std::vector<DD::Image::LightContext*> lights);
-
-    void CreateOpGeo(DD::Image::GeoOp* geoOp, const SdfPath& subtree,
-                     const GeoInfoVector& geoInfos);
-    void UpdateOpGeo(DD::Image::GeoOp* geoOp, const SdfPath& subtree,
-                     const GeoInfoVector& geoInfos);
-
-    void ClearNukeGeo();
-    void ClearNukeLights();
-
-
-    inline void _RemoveRprim(const SdfPath& primId);
-    void _RemoveSubtree(const SdfPath& subtree);
+    void SyncNukeGeometry();
+    void SyncNukeLights();
+
+    // What serves the queries for a prim in the render index. Nuke adapters
+    // are held by reference so they outlive their removal from scene data
+    // shared with another delegate until this delegate syncs.
+    struct _PrimHandle
+    {
+        enum Kind : uint8_t { Geo, Instancer, NukeLight, HydraLight };
+
+        Kind kind = Geo;
+        std::shared_ptr<void> adapter;
+        HydraLightOp* hydraLightOp = nullptr;
+    };
+
+    const _PrimHandle* _FindPrim(const SdfPath& id) const;
+    // Returns the adapter of the given kind serving the prim, or null.
+    template <typename Adapter>
+    Adapter* _FindAdapter(const SdfPath& id, _PrimHandle::Kind kind) const;
+    // Registering a prim with the adapter it already has is a single lookup,
+    // so syncs can register every prim without copying its handle.
+    template <typename Adapter>
+    void _RegisterAdapter(const SdfPath& id, _PrimHandle::Kind kind,
+                          const std::shared_ptr<Adapter>& adapter);
+    void _RegisterHydraLight(const SdfPath& id, HydraLightOp* op);
 
 private:
     friend class HydraOpManager;
 
-    HdNukeDelegateConfig _config;
+    struct _IndexedRprim
+    {
+        TfToken primType;
+        SdfPath instancerId;
+    };
+
+    void _MarkDisplayColorDirty();
 
-    DD::Image::Scene _scene;
+    HdNukeSceneDataPtr _sceneData;
+    // The scene data version the render index was last synced to.
+    uint64_t _syncedVersion = 0;
 
-    std::unordered_map<DD::Image::GeoOp*, SdfPath> _opSubtrees;
-    std::unordered_map<DD::Image::GeoOp*, GeoOpHashArray> _opStateHashes;
+    // The Nuke prims currently in the render index.
+    SdfPathMap<_IndexedRprim> _indexedRprims;
+    std::unordered_set<SdfPath, SdfPath::Hash> _indexedInstancers;
+    SdfPathMap<TfToken> _indexedLights;
+    bool _defaultMaterialInserted = false;
 
-    SdfPathMap<HdNukeGeoAdapterPtr> _geoAdapters;
-    SdfPathMap<HdNukeInstancerAdapterPtr> _instancerAdapters;
-    SdfPathMap<HdNukeLightAdapterPtr> _lightAdapters;
+    // Every Nuke and Hydra op prim in the render index, so queries take a
+    // single lookup rather than matching the ID against each root.
+    SdfPathMap<_PrimHandle> _prims;
 
     SdfPathMap<HydraLightOp*> _hydraLightOps;
+    SdfPathMap<std::map<TfToken, VtValue>> _lightParamOverrides;
+    VtValue _displayColorOverride;
     SdfPathMap<std::unique_ptr<UsdImagingDelegate>> _usdDelegates;
 
-    AdapterSharedState sharedState;
     SdfPath _defaultMaterialId;
 };
 
 
+template <typename Adapter>
+void
+HdNukeSceneDelegate::_RegisterAdapter(const SdfPath& id,
+                                      _PrimHandle::Kind kind,
+                                      const std::shared_ptr<Adapter>& adapter)
+{
+    _PrimHandle& prim = _prims[id];
+    if (prim.kind == kind and prim.adapter.get() == adapter.get()) {
+        return;
+    }
+    prim.kind = kind;
+    prim.adapter = adapter;
+    prim.hydraLightOp = nullptr;
+}
+
+
 PXR_NAMESPACE_CLOSE_SCOPE
 
 #endif  // HDNUKE_SCENEDELEGATE_H
@@ -18,15 +18,40 @@
 #include <pxr/pxr.h>
 
 #include <pxr/base/gf/vec3f.h>
+#include <pxr/base/vt/value.h>
+
+#include "arrayPool.h"
+#include "packedArray.h"
+#include "primvarFilter.h"
+#include "primvarLayout.h"
 
 
 PXR_NAMESPACE_OPEN_SCOPE
 
 
-// Container for common parameters that adapters may need access to.
+// Container for common parameters that adapters may need access to. Only
+// written while the scene data is updated, never during a Hydra sync, so
+// adapters may read it from any thread.
 struct AdapterSharedState
 {
-    GfVec3f defaultDisplayColor = {0.18, 0.18, 0.18};
+    // Kept as a VtValue so queries can return it without allocating.
+    VtValue defaultDisplayColor = VtValue(GfVec3f(0.18, 0.18, 0.18));
+
+    HdNukePrimvarLayoutCache primvarLayouts;
+
+    // Shares the buffers of identical point and primvar arrays.
+    HdNukeArrayPool arrayPool;
+
+    // Attributes that fail the filter aren't converted at all.
+    HdNukePrimvarFilter primvarFilter;
+
+    // Defer primvar conversion until the render delegate asks for the value.
+    bool lazyPrimvars = false;
+
+    // Large float arrays of the primvars matching the filter are stored at
+    // this precision.
+    HdNukePrimvarPrecision primvarPrecision = HdNukePrimvarPrecision::Full;
+    HdNukePrimvarFilter reducedPrecisionPrimvars;
 };
 
 
@@ -72,10 +72,13 @@ VtValueKnobCache::OnKnobChanged(Knob* knob)
     return true;
 }
 
-VtValue&
-VtValueKnobCache::GetValue(const TfToken& key)
+const VtValue&
+VtValueKnobCache::GetValue(const TfToken& key) const
 {
-    return _valueCache[key];
+    static const VtValue emptyValue;
+
+    const auto it = _valueCache.find(key);
+    return it == _valueCache.end() ? emptyValue : it->second;
 }
 
 void
@@ -36,7 +36,9 @@ public:
 
     bool OnKnobChanged(DD::Image::Knob* knob);
 
-    VtValue& GetValue(const TfToken& key);
+    // Doesn't insert missing keys, so Hydra can query the cache from several
+    // threads during a sync.
+    const VtValue& GetValue(const TfToken& key) const;
 
     void Flush();
 
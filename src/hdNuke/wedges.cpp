@@ -0,0 +1,77 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <sstream>
+
+#include <pxr/base/tf/diagnostic.h>
+#include <pxr/base/tf/stringUtils.h>
+
+#include "wedges.h"
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+std::vector<HdNukeWedgeVariant>
+HdNukeParseWedges(const std::string& text)
+{
+    std::vector<HdNukeWedgeVariant> variants;
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        line = TfStringTrim(line);
+        if (line.empty() or line[0] == '#') {
+            continue;
+        }
+
+        HdNukeWedgeVariant variant;
+        for (const auto& overrideText : TfStringSplit(line, ";"))
+        {
+            const std::vector<std::string> words = TfStringTokenize(overrideText);
+            if (words.empty()) {
+                continue;
+            }
+            HdNukeWedgeOverride wedgeOverride;
+            if (words[0] == "light" and words.size() >= 4) {
+                wedgeOverride.kind = HdNukeWedgeOverride::Light;
+                wedgeOverride.name = words[1];
+                wedgeOverride.param = TfToken(words[2]);
+                wedgeOverride.value = TfStringJoin(words.begin() + 3,
+                                                   words.end(), " ");
+            }
+            else if (words[0] == "displayColor" and words.size() == 4) {
+                wedgeOverride.kind = HdNukeWedgeOverride::DisplayColor;
+                wedgeOverride.value = TfStringJoin(words.begin() + 1,
+                                                   words.end(), " ");
+            }
+            else if (words.size() >= 2) {
+                wedgeOverride.name = words[0];
+                wedgeOverride.value = TfStringJoin(words.begin() + 1,
+                                                   words.end(), " ");
+            }
+            else {
+                TF_WARN("HdNukeParseWedges : Invalid wedge override \"%s\"",
+                        overrideText.c_str());
+                continue;
+            }
+            variant.push_back(wedgeOverride);
+        }
+        variants.push_back(variant);
+    }
+    return variants;
+}
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,52 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#ifndef HDNUKE_WEDGES_H
+#define HDNUKE_WEDGES_H
+
+#include <string>
+#include <vector>
+
+#include <pxr/pxr.h>
+
+#include <pxr/base/tf/token.h>
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+// One override of a wedge variant, given as "<setting> <value>",
+// "light <light> <param> <value>" or "displayColor <r> <g> <b>".
+struct HdNukeWedgeOverride
+{
+    enum Kind { Setting, Light, DisplayColor };
+
+    Kind kind = Setting;
+    // The setting, or the light's node name or ID.
+    std::string name;
+    TfToken param;
+    std::string value;
+};
+
+using HdNukeWedgeVariant = std::vector<HdNukeWedgeOverride>;
+
+// Parses one variant per line, with its overrides separated by semicolons.
+// Empty lines and lines starting with '#' are skipped, as are (with a
+// warning) malformed overrides.
+std::vector<HdNukeWedgeVariant> HdNukeParseWedges(const std::string& text);
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // HDNUKE_WEDGES_H
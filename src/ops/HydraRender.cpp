@@ -12,16 +12,33 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 //
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
 #include <GL/glew.h>
 
 #include <pxr/pxr.h>
 
 #include <pxr/base/gf/camera.h>
 #include <pxr/base/gf/frustum.h>
+#include <pxr/base/gf/matrix4d.h>
 #include <pxr/base/gf/vec3f.h>
+#include <pxr/base/gf/vec4d.h>
+#include <pxr/base/tf/stringUtils.h>
 
 #include <pxr/imaging/hd/engine.h>
 
+#include <DDImage/Application.h>
 #include <DDImage/CameraOp.h>
 #include <DDImage/Enumeration_KnobI.h>
 #include <DDImage/PlanarIop.h>
@@ -31,10 +48,19 @@
 #include <DDImage/Row.h>
 #include <DDImage/Scene.h>
 
+#include <hdNuke/convergenceEstimator.h>
+#include <hdNuke/idleTimer.h>
 #include <hdNuke/knobFactory.h>
 #include <hdNuke/opBases.h>
+#include <hdNuke/renderCache.h>
+#include <hdNuke/renderCheckpoints.h>
+#include <hdNuke/renderClient.h>
+#include <hdNuke/renderLoop.h>
+#include <hdNuke/renderProductWriter.h>
 #include <hdNuke/renderStack.h>
+#include <hdNuke/renderWorkers.h>
 #include <hdNuke/utils.h>
+#include <hdNuke/wedges.h>
 
 
 using namespace DD::Image;
@@ -50,7 +76,7 @@ class HydraRender : public PlanarIop, public HdNukeKnobFactory
 {
 public:
     HydraRender(Node* node);
-    ~HydraRender() override { }
+    ~HydraRender() override { _idleTimer.Stop(); }
 
     const char* input_label(int index, char*) const override;
     Op* default_input(int index) const override;
@@ -70,6 +96,8 @@ public:
 
     void renderStripe(ImagePlane& plane) override;
 
+    bool updateUI(const OutputContext& context) override;
+
     const char* Class() const override { return CLASS; }
     const char* node_help() const override { return HELP; }
 
@@ -82,28 +110,269 @@ public:
     static void dynamicKnobCallback(void* ptr, Knob_Callback f);
 
 protected:
+    // Nuke creates one op per output context, but render stacks (and the
+    // render delegate knobs) are shared by all of a node's ops, and are owned
+    // by its first op. Everything below must only be called while holding the
+    // owning op's render mutex.
+    inline HydraRender* nodeOp() const {
+        return static_cast<HydraRender*>(firstOp());
+    }
+
+    inline HydraRenderStack* renderStack() const {
+        return nodeOp()->_hydra;
+    }
+
     inline HdNukeSceneDelegate* sceneDelegate() const {
-        return _hydra->nukeDelegate;
+        return renderStack()->nukeDelegate;
     }
 
     inline HdRenderDelegate* renderDelegate() const {
-        return _hydra->GetRenderDelegate();
+        return renderStack()->GetRenderDelegate();
     }
 
-    inline HdxTaskController* taskController() const {
-        return _hydra->taskController;
-    }
+    // The task controller rendering this op's view.
+    HdxTaskController* taskController() const;
+    void configureTaskController(HdxTaskController* controller) const;
 
-    void initRenderer() { initRenderer(_rendererId); }
+    void initRenderer() { nodeOp()->initRenderer(_rendererId); }
     void initRenderer(const std::string& delegateId);
+    void syncRenderDelegateSettings();
+    // Applies a setting to the active render delegate, or queues it for the
+    // render server.
+    void setRenderSetting(const TfToken& key, const VtValue& value);
+    void applyRendererCacheLimits();
+
+    // Applies the interactive setting overrides, or restores the settings
+    // from the knobs once they are no longer wanted.
+    void applyRenderProfile(bool interactive);
+    // Applies the lazy primvar and primvar filter knobs to the scene data.
+    void applyPrimvarOptions();
+    std::vector<std::pair<TfToken, VtValue>> interactiveOverrides() const;
+    // Looks a render delegate setting up by its key (or knob name without the
+    // rd_ prefix), and parses a value for it. Warns and returns false if
+    // either fails.
+    bool resolveRenderSetting(const std::string& name,
+                              const std::string& valueText, const char* context,
+                              std::pair<TfToken, VtValue>* setting) const;
+
+    // Asks a render in flight on the node's stack to stop at its next
+    // iteration, and returns the node's render lock once it has.
+    std::unique_lock<std::recursive_mutex> interruptRender();
+    bool renderInterrupted();
+
+    struct RenderTimings
+    {
+        double sync = 0;
+        double render = 0;
+        double copy = 0;
+        // The time spent building this frame's scene in the background, and
+        // the part of it that the render had to wait for.
+        double prefetch = 0;
+        double prefetchWait = 0;
+        double wedges = 0;
+        int iterations = 0;
+        const char* stopReason = "converged";
+        // Whether the image is final, rather than cut short by a time limit.
+        bool complete = true;
+        bool cacheHit = false;
+        // The iterations a checkpoint held when the render resumed from it.
+        int resumedIterations = 0;
+        // The resolution ladder's downscale factor.
+        int downscale = 1;
+
+        // Records why a render stopped. Returns true if it stopped for good
+        // before converging, so the delegate should be paused rather than
+        // left refining the delivered image.
+        bool setStopReason(HdNukeRenderLoop::Result result);
+    };
+
+    // What a render request has to do, decided from what was last rendered
+    // into the view and the interactive rendering knobs.
+    struct RenderPlan
+    {
+        bool needRender = false;
+        // Continues the view's last render, which was cut short to show its
+        // progress, rather than starting over.
+        bool continueSlice = false;
+        bool interactive = false;
+        bool finalProfilePass = false;
+        bool useLadder = false;
+        int ladderLevel = 0;
+        GfVec4d viewport;
+    };
+
+    // What was last rendered into (and set on) a view.
+    struct ViewState
+    {
+        Hash renderHash;
+        GfVec4d viewport;
+        GfMatrix4d viewMatrix;
+        GfMatrix4d projectionMatrix;
+        bool cameraSet = false;
+        bool renderComplete = false;
+        // Rendered at full resolution, with the final settings.
+        bool fullQuality = false;
+        // The AOVs the view renders, if not just color and depth, and the
+        // render products file last written from it.
+        TfTokenVector renderOutputs;
+        std::string productsPath;
+        // The checkpoint the last render resumed from, which is blended into
+        // its image, and the iterations rendered on top of it.
+        std::shared_ptr<const HdNukeExrImage> resumeImage;
+        int resumeIterations = 0;
+        int iterations = 0;
+        // Set when the last render ran out of the target frame rate's time,
+        // so the next update continues it with the same plan. The time spent
+        // on the image so far counts towards the max time.
+        bool sliced = false;
+        RenderPlan slicedPlan;
+        double renderTime = 0;
+        // The render time at which the last checkpoint was stored.
+        double checkpointTime = 0;
+    };
+
+    RenderPlan planRender(const ViewState& view, RenderTimings& timings) const;
+    // Applies the limits and interruption checks of the knobs to a render
+    // loop. With a view, the loop continues the view's render if the plan
+    // says so, and may be sliced.
+    void configureRenderLoop(HdNukeRenderLoop& loop, const ViewState* view);
+    // Records how a render loop ended in the view and the timings. Returns
+    // true if the delegate should be paused.
+    bool finishRenderLoop(const HdNukeRenderLoop& loop,
+                          HdNukeRenderLoop::Result result,
+                          const RenderPlan& plan, ViewState& view,
+                          RenderTimings& timings) const;
+    // Moves the resolution ladder and interactive profile on after a render,
+    // or has the viewer continue it if it was sliced.
+    void finishRender(const RenderPlan& plan, const ViewState& view);
+
+    // Renders through hdNukeRenderServer processes instead of a render stack.
+    void renderStripeRemote(ImagePlane& plane, const std::string& cacheKey);
+    // Renders each wedge variant in turn, with its overrides applied to the
+    // synced scene and settings. Returns false if the render was interrupted.
+    bool renderWedges(const RenderPlan& plan, RenderTimings& timings);
+    // Returns the wedge variant whose layer the channels are in, or -1.
+    int wedgeIndex(const ChannelSet& channels) const;
+    // Splits the image into tiles, and renders them on all workers at once.
+    // Returns false if the render failed or was interrupted.
+    bool renderTiles(const RenderPlan& plan, RenderTimings& timings);
+
+    // Returns the time allowed for rendering an image in seconds, or zero if
+    // it is unlimited.
+    double renderTimeBudget() const;
+    // Returns how long a render may run before the viewer is shown its
+    // progress, or zero to only show it once the render stops.
+    double renderSliceTime() const;
+    void setRenderStats(const RenderTimings& timings);
+
+    // Batch mode: builds the next frame's Nuke scene on a worker thread, and
+    // converts it in place of a fresh build_scene once that frame renders.
+    bool syncStagedScene(GeoOp* geoOp, RenderTimings& timings);
+    void startPrefetch();
+    void discardPrefetch();
+
+    std::string renderCacheKey(const ChannelSet& channels) const;
+    bool loadCachedRender(const std::string& key, ImagePlane& plane);
+    void storeCachedRender(const std::string& key, const ImagePlane& plane);
+    // Fills a plane with the image's channels of the same name. Returns
+    // false if the image doesn't match the plane.
+    bool copyExrImageToImagePlane(const HdNukeExrImage& image,
+                                  ImagePlane& plane);
+
+    // Checkpoints: snapshots of long renders, which later renders of the same
+    // image resume from.
+    void loadCheckpoint(ViewState& view, const std::string& key,
+                        RenderTimings& timings);
+    void storeCheckpoint(const ViewState& view, const std::string& key,
+                         bool wait);
+    // The render buffers' color and depth, blended with the checkpoint the
+    // render resumed from.
+    HdNukeExrImage checkpointImage(const ViewState& view) const;
+
+    // Render products: the view's AOVs, written straight to a multi-part EXR
+    // file per frame.
+    TfTokenVector renderProductAovs() const;
+    // Returns an empty string if the view's products shouldn't be written.
+    std::string renderProductsPath(const ViewState& view) const;
+    bool renderProductsOnly() const;
+    void writeRenderProducts(ViewState& view, const std::string& path,
+                             std::vector<HdNukeExrPart>&& parts);
 
     void copyBufferToImagePlane(HdRenderBuffer* buffer, ImagePlane& plane);
+    // Fills a plane from a buffer of a lower resolution.
+    void copyScaledBufferToImagePlane(HdRenderBuffer* buffer, ImagePlane& plane);
+    // Fills a plane from interleaved floats, scaling them up if needed.
+    void copyFloatsToImagePlane(const float* data, int width, int height,
+                                size_t numComponents, ImagePlane& plane);
 
 private:
-    std::unique_ptr<HydraRenderStack> _hydra;
-    HdEngine _engine;
+    // Per-node state, only used on the first op.
+    HdNukeSceneDataPtr _sceneData;
+    HydraRenderStackCache _stackCache;
+    HydraRenderStack* _hydra = nullptr;
+    std::recursive_mutex _renderMutex;
+    std::atomic<bool> _interruptRender;
     std::string _activeRenderer;
-    bool _needRender = false;
+    // Indexed by Nuke view.
+    std::map<int, ViewState> _views;
+    // The hash of the Hydra input last synced into the active stack.
+    Hash _syncedHydraHash;
+    bool _hydraSynced = false;
+    // The scene being built for the next frame, and the one converted last
+    // (which must outlive its conversion). Declared before the future, so
+    // it is waited for before the scene it builds is destroyed.
+    std::unique_ptr<HdNukeStagedScene> _stagedScene;
+    std::unique_ptr<HdNukeStagedScene> _convertedStagedScene;
+    std::future<double> _prefetch;
+    HdNukeRenderCache _renderCache;
+    HdNukeRenderProductWriter _productWriter;
+    HdNukeRenderCheckpoints _checkpoints;
+    // Out of process rendering: the server connections (one per worker), what
+    // was last rendered into (and set on) each view, and the settings to send
+    // them next.
+    std::vector<std::unique_ptr<HdNukeRenderClient>> _renderClients;
+    std::map<int, ViewState> _remoteViews;
+    // An image rendered into memory, with interleaved RGBA color.
+    struct RenderedImage
+    {
+        int width = 0;
+        int height = 0;
+        std::vector<float> color;
+        std::vector<float> depth;
+    };
+    // Tiled mode: the image assembled from the workers' tiles, per view.
+    std::map<int, RenderedImage> _tiledImages;
+    // The images of the wedge variants, per view, and the hash they were
+    // rendered for.
+    struct WedgeImages
+    {
+        Hash hash;
+        std::vector<RenderedImage> images;
+    };
+    std::map<int, WedgeImages> _wedgeImages;
+    std::vector<std::pair<TfToken, VtValue>> _pendingRemoteSettings;
+    bool _renderedRemotely = false;
+    // The resolution ladder's last rendered level, or -1 if the last render
+    // didn't use the ladder.
+    int _ladderLevel = -1;
+    // Set by the idle timer once the interactive render of `_interactiveHash`
+    // should be redone with the final settings. The timer can't touch knobs,
+    // so updateUI asks the viewer for that render.
+    std::atomic<bool> _finalProfileRequested;
+    std::atomic<bool> _needAsapUpdate;
+    Hash _interactiveHash;
+    bool _interactiveProfileApplied = false;
+    // The stats of the last render, published by the render thread for
+    // updateUI to show on the knob.
+    std::mutex _renderStatsMutex;
+    std::string _publishedRenderStats;
+    bool _renderStatsChanged = false;
+
+    HdEngine _engine;
+    HdNukeConvergenceEstimator _convergenceEstimator;
+    GfVec4d _viewport;
+    GfMatrix4d _viewMatrix;
+    GfMatrix4d _projectionMatrix;
 
     std::vector<std::string> _delegateKnobNames;
     std::unordered_map<std::string, HdRenderSettingDescriptor> _delegateSettings;
@@ -115,12 +384,57 @@ private:
     std::string _rendererId;
     int _rendererIndex = 0;
     float _displayColor[3] = {0.18, 0.18, 0.18};
+    bool _lazyPrimvars = false;
+    std::string _primvarAllow;
+    std::string _primvarDeny;
+    int _primvarPrecision = 0;
+    std::string _reducedPrecisionPrimvars;
+    int _rendererCacheSize = 2;
+    int _rendererCacheMemory = 0;
+    bool _useRenderServer = false;
+    int _renderServerThreads = 0;
+    std::string _renderServerCpus;
+    double _renderServerTimeout = 600;
+    int _renderWorkers = 1;
+    int _renderTiles = 16;
+    double _maxTime = 0;
+    int _maxIterations = 0;
+    double _targetFrameRate = 0;
+    double _convergenceThreshold = 0;
+    bool _batchMode = false;
+    bool _animated = false;
+    bool _resolutionLadder = false;
+    bool _useRenderCache = false;
+    const char* _renderCacheDir = "";
+    int _renderCacheSize = 4096;
+    bool _useCheckpoints = false;
+    double _checkpointInterval = 300;
+    const char* _checkpointDir = "";
+    bool _writeRenderProducts = false;
+    const char* _renderProductsFile = "";
+    std::string _renderProductAovs = "color depth";
+    bool _renderProductsOnly = false;
+    const char* _interactiveSettings = "";
+    const char* _wedges = "";
+    double _idleTimeout = 1.0;
+    std::string _renderStats;
 
     // The index of the first dynamic render delegate knob.
     int _renderDelegateKnobStartIndex = -1;
     // The number of dynamic render delegate knobs, to pass to `replace_knobs`.
     int _renderDelegateKnobCount = 0;
-    bool _needDelegateKnobSync = true;
+    // Knob changes are picked up by the next render, rather than blocking the
+    // UI until the current one lets go of the render stack.
+    std::atomic<bool> _needDelegateKnobSync;
+    // Set when a cached stack is reactivated (since it may still hold settings
+    // that have since been reset to their defaults on the knobs), or after a
+    // setting knob has been changed (possibly back to its default).
+    std::atomic<bool> _syncAllDelegateKnobs;
+    std::atomic<bool> _needForceUpdate;
+
+    // Declared last, so it is stopped before anything its callback uses is
+    // destroyed.
+    HdNukeIdleTimer _idleTimer;
 };
 
 
@@ -132,6 +446,18 @@ const std::string HydraRender::RENDERER_KNOB_PREFIX("rd_");
 
 namespace {
 
+using Clock = std::chrono::steady_clock;
+
+// 1/8, 1/4, 1/2 and full resolution.
+static const int LADDER_LEVELS = 4;
+
+inline double
+_SecondsSince(const Clock::time_point& start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+
 static TfTokenVector g_pluginIds;
 static std::vector<std::string> g_pluginKnobStrings;
 
@@ -167,6 +493,221 @@ _scanRendererPlugins()
     });
 }
 
+// The render setting descriptors of each renderer plugin, so the settings
+// knobs can be built without a render stack (e.g. when renders are loaded
+// from the disk cache). They are taken from the active delegate if there is
+// one, and otherwise from a temporary delegate, which is only created the
+// first time a renderer is queried.
+static const HdRenderSettingDescriptorList&
+_GetRenderSettingDescriptors(const TfToken& pluginId,
+                             HdRenderDelegate* activeDelegate)
+{
+    static std::mutex descriptorMutex;
+    static std::map<TfToken, HdRenderSettingDescriptorList> descriptorCache;
+
+    {
+        std::lock_guard<std::mutex> lock(descriptorMutex);
+        auto it = descriptorCache.find(pluginId);
+        if (it != descriptorCache.end()) {
+            return it->second;
+        }
+    }
+
+    HdRenderSettingDescriptorList descriptors;
+    if (activeDelegate != nullptr) {
+        descriptors = activeDelegate->GetRenderSettingDescriptors();
+    }
+    else {
+        auto& pluginRegistry = HdRendererPluginRegistry::GetInstance();
+        HdRendererPlugin* plugin = nullptr;
+        if (pluginRegistry.IsRegisteredPlugin(pluginId)) {
+            plugin = pluginRegistry.GetRendererPlugin(pluginId);
+        }
+        if (plugin != nullptr) {
+            if (plugin->IsSupported()) {
+                if (HdRenderDelegate* delegate = plugin->CreateRenderDelegate()) {
+                    descriptors = delegate->GetRenderSettingDescriptors();
+                    plugin->DeleteRenderDelegate(delegate);
+                }
+            }
+            pluginRegistry.ReleasePlugin(plugin);
+        }
+    }
+
+    // Another thread may have queried the same renderer meanwhile, in which
+    // case its descriptors are kept.
+    std::lock_guard<std::mutex> lock(descriptorMutex);
+    return descriptorCache.emplace(pluginId, std::move(descriptors)).first->second;
+}
+
+// Parses a setting value given as text, as the type of the setting's default.
+static bool
+_ParseSettingValue(const VtValue& defaultValue, const std::string& text,
+                   VtValue* result)
+{
+    if (text.empty()) {
+        return false;
+    }
+    const char* start = text.c_str();
+    char* end = nullptr;
+
+    if (defaultValue.IsHolding<bool>()) {
+        const std::string lower = TfStringToLower(text);
+        if (lower == "1" or lower == "true" or lower == "on") {
+            *result = VtValue(true);
+        }
+        else if (lower == "0" or lower == "false" or lower == "off") {
+            *result = VtValue(false);
+        }
+        else {
+            return false;
+        }
+        return true;
+    }
+    if (defaultValue.IsHolding<int>()) {
+        const long value = std::strtol(start, &end, 10);
+        *result = VtValue(static_cast<int>(value));
+        return *end == '\0';
+    }
+    if (defaultValue.IsHolding<float>()) {
+        const double value = std::strtod(start, &end);
+        *result = VtValue(static_cast<float>(value));
+        return *end == '\0';
+    }
+    if (defaultValue.IsHolding<double>()) {
+        const double value = std::strtod(start, &end);
+        *result = VtValue(value);
+        return *end == '\0';
+    }
+    if (defaultValue.IsHolding<std::string>()) {
+        *result = VtValue(text);
+        return true;
+    }
+    if (defaultValue.IsHolding<TfToken>()) {
+        *result = VtValue(TfToken(text));
+        return true;
+    }
+    if (defaultValue.IsHolding<GfVec3f>()) {
+        GfVec3f value;
+        for (int i = 0; i < 3; i++)
+        {
+            value[i] = static_cast<float>(std::strtod(start, &end));
+            if (end == start) {
+                return false;
+            }
+            start = end;
+        }
+        *result = VtValue(value);
+        return *TfStringTrim(end).c_str() == '\0';
+    }
+    return false;
+}
+
+static const size_t MAX_WEDGES = 32;
+
+// Each variant is output as its own layer, wedge1 to wedgeN.
+static ChannelSet
+_GetWedgeChannels(size_t index)
+{
+    const std::string layer = "wedge" + TfStringify(index + 1);
+    ChannelSet channels;
+    for (const char* name : {".red", ".green", ".blue", ".alpha"})
+    {
+        channels += getChannel((layer + name).c_str());
+    }
+    return channels;
+}
+
+// Replaces the first run of #'s (or printf style %d) in a path with the
+// frame number.
+static std::string
+_ExpandFrameNumber(const std::string& path, int frame)
+{
+    const size_t hashStart = path.find('#');
+    if (hashStart != std::string::npos) {
+        const size_t hashEnd = path.find_first_not_of('#', hashStart);
+        const size_t width = (hashEnd == std::string::npos ? path.size() : hashEnd)
+                             - hashStart;
+        std::ostringstream buf;
+        buf << std::setw(static_cast<int>(width)) << std::setfill('0') << frame;
+        return path.substr(0, hashStart) + buf.str()
+               + (hashEnd == std::string::npos ? "" : path.substr(hashEnd));
+    }
+
+    const size_t percent = path.find('%');
+    if (percent != std::string::npos) {
+        const size_t end = path.find_first_not_of("0123456789", percent + 1);
+        if (end != std::string::npos and path[end] == 'd') {
+            const std::string spec = path.substr(percent, end - percent + 1);
+            return path.substr(0, percent)
+                   + TfStringPrintf(spec.c_str(), frame) + path.substr(end + 1);
+        }
+    }
+    return path;
+}
+
+static std::string
+_GetProductPartName(const TfToken& aov)
+{
+    return aov == HdAovTokens->color ? "rgba" : aov.GetString();
+}
+
+static std::vector<std::string>
+_GetProductChannelNames(const TfToken& aov, size_t numComponents)
+{
+    if (numComponents == 1) {
+        return {aov == HdAovTokens->depth ? "Z" : "Y"};
+    }
+    static const char* const names[] = {"R", "G", "B", "A"};
+    std::vector<std::string> channelNames;
+    for (size_t c = 0; c < std::min<size_t>(numComponents, 4); c++)
+    {
+        channelNames.push_back(names[c]);
+    }
+    return channelNames;
+}
+
+static void
+_DeinterleaveFloats(const float* data, int width, int height,
+                    const std::vector<std::string>& channelNames,
+                    HdNukeExrImage* image)
+{
+    image->Resize(width, height, channelNames);
+    const size_t numComponents = channelNames.size();
+    const size_t numPixels = static_cast<size_t>(width) * height;
+    for (size_t c = 0; c < numComponents; c++)
+    {
+        float* dest = image->Channel(c);
+        for (size_t i = 0; i < numPixels; i++)
+        {
+            dest[i] = data[i * numComponents + c];
+        }
+    }
+}
+
+// The primvar filter patterns used for a renderer when the primvar knobs are
+// left empty. PW repeats the points in world space, which renderers get from
+// the points and transform, but RenderMan shaders may look up any primvar.
+static void
+_GetDefaultPrimvarFilter(const std::string& rendererId, std::string& allow,
+                         std::string& deny)
+{
+    static const std::map<std::string,
+                          std::pair<std::string, std::string>> defaults = {
+        {"HdPrmanLoaderRendererPlugin", {"", ""}},
+    };
+
+    auto it = defaults.find(rendererId);
+    if (it != defaults.end()) {
+        allow = it->second.first;
+        deny = it->second.second;
+    }
+    else {
+        allow.clear();
+        deny = "PW";
+    }
+}
+
 }  // namespace
 
 
@@ -177,6 +718,14 @@ _scanRendererPlugins()
 
 HydraRender::HydraRender(Node* node)
         : PlanarIop(node)
+        , _sceneData(std::make_shared<HdNukeSceneData>())
+        , _stackCache(_sceneData)
+        , _interruptRender(false)
+        , _needDelegateKnobSync(true)
+        , _syncAllDelegateKnobs(false)
+        , _needForceUpdate(false)
+        , _finalProfileRequested(false)
+        , _needAsapUpdate(false)
 {
     _scanRendererPlugins();
 
@@ -230,7 +779,11 @@ HydraRender::test_input(int index, Op* op) const
 void
 HydraRender::append(Hash& hash)
 {
-    hash.append(outputContext().frame());
+    // Animated inputs change their hashes from frame to frame, so renders are
+    // only tied to the frame when the node is marked as animated.
+    if (_animated) {
+        hash.append(outputContext().frame());
+    }
 
     Op::input(1)->append(hash);
     if (GeoOp* geoOp = op_cast<GeoOp*>(Op::input(0))) {
@@ -256,8 +809,234 @@ HydraRender::knobs(Knob_Callback f)
         k->enumerationKnob()->menu(g_pluginKnobStrings);
     }
 
+    Int_knob(f, &_rendererCacheSize, "renderer_cache_size", "cached renderers");
+    SetFlags(f, Knob::STARTLINE | Knob::NO_RERENDER);
+    SetRange(f, 1, 8);
+    Tooltip(f, "The number of render delegates to keep alive, including the "
+               "current one. Switching back to a cached delegate only needs to "
+               "sync the scene changes made since it was last used.");
+    Int_knob(f, &_rendererCacheMemory, "renderer_cache_memory", "memory limit (MB)");
+    SetFlags(f, Knob::NO_RERENDER);
+    Tooltip(f, "When Nuke's resident memory exceeds this limit, the least "
+               "recently used inactive delegate is released, one per render, "
+               "and only while memory keeps growing. Zero disables the "
+               "limit.");
+
+    Bool_knob(f, &_useRenderServer, "render_server", "render out of process");
+    SetFlags(f, Knob::STARTLINE | Knob::NO_ANIMATION);
+    Tooltip(f, "Render in a separate hdNukeRenderServer process, which is sent "
+               "the changes to the Nuke scene and hands the image back through "
+               "shared memory. A crashing renderer then doesn't take Nuke down "
+               "with it. The Hydra scene input and instanced geometry are not "
+               "supported yet.");
+    Int_knob(f, &_renderServerThreads, "render_server_threads", "threads");
+    SetFlags(f, Knob::NO_RERENDER | Knob::NO_ANIMATION);
+    SetRange(f, 0, 64);
+    Tooltip(f, "The number of threads the render server may use. Zero uses one "
+               "per core it is allowed to run on. Changing this restarts the "
+               "server.");
+    String_knob(f, &_renderServerCpus, "render_server_cpus", "cores");
+    SetFlags(f, Knob::NO_RERENDER | Knob::NO_ANIMATION);
+    Tooltip(f, "Pins the render server to these cores, e.g. \"0-7,16\", to keep "
+               "it off the ones Nuke is using. Multiple workers split the "
+               "cores between them, and need at least one each. Empty to use "
+               "any core (Linux only). Changing this restarts the server.");
+    Double_knob(f, &_renderServerTimeout, "render_server_timeout", "timeout");
+    SetFlags(f, Knob::NO_RERENDER | Knob::NO_ANIMATION);
+    SetRange(f, 0, 3600);
+    Tooltip(f, "Seconds to wait for the render server to answer a request, "
+               "e.g. to render one pass or load a scene, before stopping it "
+               "as hung. Zero waits forever.");
+    Int_knob(f, &_renderWorkers, "render_workers", "workers");
+    SetFlags(f, Knob::STARTLINE | Knob::NO_RERENDER | Knob::NO_ANIMATION);
+    SetRange(f, 1, 16);
+    Tooltip(f, "With more than one worker, the image is split into tiles, "
+               "which are rendered by that many render server processes at "
+               "once. Each worker is sent the whole scene, and is pinned to "
+               "its share of the cores. Helps with renderers that don't scale "
+               "to all of a machine's cores.");
+    Int_knob(f, &_renderTiles, "render_tiles", "tiles");
+    SetFlags(f, Knob::NO_RERENDER | Knob::NO_ANIMATION);
+    SetRange(f, 1, 256);
+    Tooltip(f, "The number of tiles the image is split into when rendering "
+               "with more than one worker.");
+
     Color_knob(f, _displayColor, "default_display_color", "default display color");
 
+    Bool_knob(f, &_lazyPrimvars, "lazy_primvars", "lazy primvars");
+    SetFlags(f, Knob::STARTLINE);
+    Tooltip(f, "Only convert a geometry attribute when the renderer first asks "
+               "for it, rather than converting every attribute up front. "
+               "Saves time and memory on geometry with many attributes the "
+               "renderer doesn't use.");
+
+    String_knob(f, &_primvarAllow, "primvar_allow", "allow primvars");
+    SetFlags(f, Knob::NO_ANIMATION);
+    Tooltip(f, "Space-separated glob patterns of the geometry attributes to "
+               "convert to primvars, matched against either the Nuke "
+               "attribute name (e.g. N) or the primvar name (e.g. normals). "
+               "Empty allows every attribute that isn't denied. If both "
+               "lists are empty, the renderer's defaults are used, which "
+               "usually deny PW.");
+    String_knob(f, &_primvarDeny, "primvar_deny", "deny primvars");
+    SetFlags(f, Knob::NO_ANIMATION);
+    Tooltip(f, "Space-separated glob patterns of the geometry attributes "
+               "never to convert. Filtered attributes are dropped before any "
+               "conversion.");
+
+    static const char* const precisions[] = {"full", "half", "quantized",
+                                             nullptr};
+    Enumeration_knob(f, &_primvarPrecision, precisions, "primvar_precision",
+                     "primvar precision");
+    SetFlags(f, Knob::NO_ANIMATION);
+    Tooltip(f, "Stores large float primvars (e.g. normals and velocities) "
+               "with 16 bits per component to save memory, e.g. for preview "
+               "renders. Half keeps relative precision; quantized spreads "
+               "each component evenly over its range in the array. Values "
+               "are widened back to full floats every time the renderer reads "
+               "them, so syncs take longer in exchange for the memory. "
+               "Points are always kept at full precision.");
+    String_knob(f, &_reducedPrecisionPrimvars, "reduced_precision_primvars",
+                "");
+    ClearFlags(f, Knob::STARTLINE);
+    SetFlags(f, Knob::NO_ANIMATION);
+    Tooltip(f, "Space-separated glob patterns of the primvars stored at "
+               "reduced precision, matched like the allow list. Empty means "
+               "all of them.");
+
+    Bool_knob(f, &_animated, "animated");
+    SetFlags(f, Knob::STARTLINE);
+    Tooltip(f, "Render every frame, even if none of the inputs change over "
+               "time. Otherwise, the last render is reused until an input "
+               "changes. Turn this on if the image varies with time in ways "
+               "the inputs don't show, e.g. through render delegate settings.");
+
+    Double_knob(f, &_maxTime, "max_time", "max time (s)");
+    SetFlags(f, Knob::STARTLINE | Knob::NO_ANIMATION);
+    SetRange(f, 0, 600);
+    Tooltip(f, "Stop rendering after this many seconds, even if the renderer "
+               "has not converged. Zero disables the limit.");
+    Int_knob(f, &_maxIterations, "max_iterations", "max iterations");
+    SetFlags(f, Knob::NO_ANIMATION);
+    SetRange(f, 0, 1024);
+    Tooltip(f, "Stop rendering after this many renderer passes, even if the "
+               "renderer has not converged. Zero disables the limit.");
+    Double_knob(f, &_targetFrameRate, "target_frame_rate", "target frame rate");
+    SetFlags(f, Knob::STARTLINE | Knob::NO_ANIMATION);
+    SetRange(f, 0, 30);
+    Tooltip(f, "In interactive sessions, show the render's progress this many "
+               "times per second. The render carries on after each update "
+               "until it converges or reaches one of the limits above. "
+               "Ignored when rendering from the command line. Zero only "
+               "shows the image once the render stops.");
+
+    Double_knob(f, &_convergenceThreshold, "convergence_threshold",
+                "convergence threshold");
+    SetFlags(f, Knob::STARTLINE | Knob::NO_ANIMATION | Knob::LOG_SLIDER);
+    SetRange(f, 0, 0.1);
+    Tooltip(f, "Stop rendering once every tile of the image changes by less "
+               "than this fraction of its brightness between renderer passes, "
+               "regardless of whether the renderer considers itself converged. "
+               "Zero leaves convergence up to the renderer.");
+
+    Bool_knob(f, &_batchMode, "batch_mode", "pipelined batch mode");
+    SetFlags(f, Knob::STARTLINE | Knob::NO_RERENDER);
+    Tooltip(f, "Build the next frame's Nuke scene before each frame renders, "
+               "and convert it into Hydra terms on a worker thread while the "
+               "frame renders, so the conversion is hidden behind render time. "
+               "Intended for frame range renders from the command line.");
+
+    Bool_knob(f, &_writeRenderProducts, "render_products", "write render products");
+    SetFlags(f, Knob::STARTLINE);
+    Tooltip(f, "Write the AOVs of every full resolution render straight to a "
+               "multi-part EXR file, one part per AOV, without going through "
+               "Nuke's channels. Files are compressed and written in the "
+               "background while the next frame renders. Out of process "
+               "renders can only write color and depth.");
+    File_knob(f, &_renderProductsFile, "render_products_file", "products file");
+    Tooltip(f, "The file to write, with the frame number as #### or %04d.");
+    String_knob(f, &_renderProductAovs, "render_product_aovs", "AOVs");
+    SetFlags(f, Knob::STARTLINE);
+    Tooltip(f, "The AOVs to write, separated by spaces, e.g. \"color depth "
+               "normal primId\". Color is written as the rgba part.");
+    Bool_knob(f, &_renderProductsOnly, "render_products_only", "products only");
+    SetFlags(f, Knob::STARTLINE | Knob::NO_RERENDER);
+    Tooltip(f, "In command line renders, only write the render products, and "
+               "leave this node's image black rather than copying the render "
+               "into it. For scripts that have no Write node of their own.");
+
+    Bool_knob(f, &_resolutionLadder, "resolution_ladder", "resolution ladder");
+    SetFlags(f, Knob::STARTLINE);
+    Tooltip(f, "In interactive sessions, render quick passes at 1/8, 1/4 and "
+               "1/2 of the resolution before the full resolution render, and "
+               "show each of them in the viewer as soon as it is done.");
+
+    Multiline_String_knob(f, &_interactiveSettings, "interactive_settings",
+                          "interactive settings", 3);
+    SetFlags(f, Knob::STARTLINE);
+    Tooltip(f, "Render delegate setting overrides used while the scene is "
+               "being changed in an interactive session, one \"setting value\" "
+               "pair per line, e.g. \"pixelSamples 1\". Settings are named by "
+               "their key, or their knob name without the rd_ prefix. Once "
+               "nothing has changed for the idle timeout, the image is "
+               "rendered again with the settings from the knobs. Batch mode "
+               "and command-line renders always use the knobs.");
+    Double_knob(f, &_idleTimeout, "idle_timeout", "idle timeout (s)");
+    SetFlags(f, Knob::STARTLINE | Knob::NO_RERENDER | Knob::NO_ANIMATION);
+    SetRange(f, 0, 10);
+
+    Multiline_String_knob(f, &_wedges, "wedges", "wedges", 3);
+    SetFlags(f, Knob::STARTLINE);
+    Tooltip(f, "Variants of the render to output as the layers wedge1, wedge2 "
+               "and so on, one per line, each a list of overrides separated "
+               "by semicolons, e.g. \"light Light1 intensity 2; pixelSamples "
+               "16\". Overrides are a render delegate setting and its value, "
+               "\"light <node> <parameter> <value>\", or \"displayColor <r> "
+               "<g> <b>\". When a wedge layer is requested, all variants are "
+               "rendered one after another from the scene synced for the "
+               "main image, with only their overrides changed in between. Up "
+               "to 32 variants are output; not supported when rendering out of "
+               "process.");
+
+    Bool_knob(f, &_useRenderCache, "render_cache", "disk cache");
+    SetFlags(f, Knob::STARTLINE | Knob::NO_RERENDER);
+    Tooltip(f, "Keep finished renders in a directory on disk, and reuse them "
+               "whenever the same image is requested again, even in another "
+               "session. Renders cut short by a time limit are not cached.");
+    File_knob(f, &_renderCacheDir, "render_cache_dir", "cache directory");
+    SetFlags(f, Knob::NO_RERENDER);
+    Tooltip(f, "Defaults to $HDNUKE_RENDER_CACHE_DIR, or a directory in the "
+               "system's temporary directory.");
+    Int_knob(f, &_renderCacheSize, "render_cache_size", "cache size (MB)");
+    SetFlags(f, Knob::STARTLINE | Knob::NO_RERENDER | Knob::NO_ANIMATION);
+    SetRange(f, 0, 65536);
+    Tooltip(f, "Least recently used renders are deleted once the cache "
+               "directory grows beyond this size. Zero disables the limit.");
+
+    Bool_knob(f, &_useCheckpoints, "checkpoints");
+    SetFlags(f, Knob::STARTLINE | Knob::NO_RERENDER);
+    Tooltip(f, "Save the image of full resolution renders to disk every so "
+               "often, and when a render stops at the time limit. A later "
+               "render of the same image (e.g. a farm job restarted after it "
+               "was preempted) resumes from the last snapshot: its passes are "
+               "blended with the snapshot's, and count towards the iteration "
+               "limit. The snapshot is deleted once the render is done. Not "
+               "supported when rendering out of process.");
+    Double_knob(f, &_checkpointInterval, "checkpoint_interval", "interval (s)");
+    SetFlags(f, Knob::NO_RERENDER | Knob::NO_ANIMATION);
+    SetRange(f, 10, 3600);
+    File_knob(f, &_checkpointDir, "checkpoint_dir", "checkpoint directory");
+    SetFlags(f, Knob::NO_RERENDER);
+    Tooltip(f, "Defaults to $HDNUKE_CHECKPOINT_DIR, or a directory in the "
+               "system's temporary directory. Use a shared directory to resume "
+               "on another machine.");
+
+    String_knob(f, &_renderStats, "render_stats", "last render");
+    SetFlags(f, Knob::STARTLINE | Knob::READ_ONLY | Knob::DO_NOT_WRITE
+                | Knob::NO_RERENDER | Knob::NO_UNDO);
+    Tooltip(f, "The time and number of renderer passes used by the last "
+               "render, and why it stopped.");
+
     Button(f, "force_update", "force update");
     SetFlags(f, Knob::STARTLINE);
 
@@ -281,6 +1060,9 @@ HydraRender::knob_changed(Knob* k)
         return 1;
     }
     if (k->is("renderer_id")) {
+        // Switching may release the current stack, so it can't be in use.
+        std::unique_lock<std::recursive_mutex> renderLock = interruptRender();
+
         const char* newId = k->get_text();
         Knob* menu = knob("renderer");
         if (g_pluginIds[static_cast<size_t>(menu->get_value())] != newId) {
@@ -295,7 +1077,6 @@ HydraRender::knob_changed(Knob* k)
                 i++;
             }
         }
-        initRenderer(newId);
         FreeDynamicKnobStorage();
         _renderDelegateKnobCount = replace_knobs(knob("renderer_knob_group"),
                                                  _renderDelegateKnobCount,
@@ -303,17 +1084,28 @@ HydraRender::knob_changed(Knob* k)
         _needDelegateKnobSync = true;
         return 1;
     }
+    if (k->is("renderer_cache_size") or k->is("renderer_cache_memory")) {
+        // Otherwise applied by the next render.
+        HydraRender* node = nodeOp();
+        std::unique_lock<std::recursive_mutex> renderLock(node->_renderMutex,
+                                                          std::try_to_lock);
+        if (renderLock.owns_lock()) {
+            node->applyRendererCacheLimits();
+        }
+        return 1;
+    }
     if (k->is("default_display_color")) {
-        sceneDelegate()->SetDefaultDisplayColor(GfVec3f(_displayColor));
+        // Picked up by the next render.
         return 1;
     }
     if (k->is("force_update")) {
-        sceneDelegate()->ClearAll();
+        _needForceUpdate = true;
         invalidate();
         return 1;
     }
     if (k->startsWith(RENDERER_KNOB_PREFIX.c_str())) {
-        syncRenderDelegateSettingKnob(k);
+        _syncAllDelegateKnobs = true;
+        _needDelegateKnobSync = true;
         return 1;
     }
     return Iop::knob_changed(k);
@@ -322,26 +1114,33 @@ HydraRender::knob_changed(Knob* k)
 void
 HydraRender::_validate(bool for_real)
 {
-    initRenderer();
-
-    if (not _hydra) {
-        if (_rendererId.empty()) {
-            error("Empty renderer_id");
-        }
-        else {
-            error("Renderer plugin %s is unavailable or unsupported in the "
-                  "current environment", _rendererId.c_str());
-        }
+    // The render stack itself is only created (or reactivated) when rendering,
+    // so validation never has to wait on another op's render.
+    if (_rendererId.empty()) {
+        error("Empty renderer_id");
+        return;
+    }
+    if (not HdRendererPluginRegistry::GetInstance().IsRegisteredPlugin(
+            TfToken(_rendererId))) {
+        error("Renderer plugin %s is unavailable or unsupported in the "
+              "current environment", _rendererId.c_str());
         return;
     }
 
     info_.full_size_format(*_formats.fullSizeFormat());
     info_.format(*_formats.format());
-    info_.channels(Mask_RGBA | Mask_Z);
+    ChannelSet channels(Mask_RGBA | Mask_Z);
+    const size_t numWedges = std::min(
+        HdNukeParseWedges(_wedges ? _wedges : "").size(), MAX_WEDGES);
+    for (size_t i = 0; i < numWedges; i++)
+    {
+        channels += _GetWedgeChannels(i);
+    }
+    info_.channels(channels);
     info_.set(format());
 
-    GfVec4d viewport(0, 0, info_.w(), info_.h());
-    taskController()->SetRenderViewport(viewport);
+    // The format is already scaled for proxy mode and the viewer's downscale.
+    _viewport = GfVec4d(0, 0, info_.w(), info_.h());
 
     // Set up Gf camera from camera input
     CameraOp* cam = dynamic_cast<CameraOp*>(Op::input(1));
@@ -372,52 +1171,293 @@ HydraRender::_validate(bool for_real)
     );
 
     GfFrustum frustum = gfCamera.GetFrustum();
-    taskController()->SetFreeCameraMatrices(frustum.ComputeViewMatrix(),
-                                            frustum.ComputeProjectionMatrix());
+    _viewMatrix = frustum.ComputeViewMatrix();
+    _projectionMatrix = frustum.ComputeProjectionMatrix();
+}
 
-    if (_needDelegateKnobSync and _renderDelegateKnobCount > 0
-            and _renderDelegateKnobStartIndex > 0)
+bool
+HydraRender::updateUI(const OutputContext& context)
+{
+    // Knobs may only be changed (and updates requested) on the main thread,
+    // so render and timer threads leave their results for this to pick up.
+    HydraRender* node = nodeOp();
+    std::string stats;
+    bool changed = false;
     {
-        const int lastIndex = _renderDelegateKnobStartIndex + _renderDelegateKnobCount;
-        for (int ki = _renderDelegateKnobStartIndex; ki <= lastIndex; ki++)
-        {
-            Knob* delegateKnob = knob(ki);
-            if (delegateKnob->not_default()) {
-                syncRenderDelegateSettingKnob(delegateKnob);
-            }
+        std::lock_guard<std::mutex> lock(node->_renderStatsMutex);
+        if (node->_renderStatsChanged) {
+            stats.swap(node->_publishedRenderStats);
+            node->_renderStatsChanged = false;
+            changed = true;
         }
-        _needDelegateKnobSync = false;
     }
-
-    if (for_real) {
-        _needRender = true;
+    if (changed) {
+        if (Knob* k = node->knob("render_stats")) {
+            k->set_text(stats.c_str());
+        }
     }
+    if (node->_needAsapUpdate.exchange(false)) {
+        node->asapUpdate();
+    }
+    return PlanarIop::updateUI(context);
 }
 
 void
 HydraRender::renderStripe(ImagePlane& plane)
 {
-    if (_needRender) {
+    HydraRender* node = nodeOp();
+    std::lock_guard<std::recursive_mutex> renderLock(node->_renderMutex);
+
+    // Settings applied to one backend are unknown to the other.
+    if (node->_renderedRemotely != _useRenderServer) {
+        node->_renderedRemotely = _useRenderServer;
+        node->_needDelegateKnobSync = true;
+        node->_syncAllDelegateKnobs = true;
+        if (not _useRenderServer) {
+            node->_renderClients.clear();
+            node->_remoteViews.clear();
+            node->_tiledImages.clear();
+        }
+    }
+
+    // A cached render is used without creating (or syncing) a render stack,
+    // unless the stack's buffers already hold the image.
+    std::string cacheKey;
+    if (_useRenderCache) {
+        node->_renderCache.SetDirectory(_renderCacheDir ? _renderCacheDir : "");
+        node->_renderCache.SetMaxBytes(
+            static_cast<size_t>(std::max(_renderCacheSize, 0)) << 20);
+        cacheKey = renderCacheKey(plane.channels());
+
+        const auto& views = _useRenderServer ? node->_remoteViews : node->_views;
+        const bool haveBuffers = _useRenderServer
+            ? not node->_renderClients.empty()
+              and node->_renderClients.front()->IsRunning()
+            : renderStack() != nullptr;
+        auto viewIt = views.find(outputContext().view());
+        const bool inBuffers = haveBuffers and viewIt != views.end()
+                               and viewIt->second.renderHash == hash();
+        if (not inBuffers and node->loadCachedRender(cacheKey, plane)) {
+            RenderTimings timings;
+            timings.cacheHit = true;
+            setRenderStats(timings);
+            return;
+        }
+    }
+
+    if (_useRenderServer) {
+        if (wedgeIndex(plane.channels()) >= 0) {
+            warning("Wedges are not rendered out of process");
+            plane.makeWritable();
+            foreach(z, plane.channels()) {
+                plane.fillChannel(z, 0.0f);
+            }
+            return;
+        }
+        renderStripeRemote(plane, cacheKey);
+        return;
+    }
+
+    node->applyRendererCacheLimits();
+    initRenderer();
+    if (not renderStack()) {
+        error("Renderer plugin %s is unavailable or unsupported in the "
+              "current environment", _rendererId.c_str());
+        return;
+    }
+
+    if (node->_needForceUpdate.exchange(false)) {
+        node->discardPrefetch();
+        // Cached stacks would otherwise still hold the stale scene.
+        node->_stackCache.ClearInactive();
+        // This also throws away the converted scene shared by the stacks.
+        sceneDelegate()->ClearAll();
+        node->_views.clear();
+        node->_hydraSynced = false;
+    }
+    sceneDelegate()->SetDefaultDisplayColor(GfVec3f(_displayColor));
+    applyPrimvarOptions();
+
+    // The buffers still hold the last image rendered for this view, which can
+    // be reused as long as its hash matches (e.g. on another frame of a
+    // scene that doesn't change over time).
+    ViewState& view = node->_views[outputContext().view()];
+    RenderTimings timings;
+    // Wedges are rendered along with the image, on the scene synced for it.
+    const int wedge = wedgeIndex(plane.channels());
+    if (wedge >= 0 and node->_wedgeImages[outputContext().view()].hash != hash()) {
+        view.renderHash = Hash();
+    }
+    const RenderPlan plan = planRender(view, timings);
+
+    if (plan.needRender) {
+        syncRenderDelegateSettings();
+        applyRenderProfile(plan.interactive);
+
+        // Each sync stage is skipped if its inputs haven't changed, so e.g.
+        // moving the camera only updates the camera.
+        if (not view.cameraSet or view.viewport != plan.viewport) {
+            taskController()->SetRenderViewport(plan.viewport);
+            view.viewport = plan.viewport;
+        }
+        if (not view.cameraSet or view.viewMatrix != _viewMatrix
+                or view.projectionMatrix != _projectionMatrix) {
+            taskController()->SetFreeCameraMatrices(_viewMatrix,
+                                                    _projectionMatrix);
+            view.viewMatrix = _viewMatrix;
+            view.projectionMatrix = _projectionMatrix;
+        }
+        view.cameraSet = true;
+
+        // Render products may need AOVs beyond the ones shown in Nuke.
+        TfTokenVector renderOutputs;
+        if (_writeRenderProducts) {
+            for (const TfToken& aov : renderProductAovs())
+            {
+                if (aov != HdAovTokens->color and aov != HdAovTokens->depth) {
+                    renderOutputs.push_back(aov);
+                }
+            }
+            if (not renderOutputs.empty()) {
+                renderOutputs.insert(renderOutputs.begin(),
+                                     {HdAovTokens->color, HdAovTokens->depth});
+            }
+        }
+        if (view.renderOutputs != renderOutputs) {
+            taskController()->SetRenderOutputs(
+                renderOutputs.empty()
+                    ? TfTokenVector{HdAovTokens->color, HdAovTokens->depth}
+                    : renderOutputs);
+            view.renderOutputs = renderOutputs;
+        }
+
+        const Clock::time_point syncStart = Clock::now();
+        // The scene data skips build_scene if the geometry hashes are
+        // unchanged, and the delegate skips its sync if the scene data is.
         if (GeoOp* geoOp = op_cast<GeoOp*>(Op::input(0))) {
-            sceneDelegate()->SyncFromGeoOp(geoOp);
+            if (not syncStagedScene(geoOp, timings)) {
+                sceneDelegate()->SyncFromGeoOp(geoOp);
+            }
         }
         else {
+            node->discardPrefetch();
             sceneDelegate()->ClearNukePrims();
         }
 
-        if (HydraOp* hydraOp = dynamic_cast<HydraOp*>(Op::input(2))) {
-            sceneDelegate()->SyncHydraOp(hydraOp);
+        HydraOp* hydraOp = dynamic_cast<HydraOp*>(Op::input(2));
+        const Hash hydraHash = hydraOp ? hydraOp->hash() : Hash();
+        if (not node->_hydraSynced or hydraHash != node->_syncedHydraHash) {
+            if (hydraOp) {
+                sceneDelegate()->SyncHydraOp(hydraOp);
+            }
+            else {
+                sceneDelegate()->ClearHydraPrims();
+            }
+            node->_syncedHydraHash = hydraHash;
+            node->_hydraSynced = true;
+        }
+        timings.sync = _SecondsSince(syncStart);
+
+        // Build the next frame's scene, and convert it while this one
+        // renders.
+        if (_batchMode and not plan.continueSlice) {
+            startPrefetch();
+        }
+
+        // The delegate may have been paused by an earlier, interrupted render.
+        renderStack()->ResumeRendering();
+        view.renderComplete = false;
+        if (not plan.continueSlice) {
+            // Until it is done, the buffers hold neither the last image nor
+            // this one.
+            view.renderHash = Hash();
+            view.sliced = false;
+            view.renderTime = 0;
+            view.checkpointTime = 0;
+        }
+
+        // The wedges go first, so the buffers end up holding the image.
+        if (wedge >= 0 and not plan.continueSlice
+                and not renderWedges(plan, timings)) {
+            return;
+        }
+
+        // The checkpoint covers color and depth of the whole view.
+        const bool checkpointing = _useCheckpoints and timings.downscale == 1
+                                   and not plan.interactive;
+        std::string checkpointKey;
+        if (checkpointing) {
+            node->_checkpoints.SetDirectory(_checkpointDir ? _checkpointDir : "");
+            checkpointKey = renderCacheKey(Mask_RGBA | Mask_Z);
+        }
+        if (plan.continueSlice) {
+            timings.resumedIterations = view.resumeIterations;
         }
         else {
-            sceneDelegate()->ClearHydraPrims();
+            loadCheckpoint(view, checkpointKey, timings);
+            _convergenceEstimator.Reset();
         }
+        timings.iterations = view.iterations;
+
+        const Clock::time_point renderStart = Clock::now();
         auto tasks = taskController()->GetRenderingTasks();
-        do {
-            _engine.Execute(_hydra->renderIndex, &tasks);
+
+        HdNukeRenderLoop loop;
+        configureRenderLoop(loop, &view);
+        loop.execute = [&](bool* converged) {
+            _engine.Execute(renderStack()->renderIndex, &tasks);
+            view.iterations = ++timings.iterations;
+            *converged = taskController()->IsConverged();
+            return true;
+        };
+        loop.afterPass = [&](bool) {
+            const double renderTime = view.renderTime
+                                      + _SecondsSince(renderStart);
+            if (checkpointing and renderTime - view.checkpointTime
+                                  >= std::max(_checkpointInterval, 1.0)) {
+                storeCheckpoint(view, checkpointKey, false);
+                view.checkpointTime = renderTime;
+            }
+            return _convergenceThreshold > 0 and _convergenceEstimator.Update(
+                taskController()->GetRenderOutput(HdAovTokens->color),
+                static_cast<float>(_convergenceThreshold));
+        };
+        loop.pause = [&]() {
+            if (checkpointing and view.iterations > 0) {
+                storeCheckpoint(view, checkpointKey, false);
+            }
+            renderStack()->PauseRendering();
+        };
+
+        const HdNukeRenderLoop::Result result = loop.Run();
+        const bool pause = finishRenderLoop(loop, result, plan, view, timings);
+        if (result == HdNukeRenderLoop::Interrupted) {
+            return;
+        }
+        if (pause) {
+            // Progressive delegates would otherwise keep refining the
+            // (already delivered) image in the background.
+            renderStack()->PauseRendering();
+        }
+        if (timings.downscale > 1 or plan.interactive) {
+            timings.complete = false;
+        }
+
+        // A render stopped by the time limit leaves a checkpoint for the
+        // next attempt.
+        if (checkpointing and not view.sliced) {
+            if (timings.complete) {
+                node->_checkpoints.Remove(checkpointKey);
+            }
+            else if (view.iterations > 0) {
+                storeCheckpoint(view, checkpointKey, true);
+            }
         }
-        while (!taskController()->IsConverged());
 
-        _needRender = false;
+        view.renderHash = hash();
+        view.renderComplete = timings.complete;
+        view.fullQuality = timings.downscale == 1 and not plan.interactive;
+        view.productsPath.clear();
 
         if (!taskController()->GetRenderOutput(HdAovTokens->color)) {
             error("Null color buffer after render!");
@@ -429,9 +1469,78 @@ HydraRender::renderStripe(ImagePlane& plane)
         return;
     }
 
+    const std::string productsPath = renderProductsPath(view);
+    if (not productsPath.empty()) {
+        std::vector<HdNukeExrPart> parts;
+        for (const TfToken& aov : renderProductAovs())
+        {
+            // A resumed render's color includes the checkpoint's passes.
+            if (aov == HdAovTokens->color and view.resumeImage) {
+                HdNukeExrPart part;
+                part.name = _GetProductPartName(aov);
+                part.image = checkpointImage(view);
+                if (not part.image.pixels.empty()) {
+                    part.image.channelNames = _GetProductChannelNames(aov, 4);
+                    part.image.pixels.resize(
+                        4 * static_cast<size_t>(part.image.width)
+                        * part.image.height);
+                    parts.push_back(std::move(part));
+                    continue;
+                }
+            }
+            HdRenderBuffer* buffer = taskController()->GetRenderOutput(aov);
+            if (buffer == nullptr) {
+                warning("The renderer has no %s output to write", aov.GetText());
+                continue;
+            }
+            buffer->Resolve();
+            HdNukeExrPart part;
+            part.name = _GetProductPartName(aov);
+            const std::vector<std::string> channelNames = _GetProductChannelNames(
+                aov, HdGetComponentCount(buffer->GetFormat()));
+            if (not HdNukeRenderBufferToExrImage(buffer, channelNames,
+                                                 &part.image)) {
+                warning("Unsupported format of the %s output", aov.GetText());
+                continue;
+            }
+            parts.push_back(std::move(part));
+        }
+        writeRenderProducts(view, productsPath, std::move(parts));
+    }
+
     plane.makeWritable();
     const ChannelSet channels = plane.channels();
 
+    if (wedge >= 0) {
+        const WedgeImages& wedgeImages = node->_wedgeImages[outputContext().view()];
+        if (static_cast<size_t>(wedge) >= wedgeImages.images.size()
+                or wedgeImages.images[static_cast<size_t>(wedge)].color.empty()) {
+            foreach(z, channels) {
+                plane.fillChannel(z, 0.0f);
+            }
+            return;
+        }
+        const RenderedImage& image = wedgeImages.images[static_cast<size_t>(wedge)];
+        copyFloatsToImagePlane(image.color.data(), image.width, image.height, 4,
+                               plane);
+        if (plan.needRender) {
+            setRenderStats(timings);
+        }
+        finishRender(plan, view);
+        return;
+    }
+
+    if (renderProductsOnly()) {
+        foreach(z, channels) {
+            plane.fillChannel(z, 0.0f);
+        }
+        if (plan.needRender) {
+            setRenderStats(timings);
+        }
+        finishRender(plan, view);
+        return;
+    }
+
     TfToken outputName;
     if (channels & Mask_RGBA) {
         outputName = HdAovTokens->color;
@@ -450,90 +1559,1419 @@ HydraRender::renderStripe(ImagePlane& plane)
         return;
     }
 
-    sourceBuffer->Resolve();
-    copyBufferToImagePlane(sourceBuffer, plane);
-}
-
-void
-HydraRender::initRenderer(const std::string& delegateId)
-{
-    if (delegateId == _activeRenderer) {
-        return;
+    const Clock::time_point copyStart = Clock::now();
+    if (not view.resumeImage
+            or not copyExrImageToImagePlane(checkpointImage(view), plane)) {
+        sourceBuffer->Resolve();
+        copyBufferToImagePlane(sourceBuffer, plane);
     }
+    timings.copy = _SecondsSince(copyStart);
 
-    auto* dataPtr = HydraRenderStack::Create(TfToken(delegateId));
-    _hydra.reset(dataPtr);
-    _activeRenderer = delegateId;
-    if (dataPtr == nullptr) {
-        return;
+    if (_useRenderCache and view.renderComplete
+            and not node->_renderCache.Contains(cacheKey)) {
+        node->storeCachedRender(cacheKey, plane);
     }
 
-    sceneDelegate()->SetDefaultDisplayColor(GfVec3f(_displayColor));
-
-    taskController()->SetEnableSelection(false);
-
-    HdxRenderTaskParams renderTaskParams;
-    renderTaskParams.enableLighting = true;
-    renderTaskParams.enableSceneMaterials = true;
-    taskController()->SetRenderParams(renderTaskParams);
-
-    // To disable viewport rendering
-    taskController()->SetViewportRenderOutput(TfToken());
-
-    TfTokenVector renderTags;
-    renderTags.push_back(HdRenderTagTokens->geometry);
-    renderTags.push_back(HdRenderTagTokens->render);
-    taskController()->SetRenderTags(renderTags);
+    if (plan.needRender) {
+        setRenderStats(timings);
+    }
+    finishRender(plan, view);
 }
 
 void
-HydraRender::renderDelegateKnobCallback(Knob_Callback f)
+HydraRender::renderStripeRemote(ImagePlane& plane, const std::string& cacheKey)
 {
-    if (not _hydra) {
-        initRenderer();
-        if (not _hydra) {
+    HydraRender* node = nodeOp();
+    auto& clients = node->_renderClients;
+    const size_t numWorkers = static_cast<size_t>(std::max(_renderWorkers, 1));
+    const bool tiled = numWorkers > 1;
+    clients.resize(numWorkers);
+
+    HdNukeRenderClient::Options options;
+    options.executable = HdNukeRenderClient::GetDefaultExecutable();
+    options.threads = std::max(_renderServerThreads, 0);
+    std::vector<std::string> workerCpus;
+    std::string cpusError;
+    if (not HdNukePartitionCpus(_renderServerCpus, numWorkers, &workerCpus,
+                                &cpusError)) {
+        error("%s", cpusError.c_str());
+        return;
+    }
+
+    // A new server process (e.g. after the last one died) or renderer knows
+    // nothing of the settings or cameras.
+    bool restarted = false;
+    for (size_t i = 0; i < numWorkers; i++)
+    {
+        if (not clients[i]) {
+            clients[i].reset(new HdNukeRenderClient);
+        }
+        HdNukeRenderClient& client = *clients[i];
+        options.cpus = workerCpus[i];
+        client.SetTimeout(_renderServerTimeout);
+        client.SetInterruptCallback([this]() { return renderInterrupted(); });
+
+        const bool wasRunning = client.IsRunning();
+        bool rendererChanged = false;
+        if (not client.Start(options)
+                or not client.SetRenderer(TfToken(_rendererId), &rendererChanged)) {
+            error("%s", client.GetError().c_str());
             return;
         }
+        restarted = restarted or not wasRunning or rendererChanged;
+    }
+    if (restarted) {
+        node->_remoteViews.clear();
+        node->_tiledImages.clear();
+        node->_needDelegateKnobSync = true;
+        node->_syncAllDelegateKnobs = true;
     }
 
-    if (f.makeKnobs()) {
-        auto settingsDescriptors = renderDelegate()->GetRenderSettingDescriptors();
-        _delegateKnobNames.clear();
-        _delegateKnobNames.reserve(settingsDescriptors.size());
-        _delegateSettings.clear();
-        _delegateSettings.reserve(settingsDescriptors.size());
-
-        for (const auto& setting : settingsDescriptors)
+    if (node->_needForceUpdate.exchange(false)) {
+        node->discardPrefetch();
+        node->_sceneData->Clear();
+        node->_remoteViews.clear();
+        node->_tiledImages.clear();
+        for (auto& client : clients)
         {
-            std::string knobName = setting.key.GetString();
-            std::replace(knobName.begin(), knobName.end(), ' ', '_');
-            knobName = RENDERER_KNOB_PREFIX + knobName;
-            _delegateKnobNames.push_back(knobName);
-            _delegateSettings.emplace(knobName, setting);
+            if (not client->ClearScene()) {
+                error("%s", client->GetError().c_str());
+                return;
+            }
         }
     }
-
-    for (const auto& knobName : _delegateKnobNames)
-    {
-        HdRenderSettingDescriptor setting = _delegateSettings[knobName];
+    node->_sceneData->SetDefaultDisplayColor(GfVec3f(_displayColor));
+    applyPrimvarOptions();
+
+    HdNukeRenderClient& client = *clients.front();
+    const int viewId = outputContext().view();
+    ViewState& view = node->_remoteViews[viewId];
+    RenderTimings timings;
+    const RenderPlan plan = planRender(view, timings);
+
+    if (plan.needRender) {
+        // Collects the settings into _pendingRemoteSettings.
+        syncRenderDelegateSettings();
+        applyRenderProfile(plan.interactive);
+        for (auto& worker : clients)
+        {
+            if (not worker->SetSettings(node->_pendingRemoteSettings)) {
+                node->_pendingRemoteSettings.clear();
+                error("%s", worker->GetError().c_str());
+                return;
+            }
+        }
+        node->_pendingRemoteSettings.clear();
+
+        // In tiled mode, the workers' cameras are set for each tile.
+        if (not tiled and (not view.cameraSet or view.viewport != plan.viewport
+                           or view.viewMatrix != _viewMatrix
+                           or view.projectionMatrix != _projectionMatrix)) {
+            if (not client.SetCamera(viewId, plan.viewport, _viewMatrix,
+                                     _projectionMatrix)) {
+                error("%s", client.GetError().c_str());
+                return;
+            }
+            view.viewMatrix = _viewMatrix;
+            view.projectionMatrix = _projectionMatrix;
+            view.cameraSet = true;
+        }
+        view.viewport = plan.viewport;
+
+        // Only the converted scene data is kept in this process; the servers
+        // are sent what changed in it.
+        const Clock::time_point syncStart = Clock::now();
+        if (GeoOp* geoOp = op_cast<GeoOp*>(Op::input(0))) {
+            if (not syncStagedScene(geoOp, timings)) {
+                node->_sceneData->Update(geoOp);
+            }
+        }
+        else {
+            node->discardPrefetch();
+            node->_sceneData->Clear();
+        }
+        if (Op::input(2) != nullptr) {
+            warning("The Hydra scene input is not rendered out of process");
+        }
+        // The scene data is only read while the workers are synced.
+        std::vector<std::future<bool>> syncs;
+        for (auto& worker : clients)
+        {
+            HdNukeRenderClient* workerPtr = worker.get();
+            const HdNukeSceneData* sceneData = node->_sceneData.get();
+            syncs.push_back(std::async(std::launch::async, [workerPtr, sceneData]() {
+                return workerPtr->SyncScene(*sceneData);
+            }));
+        }
+        bool synced = true;
+        for (auto& sync : syncs)
+        {
+            synced = sync.get() and synced;
+        }
+        if (not synced) {
+            if (renderInterrupted()) {
+                return;
+            }
+            for (auto& worker : clients)
+            {
+                if (not worker->GetError().empty()) {
+                    error("%s", worker->GetError().c_str());
+                    break;
+                }
+            }
+            return;
+        }
+        timings.sync = _SecondsSince(syncStart);
+
+        if (_batchMode and not plan.continueSlice) {
+            startPrefetch();
+        }
+
+        view.renderComplete = false;
+        if (not plan.continueSlice) {
+            view.renderHash = Hash();
+            view.sliced = false;
+            view.renderTime = 0;
+            view.iterations = 0;
+        }
+        if (tiled) {
+            // The workers' first view is used for the tiles.
+            auto firstView = node->_remoteViews.find(0);
+            if (firstView != node->_remoteViews.end()) {
+                firstView->second.cameraSet = false;
+            }
+            if (not renderTiles(plan, timings)) {
+                return;
+            }
+        }
+        else {
+            if (not plan.continueSlice) {
+                _convergenceEstimator.Reset();
+            }
+            timings.iterations = view.iterations;
+
+            HdNukeRenderLoop loop;
+            configureRenderLoop(loop, &view);
+            loop.execute = [&](bool* converged) {
+                if (not client.Execute(viewId, converged)) {
+                    return false;
+                }
+                view.iterations = ++timings.iterations;
+                return true;
+            };
+            loop.afterPass = [&](bool converged) {
+                if (_convergenceThreshold <= 0 or converged) {
+                    return false;
+                }
+                const float* color = nullptr;
+                const float* depth = nullptr;
+                int width = 0;
+                int height = 0;
+                return client.Resolve(viewId, static_cast<int>(plan.viewport[2]),
+                                      static_cast<int>(plan.viewport[3]),
+                                      &color, &depth, &width, &height)
+                    and _convergenceEstimator.Update(
+                        color, width, height,
+                        static_cast<float>(_convergenceThreshold));
+            };
+            loop.pause = [&]() { client.Pause(); };
+
+            const HdNukeRenderLoop::Result result = loop.Run();
+            const bool pause = finishRenderLoop(loop, result, plan, view,
+                                                timings);
+            if (result == HdNukeRenderLoop::Interrupted) {
+                return;
+            }
+            if (result == HdNukeRenderLoop::Failed) {
+                error("%s", client.GetError().c_str());
+                return;
+            }
+            if (pause) {
+                client.Pause();
+            }
+        }
+        if (timings.downscale > 1 or plan.interactive) {
+            timings.complete = false;
+        }
+
+        view.renderHash = hash();
+        view.renderComplete = timings.complete;
+        view.fullQuality = timings.downscale == 1 and not plan.interactive;
+        view.productsPath.clear();
+    }
+
+    if (aborted()) {
+        return;
+    }
+
+    const ChannelSet channels = plane.channels();
+    if (not (channels & Mask_RGBA) and not (channels & Mask_Z)) {
+        error("Unknown ChanneSet requested in renderStripe");
+        return;
+    }
+
+    const Clock::time_point copyStart = Clock::now();
+    const float* color = nullptr;
+    const float* depth = nullptr;
+    int width = 0;
+    int height = 0;
+    if (tiled) {
+        const RenderedImage& image = node->_tiledImages[viewId];
+        color = image.color.data();
+        depth = image.depth.data();
+        width = image.width;
+        height = image.height;
+    }
+    else if (not client.Resolve(viewId, static_cast<int>(view.viewport[2]),
+                                static_cast<int>(view.viewport[3]),
+                                &color, &depth, &width, &height)) {
+        error("%s", client.GetError().c_str());
+        return;
+    }
+    if (width <= 0 or height <= 0) {
+        error("No image has been rendered for this view");
+        return;
+    }
+
+    const std::string productsPath = renderProductsPath(view);
+    if (not productsPath.empty()) {
+        std::vector<HdNukeExrPart> parts;
+        for (const TfToken& aov : renderProductAovs())
+        {
+            const bool isColor = aov == HdAovTokens->color;
+            if (not isColor and aov != HdAovTokens->depth) {
+                warning("Only color and depth are written when rendering out "
+                        "of process");
+                continue;
+            }
+            HdNukeExrPart part;
+            part.name = _GetProductPartName(aov);
+            _DeinterleaveFloats(isColor ? color : depth, width, height,
+                                _GetProductChannelNames(aov, isColor ? 4 : 1),
+                                &part.image);
+            parts.push_back(std::move(part));
+        }
+        writeRenderProducts(view, productsPath, std::move(parts));
+    }
+    plane.makeWritable();
+    if (renderProductsOnly()) {
+        foreach(z, channels) {
+            plane.fillChannel(z, 0.0f);
+        }
+        if (plan.needRender) {
+            setRenderStats(timings);
+        }
+        finishRender(plan, view);
+        return;
+    }
+    if (channels & Mask_RGBA) {
+        copyFloatsToImagePlane(color, width, height, 4, plane);
+    }
+    else {
+        copyFloatsToImagePlane(depth, width, height, 1, plane);
+    }
+    timings.copy = _SecondsSince(copyStart);
+
+    if (_useRenderCache and view.renderComplete
+            and not node->_renderCache.Contains(cacheKey)) {
+        node->storeCachedRender(cacheKey, plane);
+    }
+
+    if (plan.needRender) {
+        setRenderStats(timings);
+    }
+    finishRender(plan, view);
+}
+
+bool
+HydraRender::renderWedges(const RenderPlan& plan, RenderTimings& timings)
+{
+    HydraRender* node = nodeOp();
+    const Clock::time_point wedgesStart = Clock::now();
+    std::vector<HdNukeWedgeVariant> variants =
+        HdNukeParseWedges(_wedges ? _wedges : "");
+    variants.resize(std::min(variants.size(), MAX_WEDGES));
+
+    WedgeImages& wedgeImages = node->_wedgeImages[outputContext().view()];
+    wedgeImages.hash = Hash();
+    wedgeImages.images.assign(variants.size(), RenderedImage());
+
+    HdRenderDelegate* renderDelegate = renderStack()->GetRenderDelegate();
+    HdNukeSceneDelegate* delegate = sceneDelegate();
+    auto tasks = taskController()->GetRenderingTasks();
+
+    for (size_t i = 0; i < variants.size(); i++)
+    {
+        // Only what the variant overrides is changed (and dirtied), and put
+        // back once it has rendered.
+        std::vector<std::pair<TfToken, VtValue>> previousSettings;
+        for (const HdNukeWedgeOverride& wedgeOverride : variants[i])
+        {
+            if (wedgeOverride.kind == HdNukeWedgeOverride::Setting) {
+                std::pair<TfToken, VtValue> setting;
+                if (resolveRenderSetting(wedgeOverride.name, wedgeOverride.value,
+                                         "wedge setting", &setting)) {
+                    previousSettings.emplace_back(
+                        setting.first,
+                        renderDelegate->GetRenderSetting(setting.first));
+                    renderDelegate->SetRenderSetting(setting.first,
+                                                     setting.second);
+                }
+            }
+            else if (wedgeOverride.kind == HdNukeWedgeOverride::Light) {
+                const SdfPath lightId = delegate->FindLightId(wedgeOverride.name);
+                const VtValue current = lightId.IsEmpty()
+                    ? VtValue()
+                    : delegate->GetLightParamValue(lightId, wedgeOverride.param);
+                VtValue value;
+                if (current.IsEmpty()) {
+                    TF_WARN("[HydraRender] Unknown wedge light parameter "
+                            "\"%s %s\"", wedgeOverride.name.c_str(),
+                            wedgeOverride.param.GetText());
+                }
+                else if (not _ParseSettingValue(current, wedgeOverride.value,
+                                                &value)) {
+                    TF_WARN("[HydraRender] Invalid value for wedge light "
+                            "parameter \"%s %s\": %s",
+                            wedgeOverride.name.c_str(),
+                            wedgeOverride.param.GetText(),
+                            wedgeOverride.value.c_str());
+                }
+                else {
+                    delegate->SetLightParamOverride(lightId, wedgeOverride.param,
+                                                    value);
+                }
+            }
+            else {
+                VtValue value;
+                if (_ParseSettingValue(VtValue(GfVec3f()), wedgeOverride.value,
+                                       &value)) {
+                    delegate->SetDisplayColorOverride(
+                        value.UncheckedGet<GfVec3f>());
+                }
+            }
+        }
+
+        auto restore = [&]() {
+            for (auto it = previousSettings.rbegin();
+                 it != previousSettings.rend(); it++)
+            {
+                renderDelegate->SetRenderSetting(it->first, it->second);
+            }
+            delegate->ClearLightParamOverrides();
+            delegate->ClearDisplayColorOverride();
+        };
+
+        HdNukeRenderLoop loop;
+        configureRenderLoop(loop, nullptr);
+        loop.execute = [&](bool* converged) {
+            _engine.Execute(renderStack()->renderIndex, &tasks);
+            *converged = taskController()->IsConverged();
+            return true;
+        };
+        loop.pause = [&]() {
+            restore();
+            renderStack()->PauseRendering();
+        };
+        if (loop.Run() == HdNukeRenderLoop::Interrupted) {
+            return false;
+        }
+
+        HdRenderBuffer* colorBuffer = taskController()->GetRenderOutput(
+            HdAovTokens->color);
+        HdNukeExrImage color;
+        if (colorBuffer != nullptr) {
+            colorBuffer->Resolve();
+        }
+        if (colorBuffer != nullptr and HdNukeRenderBufferToExrImage(
+                colorBuffer, {"R", "G", "B", "A"}, &color)) {
+            RenderedImage& image = wedgeImages.images[i];
+            image.width = color.width;
+            image.height = color.height;
+            const size_t numPixels = static_cast<size_t>(color.width)
+                                     * color.height;
+            image.color.resize(numPixels * 4);
+            for (size_t c = 0; c < 4; c++)
+            {
+                const float* src = color.Channel(c);
+                for (size_t p = 0; p < numPixels; p++)
+                {
+                    image.color[p * 4 + c] = src[p];
+                }
+            }
+        }
+        restore();
+    }
+
+    wedgeImages.hash = hash();
+    timings.wedges = _SecondsSince(wedgesStart);
+    return true;
+}
+
+int
+HydraRender::wedgeIndex(const ChannelSet& channels) const
+{
+    const size_t numWedges = std::min(
+        HdNukeParseWedges(_wedges ? _wedges : "").size(), MAX_WEDGES);
+    for (size_t i = 0; i < numWedges; i++)
+    {
+        if (channels & _GetWedgeChannels(i)) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+bool
+HydraRender::renderTiles(const RenderPlan& plan, RenderTimings& timings)
+{
+    HydraRender* node = nodeOp();
+    const int width = static_cast<int>(plan.viewport[2]);
+    const int height = static_cast<int>(plan.viewport[3]);
+    const size_t numPixels = static_cast<size_t>(width) * height;
+
+    RenderedImage& image = node->_tiledImages[outputContext().view()];
+    image.width = width;
+    image.height = height;
+    image.color.assign(numPixels * 4, 0.0f);
+    image.depth.assign(numPixels, 0.0f);
+
+    const std::vector<HdNukeTile> tiles = HdNukeSplitIntoTiles(width, height,
+                                                            _renderTiles);
+    const Clock::time_point renderStart = Clock::now();
+    const double timeBudget = renderTimeBudget();
+    const int maxIterations = _maxIterations;
+    const float threshold = static_cast<float>(_convergenceThreshold);
+
+    std::atomic<size_t> nextTile(0);
+    std::atomic<int> iterations(0);
+    std::atomic<bool> stopped(false);
+    std::atomic<bool> timeLimited(false);
+    std::atomic<bool> iterationLimited(false);
+    std::mutex errorMutex;
+    std::string errorMessage;
+
+    // Each worker takes the next tile as soon as it is done with the last,
+    // so faster workers (or simpler parts of the image) take more of them.
+    auto renderWorker = [&](HdNukeRenderClient* client) {
+        HdNukeConvergenceEstimator estimator;
+        for (size_t t = nextTile++; t < tiles.size(); t = nextTile++)
+        {
+            const HdNukeTile& tile = tiles[t];
+            const int tileWidth = tile.x1 - tile.x0;
+            const int tileHeight = tile.y1 - tile.y0;
+
+            bool ok = client->SetCamera(
+                0, GfVec4d(0, 0, tileWidth, tileHeight), _viewMatrix,
+                HdNukeTileProjection(_projectionMatrix, tile, width, height));
+            estimator.Reset();
+
+            const float* color = nullptr;
+            const float* depth = nullptr;
+            int bufferWidth = 0;
+            int bufferHeight = 0;
+            bool converged = false;
+            int tileIterations = 0;
+            while (ok and not converged) {
+                if (stopped or renderInterrupted()) {
+                    stopped = true;
+                    client->Pause();
+                    return;
+                }
+                if (maxIterations > 0 and tileIterations >= maxIterations) {
+                    iterationLimited = true;
+                    break;
+                }
+                if (timeBudget > 0 and tileIterations > 0
+                        and _SecondsSince(renderStart) >= timeBudget) {
+                    timeLimited = true;
+                    break;
+                }
+                ok = client->Execute(0, &converged);
+                tileIterations++;
+
+                if (ok and threshold > 0 and not converged) {
+                    ok = client->Resolve(0, tileWidth, tileHeight, &color,
+                                         &depth, &bufferWidth, &bufferHeight);
+                    if (ok and estimator.Update(color, bufferWidth,
+                                                bufferHeight, threshold)) {
+                        break;
+                    }
+                }
+            }
+            iterations += tileIterations;
+
+            if (ok and not converged) {
+                ok = client->Pause();
+            }
+            ok = ok and client->Resolve(0, tileWidth, tileHeight, &color,
+                                        &depth, &bufferWidth, &bufferHeight);
+            if (not ok or bufferWidth != tileWidth
+                    or bufferHeight != tileHeight) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (errorMessage.empty()) {
+                    errorMessage = ok ? "Unexpected tile size from render server"
+                                      : client->GetError();
+                }
+                stopped = true;
+                return;
+            }
+
+            for (int y = 0; y < tileHeight; y++)
+            {
+                const size_t srcRow = static_cast<size_t>(y) * tileWidth;
+                const size_t destRow = static_cast<size_t>(tile.y0 + y) * width
+                                       + tile.x0;
+                std::copy(color + srcRow * 4, color + (srcRow + tileWidth) * 4,
+                          image.color.begin() + destRow * 4);
+                std::copy(depth + srcRow, depth + srcRow + tileWidth,
+                          image.depth.begin() + destRow);
+            }
+        }
+    };
+
+    std::vector<std::future<void>> workers;
+    for (auto& client : node->_renderClients)
+    {
+        workers.push_back(std::async(std::launch::async, renderWorker,
+                                     client.get()));
+    }
+    for (auto& worker : workers)
+    {
+        worker.wait();
+    }
+
+    timings.iterations = iterations;
+    timings.render = _SecondsSince(renderStart);
+    if (not errorMessage.empty()) {
+        error("%s", errorMessage.c_str());
+        return false;
+    }
+    if (stopped) {
+        return false;
+    }
+    timings.setStopReason(timeLimited ? HdNukeRenderLoop::TimeLimit
+                          : iterationLimited ? HdNukeRenderLoop::IterationLimit
+                          : HdNukeRenderLoop::Converged);
+    return true;
+}
+
+HydraRender::RenderPlan
+HydraRender::planRender(const ViewState& view, RenderTimings& timings) const
+{
+    const HydraRender* node = nodeOp();
+    RenderPlan plan;
+    const bool changed = view.renderHash != hash();
+
+    if (not changed and view.sliced) {
+        plan = view.slicedPlan;
+        plan.continueSlice = true;
+        timings.downscale = 1 << (LADDER_LEVELS - 1 - plan.ladderLevel);
+        return plan;
+    }
+
+    // The ladder's next level renders the same image (and hash) as the last
+    // one, so it is picked up from the node's state.
+    const bool continueLadder = not changed and _resolutionLadder
+                                and Application::gui
+                                and node->_ladderLevel >= 0
+                                and node->_ladderLevel < LADDER_LEVELS - 1;
+    // Likewise for the final render after an interactive one.
+    const bool finalPending = not changed and node->_finalProfileRequested
+                              and node->_interactiveHash == hash();
+    plan.needRender = changed or continueLadder or finalPending;
+
+    // Interactive overrides are used until the idle timer asks for the final
+    // render.
+    if (plan.needRender and Application::gui and not _batchMode
+            and _interactiveSettings and *_interactiveSettings) {
+        plan.finalProfilePass = finalPending;
+        plan.interactive = not plan.finalProfilePass;
+    }
+
+    // A changed image starts the ladder over.
+    plan.useLadder = plan.needRender and _resolutionLadder and Application::gui
+                     and not plan.finalProfilePass;
+    plan.ladderLevel = LADDER_LEVELS - 1;
+    if (plan.useLadder) {
+        plan.ladderLevel = continueLadder ? node->_ladderLevel + 1 : 0;
+    }
+
+    timings.downscale = 1 << (LADDER_LEVELS - 1 - plan.ladderLevel);
+    plan.viewport = GfVec4d(
+        0, 0,
+        std::max(1.0, std::ceil(_viewport[2] / timings.downscale)),
+        std::max(1.0, std::ceil(_viewport[3] / timings.downscale)));
+    return plan;
+}
+
+void
+HydraRender::configureRenderLoop(HdNukeRenderLoop& loop,
+                                 const ViewState* view)
+{
+    loop.maxIterations = _maxIterations;
+    loop.timeBudget = renderTimeBudget();
+    if (view != nullptr) {
+        loop.startIteration = view->resumeIterations + view->iterations;
+        loop.startTime = view->renderTime;
+        loop.sliceTime = renderSliceTime();
+    }
+    // Checked between iterations, so a new request (or a knob change that
+    // needs the render stack) doesn't have to wait for the current image to
+    // converge.
+    loop.interrupted = [this]() { return renderInterrupted(); };
+}
+
+bool
+HydraRender::finishRenderLoop(const HdNukeRenderLoop& loop,
+                              HdNukeRenderLoop::Result result,
+                              const RenderPlan& plan, ViewState& view,
+                              RenderTimings& timings) const
+{
+    view.renderTime += loop.GetElapsed();
+    timings.render = view.renderTime;
+    if (result == HdNukeRenderLoop::Interrupted
+            or result == HdNukeRenderLoop::Failed) {
+        return false;
+    }
+
+    // A sliced render is left refining the image until the next update
+    // continues it.
+    view.sliced = result == HdNukeRenderLoop::Sliced;
+    if (view.sliced) {
+        view.slicedPlan = plan;
+    }
+    return timings.setStopReason(result);
+}
+
+bool
+HydraRender::RenderTimings::setStopReason(HdNukeRenderLoop::Result result)
+{
+    switch (result) {
+        case HdNukeRenderLoop::Finished:
+            stopReason = "converged tiles";
+            return true;
+        case HdNukeRenderLoop::IterationLimit:
+            stopReason = "iteration limit";
+            return true;
+        case HdNukeRenderLoop::TimeLimit:
+            stopReason = "time limit";
+            complete = false;
+            return true;
+        case HdNukeRenderLoop::Sliced:
+            stopReason = "continuing";
+            complete = false;
+            return false;
+        default:
+            return false;
+    }
+}
+
+void
+HydraRender::finishRender(const RenderPlan& plan, const ViewState& view)
+{
+    if (view.sliced) {
+        // Have the viewer ask for the image again, to continue the render.
+        // The ladder and profile move on once it stops.
+        asapUpdate();
+        return;
+    }
+
+    HydraRender* node = nodeOp();
+    node->_ladderLevel = plan.useLadder ? plan.ladderLevel : -1;
+    if (plan.useLadder and plan.ladderLevel < LADDER_LEVELS - 1) {
+        // Have the viewer ask for the image again, for the next level.
+        asapUpdate();
+    }
+
+    if (plan.finalProfilePass) {
+        node->_finalProfileRequested = false;
+    }
+    else if (plan.interactive) {
+        // Each interactive render restarts the timer.
+        node->_finalProfileRequested = false;
+        node->_interactiveHash = hash();
+        node->_idleTimer.Schedule(std::max(_idleTimeout, 0.0), [node]() {
+            node->_finalProfileRequested = true;
+            node->_needAsapUpdate = true;
+        });
+    }
+}
+
+bool
+HydraRender::syncStagedScene(GeoOp* geoOp, RenderTimings& timings)
+{
+    HydraRender* node = nodeOp();
+    if (not node->_prefetch.valid()) {
+        return false;
+    }
+
+    const Clock::time_point waitStart = Clock::now();
+    timings.prefetch = node->_prefetch.get();
+    timings.prefetchWait = _SecondsSince(waitStart);
+
+    std::unique_ptr<HdNukeStagedScene> staged = std::move(node->_stagedScene);
+    if (not staged or staged->hash != HdNukeSceneData::ComputeSceneHash(geoOp)) {
+        // Not the frame (or state) that was prefetched.
+        return false;
+    }
+
+    node->_sceneData->Update(*staged);
+    if (not _useRenderServer) {
+        sceneDelegate()->SyncSceneData();
+    }
+    node->_convertedStagedScene = std::move(staged);
+    return true;
+}
+
+void
+HydraRender::startPrefetch()
+{
+    HydraRender* node = nodeOp();
+    node->discardPrefetch();
+
+    OutputContext nextContext(outputContext());
+    nextContext.setFrame(nextContext.frame() + 1);
+    GeoOp* nextGeoOp = op_cast<GeoOp*>(node_input(0, Op::INPUT_OP, &nextContext));
+    if (nextGeoOp == nullptr) {
+        return;
+    }
+
+    // Ops may only be validated and built on a Nuke thread, so only the
+    // conversion of the built geometry runs alongside the render.
+    const Clock::time_point start = Clock::now();
+    nextGeoOp->validate(true);
+    HdNukeStagedScene* staged = new HdNukeStagedScene;
+    node->_stagedScene.reset(staged);
+    staged->Build(nextGeoOp, *node->_sceneData);
+    const double buildTime = _SecondsSince(start);
+
+    node->_prefetch = std::async(std::launch::async, [staged, buildTime]() {
+        const Clock::time_point start = Clock::now();
+        staged->Convert();
+        return buildTime + _SecondsSince(start);
+    });
+}
+
+void
+HydraRender::discardPrefetch()
+{
+    if (_prefetch.valid()) {
+        _prefetch.wait();
+        _prefetch = std::future<double>();
+    }
+    _stagedScene.reset();
+}
+
+void
+HydraRender::initRenderer(const std::string& delegateId)
+{
+    if (_hydra and delegateId == _activeRenderer) {
+        return;
+    }
+
+    bool created = false;
+    _hydra = _stackCache.Acquire(TfToken(delegateId), &created);
+    _activeRenderer = delegateId;
+    _views.clear();
+    _hydraSynced = false;
+    if (_hydra == nullptr) {
+        return;
+    }
+
+    sceneDelegate()->SetDefaultDisplayColor(GfVec3f(_displayColor));
+
+    _needDelegateKnobSync = true;
+    if (not created) {
+        _syncAllDelegateKnobs = true;
+    }
+}
+
+HdxTaskController*
+HydraRender::taskController() const
+{
+    bool created = false;
+    HdxTaskController* controller = renderStack()->GetTaskController(
+        outputContext().view(), &created);
+    if (created) {
+        configureTaskController(controller);
+    }
+    return controller;
+}
+
+void
+HydraRender::configureTaskController(HdxTaskController* controller) const
+{
+    controller->SetEnableSelection(false);
+
+    HdxRenderTaskParams renderTaskParams;
+    renderTaskParams.enableLighting = true;
+    renderTaskParams.enableSceneMaterials = true;
+    controller->SetRenderParams(renderTaskParams);
+
+    // To disable viewport rendering
+    controller->SetViewportRenderOutput(TfToken());
+
+    TfTokenVector renderTags;
+    renderTags.push_back(HdRenderTagTokens->geometry);
+    renderTags.push_back(HdRenderTagTokens->render);
+    controller->SetRenderTags(renderTags);
+}
+
+void
+HydraRender::renderDelegateKnobCallback(Knob_Callback f)
+{
+    std::unique_lock<std::recursive_mutex> renderLock(_renderMutex, std::defer_lock);
+    if (f.makeKnobs()) {
+        renderLock.lock();
+
+        HdRenderDelegate* activeDelegate = nullptr;
+        if (_hydra != nullptr and _activeRenderer == _rendererId) {
+            activeDelegate = _hydra->GetRenderDelegate();
+        }
+        const auto& settingsDescriptors =
+            _GetRenderSettingDescriptors(TfToken(_rendererId), activeDelegate);
+        _delegateKnobNames.clear();
+        _delegateKnobNames.reserve(settingsDescriptors.size());
+        _delegateSettings.clear();
+        _delegateSettings.reserve(settingsDescriptors.size());
+
+        for (const auto& setting : settingsDescriptors)
+        {
+            std::string knobName = setting.key.GetString();
+            std::replace(knobName.begin(), knobName.end(), ' ', '_');
+            knobName = RENDERER_KNOB_PREFIX + knobName;
+            _delegateKnobNames.push_back(knobName);
+            _delegateSettings.emplace(knobName, setting);
+        }
+    }
+
+    for (const auto& knobName : _delegateKnobNames)
+    {
+        HdRenderSettingDescriptor setting = _delegateSettings[knobName];
         VtValueKnob(f, knobName, setting.name, setting.defaultValue);
         SetFlags(f, Knob::STARTLINE);
     }
 }
 
+void
+HydraRender::applyRendererCacheLimits()
+{
+    _stackCache.SetCapacity(static_cast<size_t>(_rendererCacheSize));
+    _stackCache.SetMemoryLimit(
+        static_cast<size_t>(std::max(_rendererCacheMemory, 0)) << 20);
+    _stackCache.Trim();
+}
+
+void
+HydraRender::applyPrimvarOptions()
+{
+    std::string allow = _primvarAllow;
+    std::string deny = _primvarDeny;
+    if (TfStringTrim(allow).empty() and TfStringTrim(deny).empty()) {
+        _GetDefaultPrimvarFilter(_rendererId, allow, deny);
+    }
+
+    HydraRender* node = nodeOp();
+    node->_sceneData->SetLazyPrimvars(_lazyPrimvars);
+    node->_sceneData->SetPrimvarFilter(allow, deny);
+    node->_sceneData->SetPrimvarPrecision(
+        static_cast<HdNukePrimvarPrecision>(_primvarPrecision),
+        _reducedPrecisionPrimvars);
+}
+
+void
+HydraRender::applyRenderProfile(bool interactive)
+{
+    HydraRender* node = nodeOp();
+    if (interactive) {
+        for (const auto& setting : interactiveOverrides())
+        {
+            setRenderSetting(setting.first, setting.second);
+        }
+        node->_interactiveProfileApplied = true;
+    }
+    else if (node->_interactiveProfileApplied) {
+        node->_needDelegateKnobSync = true;
+        node->_syncAllDelegateKnobs = true;
+        syncRenderDelegateSettings();
+        node->_interactiveProfileApplied = false;
+    }
+}
+
+std::vector<std::pair<TfToken, VtValue>>
+HydraRender::interactiveOverrides() const
+{
+    std::vector<std::pair<TfToken, VtValue>> overrides;
+
+    std::istringstream lines(_interactiveSettings ? _interactiveSettings : "");
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        line = TfStringTrim(line);
+        if (line.empty() or line[0] == '#') {
+            continue;
+        }
+        const size_t split = line.find_first_of(" \t=");
+        if (split == std::string::npos) {
+            TF_WARN("[HydraRender] No value for interactive setting \"%s\"",
+                    line.c_str());
+            continue;
+        }
+        const std::string name = line.substr(0, split);
+        const std::string valueText = TfStringTrim(line.substr(split + 1),
+                                                   " \t=");
+
+        std::pair<TfToken, VtValue> setting;
+        if (resolveRenderSetting(name, valueText, "interactive setting",
+                                 &setting)) {
+            overrides.push_back(setting);
+        }
+    }
+    return overrides;
+}
+
+bool
+HydraRender::resolveRenderSetting(const std::string& name,
+                                  const std::string& valueText,
+                                  const char* context,
+                                  std::pair<TfToken, VtValue>* setting) const
+{
+    const HydraRender* node = nodeOp();
+    auto it = node->_delegateSettings.find(RENDERER_KNOB_PREFIX + name);
+    if (it == node->_delegateSettings.end()) {
+        for (it = node->_delegateSettings.begin();
+             it != node->_delegateSettings.end(); it++)
+        {
+            if (it->second.key == name) {
+                break;
+            }
+        }
+    }
+    if (it == node->_delegateSettings.end()) {
+        TF_WARN("[HydraRender] Unknown %s \"%s\"", context, name.c_str());
+        return false;
+    }
+
+    VtValue value;
+    if (not _ParseSettingValue(it->second.defaultValue, valueText, &value)) {
+        TF_WARN("[HydraRender] Invalid value for %s \"%s\": %s", context,
+                name.c_str(), valueText.c_str());
+        return false;
+    }
+    *setting = std::make_pair(it->second.key, value);
+    return true;
+}
+
+std::unique_lock<std::recursive_mutex>
+HydraRender::interruptRender()
+{
+    HydraRender* node = nodeOp();
+    node->_interruptRender = true;
+    std::unique_lock<std::recursive_mutex> renderLock(node->_renderMutex);
+    node->_interruptRender = false;
+    return renderLock;
+}
+
+bool
+HydraRender::renderInterrupted()
+{
+    return aborted() or nodeOp()->_interruptRender;
+}
+
+void
+HydraRender::syncRenderDelegateSettings()
+{
+    HydraRender* node = nodeOp();
+    if (not node->_needDelegateKnobSync or node->_renderDelegateKnobCount <= 0
+            or node->_renderDelegateKnobStartIndex <= 0) {
+        return;
+    }
+
+    const int lastIndex = node->_renderDelegateKnobStartIndex
+                          + node->_renderDelegateKnobCount;
+    for (int ki = node->_renderDelegateKnobStartIndex; ki <= lastIndex; ki++)
+    {
+        Knob* delegateKnob = node->knob(ki);
+        if (node->_syncAllDelegateKnobs or delegateKnob->not_default()) {
+            node->syncRenderDelegateSettingKnob(delegateKnob);
+        }
+    }
+    node->_needDelegateKnobSync = false;
+    node->_syncAllDelegateKnobs = false;
+}
+
+void
+HydraRender::setRenderSetting(const TfToken& key, const VtValue& value)
+{
+    if (_useRenderServer) {
+        nodeOp()->_pendingRemoteSettings.emplace_back(key, value);
+    }
+    else {
+        renderDelegate()->SetRenderSetting(key, value);
+    }
+}
+
 inline void
 HydraRender::syncRenderDelegateSettingKnob(Knob* k)
 {
+    const auto it = _delegateSettings.find(k->name());
+    if (it == _delegateSettings.end()) {
+        return;
+    }
     VtValue newValue = KnobToVtValue(k);
     if (not newValue.IsEmpty()) {
-        const auto& setting = _delegateSettings[k->name()];
-        renderDelegate()->SetRenderSetting(setting.key, newValue);
+        setRenderSetting(it->second.key, newValue);
+    }
+}
+
+std::string
+HydraRender::renderCacheKey(const ChannelSet& channels) const
+{
+    // Everything that goes into the image is hashed explicitly, rather than
+    // trusting the op hash to cover it, so knobs that don't change the image
+    // don't invalidate the cache. Render limits are left out, so checkpoints
+    // can resume with a larger budget. Bump the version whenever the image
+    // of a given key would change.
+    static const int CACHE_KEY_VERSION = 2;
+
+    Hash keyHash;
+    keyHash.append(CACHE_KEY_VERSION);
+
+    if (GeoOp* geoOp = op_cast<GeoOp*>(Op::input(0))) {
+        keyHash.append(HdNukeSceneData::ComputeSceneHash(geoOp));
+    }
+    if (Op* cameraOp = Op::input(1)) {
+        keyHash.append(cameraOp->hash());
+    }
+    if (Op* hydraOp = Op::input(2)) {
+        keyHash.append(hydraOp->hash());
+    }
+    keyHash.append(_viewMatrix.GetArray(), sizeof(double) * 16);
+    keyHash.append(_projectionMatrix.GetArray(), sizeof(double) * 16);
+
+    const Format& fmt = format();
+    keyHash.append(fmt.width());
+    keyHash.append(fmt.height());
+    keyHash.append(fmt.pixel_aspect());
+    keyHash.append(outputContext().view());
+    foreach(z, channels) {
+        keyHash.append(getName(z));
+    }
+
+    keyHash.append(_rendererId.c_str());
+    // In name order, as the settings map is unordered.
+    std::map<std::string, std::string> settings;
+    for (const auto& entry : _delegateSettings)
+    {
+        if (Knob* k = knob(entry.first.c_str())) {
+            settings[entry.first] = TfStringify(KnobToVtValue(k));
+        }
+    }
+    for (const auto& setting : settings)
+    {
+        keyHash.append(setting.first.c_str());
+        keyHash.append(setting.second.c_str());
+    }
+
+    for (float component : _displayColor)
+    {
+        keyHash.append(component);
+    }
+    keyHash.append(_primvarAllow.c_str());
+    keyHash.append(_primvarDeny.c_str());
+    keyHash.append(_primvarPrecision);
+    keyHash.append(_reducedPrecisionPrimvars.c_str());
+
+    return TfStringPrintf("%s_%016llx", CLASS,
+                          static_cast<unsigned long long>(keyHash.value()));
+}
+
+bool
+HydraRender::loadCachedRender(const std::string& key, ImagePlane& plane)
+{
+    HdNukeExrImage image;
+    if (not _renderCache.Load(key, &image)) {
+        return false;
+    }
+
+    return copyExrImageToImagePlane(image, plane);
+}
+
+bool
+HydraRender::copyExrImageToImagePlane(const HdNukeExrImage& image,
+                                      ImagePlane& plane)
+{
+    const Box& bounds = plane.bounds();
+    if (image.width != bounds.w() or image.height != bounds.h()) {
+        return false;
+    }
+
+    std::vector<int> imageChannels;
+    foreach(z, plane.channels()) {
+        const int c = image.FindChannel(getName(z));
+        if (c < 0) {
+            return false;
+        }
+        imageChannels.push_back(c);
+    }
+
+    plane.makeWritable();
+    int chanNo = 0;
+    foreach(z, plane.channels()) {
+        const float* src = image.Channel(static_cast<size_t>(imageChannels[chanNo]));
+        for (int y = 0; y < image.height; y++)
+        {
+            for (int x = 0; x < image.width; x++)
+            {
+                plane.writableAt(bounds.x() + x, bounds.y() + y, chanNo) = *src++;
+            }
+        }
+        chanNo++;
+    }
+    return true;
+}
+
+void
+HydraRender::storeCachedRender(const std::string& key, const ImagePlane& plane)
+{
+    const Box& bounds = plane.bounds();
+    std::vector<std::string> channelNames;
+    foreach(z, plane.channels()) {
+        channelNames.push_back(getName(z));
+    }
+
+    HdNukeExrImage image;
+    image.Resize(bounds.w(), bounds.h(), channelNames);
+    for (size_t chanNo = 0; chanNo < channelNames.size(); chanNo++)
+    {
+        float* dest = image.Channel(chanNo);
+        for (int y = 0; y < image.height; y++)
+        {
+            for (int x = 0; x < image.width; x++)
+            {
+                *dest++ = plane.at(bounds.x() + x, bounds.y() + y,
+                                   static_cast<int>(chanNo));
+            }
+        }
+    }
+    _renderCache.Store(key, image);
+}
+
+void
+HydraRender::loadCheckpoint(ViewState& view, const std::string& key,
+                            RenderTimings& timings)
+{
+    view.resumeImage.reset();
+    view.resumeIterations = 0;
+    view.iterations = 0;
+    if (key.empty()) {
+        return;
+    }
+
+    auto image = std::make_shared<HdNukeExrImage>();
+    int iterations = 0;
+    if (not nodeOp()->_checkpoints.Load(key, image.get(), &iterations)
+            or image->width != static_cast<int>(_viewport[2])
+            or image->height != static_cast<int>(_viewport[3])) {
+        return;
+    }
+    view.resumeImage = image;
+    view.resumeIterations = iterations;
+    timings.resumedIterations = iterations;
+}
+
+void
+HydraRender::storeCheckpoint(const ViewState& view, const std::string& key,
+                             bool wait)
+{
+    HdNukeExrImage image = checkpointImage(view);
+    if (image.pixels.empty()) {
+        return;
+    }
+    nodeOp()->_checkpoints.Store(key, std::move(image),
+                                 view.resumeIterations + view.iterations, wait);
+}
+
+HdNukeExrImage
+HydraRender::checkpointImage(const ViewState& view) const
+{
+    if (view.iterations == 0 and view.resumeImage) {
+        return *view.resumeImage;
+    }
+
+    HdRenderBuffer* colorBuffer = taskController()->GetRenderOutput(
+        HdAovTokens->color);
+    HdRenderBuffer* depthBuffer = taskController()->GetRenderOutput(
+        HdAovTokens->depth);
+    if (colorBuffer == nullptr or depthBuffer == nullptr) {
+        return HdNukeExrImage();
+    }
+    colorBuffer->Resolve();
+    depthBuffer->Resolve();
+
+    HdNukeExrImage image;
+    HdNukeExrImage depth;
+    if (not HdNukeRenderBufferToExrImage(
+                colorBuffer, {getName(Chan_Red), getName(Chan_Green),
+                              getName(Chan_Blue), getName(Chan_Alpha)}, &image)
+            or not HdNukeRenderBufferToExrImage(depthBuffer, {getName(Chan_Z)},
+                                                &depth)
+            or depth.width != image.width or depth.height != image.height) {
+        return HdNukeExrImage();
+    }
+    image.channelNames.push_back(getName(Chan_Z));
+    image.pixels.insert(image.pixels.end(), depth.pixels.begin(),
+                        depth.pixels.end());
+
+    // Depth isn't accumulated, and is taken from the latest pass.
+    if (view.resumeImage) {
+        HdNukeRenderCheckpoints::Blend(
+            &image, view.iterations, *view.resumeImage, view.resumeIterations,
+            {getName(Chan_Red), getName(Chan_Green), getName(Chan_Blue),
+             getName(Chan_Alpha)});
+    }
+    return image;
+}
+
+TfTokenVector
+HydraRender::renderProductAovs() const
+{
+    TfTokenVector aovs;
+    for (const auto& name : TfStringTokenize(_renderProductAovs))
+    {
+        const TfToken aov(name);
+        if (std::find(aovs.begin(), aovs.end(), aov) == aovs.end()) {
+            aovs.push_back(aov);
+        }
+    }
+    return aovs;
+}
+
+std::string
+HydraRender::renderProductsPath(const ViewState& view) const
+{
+    // Only images the render has stopped on for good. Every render clears
+    // the path it was written to, so a render that changes the image (e.g.
+    // one that is resumed) writes it again.
+    if (not _writeRenderProducts or not view.fullQuality or view.sliced
+            or not _renderProductsFile or not *_renderProductsFile) {
+        return std::string();
+    }
+
+    // The buffers can be reused for several frames, which all get a file.
+    const int frame = static_cast<int>(std::lround(outputContext().frame()));
+    const std::string path = _ExpandFrameNumber(_renderProductsFile, frame);
+    return path == view.productsPath ? std::string() : path;
+}
+
+bool
+HydraRender::renderProductsOnly() const
+{
+    return _writeRenderProducts and _renderProductsOnly and not Application::gui;
+}
+
+void
+HydraRender::writeRenderProducts(ViewState& view, const std::string& path,
+                                 std::vector<HdNukeExrPart>&& parts)
+{
+    HydraRender* node = nodeOp();
+    view.productsPath = path;
+
+    // Earlier frames are written in the background, so their errors only
+    // show up now.
+    const std::string errors = node->_productWriter.TakeErrors();
+    if (not errors.empty()) {
+        error("Could not write render products: %s", errors.c_str());
+    }
+    if (parts.empty()) {
+        return;
+    }
+    node->_productWriter.Write(path, std::move(parts));
+}
+
+double
+HydraRender::renderTimeBudget() const
+{
+    return std::max(_maxTime, 0.0);
+}
+
+double
+HydraRender::renderSliceTime() const
+{
+    if (_targetFrameRate > 0 and Application::gui) {
+        return 1.0 / _targetFrameRate;
+    }
+    return 0.0;
+}
+
+void
+HydraRender::setRenderStats(const RenderTimings& timings)
+{
+    std::ostringstream buf;
+    buf << std::fixed << std::setprecision(2);
+    if (timings.cacheHit) {
+        buf << "loaded from disk cache";
+    }
+    else {
+        if (timings.downscale > 1) {
+            buf << "1/" << timings.downscale << " res: ";
+        }
+        buf << timings.render << " s, " << timings.iterations
+            << (timings.iterations == 1 ? " iteration (" : " iterations (")
+            << timings.stopReason << "); sync " << timings.sync << " s, copy "
+            << timings.copy << " s";
+        if (timings.wedges > 0) {
+            buf << ", wedges " << timings.wedges << " s";
+        }
+        if (timings.resumedIterations > 0) {
+            buf << "; resumed from " << timings.resumedIterations
+                << " checkpointed iterations";
+        }
+        if (timings.prefetch > 0) {
+            buf << ", prefetch " << timings.prefetch << " s (waited "
+                << timings.prefetchWait << " s)";
+        }
+    }
+    if (not timings.cacheHit) {
+        size_t primvarBytes = 0;
+        size_t fullPrimvarBytes = 0;
+        nodeOp()->_sceneData->GetPrimvarMemoryUsage(primvarBytes,
+                                                    fullPrimvarBytes);
+        buf << "; primvars " << primvarBytes / (1024.0 * 1024.0) << " MB";
+        if (primvarBytes != fullPrimvarBytes) {
+            buf << " (" << fullPrimvarBytes / (1024.0 * 1024.0)
+                << " MB at full precision)";
+        }
+    }
+    if (_useRenderCache) {
+        const HdNukeRenderCache& cache = nodeOp()->_renderCache;
+        buf << "; cache " << cache.GetHits() << " hits, " << cache.GetMisses()
+            << " misses";
+    }
+    HydraRender* node = nodeOp();
+    {
+        std::lock_guard<std::mutex> lock(node->_renderStatsMutex);
+        node->_publishedRenderStats = buf.str();
+        node->_renderStatsChanged = true;
+    }
+
+    if (_batchMode) {
+        TF_STATUS("[HydraRender] %s frame %g: %s", node_name().c_str(),
+                  outputContext().frame(), buf.str().c_str());
     }
 }
 
 void
 HydraRender::copyBufferToImagePlane(HdRenderBuffer* buffer, ImagePlane& plane)
 {
+    const Box& bounds = plane.bounds();
+    if (static_cast<int>(buffer->GetWidth()) != bounds.w()
+            or static_cast<int>(buffer->GetHeight()) != bounds.h()) {
+        copyScaledBufferToImagePlane(buffer, plane);
+        return;
+    }
+
     const HdFormat bufferFormat = buffer->GetFormat();
     const size_t numComponents = HdGetComponentCount(bufferFormat);
 
@@ -604,6 +3042,103 @@ HydraRender::copyBufferToImagePlane(HdRenderBuffer* buffer, ImagePlane& plane)
     buffer->Unmap();
 }
 
+void
+HydraRender::copyScaledBufferToImagePlane(HdRenderBuffer* buffer,
+                                          ImagePlane& plane)
+{
+    const HdFormat bufferFormat = buffer->GetFormat();
+    const size_t numComponents = HdGetComponentCount(bufferFormat);
+
+    const ChannelSet channels = plane.channels();
+    if (channels.size() != numComponents) {
+        error("Buffer component count (%zu) does not match output plane "
+              "channel count (%d)", numComponents, channels.size());
+        return;
+    }
+
+    const int srcWidth = static_cast<int>(buffer->GetWidth());
+    const int srcHeight = static_cast<int>(buffer->GetHeight());
+    const size_t numPixels = static_cast<size_t>(srcWidth) * srcHeight;
+    std::vector<float> pixels(numPixels * numComponents, 0.0f);
+    void* data = buffer->Map();
+
+    switch (HdGetComponentFormat(bufferFormat)) {
+        case HdFormatUNorm8:
+            Linear::from_byte(pixels.data(), static_cast<uint8_t*>(data),
+                              static_cast<int>(pixels.size()));
+            break;
+        case HdFormatSNorm8:
+            ConvertHdBufferData<int8_t>(data, pixels.data(), numPixels,
+                                        numComponents, true);
+            break;
+        case HdFormatFloat16:
+            ConvertHdBufferData<GfHalf>(data, pixels.data(), numPixels,
+                                        numComponents, true);
+            break;
+        case HdFormatFloat32:
+            Linear::from_float(pixels.data(), static_cast<float*>(data),
+                               static_cast<int>(pixels.size()));
+            break;
+        case HdFormatInt32:
+            ConvertHdBufferData<int32_t>(data, pixels.data(), numPixels,
+                                         numComponents, true);
+            break;
+        default:
+            TF_WARN("[HydraRender] Unhandled render buffer format: %d",
+                    static_cast<std::underlying_type<HdFormat>::type>(bufferFormat));
+    }
+
+    buffer->Unmap();
+
+    // Nearest neighbour is enough for a preview.
+    const Box& bounds = plane.bounds();
+    for (int y = 0; y < bounds.h(); y++)
+    {
+        const size_t srcY = static_cast<size_t>(y) * srcHeight / bounds.h();
+        for (int x = 0; x < bounds.w(); x++)
+        {
+            const size_t srcX = static_cast<size_t>(x) * srcWidth / bounds.w();
+            const float* src = pixels.data()
+                               + (srcY * srcWidth + srcX) * numComponents;
+            for (size_t c = 0; c < numComponents; c++)
+            {
+                plane.writableAt(bounds.x() + x, bounds.y() + y,
+                                 static_cast<int>(c)) = src[c];
+            }
+        }
+    }
+}
+
+void
+HydraRender::copyFloatsToImagePlane(const float* data, int width, int height,
+                                    size_t numComponents, ImagePlane& plane)
+{
+    // Channels take the component at their index within their layer, so e.g.
+    // a plane holding only alpha gets the fourth component.
+    std::vector<size_t> components;
+    foreach(z, plane.channels()) {
+        components.push_back(colourIndex(z));
+    }
+
+    const Box& bounds = plane.bounds();
+    for (int y = 0; y < bounds.h(); y++)
+    {
+        const size_t srcY = static_cast<size_t>(y) * height / bounds.h();
+        for (int x = 0; x < bounds.w(); x++)
+        {
+            const size_t srcX = static_cast<size_t>(x) * width / bounds.w();
+            const float* src = data + (srcY * width + srcX) * numComponents;
+            for (size_t chanNo = 0; chanNo < components.size(); chanNo++)
+            {
+                const size_t c = components[chanNo];
+                plane.writableAt(bounds.x() + x, bounds.y() + y,
+                                 static_cast<int>(chanNo))
+                    = c < numComponents ? src[c] : 0.0f;
+            }
+        }
+    }
+}
+
 /* static */
 void
 HydraRender::dynamicKnobCallback(void* ptr, Knob_Callback f)
@@ -49,6 +49,8 @@ public:
     void knobs(Knob_Callback f) override;
     int knob_changed(DD::Image::Knob* k) override;
 
+    void append(Hash& hash) override;
+
     const char* Class() const override { return CLASS; }
     const char* node_help() const override { return HELP; }
 
@@ -122,6 +124,19 @@ HydraUSDStage::knob_changed(Knob* k)
     return AxisOp::knob_changed(k);
 }
 
+void
+HydraUSDStage::append(Hash& hash)
+{
+    AxisOp::append(hash);
+
+    // Until the stage has been loaded (or if it doesn't declare its time
+    // range), assume it is animated.
+    if (not _stage or not _stage->HasAuthoredTimeCodeRange()
+            or _stage->GetStartTimeCode() != _stage->GetEndTimeCode()) {
+        hash.append(outputContext().frame());
+    }
+}
+
 
 void
 HydraUSDStage::Populate(HydraOpManager* manager)
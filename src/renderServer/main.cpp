@@ -0,0 +1,497 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// hdNukeRenderServer: renders the scenes HydraRender sends it over a socket
+// inherited from HydraRender (see HdNukeRenderClient), and hands the
+// framebuffers back through shared memory.
+//
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sched.h>
+#include <unistd.h>
+
+#include <pxr/pxr.h>
+
+#include <pxr/base/arch/defines.h>
+#include <pxr/base/gf/half.h>
+#include <pxr/base/tf/stringUtils.h>
+#include <pxr/base/work/threadLimits.h>
+
+#include <pxr/imaging/hd/engine.h>
+#include <pxr/imaging/hd/renderBuffer.h>
+#include <pxr/imaging/hd/rendererPlugin.h>
+#include <pxr/imaging/hd/rendererPluginRegistry.h>
+#include <pxr/imaging/hd/renderIndex.h>
+#include <pxr/imaging/hd/tokens.h>
+#include <pxr/imaging/hdx/taskController.h>
+
+#include <hdNuke/renderServerProtocol.h>
+
+#include "remoteSceneDelegate.h"
+
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+
+namespace {
+
+// Returns the number of cores pinned, or zero on failure.
+int
+_SetAffinity(const std::string& cpus)
+{
+#if defined(ARCH_OS_LINUX)
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (const auto& range : TfStringSplit(cpus, ","))
+    {
+        const std::vector<std::string> bounds = TfStringSplit(range, "-");
+        if (bounds.empty() or bounds.size() > 2) {
+            return 0;
+        }
+        const int first = std::atoi(bounds.front().c_str());
+        const int last = std::atoi(bounds.back().c_str());
+        for (int cpu = first; cpu <= last and cpu < CPU_SETSIZE; cpu++)
+        {
+            CPU_SET(cpu, &cpuSet);
+        }
+    }
+    // Threads created later (i.e. all of the renderer's) inherit the mask.
+    if (sched_setaffinity(0, sizeof(cpuSet), &cpuSet) != 0) {
+        return 0;
+    }
+    return CPU_COUNT(&cpuSet);
+#else
+    std::cerr << "[hdNukeRenderServer] --cpus is not supported on this "
+                 "platform" << std::endl;
+    return 0;
+#endif
+}
+
+// Converts a render buffer to floats with the given number of components.
+// Missing components are filled with zero (or one, for alpha).
+void
+_ReadBuffer(HdRenderBuffer* buffer, float* dest, size_t destComponents)
+{
+    const HdFormat format = buffer->GetFormat();
+    const size_t components = HdGetComponentCount(format);
+    const size_t numPixels = static_cast<size_t>(buffer->GetWidth())
+                             * buffer->GetHeight();
+
+    buffer->Resolve();
+    const void* data = buffer->Map();
+    for (size_t i = 0; i < numPixels; i++)
+    {
+        for (size_t c = 0; c < destComponents; c++)
+        {
+            float value = c == 3 ? 1.0f : 0.0f;
+            if (c < components) {
+                const size_t index = i * components + c;
+                switch (HdGetComponentFormat(format)) {
+                    case HdFormatUNorm8:
+                        value = static_cast<const uint8_t*>(data)[index] / 255.0f;
+                        break;
+                    case HdFormatSNorm8:
+                        value = std::max(
+                            static_cast<const int8_t*>(data)[index] / 127.0f,
+                            -1.0f);
+                        break;
+                    case HdFormatFloat16:
+                        value = static_cast<const GfHalf*>(data)[index];
+                        break;
+                    case HdFormatFloat32:
+                        value = static_cast<const float*>(data)[index];
+                        break;
+                    case HdFormatInt32:
+                        value = static_cast<float>(
+                            static_cast<const int32_t*>(data)[index]);
+                        break;
+                    default:
+                        break;
+                }
+            }
+            *dest++ = value;
+        }
+    }
+    buffer->Unmap();
+}
+
+
+class _RenderServer
+{
+public:
+    _RenderServer(int fd)
+        : _fd(fd), _scene(std::make_shared<HdNukeRemoteScene>()) { }
+
+    ~_RenderServer() { _ReleaseRenderer(); }
+
+    // Serves requests until the client quits or goes away.
+    void Run();
+
+private:
+    bool _Handle(HdNukeRenderServerMessage type, HdNukeMessageReader& reader,
+                 HdNukeMessageWriter& results, std::string* error);
+
+    bool _SetRenderer(const TfToken& pluginId, std::string* error);
+    void _ReleaseRenderer();
+    HdxTaskController* _GetTaskController(int view);
+
+    void _Pause();
+    void _Resume();
+
+    int _fd;
+    HdNukeRemoteScenePtr _scene;
+
+    HdRendererPlugin* _plugin = nullptr;
+    HdRenderIndex* _renderIndex = nullptr;
+    std::unique_ptr<HdNukeRemoteSceneDelegate> _delegate;
+    std::map<int, std::unique_ptr<HdxTaskController>> _taskControllers;
+    HdEngine _engine;
+    bool _paused = false;
+    bool _stopped = false;
+
+    HdNukeSharedMemory _framebuffer;
+};
+
+void
+_RenderServer::Run()
+{
+    HdNukeRenderServerMessage type;
+    std::vector<char> payload;
+    while (HdNukeReceiveMessage(_fd, &type, &payload))
+    {
+        if (type == HdNukeRenderServerMessage::Quit) {
+            return;
+        }
+
+        HdNukeMessageReader reader(payload);
+        HdNukeMessageWriter results;
+        std::string error;
+        const bool ok = _Handle(type, reader, results, &error);
+
+        HdNukeMessageWriter reply;
+        reply.Write(static_cast<uint8_t>(ok));
+        reply.WriteString(error);
+        if (ok) {
+            reply.WriteBytes(results.GetData().data(), results.GetData().size());
+        }
+        if (not HdNukeSendMessage(_fd, HdNukeRenderServerMessage::Reply, reply)) {
+            return;
+        }
+    }
+}
+
+bool
+_RenderServer::_Handle(HdNukeRenderServerMessage type,
+                       HdNukeMessageReader& reader,
+                       HdNukeMessageWriter& results, std::string* error)
+{
+    if (type == HdNukeRenderServerMessage::SetRenderer) {
+        return _SetRenderer(reader.ReadToken(), error);
+    }
+    if (type == HdNukeRenderServerMessage::SetFramebuffer) {
+        const std::string name = reader.ReadString();
+        const uint64_t size = reader.Read<uint64_t>();
+        if (not reader.IsValid() or not _framebuffer.Open(name, size)) {
+            *error = "Could not map framebuffer " + name;
+            return false;
+        }
+        return true;
+    }
+    if (type == HdNukeRenderServerMessage::ClearScene) {
+        if (_delegate) {
+            _delegate->Clear();
+        }
+        else {
+            _scene->rprims.clear();
+            _scene->lights.clear();
+        }
+        return true;
+    }
+
+    if (not _delegate) {
+        *error = "No renderer has been set";
+        return false;
+    }
+
+    switch (type) {
+        case HdNukeRenderServerMessage::SetSettings: {
+            HdRenderDelegate* renderDelegate = _renderIndex->GetRenderDelegate();
+            const uint32_t count = reader.Read<uint32_t>();
+            for (uint32_t i = 0; i < count and reader.IsValid(); i++)
+            {
+                const TfToken key = reader.ReadToken();
+                const VtValue value = reader.ReadValue();
+                if (not value.IsEmpty()) {
+                    renderDelegate->SetRenderSetting(key, value);
+                }
+            }
+            break;
+        }
+        case HdNukeRenderServerMessage::SetCamera: {
+            const int view = reader.Read<int32_t>();
+            const GfVec4d viewport = reader.Read<GfVec4d>();
+            const GfMatrix4d viewMatrix = reader.Read<GfMatrix4d>();
+            const GfMatrix4d projectionMatrix = reader.Read<GfMatrix4d>();
+            if (reader.IsValid()) {
+                HdxTaskController* controller = _GetTaskController(view);
+                controller->SetRenderViewport(viewport);
+                controller->SetFreeCameraMatrices(viewMatrix, projectionMatrix);
+            }
+            break;
+        }
+        case HdNukeRenderServerMessage::UpdateScene:
+            if (not _delegate->ApplyUpdate(reader)) {
+                *error = "Malformed scene update";
+                return false;
+            }
+            break;
+        case HdNukeRenderServerMessage::Execute: {
+            HdxTaskController* controller = _GetTaskController(
+                reader.Read<int32_t>());
+            _Resume();
+            auto tasks = controller->GetRenderingTasks();
+            _engine.Execute(_renderIndex, &tasks);
+            results.Write(static_cast<uint8_t>(controller->IsConverged()));
+            break;
+        }
+        case HdNukeRenderServerMessage::Pause:
+            _Pause();
+            break;
+        case HdNukeRenderServerMessage::Resolve: {
+            HdxTaskController* controller = _GetTaskController(
+                reader.Read<int32_t>());
+            HdRenderBuffer* color = controller->GetRenderOutput(
+                HdAovTokens->color);
+            if (color == nullptr) {
+                *error = "No color buffer";
+                return false;
+            }
+            const size_t numPixels = static_cast<size_t>(color->GetWidth())
+                                     * color->GetHeight();
+            if (_framebuffer.GetData() == nullptr
+                    or numPixels * 5 * sizeof(float) > _framebuffer.GetSize()) {
+                *error = "The framebuffer is too small for the render";
+                return false;
+            }
+
+            float* colorData = static_cast<float*>(_framebuffer.GetData());
+            float* depthData = colorData + numPixels * 4;
+            _ReadBuffer(color, colorData, 4);
+
+            HdRenderBuffer* depth = controller->GetRenderOutput(
+                HdAovTokens->depth);
+            if (depth != nullptr and depth->GetWidth() == color->GetWidth()
+                    and depth->GetHeight() == color->GetHeight()) {
+                _ReadBuffer(depth, depthData, 1);
+            }
+            else {
+                std::fill(depthData, depthData + numPixels, 0.0f);
+            }
+
+            results.Write(static_cast<int32_t>(color->GetWidth()));
+            results.Write(static_cast<int32_t>(color->GetHeight()));
+            break;
+        }
+        default:
+            *error = TfStringPrintf("Unknown request %u",
+                                    static_cast<unsigned>(type));
+            return false;
+    }
+
+    if (not reader.IsValid()) {
+        *error = "Malformed request";
+        return false;
+    }
+    return true;
+}
+
+bool
+_RenderServer::_SetRenderer(const TfToken& pluginId, std::string* error)
+{
+    _ReleaseRenderer();
+
+    auto& pluginRegistry = HdRendererPluginRegistry::GetInstance();
+    if (not pluginRegistry.IsRegisteredPlugin(pluginId)) {
+        *error = "Unknown renderer plugin " + pluginId.GetString();
+        return false;
+    }
+    HdRendererPlugin* plugin = pluginRegistry.GetRendererPlugin(pluginId);
+    if (plugin == nullptr or not plugin->IsSupported()) {
+        if (plugin != nullptr) {
+            pluginRegistry.ReleasePlugin(plugin);
+        }
+        *error = "Renderer plugin " + pluginId.GetString() + " is not supported";
+        return false;
+    }
+
+    _plugin = plugin;
+    _renderIndex = HdRenderIndex::New(_plugin->CreateRenderDelegate());
+    _delegate.reset(new HdNukeRemoteSceneDelegate(_renderIndex, _scene));
+    _delegate->Populate();
+    return true;
+}
+
+void
+_RenderServer::_ReleaseRenderer()
+{
+    _taskControllers.clear();
+    _delegate.reset();
+
+    if (_renderIndex != nullptr) {
+        HdRenderDelegate* renderDelegate = _renderIndex->GetRenderDelegate();
+        delete _renderIndex;
+        _renderIndex = nullptr;
+        _plugin->DeleteRenderDelegate(renderDelegate);
+    }
+    if (_plugin != nullptr) {
+        HdRendererPluginRegistry::GetInstance().ReleasePlugin(_plugin);
+        _plugin = nullptr;
+    }
+    _paused = false;
+    _stopped = false;
+}
+
+HdxTaskController*
+_RenderServer::_GetTaskController(int view)
+{
+    auto it = _taskControllers.find(view);
+    if (it != _taskControllers.end()) {
+        return it->second.get();
+    }
+
+    SdfPath controllerId(TfStringPrintf("/HdNuke_TaskController_view%d", view));
+    HdxTaskController* controller = new HdxTaskController(_renderIndex,
+                                                          controllerId);
+    _taskControllers[view].reset(controller);
+
+    controller->SetCollection(HdRprimCollection(
+        HdTokens->geometry, HdReprSelector(HdReprTokens->refined)));
+    controller->SetEnableSelection(false);
+
+    HdxRenderTaskParams renderTaskParams;
+    renderTaskParams.enableLighting = true;
+    renderTaskParams.enableSceneMaterials = true;
+    controller->SetRenderParams(renderTaskParams);
+    controller->SetViewportRenderOutput(TfToken());
+
+    TfTokenVector renderTags;
+    renderTags.push_back(HdRenderTagTokens->geometry);
+    renderTags.push_back(HdRenderTagTokens->render);
+    controller->SetRenderTags(renderTags);
+    return controller;
+}
+
+void
+_RenderServer::_Pause()
+{
+    if (_paused or _stopped) {
+        return;
+    }
+    HdRenderDelegate* renderDelegate = _renderIndex->GetRenderDelegate();
+    if (renderDelegate->IsPauseSupported()) {
+        _paused = renderDelegate->Pause();
+    }
+#if PXR_VERSION >= 2011
+    else if (renderDelegate->IsStopSupported()) {
+        _stopped = renderDelegate->Stop();
+    }
+#endif
+}
+
+void
+_RenderServer::_Resume()
+{
+    HdRenderDelegate* renderDelegate = _renderIndex->GetRenderDelegate();
+    if (_paused) {
+        renderDelegate->Resume();
+        _paused = false;
+    }
+#if PXR_VERSION >= 2011
+    if (_stopped) {
+        renderDelegate->Restart();
+        _stopped = false;
+    }
+#endif
+}
+
+}  // namespace
+
+
+int
+main(int argc, char* argv[])
+{
+    int fd = -1;
+    int threads = 0;
+    std::string cpus;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "[hdNukeRenderServer] Missing value for " << arg
+                      << std::endl;
+            return 1;
+        }
+        if (arg == "--fd") {
+            fd = std::atoi(argv[++i]);
+        }
+        else if (arg == "--threads") {
+            threads = std::atoi(argv[++i]);
+        }
+        else if (arg == "--cpus") {
+            cpus = argv[++i];
+        }
+        else {
+            std::cerr << "[hdNukeRenderServer] Unknown argument " << arg
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    if (fd < 0) {
+        std::cerr << "usage: hdNukeRenderServer --fd <socket> "
+                     "[--threads <count>] [--cpus <list>]" << std::endl;
+        return 1;
+    }
+
+    // A dying client shows up as a failed send instead.
+    std::signal(SIGPIPE, SIG_IGN);
+
+    if (not cpus.empty()) {
+        const int pinned = _SetAffinity(cpus);
+        if (pinned == 0) {
+            std::cerr << "[hdNukeRenderServer] Could not pin to cores " << cpus
+                      << std::endl;
+        }
+        else if (threads <= 0) {
+            threads = pinned;
+        }
+    }
+    if (threads > 0) {
+        WorkSetConcurrencyLimit(static_cast<unsigned>(threads));
+    }
+
+    {
+        _RenderServer server(fd);
+        server.Run();
+    }
+    close(fd);
+    return 0;
+}
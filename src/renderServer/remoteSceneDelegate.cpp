@@ -0,0 +1,341 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <pxr/imaging/hd/changeTracker.h>
+#include <pxr/imaging/hd/light.h>
+#include <pxr/imaging/hd/renderIndex.h>
+#include <pxr/imaging/hd/tokens.h>
+
+#include "remoteSceneDelegate.h"
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+namespace
+{
+    const HdDirtyBits _PrimvarDirtyBits = HdChangeTracker::DirtyPrimvar
+                                          | HdChangeTracker::DirtyPoints
+                                          | HdChangeTracker::DirtyNormals
+                                          | HdChangeTracker::DirtyWidths;
+
+    template <typename Map>
+    inline const typename Map::mapped_type*
+    _Find(const Map& map, const SdfPath& id)
+    {
+        auto it = map.find(id);
+        return it == map.end() ? nullptr : &it->second;
+    }
+}  // namespace
+
+
+HdNukeRemoteSceneDelegate::HdNukeRemoteSceneDelegate(
+        HdRenderIndex* renderIndex, const HdNukeRemoteScenePtr& scene)
+    : HdSceneDelegate(renderIndex, SdfPath::AbsoluteRootPath())
+    , _scene(scene)
+{
+}
+
+HdNukeRemoteSceneDelegate::~HdNukeRemoteSceneDelegate()
+{
+    GetRenderIndex().RemoveSubtree(GetDelegateID(), this);
+}
+
+HdMeshTopology
+HdNukeRemoteSceneDelegate::GetMeshTopology(const SdfPath& id)
+{
+    const HdNukeRemoteRprim* rprim = _Find(_scene->rprims, id);
+    return rprim ? rprim->topology : HdMeshTopology();
+}
+
+GfRange3d
+HdNukeRemoteSceneDelegate::GetExtent(const SdfPath& id)
+{
+    const HdNukeRemoteRprim* rprim = _Find(_scene->rprims, id);
+    return rprim ? rprim->extent : GfRange3d();
+}
+
+GfMatrix4d
+HdNukeRemoteSceneDelegate::GetTransform(const SdfPath& id)
+{
+    if (const HdNukeRemoteRprim* rprim = _Find(_scene->rprims, id)) {
+        return rprim->transform;
+    }
+    if (const HdNukeRemoteLight* light = _Find(_scene->lights, id)) {
+        return light->transform;
+    }
+    return GfMatrix4d(1);
+}
+
+bool
+HdNukeRemoteSceneDelegate::GetVisible(const SdfPath& id)
+{
+    const HdNukeRemoteRprim* rprim = _Find(_scene->rprims, id);
+    return rprim ? rprim->visible : false;
+}
+
+VtValue
+HdNukeRemoteSceneDelegate::Get(const SdfPath& id, const TfToken& key)
+{
+    if (const HdNukeRemoteRprim* rprim = _Find(_scene->rprims, id)) {
+        auto it = rprim->primvars.find(key);
+        if (it != rprim->primvars.end()) {
+            return it->second;
+        }
+        return VtValue();
+    }
+    return GetLightParamValue(id, key);
+}
+
+VtValue
+HdNukeRemoteSceneDelegate::GetLightParamValue(const SdfPath& id,
+                                              const TfToken& paramName)
+{
+    if (const HdNukeRemoteLight* light = _Find(_scene->lights, id)) {
+        auto it = light->params.find(paramName);
+        if (it != light->params.end()) {
+            return it->second;
+        }
+    }
+    return VtValue();
+}
+
+HdPrimvarDescriptorVector
+HdNukeRemoteSceneDelegate::GetPrimvarDescriptors(const SdfPath& id,
+                                                 HdInterpolation interpolation)
+{
+    const HdNukeRemoteRprim* rprim = _Find(_scene->rprims, id);
+    if (rprim == nullptr or interpolation < 0
+            or interpolation >= HdInterpolationCount) {
+        return HdPrimvarDescriptorVector();
+    }
+    return rprim->primvarDescriptors[interpolation];
+}
+
+void
+HdNukeRemoteSceneDelegate::Populate()
+{
+    for (const auto& rprimEntry : _scene->rprims)
+    {
+        _InsertRprim(rprimEntry.first, rprimEntry.second.primType);
+    }
+    for (const auto& lightEntry : _scene->lights)
+    {
+        _InsertLight(lightEntry.first, lightEntry.second.lightType);
+    }
+}
+
+bool
+HdNukeRemoteSceneDelegate::ApplyUpdate(HdNukeMessageReader& reader)
+{
+    HdRenderIndex& renderIndex = GetRenderIndex();
+
+    const uint32_t removedRprims = reader.Read<uint32_t>();
+    for (uint32_t i = 0; i < removedRprims and reader.IsValid(); i++)
+    {
+        const SdfPath id = reader.ReadPath();
+        if (_scene->rprims.erase(id) > 0 and renderIndex.HasRprim(id)) {
+            renderIndex.RemoveRprim(id);
+        }
+    }
+
+    const uint32_t changedRprims = reader.Read<uint32_t>();
+    for (uint32_t i = 0; i < changedRprims and reader.IsValid(); i++)
+    {
+        if (not _ReadRprim(reader)) {
+            return false;
+        }
+    }
+
+    const uint32_t removedLights = reader.Read<uint32_t>();
+    for (uint32_t i = 0; i < removedLights and reader.IsValid(); i++)
+    {
+        const SdfPath id = reader.ReadPath();
+        auto it = _scene->lights.find(id);
+        if (it == _scene->lights.end()) {
+            continue;
+        }
+        if (renderIndex.GetSprim(it->second.lightType, id)) {
+            renderIndex.RemoveSprim(it->second.lightType, id);
+        }
+        _scene->lights.erase(it);
+    }
+
+    const uint32_t changedLights = reader.Read<uint32_t>();
+    for (uint32_t i = 0; i < changedLights and reader.IsValid(); i++)
+    {
+        if (not _ReadLight(reader)) {
+            return false;
+        }
+    }
+
+    return reader.IsValid() and reader.AtEnd();
+}
+
+bool
+HdNukeRemoteSceneDelegate::_ReadRprim(HdNukeMessageReader& reader)
+{
+    HdRenderIndex& renderIndex = GetRenderIndex();
+
+    const SdfPath id = reader.ReadPath();
+    const TfToken primType = reader.ReadToken();
+    const HdDirtyBits dirtyBits = reader.Read<uint32_t>();
+    if (not reader.IsValid() or id.IsEmpty()) {
+        return false;
+    }
+
+    auto it = _scene->rprims.find(id);
+    bool inserted = it == _scene->rprims.end();
+    if (inserted) {
+        it = _scene->rprims.emplace(id, HdNukeRemoteRprim()).first;
+    }
+    else if (it->second.primType != primType) {
+        // HdRprim can't change its type in place.
+        if (renderIndex.HasRprim(id)) {
+            renderIndex.RemoveRprim(id);
+        }
+        it->second = HdNukeRemoteRprim();
+        inserted = true;
+    }
+    HdNukeRemoteRprim& rprim = it->second;
+    rprim.primType = primType;
+
+    if (dirtyBits & HdChangeTracker::DirtyTransform) {
+        rprim.transform = reader.Read<GfMatrix4d>();
+    }
+    if (dirtyBits & HdChangeTracker::DirtyVisibility) {
+        rprim.visible = reader.Read<uint8_t>() != 0;
+    }
+    if (dirtyBits & HdChangeTracker::DirtyExtent) {
+        const GfVec3d min = reader.Read<GfVec3d>();
+        const GfVec3d max = reader.Read<GfVec3d>();
+        rprim.extent = GfRange3d(min, max);
+    }
+    if (dirtyBits & HdChangeTracker::DirtyTopology) {
+        rprim.topology = reader.ReadTopology();
+    }
+    if (dirtyBits & _PrimvarDirtyBits) {
+        rprim.primvars.clear();
+        for (int interpolation = 0; interpolation < HdInterpolationCount;
+             interpolation++)
+        {
+            HdPrimvarDescriptorVector& descriptors =
+                rprim.primvarDescriptors[interpolation];
+            descriptors = reader.ReadPrimvarDescriptors();
+            for (const auto& descriptor : descriptors)
+            {
+                rprim.primvars[descriptor.name] = reader.ReadValue();
+            }
+        }
+    }
+    if (not reader.IsValid()) {
+        return false;
+    }
+
+    if (inserted) {
+        _InsertRprim(id, primType);
+    }
+    else if (renderIndex.HasRprim(id)) {
+        renderIndex.GetChangeTracker().MarkRprimDirty(
+            id, dirtyBits & ~HdChangeTracker::DirtyInstancer);
+    }
+    return true;
+}
+
+bool
+HdNukeRemoteSceneDelegate::_ReadLight(HdNukeMessageReader& reader)
+{
+    HdRenderIndex& renderIndex = GetRenderIndex();
+
+    const SdfPath id = reader.ReadPath();
+    const TfToken lightType = reader.ReadToken();
+    const HdDirtyBits dirtyBits = reader.Read<uint32_t>();
+    if (not reader.IsValid() or id.IsEmpty()) {
+        return false;
+    }
+
+    auto it = _scene->lights.find(id);
+    bool inserted = it == _scene->lights.end();
+    if (inserted) {
+        it = _scene->lights.emplace(id, HdNukeRemoteLight()).first;
+    }
+    else if (it->second.lightType != lightType) {
+        if (renderIndex.GetSprim(it->second.lightType, id)) {
+            renderIndex.RemoveSprim(it->second.lightType, id);
+        }
+        it->second = HdNukeRemoteLight();
+        inserted = true;
+    }
+    HdNukeRemoteLight& light = it->second;
+    light.lightType = lightType;
+
+    if (dirtyBits & HdLight::DirtyTransform) {
+        light.transform = reader.Read<GfMatrix4d>();
+    }
+    if (dirtyBits & (HdLight::DirtyParams | HdLight::DirtyShadowParams)) {
+        light.params.clear();
+        const uint32_t count = reader.Read<uint32_t>();
+        for (uint32_t i = 0; i < count and reader.IsValid(); i++)
+        {
+            const TfToken name = reader.ReadToken();
+            light.params[name] = reader.ReadValue();
+        }
+    }
+    if (not reader.IsValid()) {
+        return false;
+    }
+
+    if (inserted) {
+        _InsertLight(id, lightType);
+    }
+    else if (renderIndex.GetSprim(lightType, id)) {
+        renderIndex.GetChangeTracker().MarkSprimDirty(id, dirtyBits);
+    }
+    return true;
+}
+
+void
+HdNukeRemoteSceneDelegate::_InsertRprim(const SdfPath& id,
+                                        const TfToken& primType)
+{
+    HdRenderIndex& renderIndex = GetRenderIndex();
+    if (renderIndex.IsRprimTypeSupported(primType)) {
+        renderIndex.InsertRprim(primType, this, id);
+    }
+}
+
+void
+HdNukeRemoteSceneDelegate::_InsertLight(const SdfPath& id,
+                                        const TfToken& lightType)
+{
+    HdRenderIndex& renderIndex = GetRenderIndex();
+    if (renderIndex.IsSprimTypeSupported(lightType)) {
+        renderIndex.InsertSprim(lightType, this, id);
+    }
+    else {
+        TF_WARN("Selected render delegate does not support Sprim type %s",
+                lightType.GetText());
+    }
+}
+
+void
+HdNukeRemoteSceneDelegate::Clear()
+{
+    GetRenderIndex().RemoveSubtree(GetDelegateID(), this);
+    _scene->rprims.clear();
+    _scene->lights.clear();
+}
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
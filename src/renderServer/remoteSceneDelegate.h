@@ -0,0 +1,119 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#ifndef HDNUKE_REMOTESCENEDELEGATE_H
+#define HDNUKE_REMOTESCENEDELEGATE_H
+
+#include <memory>
+#include <unordered_map>
+
+#include <pxr/pxr.h>
+
+#include <pxr/base/gf/matrix4d.h>
+#include <pxr/base/gf/range3d.h>
+
+#include <pxr/imaging/hd/sceneDelegate.h>
+
+#include <hdNuke/renderServerProtocol.h>
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+using HdNukeRemoteValueMap =
+    std::unordered_map<TfToken, VtValue, TfToken::HashFunctor>;
+
+
+struct HdNukeRemoteRprim
+{
+    TfToken primType;
+    GfMatrix4d transform = GfMatrix4d(1);
+    bool visible = true;
+    GfRange3d extent;
+    HdMeshTopology topology;
+    // Indexed by HdInterpolation.
+    HdPrimvarDescriptorVector primvarDescriptors[HdInterpolationCount];
+    HdNukeRemoteValueMap primvars;
+};
+
+
+struct HdNukeRemoteLight
+{
+    TfToken lightType;
+    GfMatrix4d transform = GfMatrix4d(1);
+    HdNukeRemoteValueMap params;
+};
+
+
+// The scene received from HydraRender. Outlives the render index (and
+// delegate) of any one renderer, so switching renderers doesn't need the
+// scene to be sent again.
+struct HdNukeRemoteScene
+{
+    std::unordered_map<SdfPath, HdNukeRemoteRprim, SdfPath::Hash> rprims;
+    std::unordered_map<SdfPath, HdNukeRemoteLight, SdfPath::Hash> lights;
+};
+
+using HdNukeRemoteScenePtr = std::shared_ptr<HdNukeRemoteScene>;
+
+
+// Serves the scene sent by HdNukeRenderClient to a render index. Prim IDs
+// are used as sent, so the delegate is rooted at the absolute root path.
+class HdNukeRemoteSceneDelegate : public HdSceneDelegate
+{
+public:
+    HdNukeRemoteSceneDelegate(HdRenderIndex* renderIndex,
+                              const HdNukeRemoteScenePtr& scene);
+    ~HdNukeRemoteSceneDelegate() override;
+
+    HdMeshTopology GetMeshTopology(const SdfPath& id) override;
+
+    GfRange3d GetExtent(const SdfPath& id) override;
+
+    GfMatrix4d GetTransform(const SdfPath& id) override;
+
+    bool GetVisible(const SdfPath& id) override;
+
+    VtValue Get(const SdfPath& id, const TfToken& key) override;
+
+    VtValue GetLightParamValue(const SdfPath& id,
+                               const TfToken& paramName) override;
+
+    HdPrimvarDescriptorVector
+    GetPrimvarDescriptors(const SdfPath& id,
+                          HdInterpolation interpolation) override;
+
+    // Inserts the whole scene into the (new) render index.
+    void Populate();
+
+    // Applies an UpdateScene message to the scene and the render index.
+    // Returns false if the message is malformed.
+    bool ApplyUpdate(HdNukeMessageReader& reader);
+
+    void Clear();
+
+private:
+    bool _ReadRprim(HdNukeMessageReader& reader);
+    bool _ReadLight(HdNukeMessageReader& reader);
+
+    void _InsertRprim(const SdfPath& id, const TfToken& primType);
+    void _InsertLight(const SdfPath& id, const TfToken& lightType);
+
+    HdNukeRemoteScenePtr _scene;
+};
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // HDNUKE_REMOTESCENEDELEGATE_H
@@ -0,0 +1,168 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#ifndef HDNUKE_TESTS_STANDINRENDERDELEGATE_H
+#define HDNUKE_TESTS_STANDINRENDERDELEGATE_H
+
+#include <pxr/pxr.h>
+
+#include <pxr/imaging/hd/camera.h>
+#include <pxr/imaging/hd/light.h>
+#include <pxr/imaging/hd/mesh.h>
+#include <pxr/imaging/hd/renderDelegate.h>
+#include <pxr/imaging/hd/resourceRegistry.h>
+#include <pxr/imaging/hd/tokens.h>
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+// Meshes and lights that read nothing from their scene delegate when synced,
+// so tests can insert them and check what a scene delegate marks dirty.
+class StandInMesh : public HdMesh
+{
+public:
+    StandInMesh(const SdfPath& id, const SdfPath& instancerId)
+        : HdMesh(id, instancerId) { }
+
+    void Sync(HdSceneDelegate* delegate, HdRenderParam* renderParam,
+              HdDirtyBits* dirtyBits, const TfToken& reprToken) override {
+        *dirtyBits = HdChangeTracker::Clean;
+    }
+
+    HdDirtyBits GetInitialDirtyBitsMask() const override {
+        return HdChangeTracker::AllSceneDirtyBits;
+    }
+
+protected:
+    HdDirtyBits _PropagateDirtyBits(HdDirtyBits bits) const override {
+        return bits;
+    }
+    void _InitRepr(const TfToken& reprToken,
+                   HdDirtyBits* dirtyBits) override { }
+};
+
+class StandInLight : public HdLight
+{
+public:
+    StandInLight(const SdfPath& id) : HdLight(id) { }
+
+    void Sync(HdSceneDelegate* delegate, HdRenderParam* renderParam,
+              HdDirtyBits* dirtyBits) override {
+        *dirtyBits = HdLight::Clean;
+    }
+
+    HdDirtyBits GetInitialDirtyBitsMask() const override {
+        return HdLight::AllDirty;
+    }
+};
+
+
+// A render delegate that renders nothing, so a render index can be built
+// around a scene delegate without a real renderer. The scene delegate is then
+// queried directly, the way a delegate's Sync would. Meshes and lights are
+// stand-ins, cameras are supported so a task controller can be created for
+// it, and pause support can be switched on to test how renders are
+// interrupted.
+class StandInRenderDelegate : public HdRenderDelegate
+{
+public:
+    bool pauseSupported = false;
+
+    int pauses = 0;
+    int resumes = 0;
+
+    StandInRenderDelegate()
+        : _rprimTypes({HdPrimTypeTokens->mesh}),
+          _sprimTypes({HdPrimTypeTokens->camera,
+                       HdPrimTypeTokens->distantLight,
+                       HdPrimTypeTokens->sphereLight}),
+          _resourceRegistry(new HdResourceRegistry()) { }
+
+    const TfTokenVector& GetSupportedRprimTypes() const override {
+        return _rprimTypes;
+    }
+    const TfTokenVector& GetSupportedSprimTypes() const override {
+        return _sprimTypes;
+    }
+    const TfTokenVector& GetSupportedBprimTypes() const override {
+        return _noTypes;
+    }
+
+    HdResourceRegistrySharedPtr GetResourceRegistry() const override {
+        return _resourceRegistry;
+    }
+
+    HdRenderPassSharedPtr CreateRenderPass(
+            HdRenderIndex* index,
+            const HdRprimCollection& collection) override {
+        return HdRenderPassSharedPtr();
+    }
+
+    HdInstancer* CreateInstancer(HdSceneDelegate* delegate, const SdfPath& id,
+                                 const SdfPath& instancerId) override {
+        return nullptr;
+    }
+    void DestroyInstancer(HdInstancer* instancer) override { }
+
+    HdRprim* CreateRprim(const TfToken& typeId, const SdfPath& rprimId,
+                         const SdfPath& instancerId) override {
+        return new StandInMesh(rprimId, instancerId);
+    }
+    void DestroyRprim(HdRprim* rprim) override { delete rprim; }
+
+    HdSprim* CreateSprim(const TfToken& typeId,
+                         const SdfPath& sprimId) override {
+        if (typeId == HdPrimTypeTokens->camera) {
+            return new HdCamera(sprimId);
+        }
+        return new StandInLight(sprimId);
+    }
+    HdSprim* CreateFallbackSprim(const TfToken& typeId) override {
+        return CreateSprim(typeId, SdfPath::EmptyPath());
+    }
+    void DestroySprim(HdSprim* sprim) override { delete sprim; }
+
+    HdBprim* CreateBprim(const TfToken& typeId,
+                         const SdfPath& bprimId) override {
+        return nullptr;
+    }
+    HdBprim* CreateFallbackBprim(const TfToken& typeId) override {
+        return nullptr;
+    }
+    void DestroyBprim(HdBprim* bprim) override { }
+
+    void CommitResources(HdChangeTracker* tracker) override { }
+
+    bool IsPauseSupported() const override { return pauseSupported; }
+    bool Pause() override {
+        pauses++;
+        return pauseSupported;
+    }
+    bool Resume() override {
+        resumes++;
+        return pauseSupported;
+    }
+
+private:
+    const TfTokenVector _noTypes;
+    const TfTokenVector _rprimTypes;
+    const TfTokenVector _sprimTypes;
+    HdResourceRegistrySharedPtr _resourceRegistry;
+};
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // HDNUKE_TESTS_STANDINRENDERDELEGATE_H
@@ -0,0 +1,79 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#ifndef HDNUKE_TESTS_TESTGEOMETRY_H
+#define HDNUKE_TESTS_TESTGEOMETRY_H
+
+#include <DDImage/Attribute.h>
+#include <DDImage/GeometryList.h>
+#include <DDImage/Polygon.h>
+
+
+// Builds a grid of `size` by `size` quads as object `obj` of the list, the way
+// a GeoOp's create_geometry would, with point normals, vertex uvs and a
+// per-primitive id, so adapters convert one primvar of each interpolation.
+inline void
+BuildTestGrid(DD::Image::GeometryList& out, int obj, int size)
+{
+    using namespace DD::Image;
+
+    const int rowPoints = size + 1;
+    out.add_object(obj);
+
+    PointList* points = out.writable_points(obj);
+    points->resize(static_cast<size_t>(rowPoints * rowPoints));
+    for (int y = 0; y < rowPoints; y++)
+    {
+        for (int x = 0; x < rowPoints; x++)
+        {
+            (*points)[y * rowPoints + x] = Vector3(
+                static_cast<float>(x), static_cast<float>(y),
+                static_cast<float>(obj));
+        }
+    }
+
+    for (int y = 0; y < size; y++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            const unsigned p = static_cast<unsigned>(y * rowPoints + x);
+            out.add_primitive(obj, new Polygon(p, p + 1, p + 1 + rowPoints,
+                                               p + rowPoints, true));
+        }
+    }
+
+    Attribute* normals = out.writable_attribute(obj, Group_Points, "N",
+                                                NORMAL_ATTRIB);
+    for (unsigned i = 0; i < normals->size(); i++)
+    {
+        normals->normal(i) = Vector3(0, 0, 1);
+    }
+
+    Attribute* uvs = out.writable_attribute(obj, Group_Vertices, "uv",
+                                            VECTOR4_ATTRIB);
+    for (unsigned i = 0; i < uvs->size(); i++)
+    {
+        uvs->vector4(i).set(static_cast<float>(i % 4 == 1 or i % 4 == 2),
+                            static_cast<float>(i % 4 >= 2), 0, 1);
+    }
+
+    Attribute* ids = out.writable_attribute(obj, Group_Primitives, "faceId",
+                                            INT_ATTRIB);
+    for (unsigned i = 0; i < ids->size(); i++)
+    {
+        ids->integer(i) = static_cast<int>(i);
+    }
+}
+
+#endif  // HDNUKE_TESTS_TESTGEOMETRY_H
@@ -0,0 +1,194 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#include <pxr/pxr.h>
+
+#include <pxr/base/tf/diagnostic.h>
+#include <pxr/base/vt/types.h>
+
+#include <pxr/imaging/hd/changeTracker.h>
+#include <pxr/imaging/hd/tokens.h>
+
+#include <DDImage/GeometryList.h>
+
+#include <hdNuke/arrayPool.h>
+#include <hdNuke/geoAdapter.h>
+
+#include "testGeometry.h"
+
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+
+namespace
+{
+    VtFloatArray _MakeFloats(size_t size, float offset)
+    {
+        VtFloatArray floats(size);
+        for (size_t i = 0; i < size; i++)
+        {
+            floats[i] = offset + static_cast<float>(i);
+        }
+        return floats;
+    }
+
+    const void* _Data(const VtValue& value)
+    {
+        if (value.IsHolding<VtVec3fArray>()) {
+            return value.UncheckedGet<VtVec3fArray>().cdata();
+        }
+        if (value.IsHolding<VtFloatArray>()) {
+            return value.UncheckedGet<VtFloatArray>().cdata();
+        }
+        if (value.IsHolding<VtIntArray>()) {
+            return value.UncheckedGet<VtIntArray>().cdata();
+        }
+        return nullptr;
+    }
+
+    void TestShareIdentical()
+    {
+        HdNukeArrayPool pool;
+        // Equal contents, but built separately, the way two adapters would.
+        const HdNukeSharedValue first =
+            pool.Intern(VtValue(_MakeFloats(100, 0)));
+        const HdNukeSharedValue second =
+            pool.Intern(VtValue(_MakeFloats(100, 0)));
+        TF_AXIOM(first == second);
+        TF_AXIOM(_Data(*first) == _Data(*second));
+        TF_AXIOM(pool.GetSize() == 1);
+
+        const HdNukeSharedValue other =
+            pool.Intern(VtValue(_MakeFloats(100, 1)));
+        TF_AXIOM(other != first);
+        TF_AXIOM(pool.GetSize() == 2);
+
+        // Values that can't be hashed are only wrapped.
+        TF_AXIOM(HdNukeArrayPool::HashArray(VtValue(1.0f)) == 0);
+        TF_AXIOM(HdNukeArrayPool::HashArray(VtValue(VtFloatArray())) == 0);
+        const HdNukeSharedValue scalar = pool.Intern(VtValue(1.0f));
+        TF_AXIOM(scalar != pool.Intern(VtValue(1.0f)));
+        TF_AXIOM(pool.GetSize() == 2);
+    }
+
+    void TestTypesNotShared()
+    {
+        const VtFloatArray floats = _MakeFloats(64, 0.5f);
+        VtIntArray ints(floats.size());
+        std::memcpy(ints.data(), floats.cdata(), floats.size() * sizeof(float));
+
+        TF_AXIOM(HdNukeArrayPool::HashArray(VtValue(floats))
+                 != HdNukeArrayPool::HashArray(VtValue(ints)));
+
+        HdNukeArrayPool pool;
+        const HdNukeSharedValue pooledFloats = pool.Intern(VtValue(floats));
+        const HdNukeSharedValue pooledInts = pool.Intern(VtValue(ints));
+        TF_AXIOM(pooledFloats != pooledInts);
+        TF_AXIOM(pooledFloats->IsHolding<VtFloatArray>());
+        TF_AXIOM(pooledInts->IsHolding<VtIntArray>());
+        TF_AXIOM(_Data(*pooledFloats) != _Data(*pooledInts));
+    }
+
+    void TestPruneExpired()
+    {
+        HdNukeArrayPool pool;
+        const HdNukeSharedValue kept =
+            pool.Intern(VtValue(_MakeFloats(16, -1)));
+
+        // Values nothing holds on to any more are pruned as the pool grows,
+        // while the ones still in use stay pooled.
+        for (int i = 0; i < 1000; i++)
+        {
+            pool.Intern(VtValue(_MakeFloats(16, static_cast<float>(i))));
+        }
+        TF_AXIOM(pool.GetSize() < 256);
+        TF_AXIOM(pool.Intern(VtValue(_MakeFloats(16, -1))) == kept);
+
+        // An expired value is interned anew, from the array given.
+        pool.Intern(VtValue(_MakeFloats(16, -2)));
+        const VtFloatArray recreated = _MakeFloats(16, -2);
+        TF_AXIOM(_Data(*pool.Intern(VtValue(recreated))) == recreated.cdata());
+    }
+
+    void TestMerge()
+    {
+        HdNukeArrayPool pool;
+        const HdNukeSharedValue existing =
+            pool.Intern(VtValue(_MakeFloats(32, 0)));
+
+        // A copy that adapters were converted against on another thread.
+        HdNukeArrayPool staged = pool;
+        const HdNukeSharedValue stagedExisting =
+            staged.Intern(VtValue(_MakeFloats(32, 0)));
+        TF_AXIOM(stagedExisting == existing);
+        const HdNukeSharedValue added =
+            staged.Intern(VtValue(_MakeFloats(32, 1)));
+        staged.Intern(VtValue(_MakeFloats(32, 2)));  // Expires right away
+        TF_AXIOM(staged.GetSize() == 3);
+
+        // Only live values this pool doesn't hold yet are added.
+        pool.Merge(staged);
+        TF_AXIOM(pool.GetSize() == 2);
+        TF_AXIOM(pool.Intern(VtValue(_MakeFloats(32, 0))) == existing);
+        TF_AXIOM(pool.Intern(VtValue(_MakeFloats(32, 1))) == added);
+
+        pool.Merge(staged);
+        TF_AXIOM(pool.GetSize() == 2);
+    }
+
+    void TestShareBetweenAdapters()
+    {
+        DD::Image::GeometryList geometry;
+        BuildTestGrid(geometry, 0, 8);
+
+        AdapterSharedState sharedState;
+        HdNukeGeoAdapter first(&sharedState);
+        HdNukeGeoAdapter second(&sharedState);
+        first.Update(geometry[0], HdChangeTracker::AllDirty, false);
+        second.Update(geometry[0], HdChangeTracker::AllDirty, false);
+
+        for (const TfToken& name : {HdTokens->points, HdTokens->normals})
+        {
+            const VtValue firstValue = first.Get(name);
+            TF_AXIOM(_Data(firstValue) != nullptr);
+            TF_AXIOM(_Data(firstValue) == _Data(second.Get(name)));
+        }
+
+        // Adapters of another scene have their own pool.
+        AdapterSharedState otherState;
+        HdNukeGeoAdapter other(&otherState);
+        other.Update(geometry[0], HdChangeTracker::AllDirty, false);
+        TF_AXIOM(other.Get(HdTokens->points) == first.Get(HdTokens->points));
+        TF_AXIOM(_Data(other.Get(HdTokens->points))
+                 != _Data(first.Get(HdTokens->points)));
+    }
+}  // namespace
+
+
+int
+main(int argc, char* argv[])
+{
+    TestShareIdentical();
+    TestTypesNotShared();
+    TestPruneExpired();
+    TestMerge();
+    TestShareBetweenAdapters();
+
+    printf("OK\n");
+    return 0;
+}
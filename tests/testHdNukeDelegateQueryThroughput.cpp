@@ -0,0 +1,256 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+#include <pxr/pxr.h>
+
+#include <pxr/base/tf/diagnostic.h>
+#include <pxr/base/tf/stringUtils.h>
+#include <pxr/base/work/loops.h>
+
+#include <pxr/imaging/hd/renderIndex.h>
+#include <pxr/imaging/hd/tokens.h>
+
+#include <DDImage/GeometryList.h>
+
+#include <hdNuke/geoAdapter.h>
+#include <hdNuke/sceneDelegate.h>
+
+#include "standInRenderDelegate.h"
+#include "testGeometry.h"
+
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const int _NumPrims = 50000;
+    const int _Repeats = 5;
+    // Large enough for reduced precision packing.
+    const int _PackedGridSize = 32;
+    const int _NumPackedPrims = 2000;
+
+    // Serves prims registered directly, rather than synced from a Nuke scene,
+    // so the registry lookups can be timed on their own.
+    class _BenchDelegate : public HdNukeSceneDelegate
+    {
+    public:
+        using HdNukeSceneDelegate::HdNukeSceneDelegate;
+
+        void AddGeo(const SdfPath& id, const HdNukeGeoAdapterPtr& adapter)
+        {
+            _RegisterAdapter(id, _PrimHandle::Geo, adapter);
+        }
+    };
+
+    double _SecondsSince(const Clock::time_point& start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // The queries a render delegate makes for each mesh during a sync. Returns
+    // a checksum of the results, and adds the number of queries made.
+    size_t _QueryPrim(HdSceneDelegate& delegate, const SdfPath& id,
+                      size_t& queries)
+    {
+        size_t work = 0;
+        queries += 8;
+        work += delegate.GetVisible(id) ? 1 : 0;
+        work += delegate.GetTransform(id)[3][3] == 1.0 ? 1 : 0;
+        work += delegate.GetExtent(id).IsEmpty() ? 0 : 1;
+        work += delegate.GetMeshTopology(id).GetNumFaces();
+        for (HdInterpolation interpolation : {HdInterpolationConstant,
+                                              HdInterpolationUniform,
+                                              HdInterpolationVertex,
+                                              HdInterpolationFaceVarying})
+        {
+            for (const auto& descriptor :
+                    delegate.GetPrimvarDescriptors(id, interpolation))
+            {
+                work += delegate.Get(id, descriptor.name).IsEmpty() ? 0 : 1;
+                queries++;
+            }
+        }
+        return work;
+    }
+
+    void _Report(const char* label, double seconds, size_t queries)
+    {
+        printf("%-28s %8.1f ms  %7.2f M queries/s\n", label,
+               seconds * 1000.0, static_cast<double>(queries) / seconds / 1.0e6);
+    }
+}  // namespace
+
+
+int
+main(int argc, char* argv[])
+{
+    DD::Image::GeometryList geometry;
+    BuildTestGrid(geometry, 0, 4);
+    BuildTestGrid(geometry, 1, _PackedGridSize);
+    const DD::Image::GeoInfo& geoInfo = geometry[0];
+
+    AdapterSharedState sharedState;
+
+    StandInRenderDelegate renderDelegate;
+    std::unique_ptr<HdRenderIndex> renderIndex(
+        HdRenderIndex::New(&renderDelegate));
+    HdNukeSceneDataPtr sceneData = std::make_shared<HdNukeSceneData>();
+    _BenchDelegate delegate(renderIndex.get(), sceneData);
+    std::vector<SdfPath> ids;
+    std::vector<HdNukeGeoAdapterPtr> adapters;
+    ids.reserve(_NumPrims);
+    adapters.reserve(_NumPrims);
+    for (int i = 0; i < _NumPrims; i++)
+    {
+        ids.push_back(delegate.GetConfig().GeoRoot().AppendChild(
+            TfToken(TfStringPrintf("node%d", i / 100)))
+            .AppendChild(TfToken(TfStringPrintf("obj%d", i % 100))));
+        adapters.push_back(std::make_shared<HdNukeGeoAdapter>(&sharedState));
+        adapters.back()->Update(geoInfo, HdChangeTracker::AllDirty, false);
+    }
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < _NumPrims; i++)
+    {
+        delegate.AddGeo(ids[i], adapters[i]);
+    }
+    printf("%-28s %8.1f ms\n", "register", _SecondsSince(start) * 1000.0);
+
+    // A sync of an unchanged scene registers every prim again.
+    start = Clock::now();
+    for (int i = 0; i < _NumPrims; i++)
+    {
+        delegate.AddGeo(ids[i], adapters[i]);
+    }
+    printf("%-28s %8.1f ms\n", "re-register unchanged", _SecondsSince(start) * 1000.0);
+
+    // Points, normals, st and faceId, plus the display color.
+    size_t queriesPerPrim = 0;
+    const size_t expected = _QueryPrim(delegate, ids[0], queriesPerPrim);
+    TF_AXIOM(queriesPerPrim == 13);
+
+    start = Clock::now();
+    size_t serialWork = 0;
+    size_t serialQueries = 0;
+    for (int r = 0; r < _Repeats; r++)
+    {
+        for (const SdfPath& id : ids)
+        {
+            serialWork += _QueryPrim(delegate, id, serialQueries);
+        }
+    }
+    _Report("serial queries", _SecondsSince(start), serialQueries);
+    TF_AXIOM(serialWork == expected * _NumPrims * _Repeats);
+
+    start = Clock::now();
+    std::atomic<size_t> parallelWork(0);
+    std::atomic<size_t> parallelQueries(0);
+    for (int r = 0; r < _Repeats; r++)
+    {
+        WorkParallelForN(ids.size(), [&](size_t begin, size_t end) {
+            size_t work = 0;
+            size_t queries = 0;
+            for (size_t i = begin; i < end; i++)
+            {
+                work += _QueryPrim(delegate, ids[i], queries);
+            }
+            parallelWork += work;
+            parallelQueries += queries;
+        });
+    }
+    _Report("parallel queries", _SecondsSince(start), parallelQueries);
+    TF_AXIOM(parallelWork == serialWork);
+
+    start = Clock::now();
+    delegate.PostSyncCleanup();
+    printf("%-28s %8.1f ms\n", "post-sync cleanup",
+           _SecondsSince(start) * 1000.0);
+
+    // Reduced precision primvars are widened by their first query of a sync,
+    // and only referenced by the queries that follow until the sync is done.
+    AdapterSharedState packedState;
+    packedState.primvarPrecision = HdNukePrimvarPrecision::Half;
+    std::vector<SdfPath> packedIds;
+    for (int i = 0; i < _NumPackedPrims; i++)
+    {
+        packedIds.push_back(delegate.GetConfig().GeoRoot().AppendChild(
+            TfToken(TfStringPrintf("packed%d", i))));
+        adapters.push_back(std::make_shared<HdNukeGeoAdapter>(&packedState));
+        adapters.back()->Update(geometry[1], HdChangeTracker::AllDirty, false);
+        delegate.AddGeo(packedIds.back(), adapters.back());
+    }
+
+    size_t packedBytes = 0;
+    size_t packedFullBytes = 0;
+    std::unordered_set<const VtValue*> counted;
+    adapters.back()->GetPrimvarMemoryUsage(packedBytes, packedFullBytes,
+                                           counted);
+    TF_AXIOM(packedBytes < packedFullBytes);
+
+    const VtValue widened = delegate.Get(packedIds[0], HdTokens->normals);
+    TF_AXIOM(widened.IsHolding<VtVec3fArray>());
+    TF_AXIOM(delegate.Get(packedIds[0], HdTokens->normals)
+             .UncheckedGet<VtVec3fArray>().cdata()
+             == widened.UncheckedGet<VtVec3fArray>().cdata());
+
+    size_t packedQueriesPerPrim = 0;
+    const size_t packedExpected =
+        _QueryPrim(delegate, packedIds[0], packedQueriesPerPrim);
+    delegate.PostSyncCleanup();
+    TF_AXIOM(delegate.Get(packedIds[0], HdTokens->normals)
+             .UncheckedGet<VtVec3fArray>().cdata()
+             != widened.UncheckedGet<VtVec3fArray>().cdata());
+
+    double wideningSeconds = 0.0;
+    double widenedSeconds = 0.0;
+    size_t wideningQueries = 0;
+    size_t widenedQueries = 0;
+    size_t packedWork = 0;
+    for (int r = 0; r < _Repeats; r++)
+    {
+        // Render delegates may query a primvar more than once per sync, e.g.
+        // for each repr, so every prim is queried twice.
+        start = Clock::now();
+        for (const SdfPath& id : packedIds)
+        {
+            packedWork += _QueryPrim(delegate, id, wideningQueries);
+        }
+        wideningSeconds += _SecondsSince(start);
+
+        start = Clock::now();
+        for (const SdfPath& id : packedIds)
+        {
+            packedWork += _QueryPrim(delegate, id, widenedQueries);
+        }
+        widenedSeconds += _SecondsSince(start);
+
+        delegate.PostSyncCleanup();
+    }
+    _Report("packed queries, widening", wideningSeconds, wideningQueries);
+    _Report("packed queries, widened", widenedSeconds, widenedQueries);
+    TF_AXIOM(packedWork == packedExpected * _NumPackedPrims * _Repeats * 2);
+
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,161 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <pxr/pxr.h>
+
+#include <pxr/base/gf/matrix4f.h>
+#include <pxr/base/gf/vec3f.h>
+#include <pxr/base/tf/diagnostic.h>
+#include <pxr/base/vt/array.h>
+
+#include <hdNuke/packedArray.h>
+
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+
+// Checks that packed arrays round trip within the error bounds documented on
+// HdNukePrimvarPrecision.
+namespace
+{
+    const size_t _Size = 4096;
+
+    template <typename T>
+    VtArray<T> _RandomArray(float minValue, float maxValue, unsigned seed)
+    {
+        std::mt19937 generator(seed);
+        std::uniform_real_distribution<float> distribution(minValue, maxValue);
+        VtArray<T> array(_Size);
+        float* data = reinterpret_cast<float*>(array.data());
+        for (size_t i = 0; i < _Size * sizeof(T) / sizeof(float); i++)
+        {
+            data[i] = distribution(generator);
+        }
+        return array;
+    }
+
+    float _HalfBound(float value)
+    {
+        const float magnitude = std::fabs(value);
+        return magnitude < std::ldexp(1.0f, -14)
+            ? std::ldexp(1.0f, -25) : magnitude * std::ldexp(1.0f, -11);
+    }
+
+    // Returns the largest error divided by its bound.
+    template <typename T>
+    float _CheckRoundTrip(const VtArray<T>& array,
+                          HdNukePrimvarPrecision precision)
+    {
+        HdNukePackedArray packed;
+        TF_AXIOM(packed.Pack(VtValue(array), precision));
+        TF_AXIOM(packed.GetUnpackedMemoryUsage() == _Size * sizeof(T));
+        TF_AXIOM(packed.GetMemoryUsage() < packed.GetUnpackedMemoryUsage());
+
+        const VtValue unpackedValue = packed.Unpack();
+        TF_AXIOM(unpackedValue.IsHolding<VtArray<T>>());
+        const VtArray<T>& unpacked = unpackedValue.UncheckedGet<VtArray<T>>();
+        TF_AXIOM(unpacked.size() == array.size());
+
+        const size_t components = sizeof(T) / sizeof(float);
+        const size_t count = _Size * components;
+        const float* original = reinterpret_cast<const float*>(array.cdata());
+        const float* widened = reinterpret_cast<const float*>(unpacked.cdata());
+
+        std::vector<float> minValues(components, original[0]);
+        std::vector<float> maxValues(components, original[0]);
+        for (size_t i = 0; i < count; i++)
+        {
+            const size_t c = i % components;
+            minValues[c] = std::min(minValues[c], original[i]);
+            maxValues[c] = std::max(maxValues[c], original[i]);
+        }
+
+        float worst = 0.0f;
+        for (size_t i = 0; i < count; i++)
+        {
+            const size_t c = i % components;
+            float bound = _HalfBound(original[i]);
+            if (precision == HdNukePrimvarPrecision::Quantized) {
+                // Allow for the float rounding of the offset and scale.
+                const float largest = std::max(std::fabs(minValues[c]),
+                                               std::fabs(maxValues[c]));
+                bound = (maxValues[c] - minValues[c]) / 131070.0f
+                    + 4.0f * largest * std::numeric_limits<float>::epsilon();
+            }
+            worst = std::max(worst,
+                             std::fabs(widened[i] - original[i]) / bound);
+        }
+        return worst;
+    }
+
+    template <typename T>
+    void TestRoundTrip(const char* name, float minValue, float maxValue,
+                       unsigned seed)
+    {
+        const VtArray<T> array = _RandomArray<T>(minValue, maxValue, seed);
+        for (HdNukePrimvarPrecision precision :
+                {HdNukePrimvarPrecision::Half,
+                 HdNukePrimvarPrecision::Quantized})
+        {
+            const float worst = _CheckRoundTrip(array, precision);
+            printf("%-10s [%g, %g] %-9s worst error %.3f of bound\n", name,
+                   minValue, maxValue,
+                   precision == HdNukePrimvarPrecision::Half
+                       ? "half" : "quantized", worst);
+            TF_AXIOM(worst <= 1.0f);
+        }
+    }
+
+    void TestConstantComponent()
+    {
+        VtVec3fArray array(_Size, GfVec3f(0.5f, -2.0f, 1000.0f));
+        HdNukePackedArray packed;
+        TF_AXIOM(packed.Pack(VtValue(array),
+                             HdNukePrimvarPrecision::Quantized));
+        TF_AXIOM(packed.Unpack() == VtValue(array));
+    }
+
+    void TestUnpackable()
+    {
+        HdNukePackedArray packed;
+        TF_AXIOM(not packed.Pack(VtValue(VtIntArray(_Size, 1)),
+                                 HdNukePrimvarPrecision::Half));
+        TF_AXIOM(not packed.Pack(VtValue(VtFloatArray(_Size, 1.0f)),
+                                 HdNukePrimvarPrecision::Full));
+        TF_AXIOM(packed.IsEmpty());
+    }
+}  // namespace
+
+
+int
+main(int argc, char* argv[])
+{
+    TestRoundTrip<float>("float", 0.0f, 1.0f, 1);
+    TestRoundTrip<float>("float", -1.0e-5f, 1.0e-5f, 2);
+    TestRoundTrip<GfVec3f>("vec3f", -1.0f, 1.0f, 3);
+    TestRoundTrip<GfVec3f>("vec3f", -5000.0f, 5000.0f, 4);
+    TestRoundTrip<GfMatrix4f>("matrix4f", -10.0f, 10.0f, 5);
+    TestConstantComponent();
+    TestUnpackable();
+
+    printf("OK\n");
+    return 0;
+}
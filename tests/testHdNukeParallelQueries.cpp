@@ -0,0 +1,232 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <pxr/pxr.h>
+
+#include <pxr/base/tf/diagnostic.h>
+#include <pxr/base/tf/stringUtils.h>
+#include <pxr/base/work/loops.h>
+
+#include <pxr/imaging/hd/renderIndex.h>
+#include <pxr/imaging/hd/tokens.h>
+
+#include <DDImage/GeometryList.h>
+
+#include <hdNuke/geoAdapter.h>
+#include <hdNuke/sceneDelegate.h>
+
+#include "standInRenderDelegate.h"
+#include "testGeometry.h"
+
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+
+// Queries the delegate from many threads at once, the way render delegates
+// sync their rprims, and checks every result against a serial reference. Meant
+// to be run in a ThreadSanitizer build (HDNUKE_TSAN) as well, which reports
+// any race between the queries.
+namespace
+{
+    const int _NumObjects = 8;
+    const int _GridSize = 32;  // Large enough for reduced precision packing
+    const int _PrimsPerObject = 16;
+    // How many times each prim is queried per round, from different threads.
+    const size_t _QueriesPerPrim = 8;
+    const int _Rounds = 4;
+
+    const HdInterpolation _Interpolations[] = {
+        HdInterpolationConstant,
+        HdInterpolationUniform,
+        HdInterpolationVertex,
+        HdInterpolationFaceVarying
+    };
+
+    class _TestDelegate : public HdNukeSceneDelegate
+    {
+    public:
+        using HdNukeSceneDelegate::HdNukeSceneDelegate;
+
+        void AddGeo(const SdfPath& id, const HdNukeGeoAdapterPtr& adapter)
+        {
+            _RegisterAdapter(id, _PrimHandle::Geo, adapter);
+        }
+    };
+
+    struct _Mode
+    {
+        const char* name;
+        bool lazy;
+        HdNukePrimvarPrecision precision;
+    };
+
+    // What the queries of a prim are expected to return.
+    struct _Reference
+    {
+        HdMeshTopology topology;
+        HdPrimvarDescriptorVector descriptors[HdInterpolationCount];
+        std::unordered_map<TfToken, VtValue, TfToken::HashFunctor> values;
+    };
+
+    _Reference _BuildReference(const DD::Image::GeoInfo& geo,
+                               HdNukePrimvarPrecision precision)
+    {
+        AdapterSharedState state;
+        state.primvarPrecision = precision;
+        HdNukeGeoAdapter adapter(&state);
+        adapter.Update(geo, HdChangeTracker::AllDirty, false);
+
+        _Reference reference;
+        reference.topology = adapter.GetMeshTopology();
+        for (HdInterpolation interpolation : _Interpolations)
+        {
+            reference.descriptors[interpolation] =
+                adapter.GetPrimvarDescriptors(interpolation);
+            for (const auto& descriptor : reference.descriptors[interpolation])
+            {
+                reference.values[descriptor.name] = adapter.Get(descriptor.name);
+            }
+        }
+        return reference;
+    }
+
+    // Returns the number of mismatched results.
+    size_t _QueryPrim(HdSceneDelegate& delegate, const SdfPath& id,
+                      const _Reference& reference)
+    {
+        size_t failures = 0;
+        if (not (delegate.GetMeshTopology(id) == reference.topology)) {
+            failures++;
+        }
+        if (not delegate.GetVisible(id)) {
+            failures++;
+        }
+        delegate.GetTransform(id);
+        delegate.GetExtent(id);
+        for (HdInterpolation interpolation : _Interpolations)
+        {
+            const HdPrimvarDescriptorVector descriptors =
+                delegate.GetPrimvarDescriptors(id, interpolation);
+            if (descriptors != reference.descriptors[interpolation]) {
+                failures++;
+                continue;
+            }
+            for (const auto& descriptor : descriptors)
+            {
+                const VtValue value = delegate.Get(id, descriptor.name);
+                auto it = reference.values.find(descriptor.name);
+                if (it == reference.values.end() or value != it->second) {
+                    failures++;
+                }
+            }
+        }
+        return failures;
+    }
+
+    void TestParallelQueries(const DD::Image::GeometryList& geometry,
+                             const _Mode& mode)
+    {
+        std::vector<_Reference> references;
+        for (int obj = 0; obj < _NumObjects; obj++)
+        {
+            references.push_back(_BuildReference(geometry[obj], mode.precision));
+            TF_AXIOM(references.back().topology.GetNumFaces()
+                     == _GridSize * _GridSize);
+        }
+
+        AdapterSharedState state;
+        state.lazyPrimvars = mode.lazy;
+        state.primvarPrecision = mode.precision;
+
+        StandInRenderDelegate renderDelegate;
+        std::unique_ptr<HdRenderIndex> renderIndex(
+            HdRenderIndex::New(&renderDelegate));
+        _TestDelegate delegate(renderIndex.get(),
+                               std::make_shared<HdNukeSceneData>());
+
+        const size_t numPrims = _NumObjects * _PrimsPerObject;
+        std::vector<SdfPath> ids;
+        for (size_t i = 0; i < numPrims; i++)
+        {
+            ids.push_back(delegate.GetConfig().GeoRoot().AppendChild(
+                TfToken(TfStringPrintf("prim%zu", i))));
+        }
+
+        for (int round = 0; round < _Rounds; round++)
+        {
+            // Fresh adapters, so lazy primvars are converted by the first
+            // (concurrent) queries of each round.
+            std::vector<HdNukeGeoAdapterPtr> adapters;
+            for (size_t i = 0; i < numPrims; i++)
+            {
+                adapters.push_back(std::make_shared<HdNukeGeoAdapter>(&state));
+                adapters.back()->Update(geometry[static_cast<int>(i % _NumObjects)],
+                                        HdChangeTracker::AllDirty, false);
+                delegate.AddGeo(ids[i], adapters.back());
+            }
+
+            // Neighbouring tasks query different prims, so every prim is
+            // queried from several threads at about the same time.
+            std::atomic<size_t> failures(0);
+            WorkParallelForN(numPrims * _QueriesPerPrim,
+                             [&](size_t begin, size_t end) {
+                size_t chunkFailures = 0;
+                for (size_t task = begin; task < end; task++)
+                {
+                    const size_t prim = (task * 7919) % numPrims;
+                    chunkFailures += _QueryPrim(
+                        delegate, ids[prim], references[prim % _NumObjects]);
+                }
+                failures += chunkFailures;
+            });
+            if (failures != 0) {
+                printf("%s: %zu mismatched results in round %d\n", mode.name,
+                       failures.load(), round);
+            }
+            TF_AXIOM(failures == 0);
+        }
+        printf("%s: OK\n", mode.name);
+    }
+}  // namespace
+
+
+int
+main(int argc, char* argv[])
+{
+    DD::Image::GeometryList geometry;
+    for (int obj = 0; obj < _NumObjects; obj++)
+    {
+        BuildTestGrid(geometry, obj, _GridSize);
+    }
+
+    const _Mode modes[] = {
+        {"eager", false, HdNukePrimvarPrecision::Full},
+        {"lazy", true, HdNukePrimvarPrecision::Full},
+        {"eager half", false, HdNukePrimvarPrecision::Half},
+        {"lazy quantized", true, HdNukePrimvarPrecision::Quantized}
+    };
+    for (const _Mode& mode : modes)
+    {
+        TestParallelQueries(geometry, mode);
+    }
+
+    printf("OK\n");
+    return 0;
+}
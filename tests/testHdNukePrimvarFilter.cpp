@@ -0,0 +1,114 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <cstdio>
+
+#include <pxr/pxr.h>
+
+#include <pxr/base/tf/diagnostic.h>
+#include <pxr/base/tf/token.h>
+
+#include <hdNuke/primvarFilter.h>
+
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+
+namespace
+{
+    void TestGlobMatch()
+    {
+        TF_AXIOM(HdNukeGlobMatch("", ""));
+        TF_AXIOM(not HdNukeGlobMatch("", "N"));
+        TF_AXIOM(HdNukeGlobMatch("N", "N"));
+        TF_AXIOM(not HdNukeGlobMatch("N", "uv"));
+        TF_AXIOM(not HdNukeGlobMatch("N", "Nx"));
+        TF_AXIOM(not HdNukeGlobMatch("Nx", "N"));
+
+        // The whole name has to match.
+        TF_AXIOM(HdNukeGlobMatch("*", ""));
+        TF_AXIOM(HdNukeGlobMatch("*", "normals"));
+        TF_AXIOM(HdNukeGlobMatch("no*", "normals"));
+        TF_AXIOM(HdNukeGlobMatch("*als", "normals"));
+        TF_AXIOM(HdNukeGlobMatch("n*m*s", "normals"));
+        TF_AXIOM(not HdNukeGlobMatch("no*", "uv"));
+        TF_AXIOM(not HdNukeGlobMatch("*al", "normals"));
+
+        TF_AXIOM(HdNukeGlobMatch("?", "N"));
+        TF_AXIOM(not HdNukeGlobMatch("?", ""));
+        TF_AXIOM(not HdNukeGlobMatch("?", "uv"));
+        TF_AXIOM(HdNukeGlobMatch("u?", "uv"));
+        TF_AXIOM(HdNukeGlobMatch("*?", "uv"));
+        TF_AXIOM(not HdNukeGlobMatch("???", "uv"));
+
+        // A "*" backtracks when what follows it fails to match further on.
+        TF_AXIOM(HdNukeGlobMatch("*ab", "aab"));
+        TF_AXIOM(HdNukeGlobMatch("a*b*c", "abbbcbc"));
+        TF_AXIOM(not HdNukeGlobMatch("a*b*c", "abbbcb"));
+        TF_AXIOM(HdNukeGlobMatch("**", "vel"));
+        TF_AXIOM(HdNukeGlobMatch("v**l", "vel"));
+    }
+
+    void TestFilter()
+    {
+        const TfToken N("N");
+        const TfToken normals("normals");
+        const TfToken uv("uv");
+        const TfToken st("st");
+        const TfToken Cf("Cf");
+
+        // Everything is allowed by default.
+        HdNukePrimvarFilter filter;
+        TF_AXIOM(filter.IsAllowed(N, normals));
+        TF_AXIOM(filter.IsAllowed(uv, st));
+
+        // Patterns match either the attribute or the primvar name.
+        TF_AXIOM(filter.SetPatterns("normals uv", ""));
+        TF_AXIOM(not filter.SetPatterns("normals uv", ""));
+        TF_AXIOM(filter.IsAllowed(N, normals));
+        TF_AXIOM(filter.IsAllowed(uv, st));
+        TF_AXIOM(not filter.IsAllowed(Cf, Cf));
+
+        // Denied names win over allowed ones.
+        TF_AXIOM(filter.SetPatterns("*", "C? s*"));
+        TF_AXIOM(filter.IsAllowed(N, normals));
+        TF_AXIOM(not filter.IsAllowed(uv, st));
+        TF_AXIOM(not filter.IsAllowed(Cf, Cf));
+
+        // Results are cached by both names, so an attribute converted to a
+        // differently named primvar is filtered on its own.
+        TF_AXIOM(filter.SetPatterns("", "normals"));
+        TF_AXIOM(not filter.IsAllowed(N, normals));
+        TF_AXIOM(filter.IsAllowed(N, N));
+        TF_AXIOM(not filter.IsAllowed(N, normals));
+        TF_AXIOM(filter.IsAllowed(Cf, Cf));
+        TF_AXIOM(not filter.IsAllowed(Cf, normals));
+
+        // New patterns drop the cached results.
+        TF_AXIOM(filter.SetPatterns("", ""));
+        TF_AXIOM(filter.IsAllowed(N, normals));
+        TF_AXIOM(filter.IsAllowed(Cf, normals));
+    }
+}  // namespace
+
+
+int
+main(int argc, char* argv[])
+{
+    TestGlobMatch();
+    TestFilter();
+
+    printf("OK\n");
+    return 0;
+}
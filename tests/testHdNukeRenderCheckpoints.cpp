@@ -0,0 +1,159 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <pxr/pxr.h>
+
+#include <pxr/base/arch/fileSystem.h>
+#include <pxr/base/arch/systemInfo.h>
+#include <pxr/base/tf/diagnostic.h>
+#include <pxr/base/tf/fileUtils.h>
+#include <pxr/base/tf/pathUtils.h>
+#include <pxr/base/tf/stringUtils.h>
+
+#include <hdNuke/renderCheckpoints.h>
+
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+
+namespace
+{
+    // A 3x2 image whose pixels all differ, so flipped or swapped rows and
+    // channels show up.
+    HdNukeExrImage _Image(const std::vector<std::string>& names, float offset)
+    {
+        HdNukeExrImage image;
+        image.Resize(3, 2, names);
+        for (size_t i = 0; i < image.pixels.size(); i++)
+        {
+            image.pixels[i] = offset + static_cast<float>(i);
+        }
+        return image;
+    }
+
+    // Files list their channels by name, so they may come back in another
+    // order.
+    bool _SameImage(const HdNukeExrImage& a, const HdNukeExrImage& b)
+    {
+        if (a.width != b.width or a.height != b.height
+                or a.channelNames.size() != b.channelNames.size()) {
+            return false;
+        }
+        const size_t numPixels = static_cast<size_t>(a.width) * a.height;
+        for (size_t c = 0; c < a.channelNames.size(); c++)
+        {
+            const int other = b.FindChannel(a.channelNames[c]);
+            if (other < 0 or not std::equal(
+                    a.Channel(c), a.Channel(c) + numPixels,
+                    b.Channel(static_cast<size_t>(other)))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void TestBlend()
+    {
+        const std::vector<std::string> rgbaz = {"R", "G", "B", "A", "Z"};
+        const std::vector<std::string> rgba = {"R", "G", "B", "A"};
+
+        HdNukeExrImage resumed = _Image(rgbaz, 0.0f);
+        HdNukeExrImage image = _Image(rgbaz, 0.0f);
+        for (size_t c = 0; c < rgbaz.size(); c++)
+        {
+            std::fill(image.Channel(c), image.Channel(c) + 6, 1.0f);
+            std::fill(resumed.Channel(c), resumed.Channel(c) + 6, 0.0f);
+        }
+
+        // One new pass on top of three resumed ones.
+        TF_AXIOM(HdNukeRenderCheckpoints::Blend(&image, 1, resumed, 3, rgba));
+        for (size_t c = 0; c < 4; c++)
+        {
+            for (int i = 0; i < 6; i++)
+            {
+                TF_AXIOM(image.Channel(c)[i] == 0.25f);
+            }
+        }
+        // Depth comes from the latest pass.
+        TF_AXIOM(image.Channel(4)[0] == 1.0f);
+
+        // Without new passes, the resumed image is all there is.
+        HdNukeExrImage fresh = _Image(rgbaz, 5.0f);
+        TF_AXIOM(HdNukeRenderCheckpoints::Blend(&fresh, 0, resumed, 3, rgba));
+        TF_AXIOM(fresh.Channel(0)[0] == 0.0f);
+
+        // Channels missing from the resumed image are left alone.
+        HdNukeExrImage partial = _Image({"R"}, 0.0f);
+        HdNukeExrImage withAlpha = _Image({"R", "A"}, 8.0f);
+        TF_AXIOM(HdNukeRenderCheckpoints::Blend(&withAlpha, 1, partial, 1, rgba));
+        TF_AXIOM(withAlpha.Channel(0)[0] == 4.0f);
+        TF_AXIOM(withAlpha.Channel(1)[0] == 14.0f);
+
+        // Images of another size aren't blended.
+        HdNukeExrImage other;
+        other.Resize(4, 2, rgbaz);
+        const HdNukeExrImage before = image;
+        TF_AXIOM(not HdNukeRenderCheckpoints::Blend(&image, 1, other, 3, rgba));
+        TF_AXIOM(image.pixels == before.pixels);
+    }
+
+    void TestRoundTrip()
+    {
+        const std::string directory = TfStringCatPaths(
+            ArchGetTmpDir(),
+            TfStringPrintf("testHdNukeRenderCheckpoints_%d", ArchGetProcessId()));
+
+        HdNukeRenderCheckpoints checkpoints;
+        checkpoints.SetDirectory(directory);
+        TF_AXIOM(checkpoints.GetDirectory() == directory);
+
+        HdNukeExrImage image;
+        int iterations = 0;
+        TF_AXIOM(not checkpoints.Load("frame", &image, &iterations));
+
+        const HdNukeExrImage stored = _Image({"R", "G", "B", "A", "Z"}, 0.5f);
+        TF_AXIOM(checkpoints.Store("frame", HdNukeExrImage(stored), 7));
+        // Loading waits for the snapshot to be written.
+        TF_AXIOM(checkpoints.Load("frame", &image, &iterations));
+        TF_AXIOM(iterations == 7);
+        TF_AXIOM(_SameImage(image, stored));
+
+        // A newer snapshot replaces the last one.
+        const HdNukeExrImage newer = _Image({"R", "G", "B", "A", "Z"}, 2.0f);
+        TF_AXIOM(checkpoints.Store("frame", HdNukeExrImage(newer), 9, true));
+        TF_AXIOM(checkpoints.Load("frame", &image, &iterations));
+        TF_AXIOM(iterations == 9);
+        TF_AXIOM(_SameImage(image, newer));
+
+        checkpoints.Remove("frame");
+        TF_AXIOM(not checkpoints.Load("frame", &image, &iterations));
+        TfRmTree(directory);
+    }
+}  // namespace
+
+
+int
+main(int argc, char* argv[])
+{
+    TestBlend();
+    TestRoundTrip();
+
+    printf("OK\n");
+    return 0;
+}
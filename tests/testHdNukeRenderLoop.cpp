@@ -0,0 +1,304 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <pxr/pxr.h>
+
+#include <pxr/base/tf/diagnostic.h>
+
+#include <hdNuke/renderLoop.h>
+#include <hdNuke/renderStack.h>
+
+#include "standInRenderDelegate.h"
+
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+
+namespace
+{
+    // A render stack around a stand-in delegate, rendered the way
+    // HydraRender does: every pass may take a fixed time, the image converges
+    // after a given number of passes, and interrupting the loop pauses the
+    // stack.
+    struct _TestRender
+    {
+        StandInRenderDelegate* renderDelegate;
+        HydraRenderStack stack;
+
+        std::chrono::milliseconds passTime{0};
+        int convergeAfter = 0;  // Never, if zero
+        int executed = 0;
+
+        _TestRender(bool pauseSupported = true)
+            : renderDelegate(new StandInRenderDelegate()),
+              stack(renderDelegate, std::make_shared<HdNukeSceneData>())
+        {
+            renderDelegate->pauseSupported = pauseSupported;
+        }
+
+        void Bind(HdNukeRenderLoop& loop)
+        {
+            loop.execute = [this](bool* converged) {
+                // The stack must be resumed before its tasks run again.
+                TF_AXIOM(not stack.IsRenderingPaused());
+                std::this_thread::sleep_for(passTime);
+                executed++;
+                *converged = convergeAfter > 0 and executed >= convergeAfter;
+                return true;
+            };
+            loop.pause = [this]() { stack.PauseRendering(); };
+        }
+    };
+
+    // An interrupt raised during pass k must stop the loop before pass k+1,
+    // and pause the delegate once.
+    void TestInterruptBetweenPasses()
+    {
+        for (int k = 1; k <= 4; k++)
+        {
+            _TestRender render;
+
+            HdNukeRenderLoop loop;
+            render.Bind(loop);
+            loop.interrupted = [&render, k]() { return render.executed >= k; };
+
+            TF_AXIOM(loop.Run() == HdNukeRenderLoop::Interrupted);
+            TF_AXIOM(render.executed == k);
+            TF_AXIOM(loop.GetIterations() == k);
+            TF_AXIOM(render.stack.IsRenderingPaused());
+            TF_AXIOM(render.renderDelegate->pauses == 1);
+        }
+    }
+
+    // Interrupting from another thread, as Nuke does when a new request
+    // arrives, stops the loop after the pass that is running, whenever the
+    // interrupt arrives. Resuming the stack lets the next render continue.
+    void TestCancelFromAnotherThread()
+    {
+        for (int k = 1; k <= 3; k++)
+        {
+            _TestRender render;
+
+            std::mutex mutex;
+            std::condition_variable signal;
+            bool passRunning = false;
+            bool requested = false;
+
+            HdNukeRenderLoop loop;
+            render.Bind(loop);
+            const auto execute = loop.execute;
+            loop.execute = [&, k](bool* converged) {
+                if (render.executed + 1 == k) {
+                    // Hold pass k until the interrupt has been raised.
+                    std::unique_lock<std::mutex> lock(mutex);
+                    passRunning = true;
+                    signal.notify_all();
+                    signal.wait(lock, [&requested]() { return requested; });
+                }
+                return execute(converged);
+            };
+            loop.interrupted = [&]() {
+                std::lock_guard<std::mutex> lock(mutex);
+                return requested;
+            };
+
+            std::thread requester([&]() {
+                std::unique_lock<std::mutex> lock(mutex);
+                signal.wait(lock, [&passRunning]() { return passRunning; });
+                requested = true;
+                signal.notify_all();
+            });
+            const HdNukeRenderLoop::Result result = loop.Run();
+            requester.join();
+
+            TF_AXIOM(result == HdNukeRenderLoop::Interrupted);
+            TF_AXIOM(render.executed == k);
+            TF_AXIOM(render.renderDelegate->pauses == 1);
+            TF_AXIOM(render.renderDelegate->resumes == 0);
+
+            // Further interrupts don't pause the delegate again.
+            render.stack.PauseRendering();
+            TF_AXIOM(render.renderDelegate->pauses == 1);
+
+            render.stack.ResumeRendering();
+            TF_AXIOM(not render.stack.IsRenderingPaused());
+            TF_AXIOM(render.renderDelegate->resumes == 1);
+
+            HdNukeRenderLoop next;
+            render.Bind(next);
+            render.convergeAfter = k + 2;
+            TF_AXIOM(next.Run() == HdNukeRenderLoop::Converged);
+            TF_AXIOM(render.executed == k + 2);
+            TF_AXIOM(render.renderDelegate->pauses == 1);
+        }
+    }
+
+    // A delegate that can't pause keeps rendering in the background, so there
+    // is nothing to resume.
+    void TestPauseUnsupported()
+    {
+        _TestRender render(false);
+
+        HdNukeRenderLoop loop;
+        render.Bind(loop);
+        loop.interrupted = [&render]() { return render.executed >= 1; };
+
+        TF_AXIOM(loop.Run() == HdNukeRenderLoop::Interrupted);
+        TF_AXIOM(not render.stack.IsRenderingPaused());
+        TF_AXIOM(render.renderDelegate->pauses == 0);
+
+        render.stack.ResumeRendering();
+        TF_AXIOM(render.renderDelegate->resumes == 0);
+    }
+
+    // A render sliced by the viewer's frame rate is continued by the next
+    // Run, where it left off, until it converges.
+    void TestSlices()
+    {
+        _TestRender render;
+        render.passTime = std::chrono::milliseconds(2);
+        render.convergeAfter = 4;
+
+        int runs = 0;
+        int iterations = 0;
+        double renderTime = 0.0;
+        HdNukeRenderLoop::Result result;
+        do {
+            HdNukeRenderLoop loop;
+            render.Bind(loop);
+            // Shorter than a pass, so every slice ends after one.
+            loop.sliceTime = 0.001;
+            loop.startIteration = iterations;
+            loop.startTime = renderTime;
+            result = loop.Run();
+
+            runs++;
+            iterations += loop.GetIterations();
+            renderTime += loop.GetElapsed();
+            TF_AXIOM(loop.GetIterations() == 1);
+            TF_AXIOM(result == HdNukeRenderLoop::Sliced
+                     or result == HdNukeRenderLoop::Converged);
+        }
+        while (result == HdNukeRenderLoop::Sliced and runs < 10);
+
+        TF_AXIOM(result == HdNukeRenderLoop::Converged);
+        TF_AXIOM(runs == 4);
+        TF_AXIOM(render.executed == 4);
+        TF_AXIOM(iterations == 4);
+        // Slices don't stop the delegate.
+        TF_AXIOM(render.renderDelegate->pauses == 0);
+
+        // The time budget covers every slice of the render, and stops it for
+        // good once it runs out.
+        HdNukeRenderLoop loop;
+        render.Bind(loop);
+        render.convergeAfter = 0;
+        loop.sliceTime = 0.001;
+        loop.timeBudget = 0.001;
+        loop.startTime = renderTime;
+        TF_AXIOM(loop.Run() == HdNukeRenderLoop::TimeLimit);
+        TF_AXIOM(loop.GetIterations() == 1);
+
+        // So do the iterations.
+        HdNukeRenderLoop last;
+        render.Bind(last);
+        last.maxIterations = 5;
+        last.startIteration = 5;
+        last.sliceTime = 0.001;
+        TF_AXIOM(last.Run() == HdNukeRenderLoop::IterationLimit);
+        TF_AXIOM(last.GetIterations() == 0);
+    }
+
+    void TestLimits()
+    {
+        {
+            _TestRender render;
+            render.convergeAfter = 3;
+
+            HdNukeRenderLoop loop;
+            render.Bind(loop);
+            TF_AXIOM(loop.Run() == HdNukeRenderLoop::Converged);
+            TF_AXIOM(render.executed == 3);
+            TF_AXIOM(render.renderDelegate->pauses == 0);
+        }
+        {
+            _TestRender render;
+
+            HdNukeRenderLoop loop;
+            render.Bind(loop);
+            loop.maxIterations = 5;
+            loop.startIteration = 2;
+            TF_AXIOM(loop.Run() == HdNukeRenderLoop::IterationLimit);
+            TF_AXIOM(render.executed == 3);
+            TF_AXIOM(render.renderDelegate->pauses == 0);
+        }
+        {
+            _TestRender render;
+            render.passTime = std::chrono::milliseconds(10);
+
+            HdNukeRenderLoop loop;
+            render.Bind(loop);
+            loop.timeBudget = 0.05;
+            TF_AXIOM(loop.Run() == HdNukeRenderLoop::TimeLimit);
+            TF_AXIOM(render.executed >= 1);
+        }
+        {
+            _TestRender render;
+
+            HdNukeRenderLoop loop;
+            render.Bind(loop);
+            loop.afterPass = [&render](bool) { return render.executed == 2; };
+            TF_AXIOM(loop.Run() == HdNukeRenderLoop::Finished);
+            TF_AXIOM(render.executed == 2);
+        }
+        {
+            HdNukeRenderLoop loop;
+            loop.execute = [](bool*) { return false; };
+            TF_AXIOM(loop.Run() == HdNukeRenderLoop::Failed);
+            TF_AXIOM(loop.GetIterations() == 0);
+        }
+        {
+            // A pass that gives up because of an interruption.
+            bool interrupt = false;
+            HdNukeRenderLoop loop;
+            loop.interrupted = [&interrupt]() { return interrupt; };
+            loop.execute = [&interrupt](bool*) {
+                interrupt = true;
+                return false;
+            };
+            TF_AXIOM(loop.Run() == HdNukeRenderLoop::Interrupted);
+        }
+    }
+}  // namespace
+
+
+int
+main(int argc, char* argv[])
+{
+    TestInterruptBetweenPasses();
+    TestCancelFromAnotherThread();
+    TestPauseUnsupported();
+    TestSlices();
+    TestLimits();
+
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,323 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <pxr/pxr.h>
+
+#include <pxr/base/gf/matrix4d.h>
+#include <pxr/base/gf/vec3d.h>
+#include <pxr/base/gf/vec3f.h>
+#include <pxr/base/tf/diagnostic.h>
+
+#include <pxr/imaging/hd/changeTracker.h>
+#include <pxr/imaging/hd/light.h>
+#include <pxr/imaging/hd/renderIndex.h>
+#include <pxr/imaging/hd/tokens.h>
+#include <pxr/imaging/pxOsd/tokens.h>
+
+#include <hdNuke/renderServerProtocol.h>
+#include <renderServer/remoteSceneDelegate.h>
+
+#include "standInRenderDelegate.h"
+
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+
+namespace
+{
+    const SdfPath& _MeshId()
+    {
+        static const SdfPath id("/HdNuke/Geo/mesh");
+        return id;
+    }
+
+    const SdfPath& _LightId()
+    {
+        static const SdfPath id("/HdNuke/Lights/key");
+        return id;
+    }
+
+    HdMeshTopology _QuadTopology()
+    {
+        return HdMeshTopology(PxOsdOpenSubdivTokens->none,
+                              HdTokens->rightHanded,
+                              VtIntArray({4}), VtIntArray({0, 1, 2, 3}));
+    }
+
+    GfMatrix4d _MeshTransform()
+    {
+        return GfMatrix4d(1).SetTranslate(GfVec3d(1, 2, 3));
+    }
+
+    VtVec3fArray _Points()
+    {
+        return VtVec3fArray({GfVec3f(0, 0, 0), GfVec3f(1, 0, 0),
+                             GfVec3f(1, 1, 0), GfVec3f(0, 1, 0)});
+    }
+
+    VtVec2fArray _Uvs()
+    {
+        return VtVec2fArray({GfVec2f(0, 0), GfVec2f(1, 0),
+                             GfVec2f(1, 1), GfVec2f(0, 1)});
+    }
+
+    // An UpdateScene payload, laid out the way HdNukeRenderClient::SyncScene
+    // writes a new mesh and light.
+    HdNukeMessageWriter _FullUpdate()
+    {
+        HdNukeMessageWriter out;
+
+        out.Write(static_cast<uint32_t>(0));  // Removed rprims
+        out.Write(static_cast<uint32_t>(1));
+        out.WritePath(_MeshId());
+        out.WriteToken(HdPrimTypeTokens->mesh);
+        out.Write(static_cast<uint32_t>(HdChangeTracker::AllDirty));
+        out.Write(_MeshTransform());
+        out.Write(static_cast<uint8_t>(1));
+        out.Write(GfVec3d(0, 0, 0));
+        out.Write(GfVec3d(1, 1, 0));
+        out.WriteTopology(_QuadTopology());
+        for (int i = 0; i < HdInterpolationCount; i++)
+        {
+            const HdInterpolation interpolation = static_cast<HdInterpolation>(i);
+            HdPrimvarDescriptorVector descriptors;
+            std::vector<VtValue> values;
+            if (interpolation == HdInterpolationConstant) {
+                descriptors.emplace_back(HdTokens->displayColor, interpolation,
+                                         HdPrimvarRoleTokens->color);
+                values.emplace_back(GfVec3f(0.18f));
+            }
+            else if (interpolation == HdInterpolationVertex) {
+                descriptors.emplace_back(HdTokens->points, interpolation,
+                                         HdPrimvarRoleTokens->point);
+                values.emplace_back(_Points());
+            }
+            else if (interpolation == HdInterpolationFaceVarying) {
+                descriptors.emplace_back(TfToken("st"), interpolation,
+                                         HdPrimvarRoleTokens->textureCoordinate);
+                values.emplace_back(_Uvs());
+            }
+            out.WritePrimvarDescriptors(descriptors);
+            for (const VtValue& value : values)
+            {
+                TF_AXIOM(out.WriteValue(value));
+            }
+        }
+
+        out.Write(static_cast<uint32_t>(0));  // Removed lights
+        out.Write(static_cast<uint32_t>(1));
+        out.WritePath(_LightId());
+        out.WriteToken(HdPrimTypeTokens->sphereLight);
+        out.Write(static_cast<uint32_t>(HdLight::DirtyTransform
+                                        | HdLight::DirtyParams));
+        out.Write(GfMatrix4d(1));
+        out.Write(static_cast<uint32_t>(2));
+        out.WriteToken(HdLightTokens->intensity);
+        out.WriteValue(VtValue(2.5f));
+        out.WriteToken(HdLightTokens->color);
+        out.WriteValue(VtValue(GfVec3f(1.0f, 0.5f, 0.25f)));
+
+        return out;
+    }
+
+    // Moves the mesh, leaving the rest of the scene as it is.
+    HdNukeMessageWriter _TransformUpdate(const GfMatrix4d& transform)
+    {
+        HdNukeMessageWriter out;
+        out.Write(static_cast<uint32_t>(0));
+        out.Write(static_cast<uint32_t>(1));
+        out.WritePath(_MeshId());
+        out.WriteToken(HdPrimTypeTokens->mesh);
+        out.Write(static_cast<uint32_t>(HdChangeTracker::DirtyTransform));
+        out.Write(transform);
+        out.Write(static_cast<uint32_t>(0));
+        out.Write(static_cast<uint32_t>(0));
+        return out;
+    }
+
+    HdNukeMessageWriter _RemoveUpdate()
+    {
+        HdNukeMessageWriter out;
+        out.Write(static_cast<uint32_t>(1));
+        out.WritePath(_MeshId());
+        out.Write(static_cast<uint32_t>(0));
+        out.Write(static_cast<uint32_t>(1));
+        out.WritePath(_LightId());
+        out.Write(static_cast<uint32_t>(0));
+        return out;
+    }
+
+    // Sends a payload through a socket pair, as the client and server do, and
+    // returns what the other end received.
+    std::vector<char> _SendAndReceive(const HdNukeMessageWriter& payload)
+    {
+        int fds[2];
+        TF_AXIOM(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+        // Large payloads don't fit the socket buffer, so send from a thread.
+        bool sent = false;
+        std::thread sender([&]() {
+            sent = HdNukeSendMessage(fds[0], HdNukeRenderServerMessage::UpdateScene,
+                                     payload);
+        });
+
+        HdNukeRenderServerMessage type = HdNukeRenderServerMessage::Quit;
+        std::vector<char> received;
+        const bool ok = HdNukeReceiveMessage(fds[1], &type, &received);
+        sender.join();
+        close(fds[0]);
+        close(fds[1]);
+
+        TF_AXIOM(sent and ok);
+        TF_AXIOM(type == HdNukeRenderServerMessage::UpdateScene);
+        TF_AXIOM(received == payload.GetData());
+        return received;
+    }
+
+    bool _Apply(HdNukeRemoteSceneDelegate& delegate,
+                const HdNukeMessageWriter& payload)
+    {
+        const std::vector<char> data = _SendAndReceive(payload);
+        HdNukeMessageReader reader(data);
+        return delegate.ApplyUpdate(reader);
+    }
+
+    void TestRoundTrip(HdNukeRemoteSceneDelegate& delegate,
+                       const HdNukeRemoteScenePtr& scene)
+    {
+        TF_AXIOM(_Apply(delegate, _FullUpdate()));
+
+        TF_AXIOM(delegate.GetMeshTopology(_MeshId()) == _QuadTopology());
+        TF_AXIOM(delegate.GetTransform(_MeshId()) == _MeshTransform());
+        TF_AXIOM(delegate.GetVisible(_MeshId()));
+        TF_AXIOM(delegate.GetExtent(_MeshId())
+                 == GfRange3d(GfVec3d(0, 0, 0), GfVec3d(1, 1, 0)));
+
+        const HdPrimvarDescriptorVector vertex = delegate.GetPrimvarDescriptors(
+            _MeshId(), HdInterpolationVertex);
+        TF_AXIOM(vertex.size() == 1 and vertex[0].name == HdTokens->points
+                 and vertex[0].role == HdPrimvarRoleTokens->point);
+        const HdPrimvarDescriptorVector faceVarying =
+            delegate.GetPrimvarDescriptors(_MeshId(), HdInterpolationFaceVarying);
+        TF_AXIOM(faceVarying.size() == 1 and faceVarying[0].name == "st");
+        TF_AXIOM(delegate.GetPrimvarDescriptors(
+            _MeshId(), HdInterpolationUniform).empty());
+
+        const VtValue points = delegate.Get(_MeshId(), HdTokens->points);
+        TF_AXIOM(points.IsHolding<VtVec3fArray>()
+                 and points.UncheckedGet<VtVec3fArray>() == _Points());
+        const VtValue uvs = delegate.Get(_MeshId(), TfToken("st"));
+        TF_AXIOM(uvs.IsHolding<VtVec2fArray>()
+                 and uvs.UncheckedGet<VtVec2fArray>() == _Uvs());
+        TF_AXIOM(delegate.Get(_MeshId(), HdTokens->displayColor)
+                 == VtValue(GfVec3f(0.18f)));
+
+        TF_AXIOM(delegate.GetLightParamValue(_LightId(), HdLightTokens->intensity)
+                 == VtValue(2.5f));
+        TF_AXIOM(delegate.GetLightParamValue(_LightId(), HdLightTokens->color)
+                 == VtValue(GfVec3f(1.0f, 0.5f, 0.25f)));
+
+        // A partial update only replaces what it is dirty for.
+        const GfMatrix4d moved = GfMatrix4d(1).SetTranslate(GfVec3d(4, 5, 6));
+        TF_AXIOM(_Apply(delegate, _TransformUpdate(moved)));
+        TF_AXIOM(delegate.GetTransform(_MeshId()) == moved);
+        TF_AXIOM(delegate.GetMeshTopology(_MeshId()) == _QuadTopology());
+        TF_AXIOM(delegate.Get(_MeshId(), HdTokens->points).IsHolding<VtVec3fArray>());
+
+        TF_AXIOM(_Apply(delegate, _RemoveUpdate()));
+        TF_AXIOM(scene->rprims.empty() and scene->lights.empty());
+        TF_AXIOM(delegate.Get(_MeshId(), HdTokens->points).IsEmpty());
+    }
+
+    // Truncated messages are rejected rather than read past their end.
+    void TestMalformed(HdNukeRemoteSceneDelegate& delegate)
+    {
+        const HdNukeMessageWriter payload = _FullUpdate();
+        const std::vector<char>& full = payload.GetData();
+        for (size_t size : {size_t(0), size_t(6), full.size() / 2,
+                            full.size() - 1})
+        {
+            const std::vector<char> truncated(full.begin(), full.begin() + size);
+            HdNukeMessageReader reader(truncated);
+            TF_AXIOM(not delegate.ApplyUpdate(reader));
+        }
+        delegate.Clear();
+    }
+
+    // Waiting on a server that doesn't reply gives up, and an interrupted
+    // wait leaves the reply to be received whole later.
+    void TestTimeoutAndInterrupt()
+    {
+        using Clock = std::chrono::steady_clock;
+
+        int fds[2];
+        TF_AXIOM(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+        HdNukeRenderServerMessage type = HdNukeRenderServerMessage::Quit;
+        std::vector<char> received;
+        const Clock::time_point start = Clock::now();
+        TF_AXIOM(HdNukeReceiveMessage(fds[1], &type, &received, 0.1, nullptr)
+                 == HdNukeReceiveStatus::TimedOut);
+        TF_AXIOM(Clock::now() - start >= std::chrono::milliseconds(100));
+
+        int polls = 0;
+        auto interrupted = [&polls]() { return ++polls == 2; };
+        TF_AXIOM(HdNukeReceiveMessage(fds[1], &type, &received, 0.0, interrupted)
+                 == HdNukeReceiveStatus::Interrupted);
+        TF_AXIOM(polls == 2);
+
+        const HdNukeMessageWriter payload = _FullUpdate();
+        TF_AXIOM(HdNukeSendMessage(fds[0], HdNukeRenderServerMessage::Reply,
+                                   payload));
+        TF_AXIOM(HdNukeReceiveMessage(fds[1], &type, &received, 1.0,
+                                      []() { return true; })
+                 == HdNukeReceiveStatus::Received);
+        TF_AXIOM(type == HdNukeRenderServerMessage::Reply);
+        TF_AXIOM(received == payload.GetData());
+
+        close(fds[0]);
+        TF_AXIOM(HdNukeReceiveMessage(fds[1], &type, &received, 1.0, nullptr)
+                 == HdNukeReceiveStatus::Closed);
+        close(fds[1]);
+    }
+}  // namespace
+
+
+int
+main(int argc, char* argv[])
+{
+    StandInRenderDelegate renderDelegate;
+    std::unique_ptr<HdRenderIndex> renderIndex(
+        HdRenderIndex::New(&renderDelegate));
+    TF_AXIOM(renderIndex);
+
+    HdNukeRemoteScenePtr scene = std::make_shared<HdNukeRemoteScene>();
+    {
+        HdNukeRemoteSceneDelegate delegate(renderIndex.get(), scene);
+        TestRoundTrip(delegate, scene);
+        TestMalformed(delegate);
+    }
+    TestTimeoutAndInterrupt();
+
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,173 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pxr/pxr.h>
+
+#include <pxr/base/gf/vec3d.h>
+#include <pxr/base/tf/diagnostic.h>
+
+#include <hdNuke/renderWorkers.h>
+
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+
+namespace
+{
+    std::vector<std::string> _Partition(const std::string& cpus, size_t workers)
+    {
+        std::vector<std::string> result;
+        std::string error;
+        TF_AXIOM(HdNukePartitionCpus(cpus, workers, &result, &error));
+        TF_AXIOM(error.empty());
+        TF_AXIOM(result.size() == workers);
+        return result;
+    }
+
+    bool _PartitionFails(const std::string& cpus, size_t workers)
+    {
+        std::vector<std::string> result;
+        std::string error;
+        if (HdNukePartitionCpus(cpus, workers, &result, &error)) {
+            return false;
+        }
+        TF_AXIOM(not error.empty());
+        return true;
+    }
+
+    void TestPartitionCpus()
+    {
+        // A single worker without a list is left on all cores.
+        TF_AXIOM(_Partition("", 1) == std::vector<std::string>{""});
+
+        TF_AXIOM(_PartitionFails("a", 1));
+        TF_AXIOM(_PartitionFails("1-", 1));
+        TF_AXIOM(_PartitionFails("0-1-2", 1));
+        TF_AXIOM(_PartitionFails("-1", 1));
+        TF_AXIOM(_PartitionFails("3-1", 1));
+        // Cores the machine doesn't have are dropped.
+        TF_AXIOM(_PartitionFails("999990-999999", 1));
+        TF_AXIOM(_PartitionFails("0", 2));
+
+        TF_AXIOM(_Partition("0", 1) == std::vector<std::string>{"0"});
+
+        const unsigned available = std::thread::hardware_concurrency();
+        if (available < 4) {
+            printf("skipping core splits: only %u cores\n", available);
+            return;
+        }
+        TF_AXIOM(_Partition("0-3", 2)
+                 == (std::vector<std::string>{"0,1", "2,3"}));
+        TF_AXIOM(_Partition(" 3, 0-1 ,1", 3)
+                 == (std::vector<std::string>{"0", "1", "3"}));
+        TF_AXIOM(_Partition("0-2", 2)
+                 == (std::vector<std::string>{"0", "1,2"}));
+        TF_AXIOM(_Partition("0-3,999999", 1)
+                 == std::vector<std::string>{"0,1,2,3"});
+    }
+
+    // The tiles must cover every pixel of the image exactly once.
+    void TestSplitIntoTiles()
+    {
+        const int sizes[][3] = {
+            {100, 50, 8}, {1920, 1080, 16}, {3, 1, 16}, {1, 1, 4},
+            {7, 13, 0}, {640, 480, 1}, {33, 2000, 5}
+        };
+        for (const auto& size : sizes)
+        {
+            const int width = size[0];
+            const int height = size[1];
+            const std::vector<HdNukeTile> tiles = HdNukeSplitIntoTiles(
+                width, height, size[2]);
+            TF_AXIOM(not tiles.empty());
+
+            std::vector<int> coverage(static_cast<size_t>(width) * height, 0);
+            for (const HdNukeTile& tile : tiles)
+            {
+                TF_AXIOM(tile.x0 >= 0 and tile.x0 < tile.x1
+                         and tile.x1 <= width);
+                TF_AXIOM(tile.y0 >= 0 and tile.y0 < tile.y1
+                         and tile.y1 <= height);
+                for (int y = tile.y0; y < tile.y1; y++)
+                {
+                    for (int x = tile.x0; x < tile.x1; x++)
+                    {
+                        coverage[static_cast<size_t>(y) * width + x]++;
+                    }
+                }
+            }
+            for (int count : coverage)
+            {
+                TF_AXIOM(count == 1);
+            }
+        }
+
+        TF_AXIOM(HdNukeSplitIntoTiles(100, 50, 8).size() == 8);
+        TF_AXIOM(HdNukeSplitIntoTiles(3, 1, 16).size() == 3);
+    }
+
+    bool _IsClose(const GfVec3d& a, const GfVec3d& b)
+    {
+        return (a - b).GetLength() < 1e-9;
+    }
+
+    // A tile's projection maps the tile's corners to those of the full
+    // image's normalized device coordinates.
+    void TestTileProjection()
+    {
+        GfMatrix4d projection;
+        projection.SetScale(GfVec3d(2.0, 3.0, 1.0));
+
+        TF_AXIOM(HdNukeTileProjection(projection, {0, 0, 100, 50}, 100, 50)
+                 == projection);
+
+        // The bottom left quarter, and the top right one.
+        const GfMatrix4d bottomLeft = HdNukeTileProjection(
+            GfMatrix4d(1), {0, 0, 50, 25}, 100, 50);
+        TF_AXIOM(_IsClose(bottomLeft.Transform(GfVec3d(-1, -1, 0)),
+                          GfVec3d(-1, -1, 0)));
+        TF_AXIOM(_IsClose(bottomLeft.Transform(GfVec3d(0, 0, 0)),
+                          GfVec3d(1, 1, 0)));
+
+        const GfMatrix4d topRight = HdNukeTileProjection(
+            GfMatrix4d(1), {50, 25, 100, 50}, 100, 50);
+        TF_AXIOM(_IsClose(topRight.Transform(GfVec3d(0, 0, 0)),
+                          GfVec3d(-1, -1, 0)));
+        TF_AXIOM(_IsClose(topRight.Transform(GfVec3d(1, 1, 0)),
+                          GfVec3d(1, 1, 0)));
+
+        // The window is applied after the camera's projection.
+        const GfMatrix4d scaled = HdNukeTileProjection(
+            projection, {0, 0, 50, 25}, 100, 50);
+        TF_AXIOM(_IsClose(scaled.Transform(GfVec3d(-0.5, -1.0 / 3.0, 0)),
+                          GfVec3d(-1, -1, 0)));
+    }
+}  // namespace
+
+
+int
+main(int argc, char* argv[])
+{
+    TestPartitionCpus();
+    TestSplitIntoTiles();
+    TestTileProjection();
+
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,280 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include <pxr/pxr.h>
+
+#include <pxr/base/gf/vec3f.h>
+#include <pxr/base/tf/diagnostic.h>
+#include <pxr/base/tf/errorMark.h>
+#include <pxr/base/tf/stringUtils.h>
+
+#include <pxr/imaging/hd/changeTracker.h>
+#include <pxr/imaging/hd/light.h>
+#include <pxr/imaging/hd/renderIndex.h>
+#include <pxr/imaging/hd/tokens.h>
+
+#include <DDImage/GeometryList.h>
+
+#include <hdNuke/geoAdapter.h>
+#include <hdNuke/sceneData.h>
+#include <hdNuke/sceneDelegate.h>
+
+#include "standInRenderDelegate.h"
+#include "testGeometry.h"
+
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+
+// Checks that display color and light parameter overrides (as set for wedges)
+// only dirty the prims they apply to, in the render index of the delegate they
+// are set on, and leave the scene data shared between delegates alone.
+namespace
+{
+    class _TestDelegate : public HdNukeSceneDelegate
+    {
+    public:
+        using HdNukeSceneDelegate::HdNukeSceneDelegate;
+
+        void AddGeo(const SdfPath& id, const HdNukeGeoAdapterPtr& adapter)
+        {
+            GetRenderIndex().InsertRprim(HdPrimTypeTokens->mesh, this, id);
+            _RegisterAdapter(id, _PrimHandle::Geo, adapter);
+        }
+
+        // Only overridden parameters are queried, so the lights need no op.
+        void AddLight(const SdfPath& id)
+        {
+            GetRenderIndex().InsertSprim(HdPrimTypeTokens->sphereLight, this,
+                                         id);
+            _RegisterHydraLight(id, nullptr);
+        }
+    };
+
+    // A render index with the same prims as every other one sharing the
+    // scene data. Members are destroyed in reverse, so the delegate goes
+    // before its render index.
+    struct _Index
+    {
+        StandInRenderDelegate renderDelegate;
+        std::unique_ptr<HdRenderIndex> renderIndex;
+        std::unique_ptr<_TestDelegate> delegate;
+
+        _Index(const HdNukeSceneDataPtr& sceneData,
+               const std::vector<SdfPath>& geoIds,
+               const std::vector<HdNukeGeoAdapterPtr>& adapters,
+               const std::vector<SdfPath>& lightIds)
+            : renderIndex(HdRenderIndex::New(&renderDelegate))
+        {
+            delegate.reset(new _TestDelegate(renderIndex.get(), sceneData));
+            for (size_t i = 0; i < geoIds.size(); i++)
+            {
+                delegate->AddGeo(geoIds[i], adapters[i]);
+            }
+            for (const SdfPath& lightId : lightIds)
+            {
+                delegate->AddLight(lightId);
+            }
+        }
+
+        HdChangeTracker& Tracker() {
+            return renderIndex->GetChangeTracker();
+        }
+
+        void MarkClean(const std::vector<SdfPath>& geoIds,
+                       const std::vector<SdfPath>& lightIds)
+        {
+            for (const SdfPath& id : geoIds)
+            {
+                Tracker().MarkRprimClean(id);
+            }
+            for (const SdfPath& id : lightIds)
+            {
+                Tracker().MarkSprimClean(id);
+            }
+        }
+
+        // The bits a sync would have to update, without the varying state.
+        HdDirtyBits RprimBits(const SdfPath& id) {
+            return Tracker().GetRprimDirtyBits(id) & ~HdChangeTracker::Varying;
+        }
+        HdDirtyBits SprimBits(const SdfPath& id) {
+            return Tracker().GetSprimDirtyBits(id);
+        }
+    };
+
+    struct _Scene
+    {
+        DD::Image::GeometryList geometry;
+        AdapterSharedState sharedState;
+        HdNukeSceneDataPtr sceneData;
+        std::vector<SdfPath> geoIds;
+        std::vector<HdNukeGeoAdapterPtr> adapters;
+        std::vector<SdfPath> lightIds;
+
+        _Scene()
+            : sceneData(std::make_shared<HdNukeSceneData>())
+        {
+            const HdNukeDelegateConfig& config = sceneData->GetConfig();
+            for (int obj = 0; obj < 2; obj++)
+            {
+                BuildTestGrid(geometry, obj, 4);
+                adapters.push_back(
+                    std::make_shared<HdNukeGeoAdapter>(&sharedState));
+                adapters.back()->Update(geometry[obj],
+                                        HdChangeTracker::AllDirty, false);
+                geoIds.push_back(config.GeoRoot().AppendChild(
+                    TfToken(TfStringPrintf("grid%d", obj))));
+            }
+            lightIds.push_back(
+                config.HydraLightRoot().AppendChild(TfToken("Key")));
+            lightIds.push_back(
+                config.HydraLightRoot().AppendChild(TfToken("Fill")));
+        }
+
+        std::unique_ptr<_Index> MakeIndex()
+        {
+            return std::unique_ptr<_Index>(
+                new _Index(sceneData, geoIds, adapters, lightIds));
+        }
+    };
+
+    void TestDisplayColorOverride()
+    {
+        _Scene scene;
+        std::unique_ptr<_Index> overridden = scene.MakeIndex();
+        std::unique_ptr<_Index> other = scene.MakeIndex();
+        overridden->MarkClean(scene.geoIds, scene.lightIds);
+        other->MarkClean(scene.geoIds, scene.lightIds);
+
+        const uint64_t version = scene.sceneData->GetVersion();
+        const VtValue original =
+            scene.adapters[0]->Get(HdTokens->displayColor);
+        const GfVec3f color(1, 0, 0.5f);
+        TF_AXIOM(original != VtValue(color));
+
+        overridden->delegate->SetDisplayColorOverride(color);
+        for (size_t i = 0; i < scene.geoIds.size(); i++)
+        {
+            const SdfPath& id = scene.geoIds[i];
+            TF_AXIOM(overridden->RprimBits(id)
+                     == HdChangeTracker::DirtyPrimvar);
+            TF_AXIOM(other->RprimBits(id) == HdChangeTracker::Clean);
+
+            TF_AXIOM(overridden->delegate->Get(id, HdTokens->displayColor)
+                     == VtValue(color));
+            TF_AXIOM(other->delegate->Get(id, HdTokens->displayColor)
+                     == original);
+            TF_AXIOM(scene.adapters[i]->Get(HdTokens->displayColor)
+                     == original);
+        }
+        for (const SdfPath& id : scene.lightIds)
+        {
+            TF_AXIOM(overridden->SprimBits(id) == HdLight::Clean);
+        }
+
+        // Setting the same color again changes nothing.
+        overridden->MarkClean(scene.geoIds, scene.lightIds);
+        overridden->delegate->SetDisplayColorOverride(color);
+        for (const SdfPath& id : scene.geoIds)
+        {
+            TF_AXIOM(overridden->RprimBits(id) == HdChangeTracker::Clean);
+        }
+
+        overridden->delegate->ClearDisplayColorOverride();
+        for (const SdfPath& id : scene.geoIds)
+        {
+            TF_AXIOM(overridden->RprimBits(id)
+                     == HdChangeTracker::DirtyPrimvar);
+            TF_AXIOM(other->RprimBits(id) == HdChangeTracker::Clean);
+            TF_AXIOM(overridden->delegate->Get(id, HdTokens->displayColor)
+                     == original);
+        }
+
+        TF_AXIOM(scene.sceneData->GetVersion() == version);
+    }
+
+    void TestLightParamOverride()
+    {
+        _Scene scene;
+        std::unique_ptr<_Index> overridden = scene.MakeIndex();
+        std::unique_ptr<_Index> other = scene.MakeIndex();
+        overridden->MarkClean(scene.geoIds, scene.lightIds);
+        other->MarkClean(scene.geoIds, scene.lightIds);
+
+        const uint64_t version = scene.sceneData->GetVersion();
+        const SdfPath& key = scene.lightIds[0];
+        const SdfPath& fill = scene.lightIds[1];
+
+        // Lights are found by their node name.
+        TF_AXIOM(overridden->delegate->FindLightId("Key") == key);
+
+        overridden->delegate->SetLightParamOverride(
+            key, HdLightTokens->intensity, VtValue(2.0f));
+        TF_AXIOM(overridden->SprimBits(key) == HdLight::DirtyParams);
+        TF_AXIOM(overridden->SprimBits(fill) == HdLight::Clean);
+        TF_AXIOM(other->SprimBits(key) == HdLight::Clean);
+        for (const SdfPath& id : scene.geoIds)
+        {
+            TF_AXIOM(overridden->RprimBits(id) == HdChangeTracker::Clean);
+        }
+        TF_AXIOM(overridden->delegate->GetLightParamValue(
+                     key, HdLightTokens->intensity) == VtValue(2.0f));
+
+        // Only lights whose overrides change are dirtied again.
+        overridden->MarkClean(scene.geoIds, scene.lightIds);
+        overridden->delegate->SetLightParamOverride(
+            key, HdLightTokens->intensity, VtValue(2.0f));
+        TF_AXIOM(overridden->SprimBits(key) == HdLight::Clean);
+        overridden->delegate->SetLightParamOverride(
+            fill, HdLightTokens->exposure, VtValue(-1.0f));
+        TF_AXIOM(overridden->SprimBits(key) == HdLight::Clean);
+        TF_AXIOM(overridden->SprimBits(fill) == HdLight::DirtyParams);
+
+        // Overrides of lights that aren't in the index are kept, but have
+        // nothing to dirty.
+        TfErrorMark errorMark;
+        const SdfPath missing =
+            scene.sceneData->GetConfig().HydraLightRoot().AppendChild(
+                TfToken("Rim"));
+        overridden->delegate->SetLightParamOverride(
+            missing, HdLightTokens->intensity, VtValue(0.5f));
+        TF_AXIOM(errorMark.IsClean());
+
+        overridden->MarkClean(scene.geoIds, scene.lightIds);
+        overridden->delegate->ClearLightParamOverrides();
+        TF_AXIOM(overridden->SprimBits(key) == HdLight::DirtyParams);
+        TF_AXIOM(overridden->SprimBits(fill) == HdLight::DirtyParams);
+        TF_AXIOM(other->SprimBits(key) == HdLight::Clean);
+        TF_AXIOM(other->SprimBits(fill) == HdLight::Clean);
+        TF_AXIOM(errorMark.IsClean());
+
+        TF_AXIOM(scene.sceneData->GetVersion() == version);
+    }
+}  // namespace
+
+
+int
+main(int argc, char* argv[])
+{
+    TestDisplayColorOverride();
+    TestLightParamOverride();
+
+    printf("OK\n");
+    return 0;
+}
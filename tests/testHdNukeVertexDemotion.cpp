@@ -0,0 +1,205 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <algorithm>
+#include <cstdio>
+
+#include <pxr/pxr.h>
+
+#include <pxr/base/tf/diagnostic.h>
+#include <pxr/base/vt/array.h>
+#include <pxr/base/vt/types.h>
+
+#include <pxr/imaging/hd/changeTracker.h>
+#include <pxr/imaging/hd/tokens.h>
+
+#include <DDImage/GeometryList.h>
+
+#include <hdNuke/geoAdapter.h>
+#include <hdNuke/tokens.h>
+
+#include "testGeometry.h"
+
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+
+// Checks that face-varying primvars are only demoted to vertex ones if every
+// corner of each point agrees, and that the cached result of the check is
+// dropped when the attributes change.
+namespace
+{
+    const int _GridSize = 4;
+    const int _RowPoints = _GridSize + 1;
+    const int _NumPoints = _RowPoints * _RowPoints;
+
+    const TfToken _heightToken("height");
+
+    // The point of each corner of the test grid's quads, in vertex order.
+    int _CornerPoint(unsigned vertex)
+    {
+        static const int offsets[] = {0, 1, 1 + _RowPoints, _RowPoints};
+        const int quad = static_cast<int>(vertex / 4);
+        const int x = quad % _GridSize;
+        const int y = quad / _GridSize;
+        return y * _RowPoints + x + offsets[vertex % 4];
+    }
+
+    // Sets a face-varying "height" on the grid. If `perPoint`, every corner
+    // of a point gets the point's height.
+    void _SetHeights(DD::Image::GeometryList& geometry, bool perPoint)
+    {
+        DD::Image::Attribute* heights = geometry.writable_attribute(
+            0, DD::Image::Group_Vertices, "height", DD::Image::FLOAT_ATTRIB);
+        for (unsigned i = 0; i < heights->size(); i++)
+        {
+            heights->flt(i) = perPoint
+                ? 0.5f * static_cast<float>(_CornerPoint(i))
+                : static_cast<float>(i);
+        }
+    }
+
+    bool _HasPrimvar(const HdNukeGeoAdapter& adapter, const TfToken& name,
+                     HdInterpolation interpolation)
+    {
+        const HdPrimvarDescriptorVector& descriptors =
+            adapter.GetPrimvarDescriptors(interpolation);
+        return std::any_of(descriptors.begin(), descriptors.end(),
+                           [&name](const HdPrimvarDescriptor& descriptor) {
+            return descriptor.name == name;
+        });
+    }
+
+    void _CheckDemotedHeights(const HdNukeGeoAdapter& adapter)
+    {
+        TF_AXIOM(_HasPrimvar(adapter, _heightToken, HdInterpolationVertex));
+        TF_AXIOM(not _HasPrimvar(adapter, _heightToken,
+                                 HdInterpolationFaceVarying));
+
+        const VtValue value = adapter.Get(_heightToken);
+        TF_AXIOM(value.IsHolding<VtFloatArray>());
+        const VtFloatArray& heights = value.UncheckedGet<VtFloatArray>();
+        TF_AXIOM(heights.size() == static_cast<size_t>(_NumPoints));
+        for (int point = 0; point < _NumPoints; point++)
+        {
+            TF_AXIOM(heights[point] == 0.5f * static_cast<float>(point));
+        }
+    }
+
+    void _CheckFaceVaryingHeights(const HdNukeGeoAdapter& adapter)
+    {
+        TF_AXIOM(_HasPrimvar(adapter, _heightToken,
+                             HdInterpolationFaceVarying));
+        TF_AXIOM(not _HasPrimvar(adapter, _heightToken, HdInterpolationVertex));
+
+        const VtValue value = adapter.Get(_heightToken);
+        TF_AXIOM(value.IsHolding<VtFloatArray>());
+        const VtFloatArray& heights = value.UncheckedGet<VtFloatArray>();
+        TF_AXIOM(heights.size() == static_cast<size_t>(4 * _GridSize * _GridSize));
+        for (size_t i = 0; i < heights.size(); i++)
+        {
+            TF_AXIOM(heights[i] == static_cast<float>(i));
+        }
+    }
+
+    void TestDemotion()
+    {
+        DD::Image::GeometryList geometry;
+        BuildTestGrid(geometry, 0, _GridSize);
+        _SetHeights(geometry, true);
+
+        AdapterSharedState state;
+        HdNukeGeoAdapter adapter(&state);
+        adapter.Update(geometry[0], HdChangeTracker::AllDirty, false, 1);
+
+        _CheckDemotedHeights(adapter);
+
+        // The grid's uvs differ between the quads sharing a point.
+        TF_AXIOM(_HasPrimvar(adapter, HdNukeTokens->st,
+                             HdInterpolationFaceVarying));
+        TF_AXIOM(not _HasPrimvar(adapter, HdNukeTokens->st,
+                                 HdInterpolationVertex));
+        const VtValue uvs = adapter.Get(HdNukeTokens->st);
+        TF_AXIOM(uvs.IsHolding<VtVec2fArray>());
+        TF_AXIOM(uvs.GetArraySize() == static_cast<size_t>(4 * _GridSize
+                                                           * _GridSize));
+    }
+
+    void TestChangedAttributes()
+    {
+        DD::Image::GeometryList geometry;
+        BuildTestGrid(geometry, 0, _GridSize);
+        _SetHeights(geometry, true);
+
+        AdapterSharedState state;
+        HdNukeGeoAdapter adapter(&state);
+        adapter.Update(geometry[0], HdChangeTracker::AllDirty, false, 1);
+        _CheckDemotedHeights(adapter);
+
+        // The corners no longer agree. With a new attributes hash, the cached
+        // check is dropped even though the topology is the same.
+        _SetHeights(geometry, false);
+        adapter.Update(geometry[0], HdChangeTracker::DirtyPrimvar, false, 2);
+        _CheckFaceVaryingHeights(adapter);
+
+        // And once they agree again, the primvar is demoted again.
+        _SetHeights(geometry, true);
+        adapter.Update(geometry[0], HdChangeTracker::DirtyPrimvar, false, 3);
+        _CheckDemotedHeights(adapter);
+
+        // Without a hash, the corners are always checked.
+        _SetHeights(geometry, false);
+        adapter.Update(geometry[0], HdChangeTracker::DirtyPrimvar, false, 0);
+        _CheckFaceVaryingHeights(adapter);
+        _SetHeights(geometry, true);
+        adapter.Update(geometry[0], HdChangeTracker::DirtyPrimvar, false, 0);
+        _CheckDemotedHeights(adapter);
+    }
+
+    // While the hash is unchanged, the attributes are taken to be too, so
+    // the corners aren't compared again. Rebuilding the topology drops the
+    // cached check as well.
+    void TestUnchangedAttributes()
+    {
+        DD::Image::GeometryList geometry;
+        BuildTestGrid(geometry, 0, _GridSize);
+        _SetHeights(geometry, false);
+
+        AdapterSharedState state;
+        HdNukeGeoAdapter adapter(&state);
+        adapter.Update(geometry[0], HdChangeTracker::AllDirty, false, 1);
+        _CheckFaceVaryingHeights(adapter);
+
+        _SetHeights(geometry, true);
+        adapter.Update(geometry[0], HdChangeTracker::DirtyPrimvar, false, 1);
+        TF_AXIOM(_HasPrimvar(adapter, _heightToken,
+                             HdInterpolationFaceVarying));
+
+        adapter.Update(geometry[0], HdChangeTracker::DirtyTopology
+                                    | HdChangeTracker::DirtyPrimvar, false, 1);
+        _CheckDemotedHeights(adapter);
+    }
+}  // namespace
+
+
+int
+main(int argc, char* argv[])
+{
+    TestDemotion();
+    TestChangedAttributes();
+    TestUnchangedAttributes();
+
+    printf("OK\n");
+    return 0;
+}
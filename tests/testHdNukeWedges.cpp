@@ -0,0 +1,113 @@
+// Copyright 2019-present Nathan Rusch
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <pxr/pxr.h>
+
+#include <pxr/base/tf/diagnostic.h>
+
+#include <hdNuke/wedges.h>
+
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+
+namespace
+{
+    bool _IsOverride(const HdNukeWedgeOverride& wedgeOverride,
+                     HdNukeWedgeOverride::Kind kind, const std::string& name,
+                     const std::string& param, const std::string& value)
+    {
+        return wedgeOverride.kind == kind and wedgeOverride.name == name
+            and wedgeOverride.param == TfToken(param)
+            and wedgeOverride.value == value;
+    }
+
+    void TestParseVariants()
+    {
+        TF_AXIOM(HdNukeParseWedges("").empty());
+
+        // Empty lines and comments are skipped, and every other line is a
+        // variant, even if none of its overrides are valid.
+        const auto variants = HdNukeParseWedges(
+            "# Exposure\n"
+            "\n"
+            "  exposure 1  \n"
+            "exposure 2; samples 64\n"
+            "   # Indented comment\n"
+            "bogus\n");
+        TF_AXIOM(variants.size() == 3);
+
+        TF_AXIOM(variants[0].size() == 1);
+        TF_AXIOM(_IsOverride(variants[0][0], HdNukeWedgeOverride::Setting,
+                             "exposure", "", "1"));
+
+        TF_AXIOM(variants[1].size() == 2);
+        TF_AXIOM(_IsOverride(variants[1][0], HdNukeWedgeOverride::Setting,
+                             "exposure", "", "2"));
+        TF_AXIOM(_IsOverride(variants[1][1], HdNukeWedgeOverride::Setting,
+                             "samples", "", "64"));
+
+        TF_AXIOM(variants[2].empty());
+    }
+
+    void TestParseOverrides()
+    {
+        const auto variants = HdNukeParseWedges(
+            "light Light1 intensity 2.5;"
+            " light /HdNuke/Lights/key color 1 0.5 0;"
+            " displayColor 0.2 0.4 0.6;"
+            " renderer:mode  fast   preview ;"
+            " ;"
+            " light Light1 intensity;"
+            " displayColor 1 1;"
+            " displayColor 1 1 1 1");
+        TF_AXIOM(variants.size() == 1);
+
+        const HdNukeWedgeVariant& variant = variants[0];
+        TF_AXIOM(variant.size() == 7);
+        TF_AXIOM(_IsOverride(variant[0], HdNukeWedgeOverride::Light,
+                             "Light1", "intensity", "2.5"));
+        TF_AXIOM(_IsOverride(variant[1], HdNukeWedgeOverride::Light,
+                             "/HdNuke/Lights/key", "color", "1 0.5 0"));
+        TF_AXIOM(_IsOverride(variant[2], HdNukeWedgeOverride::DisplayColor,
+                             "", "", "0.2 0.4 0.6"));
+        // Values are re-joined with single spaces.
+        TF_AXIOM(_IsOverride(variant[3], HdNukeWedgeOverride::Setting,
+                             "renderer:mode", "", "fast preview"));
+
+        // Light overrides without a value, and display colors without
+        // exactly three components, are taken for (unknown) settings.
+        TF_AXIOM(_IsOverride(variant[4], HdNukeWedgeOverride::Setting,
+                             "light", "", "Light1 intensity"));
+        TF_AXIOM(_IsOverride(variant[5], HdNukeWedgeOverride::Setting,
+                             "displayColor", "", "1 1"));
+        TF_AXIOM(_IsOverride(variant[6], HdNukeWedgeOverride::Setting,
+                             "displayColor", "", "1 1 1 1"));
+    }
+}  // namespace
+
+
+int
+main(int argc, char* argv[])
+{
+    TestParseVariants();
+    TestParseOverrides();
+
+    printf("OK\n");
+    return 0;
+}